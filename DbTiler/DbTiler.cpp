@@ -0,0 +1,92 @@
+// DbTiler.cpp : writes a model database as paged .osgb tiles, without a
+// display, for the viewer to page in.
+//
+
+#include "stdafx.h"
+#include <vector>
+#include <LODPolicy.h>
+#include "ModelTiler.h"
+
+// as in GeometryUtility.cpp, which needs MFC
+osg::Vec4 CvtColor(int color)
+{
+	unsigned char b = color & 0xff;
+	color >>= 8;
+	unsigned char g = color & 0xff;
+	color >>= 8;
+	unsigned char r = color & 0xff;
+	color >>= 8;
+	unsigned char a = color & 0xff;
+	return osg::Vec4(r / 256.0, g / 256.0, b / 256.0, a / 256.0);
+}
+
+void PrintUsage()
+{
+	printf("usage: DbTiler <model.db> <out.osgb> [-tile size] [-threads n] [-divisions 5,8,12] [-tolerance pixels] [-nocache]\n");
+}
+
+bool ParseDivisions(const char *arg, std::vector<int> &divisions)
+{
+	divisions.clear();
+	while (*arg != '\0')
+	{
+		char *end = NULL;
+		long division = strtol(arg, &end, 10);
+		if (end == arg || division <= 0)
+			return false;
+		divisions.push_back((int)division);
+		if (*end == ',')
+			arg = end + 1;
+		else if (*end == '\0')
+			arg = end;
+		else
+			return false;
+	}
+	return !divisions.empty();
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 3)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	ModelTiler tiler(argv[1], argv[2]);
+	for (int i = 3; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "-tile") == 0 && i + 1 < argc)
+			tiler.setTileSize(atof(argv[++i]));
+		else if (strcmp(argv[i], "-threads") == 0 && i + 1 < argc)
+			tiler.setNumThreads(atoi(argv[++i]));
+		else if (strcmp(argv[i], "-divisions") == 0 && i + 1 < argc)
+		{
+			std::vector<int> divisions;
+			if (!ParseDivisions(argv[++i], divisions))
+			{
+				printf("bad division list %s\n", argv[i]);
+				return 1;
+			}
+			tiler.setDivisions(divisions);
+		}
+		else if (strcmp(argv[i], "-tolerance") == 0 && i + 1 < argc)
+			Geometry::LODPolicy::instance()->setPixelTolerance((float)atof(argv[++i]));
+		else if (strcmp(argv[i], "-nocache") == 0)
+			tiler.setUseCache(false);
+		else
+		{
+			printf("unknown option %s\n", argv[i]);
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	if (!tiler.run())
+	{
+		printf("%s\n", tiler.getErrorMessage());
+		return 1;
+	}
+	printf("%s", tiler.getReport().c_str());
+	return 0;
+}
@@ -0,0 +1,399 @@
+#include "stdafx.h"
+#include "ModelTiler.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
+#include <functional>
+#include <osg/PagedLOD>
+#include <osg/Timer>
+#include <osg/Transform>
+#include <osgDB/FileNameUtils>
+#include <osgDB/ReadFile>
+#include <osgDB/Registry>
+#include <osgDB/WriteFile>
+#include <osgUtil/Optimizer>
+#include <osgUtil/TransformAttributeFunctor>
+#include <OpenThreads/Atomic>
+#include <OpenThreads/Thread>
+
+#include <BaseGeometry.h>
+#include <LODPolicy.h>
+#include <PrototypeCache.h>
+#include "SqliteLoad.h"
+
+namespace
+{
+
+std::string Format(const char *format, ...)
+{
+	char buffer[512];
+	va_list args;
+	va_start(args, format);
+	vsnprintf(buffer, sizeof(buffer), format, args);
+	va_end(args);
+	buffer[sizeof(buffer) - 1] = '\0';
+	return buffer;
+}
+
+class WriteThread : public OpenThreads::Thread
+{
+public:
+	WriteThread(const std::function<void()> &func)
+		: m_func(func)
+	{
+	}
+
+	virtual void run()
+	{
+		m_func();
+	}
+
+private:
+	std::function<void()> m_func;
+};
+
+void RunThreads(unsigned int numThreads, const std::function<void()> &func)
+{
+	std::vector<WriteThread*> threads;
+	for (unsigned int i = 0; i < numThreads; ++i)
+	{
+		threads.push_back(new WriteThread(func));
+		threads.back()->start();
+	}
+	for (size_t i = 0; i < threads.size(); ++i)
+	{
+		threads[i]->join();
+		delete threads[i];
+	}
+}
+
+// every Geode of the scene with its world matrix
+class ItemCollector : public osg::NodeVisitor
+{
+public:
+	ItemCollector()
+		: osg::NodeVisitor(TRAVERSE_ALL_CHILDREN)
+	{
+	}
+
+	virtual void apply(osg::Geode &geode)
+	{
+		ModelTiler::Item item = { &geode, osg::computeLocalToWorld(getNodePath()) };
+		m_items.push_back(item);
+	}
+
+	std::vector<ModelTiler::Item> &getItems()
+	{
+		return m_items;
+	}
+
+private:
+	std::vector<ModelTiler::Item> m_items;
+};
+
+osg::BoundingBox GetWorldBound(const ModelTiler::Item &item)
+{
+	const osg::BoundingBox &box = item.geode->getBoundingBox();
+	osg::BoundingBox worldBox;
+	if (box.valid())
+	{
+		for (unsigned int i = 0; i < 8; ++i)
+			worldBox.expandBy(box.corner(i) * item.matrix);
+	}
+	return worldBox;
+}
+
+} // namespace
+
+bool ModelTiler::TileKey::operator<(const TileKey &other) const
+{
+	if (x != other.x)
+		return x < other.x;
+	if (y != other.y)
+		return y < other.y;
+	return z < other.z;
+}
+
+ModelTiler::ModelTiler(const std::string &dbPath, const std::string &outPath)
+	: m_dbPath(dbPath)
+	, m_outPath(outPath)
+	, m_tileSize(0.0)
+	, m_numThreads(0)
+	, m_useCache(true)
+	, m_gridSize(0.0)
+{
+}
+
+void ModelTiler::setTileSize(double tileSize)
+{
+	m_tileSize = tileSize;
+}
+
+void ModelTiler::setNumThreads(unsigned int numThreads)
+{
+	m_numThreads = numThreads;
+}
+
+void ModelTiler::setDivisions(const std::vector<int> &divisions)
+{
+	m_divisions = divisions;
+}
+
+void ModelTiler::setUseCache(bool useCache)
+{
+	m_useCache = useCache;
+}
+
+const char *ModelTiler::getErrorMessage() const
+{
+	return m_errorMessage.c_str();
+}
+
+const std::string &ModelTiler::getReport() const
+{
+	return m_report;
+}
+
+bool ModelTiler::run()
+{
+	m_errorMessage.clear();
+	m_report.clear();
+	m_gridSize = 0.0;
+
+	// loaded here, the plugin is not looked up from the writing threads
+	if (osgDB::Registry::instance()->getReaderWriterForExtension("osgb") == NULL)
+	{
+		setError("The osgb plugin is not found.");
+		return false;
+	}
+
+	std::vector<int> levels;
+	std::vector<float> levelPixelSizes;
+	Geometry::LODPolicy::instance()->getDivisionLevels(levels, levelPixelSizes);
+	std::vector<int> divisions = m_divisions.empty() ? levels : m_divisions;
+	std::sort(divisions.begin(), divisions.end());
+	divisions.erase(std::unique(divisions.begin(), divisions.end()), divisions.end());
+
+	std::vector<float> minPixelSizes;
+	for (size_t i = 0; i < divisions.size(); ++i)
+	{
+		std::vector<int>::const_iterator it = std::find(levels.begin(), levels.end(), divisions[i]);
+		if (it == levels.end())
+		{
+			setError(Format("Division %d is not a division level.", divisions[i]));
+			return false;
+		}
+		minPixelSizes.push_back(levelPixelSizes[it - levels.begin()]);
+	}
+	if (minPixelSizes.empty())
+	{
+		setError("No division to write.");
+		return false;
+	}
+	// the coarsest level written stands in for the ones left out below it
+	minPixelSizes[0] = 0.0f;
+
+	TileMap tiles;
+	for (size_t i = 0; i < divisions.size(); ++i)
+	{
+		if (!writeLevel(divisions[i], tiles))
+			return false;
+	}
+	return writeRoot(tiles, divisions, minPixelSizes);
+}
+
+bool ModelTiler::writeLevel(int division, TileMap &tiles)
+{
+	osg::Timer_t start = osg::Timer::instance()->tick();
+
+	Geometry::PrototypeCache::instance()->clear();
+	osg::ref_ptr<osg::Group> root = new osg::Group;
+	SqliteLoad load(root, m_dbPath, NULL);
+	// the primitives are drawn once while loading, before any cull could
+	// pick their division
+	load.setDivision(division);
+	load.setNumThreads(m_numThreads);
+	load.setUseCache(m_useCache);
+	if (!load.doLoad())
+	{
+		setError(load.getErrorMessage());
+		return false;
+	}
+	osg::Timer_t loaded = osg::Timer::instance()->tick();
+
+	ItemCollector collector;
+	root->accept(collector);
+	std::vector<Item> &items = collector.getItems();
+
+	std::vector<osg::BoundingBox> bounds(items.size());
+	osg::BoundingBox modelBound;
+	for (size_t i = 0; i < items.size(); ++i)
+	{
+		bounds[i] = GetWorldBound(items[i]);
+		modelBound.expandBy(bounds[i]);
+	}
+	if (m_gridSize <= 0.0)
+	{
+		if (!modelBound.valid())
+		{
+			setError("The model is empty.");
+			return false;
+		}
+		m_origin = modelBound._min;
+		m_gridSize = m_tileSize;
+		if (m_gridSize <= 0.0)
+		{
+			osg::Vec3 size = modelBound._max - modelBound._min;
+			m_gridSize = std::max(std::max(size.x(), size.y()), size.z()) / 8.0;
+		}
+		if (m_gridSize <= 0.0)
+			m_gridSize = 1.0;
+	}
+
+	// a primitive goes to the tile its center is in
+	for (size_t i = 0; i < items.size(); ++i)
+	{
+		if (!bounds[i].valid())
+			continue;
+		osg::Vec3d offset = osg::Vec3d(bounds[i].center()) - m_origin;
+		TileKey key = { (int)floor(offset.x() / m_gridSize), (int)floor(offset.y() / m_gridSize),
+			(int)floor(offset.z() / m_gridSize) };
+		Tile &tile = tiles[key];
+		tile.bound.expandBy(bounds[i]);
+		tile.items.push_back(items[i]);
+	}
+	items.clear();
+	root = NULL;
+
+	std::vector<TileMap::iterator> jobs;
+	for (TileMap::iterator it = tiles.begin(); it != tiles.end(); ++it)
+	{
+		if (!it->second.items.empty())
+			jobs.push_back(it);
+	}
+
+	unsigned int numPrimitives = 0;
+	for (size_t i = 0; i < jobs.size(); ++i)
+		numPrimitives += (unsigned int)jobs[i]->second.items.size();
+
+	// the first tile is written on this thread: the osgb serializers are
+	// registered the first time they are looked up
+	OpenThreads::Atomic numFailed;
+	if (!jobs.empty() && !writeTile(jobs[0]->first, jobs[0]->second, division))
+		++numFailed;
+
+	unsigned int numThreads = m_numThreads == 0 ? OpenThreads::GetNumberOfProcessors() : m_numThreads;
+	OpenThreads::Atomic nextJob(1);
+	RunThreads(std::max(1u, std::min(numThreads, (unsigned int)jobs.size())), [&]() {
+		for (;;)
+		{
+			size_t i = static_cast<size_t>(++nextJob - 1);
+			if (i >= jobs.size())
+				break;
+			if (!writeTile(jobs[i]->first, jobs[i]->second, division))
+				++numFailed;
+		}
+	});
+
+	for (size_t i = 0; i < jobs.size(); ++i)
+		jobs[i]->second.items.clear();
+
+	if (numFailed > 0)
+	{
+		setError(Format("Failed to write %u tiles of division %d.", (unsigned int)numFailed, division));
+		return false;
+	}
+
+	osg::Timer_t written = osg::Timer::instance()->tick();
+	m_report += Format("division %d: %u tiles, %u primitives, load %.2f s, write %.2f s\n", division,
+		(unsigned int)jobs.size(), numPrimitives, osg::Timer::instance()->delta_s(start, loaded),
+		osg::Timer::instance()->delta_s(loaded, written));
+	return true;
+}
+
+bool ModelTiler::writeTile(const TileKey &key, const Tile &tile, int division)
+{
+	osg::ref_ptr<osg::Geode> geode = new osg::Geode;
+	for (size_t i = 0; i < tile.items.size(); ++i)
+	{
+		const Item &item = tile.items[i];
+		for (unsigned int j = 0; j < item.geode->getNumDrawables(); ++j)
+		{
+			const osg::Geometry *geometry = item.geode->getDrawable(j)->asGeometry();
+			if (geometry == NULL)
+				continue;
+
+			// A plain osg::Geometry, the primitive classes have no serializers.
+			// The primitive sets are copied too: prototypes share them and
+			// merging offsets their indices.
+			osg::ref_ptr<osg::Geometry> copy = new osg::Geometry(*geometry,
+				osg::CopyOp::DEEP_COPY_ARRAYS | osg::CopyOp::DEEP_COPY_PRIMITIVES);
+			copy->setUpdateCallback(NULL);
+			copy->setCullCallback(NULL);
+			if (!item.matrix.isIdentity())
+			{
+				osgUtil::TransformAttributeFunctor functor(item.matrix);
+				copy->accept(functor);
+				copy->dirtyBound();
+				// the normals are unit again, the prototype state only
+				// normalized them
+				copy->setStateSet(NULL);
+			}
+			copy->setDataVariance(osg::Object::STATIC);
+			copy->setUseDisplayList(false);
+			copy->setUseVertexBufferObjects(true);
+			geode->addDrawable(copy);
+		}
+	}
+
+	osgUtil::Optimizer optimizer;
+	optimizer.optimize(geode, osgUtil::Optimizer::MERGE_GEOMETRY);
+	return osgDB::writeNodeFile(*geode, osgDB::concatPaths(osgDB::getFilePath(m_outPath), getTileName(key, division)));
+}
+
+// The PagedLOD ranges are pixel sizes of the tile. A tile is at least as large
+// as each of its primitives, so they are never drawn coarser than the viewer
+// would draw them.
+bool ModelTiler::writeRoot(const TileMap &tiles, const std::vector<int> &divisions,
+	const std::vector<float> &minPixelSizes)
+{
+	osg::ref_ptr<osg::Group> root = new osg::Group;
+	for (TileMap::const_iterator it = tiles.begin(); it != tiles.end(); ++it)
+	{
+		osg::ref_ptr<osg::PagedLOD> lod = new osg::PagedLOD;
+		lod->setCenterMode(osg::LOD::USER_DEFINED_CENTER);
+		lod->setCenter(it->second.bound.center());
+		lod->setRadius(it->second.bound.radius());
+		lod->setRangeMode(osg::LOD::PIXEL_SIZE_ON_SCREEN);
+		// the file names are relative, the reader takes the directory of
+		// the root file as database path
+		for (size_t i = 0; i < divisions.size(); ++i)
+		{
+			float maxPixelSize = i + 1 < divisions.size() ? minPixelSizes[i + 1] : FLT_MAX;
+			lod->setFileName((unsigned int)i, getTileName(it->first, divisions[i]));
+			lod->setRange((unsigned int)i, minPixelSizes[i], maxPixelSize);
+		}
+		root->addChild(lod);
+	}
+
+	if (!osgDB::writeNodeFile(*root, m_outPath))
+	{
+		setError("Failed to write " + m_outPath + ".");
+		return false;
+	}
+	m_report += Format("%u tiles of %.3f in %s\n", (unsigned int)tiles.size(), m_gridSize, m_outPath.c_str());
+	return true;
+}
+
+std::string ModelTiler::getTileName(const TileKey &key, int division) const
+{
+	std::string name = osgDB::getSimpleFileName(osgDB::getNameLessExtension(m_outPath));
+	return Format("%s_%d_%d_%d_%d.osgb", name.c_str(), key.x, key.y, key.z, division);
+}
+
+void ModelTiler::setError(const std::string &msg)
+{
+	m_errorMessage = msg;
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include <map>
+#include <string>
+#include <vector>
+#include <osg/BoundingSphere>
+#include <osg/Geode>
+#include <osg/Matrixd>
+#include <osg/ref_ptr>
+
+// Loads a model database once per division level and writes it as a paged
+// .osgb hierarchy the viewer opens like any other model: the root file holds
+// one PagedLOD per tile of a regular grid, and every level of a tile is a
+// file of its own with the primitives tessellated at that division, baked to
+// world space and merged by color. A level is paged in once the tile covers
+// the pixel sizes the viewer would draw its primitives at that division, see
+// Geometry::LODPolicy::getDivisionLevels().
+class ModelTiler
+{
+public:
+	ModelTiler(const std::string &dbPath, const std::string &outPath);
+
+	// Edge of a tile in model units, 0 (default) splits the longest side of
+	// the model in 8.
+	void setTileSize(double tileSize);
+	// Threads loading and writing the tiles, 0 (default) uses one per core.
+	void setNumThreads(unsigned int numThreads);
+	// Divisions written, a subset of the levels of
+	// LODPolicy::getDivisionLevels(); all of them by default.
+	void setDivisions(const std::vector<int> &divisions);
+	// Passed on to SqliteLoad::setUseCache(), on by default.
+	void setUseCache(bool useCache);
+
+	bool run();
+	const char *getErrorMessage() const;
+	// tiles, primitives and times of each level of the last run()
+	const std::string &getReport() const;
+
+	// a primitive of a level, drawn by geode at matrix
+	struct Item
+	{
+		osg::ref_ptr<osg::Geode> geode;
+		osg::Matrixd matrix;
+	};
+
+private:
+	struct TileKey
+	{
+		int x, y, z;
+		bool operator<(const TileKey &other) const;
+	};
+
+	struct Tile
+	{
+		osg::BoundingSphere bound;
+		std::vector<Item> items;
+	};
+
+	typedef std::map<TileKey, Tile> TileMap;
+
+	bool writeLevel(int division, TileMap &tiles);
+	bool writeTile(const TileKey &key, const Tile &tile, int division);
+	bool writeRoot(const TileMap &tiles, const std::vector<int> &divisions, const std::vector<float> &minPixelSizes);
+	std::string getTileName(const TileKey &key, int division) const;
+	void setError(const std::string &msg);
+
+private:
+	std::string m_dbPath;
+	std::string m_outPath;
+	double m_tileSize;
+	unsigned int m_numThreads;
+	std::vector<int> m_divisions;
+	bool m_useCache;
+	// grid of the last run(), taken from the first level
+	osg::Vec3d m_origin;
+	double m_gridSize;
+	std::string m_errorMessage;
+	std::string m_report;
+};
@@ -0,0 +1,19 @@
+// stdafx.h : include file for standard system include files,
+// or project specific include files that are used frequently, but
+// are changed infrequently
+//
+
+#pragma once
+
+#include "targetver.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define _USE_MATH_DEFINES
+#include <cmath>
+
+#include <osg/Geode>
+#include <osg/Geometry>
+#include <osg/Group>
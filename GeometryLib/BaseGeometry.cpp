@@ -1,15 +1,72 @@
 #include "stdafx.h"
 #include "BaseGeometry.h"
+#include <cstring>
+#include <osg/TriangleIndexFunctor>
+#include "LODPolicy.h"
+#include "LODStats.h"
 
 namespace Geometry
 {
 
 const int g_defaultDivision = 8;
 
+namespace
+{
+
+struct TriangleCollector
+{
+	std::vector<GLuint> *indices;
+	GLuint offset;
+
+	void operator()(unsigned int p1, unsigned int p2, unsigned int p3)
+	{
+		indices->push_back(offset + p1);
+		indices->push_back(offset + p2);
+		indices->push_back(offset + p3);
+	}
+};
+
+// FNV-1a over the bits, -0 hashed as 0 since they compare equal
+inline size_t HashFloat(size_t hash, float value)
+{
+	unsigned int bits = 0;
+	if (value != 0.0f)
+		memcpy(&bits, &value, sizeof(bits));
+	return (hash ^ bits) * 16777619u;
+}
+
+inline size_t HashVertex(const osg::Vec3 &vertex, const osg::Vec3 &normal)
+{
+	size_t hash = 2166136261u;
+	for (int i = 0; i < 3; ++i)
+		hash = HashFloat(hash, vertex[i]);
+	for (int i = 0; i < 3; ++i)
+		hash = HashFloat(hash, normal[i]);
+	return hash ^ (hash >> 15);
+}
+
+template<class DrawElements>
+DrawElements *CreateElements(const std::vector<GLuint> &indices)
+{
+	DrawElements *drawEle = new DrawElements(osg::PrimitiveSet::TRIANGLES);
+	drawEle->reserve(indices.size());
+	for (size_t i = 0; i < indices.size(); ++i)
+		drawEle->push_back(indices[i]);
+	return drawEle;
+}
+
+} // namespace
+
 BaseGeometry::BaseGeometry()
 	: m_division(g_defaultDivision)
+	, m_pixelSize(0.0f)
 	, m_needRedraw(true)
 	, m_isCulled(false)
+	, m_instancing(false)
+	, m_instanced(false)
+	, m_tessellating(false)
+	, m_redrawRequested(false)
+	, m_countStats(true)
 {
 }
 
@@ -20,9 +77,20 @@ BaseGeometry::~BaseGeometry()
 
 void BaseGeometry::draw()
 {
+	osg::Timer_t start = osg::Timer::instance()->tick();
 	subDraw();
+	// prototypes are indexed when they are drawn
+	if (!m_instanced)
+		indexVertices();
 	m_needRedraw = false;
 	setUpdateCallback(NULL);
+
+	if (m_countStats)
+	{
+		osg::Array *vertexArr = getVertexArray();
+		unsigned int vertices = !m_instanced && vertexArr != NULL ? vertexArr->getNumElements() : 0;
+		LODStats::instance()->addTessellation(vertices, start, osg::Timer::instance()->tick());
+	}
 }
 
 unsigned int BaseGeometry::getDivision()
@@ -30,11 +98,116 @@ unsigned int BaseGeometry::getDivision()
 	return m_division;
 }
 
+void BaseGeometry::setDivision(int division)
+{
+	if (division == (int)m_division)
+		return;
+	m_division = division;
+	m_needRedraw = true;
+}
+
 void BaseGeometry::subDraw()
 {
 
 }
 
+BaseGeometry *BaseGeometry::cloneGeometry() const
+{
+	return NULL;
+}
+
+BaseGeometry *BaseGeometry::beginTessellation()
+{
+	BaseGeometry *back = cloneGeometry();
+	if (back == NULL)
+		return NULL;
+
+	back->getPrimitiveSetList().clear();
+	m_tessellating = true;
+	m_needRedraw = false;
+	return back;
+}
+
+void BaseGeometry::endTessellation(BaseGeometry &back)
+{
+	setVertexArray(back.getVertexArray());
+	setNormalArray(back.getNormalArray(), osg::Array::BIND_PER_VERTEX);
+	setColorArray(back.getColorArray(), osg::Array::BIND_OVERALL);
+	setPrimitiveSetList(back.getPrimitiveSetList());
+	setStateSet(back.getStateSet());
+	setUseDisplayList(back.getUseDisplayList());
+	setUseVertexBufferObjects(back.getUseVertexBufferObjects());
+	m_instanced = back.m_instanced;
+	m_tessellating = false;
+}
+
+void BaseGeometry::indexVertices()
+{
+	osg::Vec3Array *vertexArr = dynamic_cast<osg::Vec3Array*>(getVertexArray());
+	osg::Vec3Array *normalArr = dynamic_cast<osg::Vec3Array*>(getNormalArray());
+	if (vertexArr == NULL || vertexArr->empty() || getNumPrimitiveSets() == 0)
+		return;
+	if (normalArr != NULL && normalArr->size() != vertexArr->size())
+		normalArr = NULL;
+
+	std::vector<GLuint> triangles;
+	CollectTriangles(*this, triangles);
+
+	osg::ref_ptr<osg::Vec3Array> newVertexArr = new osg::Vec3Array;
+	osg::ref_ptr<osg::Vec3Array> newNormalArr = new osg::Vec3Array;
+	newVertexArr->reserve(vertexArr->size());
+	newNormalArr->reserve(vertexArr->size());
+	std::vector<GLuint> remap(vertexArr->size(), ~0u);
+
+	// open addressing into the new vertexs, at most half full: one
+	// allocation per draw instead of a tree node per vertex
+	size_t numSlots = 16;
+	while (numSlots < vertexArr->size() * 2)
+		numSlots *= 2;
+	std::vector<GLuint> slots(numSlots, ~0u);
+	for (size_t i = 0; i < triangles.size(); ++i)
+	{
+		GLuint &index = remap[triangles[i]];
+		if (index == ~0u)
+		{
+			const osg::Vec3 &vertex = (*vertexArr)[triangles[i]];
+			const osg::Vec3 normal = normalArr != NULL ? (*normalArr)[triangles[i]] : osg::Vec3();
+			size_t slot = HashVertex(vertex, normal) & (numSlots - 1);
+			while (slots[slot] != ~0u &&
+				((*newVertexArr)[slots[slot]] != vertex || (*newNormalArr)[slots[slot]] != normal))
+				slot = (slot + 1) & (numSlots - 1);
+
+			if (slots[slot] == ~0u)
+			{
+				slots[slot] = static_cast<GLuint>(newVertexArr->size());
+				newVertexArr->push_back(vertex);
+				newNormalArr->push_back(normal);
+			}
+			index = slots[slot];
+		}
+		triangles[i] = index;
+	}
+
+	// drop the triangles collapsed by the merge, e.g. closing strip vertices
+	std::vector<GLuint> indices;
+	indices.reserve(triangles.size());
+	for (size_t i = 0; i + 2 < triangles.size(); i += 3)
+	{
+		GLuint p1 = triangles[i], p2 = triangles[i + 1], p3 = triangles[i + 2];
+		if (p1 == p2 || p2 == p3 || p1 == p3)
+			continue;
+		indices.push_back(p1);
+		indices.push_back(p2);
+		indices.push_back(p3);
+	}
+
+	setVertexArray(newVertexArr);
+	if (normalArr != NULL)
+		setNormalArray(newNormalArr, osg::Array::BIND_PER_VERTEX);
+	getPrimitiveSetList().clear();
+	addPrimitiveSet(CreateTriangles(indices, newVertexArr->size()));
+}
+
 bool BaseGeometry::doCullAndUpdate(const osg::CullStack &cullStack)
 {
 	return false;
@@ -42,7 +215,8 @@ bool BaseGeometry::doCullAndUpdate(const osg::CullStack &cullStack)
 
 void BaseGeometry::updateDivision(float pixelSize)
 {
-	int div = computeDivision(pixelSize);
+	m_pixelSize = pixelSize;
+	int div = computeDivision(pixelSize, m_division);
 
 	if (m_division == div)
 		return;
@@ -51,34 +225,9 @@ void BaseGeometry::updateDivision(float pixelSize)
 	m_needRedraw = true;
 }
 
-int BaseGeometry::computeDivision(float pixelSize)
-{
-	//int div = 8;
-	//if (pixelSize < 40.0f)
-	//	div = 8;
-	//else if (pixelSize < 120.0f)
-	//	div = 12;
-	//else if (pixelSize < 300.0f)
-	//	div = 16;
-	//else if (pixelSize < 600.0f)
-	//	div = 20;
-	//else if (pixelSize < 1000.0f)
-	//	div = 24;
-	//else
-	//	div = 32;
-
-	int div = 5;
-	if (pixelSize <= 40.0f)
-		div = 5;
-	else if (pixelSize <= 100.0f)
-		div = 8;
-	else if (pixelSize <= 500.0f)
-		div = 12;
-	else if (pixelSize <= 1000.0f)
-		div = 16;
-	else
-		div = 20;
-	return div;
+int BaseGeometry::computeDivision(float pixelSize, int current)
+{
+	return LODPolicy::instance()->computeDivision(pixelSize, current);
 }
 
 bool BaseGeometry::cullAndUpdate(const osg::CullStack &cullStack)
@@ -86,9 +235,124 @@ bool BaseGeometry::cullAndUpdate(const osg::CullStack &cullStack)
 	return m_isCulled = doCullAndUpdate(cullStack);
 }
 
+unsigned int BaseGeometry::getNumTriangles() const
+{
+	unsigned int triangles = 0;
+	for (unsigned int i = 0; i < getNumPrimitiveSets(); ++i)
+	{
+		const osg::PrimitiveSet *primitiveSet = getPrimitiveSet(i);
+		unsigned int numIndices = primitiveSet->getNumIndices();
+		switch (primitiveSet->getMode())
+		{
+		case osg::PrimitiveSet::TRIANGLES:
+			triangles += numIndices / 3;
+			break;
+		case osg::PrimitiveSet::QUADS:
+			triangles += numIndices / 2;
+			break;
+		case osg::PrimitiveSet::TRIANGLE_STRIP:
+		case osg::PrimitiveSet::TRIANGLE_FAN:
+		case osg::PrimitiveSet::QUAD_STRIP:
+		case osg::PrimitiveSet::POLYGON:
+			triangles += numIndices > 2 ? numIndices - 2 : 0;
+			break;
+		default:
+			break;
+		}
+	}
+	return triangles;
+}
+
+bool BaseGeometry::isOccluder() const
+{
+	return false;
+}
+
+bool BaseGeometry::getCullShape(CullShape &shape)
+{
+	return false;
+}
+
+void BaseGeometry::setCullResult(bool culled, float pixelSize, int division)
+{
+	m_isCulled = culled;
+	if (culled)
+		return;
+
+	m_pixelSize = pixelSize;
+	if (division != 0 && static_cast<unsigned int>(division) != m_division)
+	{
+		m_division = division;
+		m_needRedraw = true;
+	}
+}
+
+void BaseGeometry::setInstancing(bool instancing)
+{
+	m_instancing = instancing;
+	m_needRedraw = true;
+}
+
+osg::Matrix BaseGeometry::getInstanceMatrix()
+{
+	return osg::Matrix::identity();
+}
+
+bool BaseGeometry::getPrototypeKey(PrototypeKey &key)
+{
+	return false;
+}
+
+BaseGeometry *BaseGeometry::createPrototype()
+{
+	return NULL;
+}
+
+bool BaseGeometry::drawPrototype()
+{
+	m_instanced = false;
+	PrototypeKey key;
+	if (!m_instancing || !getPrototypeKey(key))
+		return false;
+
+	osg::ref_ptr<osg::Geometry> prototype = PrototypeCache::instance()->find(key);
+	if (!prototype.valid())
+	{
+		osg::ref_ptr<BaseGeometry> geo = createPrototype();
+		if (!geo.valid())
+			return false;
+		geo->draw();
+		prototype = PrototypeCache::instance()->insert(key, geo);
+	}
+
+	setVertexArray(prototype->getVertexArray());
+	setNormalArray(prototype->getNormalArray(), osg::Array::BIND_PER_VERTEX);
+	setPrimitiveSetList(prototype->getPrimitiveSetList());
+	setStateSet(prototype->getStateSet());
+	setUseDisplayList(false);
+	setUseVertexBufferObjects(true);
+	m_instanced = true;
+	return true;
+}
+
 double GetEpsilon()
 {
 	return 0.00001;
 }
 
+osg::DrawElements *CreateTriangles(const std::vector<GLuint> &indices, unsigned int numVertices)
+{
+	if (numVertices <= 0xffff)
+		return CreateElements<osg::DrawElementsUShort>(indices);
+	return CreateElements<osg::DrawElementsUInt>(indices);
+}
+
+void CollectTriangles(const osg::Drawable &drawable, std::vector<GLuint> &indices, GLuint offset)
+{
+	osg::TriangleIndexFunctor<TriangleCollector> collector;
+	collector.indices = &indices;
+	collector.offset = offset;
+	drawable.accept(collector);
+}
+
 } // namespace Geometry
\ No newline at end of file
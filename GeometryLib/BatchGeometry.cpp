@@ -0,0 +1,172 @@
+#include "stdafx.h"
+#include "BatchGeometry.h"
+
+namespace Geometry
+{
+
+BatchGeometry::BatchGeometry()
+	: m_needMerge(true)
+{
+	// the members count their own draw()
+	m_countStats = false;
+	setUseDisplayList(false);
+	setUseVertexBufferObjects(true);
+}
+
+
+BatchGeometry::~BatchGeometry()
+{
+}
+
+void BatchGeometry::addGeometry(BaseGeometry *geometry)
+{
+	Item item;
+	item.geometry = geometry;
+	item.firstVertex = 0;
+	item.numVertices = 0;
+	item.firstIndex = 0;
+	item.numIndices = 0;
+	item.culled = false;
+	m_items.push_back(item);
+
+	m_needMerge = true;
+	m_needRedraw = true;
+}
+
+void BatchGeometry::subDraw()
+{
+	osg::ref_ptr<osg::Vec4Array> colArr = new osg::Vec4Array();
+	colArr->push_back(m_color);
+	setColorArray(colArr, osg::Array::BIND_OVERALL);
+
+	if (m_needMerge)
+		mergeGeometries();
+	m_needMerge = false;
+
+	updateIndices();
+}
+
+void BatchGeometry::indexVertices()
+{
+	// the pool is built from indexed primitives, and the index list must keep
+	// the item ranges
+}
+
+bool BatchGeometry::doCullAndUpdate(const osg::CullStack &cullStack)
+{
+	bool allCulled = true;
+	m_pixelSize = 0.0f;
+	for (size_t i = 0; i < m_items.size(); ++i)
+	{
+		Item &item = m_items[i];
+		bool culled = item.geometry->cullAndUpdate(cullStack);
+		if (culled != item.culled)
+		{
+			item.culled = culled;
+			m_needRedraw = true;
+		}
+		if (!culled)
+		{
+			allCulled = false;
+			m_pixelSize = osg::maximum(m_pixelSize, item.geometry->getPixelSize());
+			if (item.geometry->needRedraw())
+			{
+				m_needMerge = true;
+				m_needRedraw = true;
+			}
+		}
+	}
+	return allCulled;
+}
+
+void BatchGeometry::mergeGeometries()
+{
+	osg::ref_ptr<osg::Vec3Array> oldVertexArr = dynamic_cast<osg::Vec3Array*>(getVertexArray());
+	osg::ref_ptr<osg::Vec3Array> oldNormalArr = dynamic_cast<osg::Vec3Array*>(getNormalArray());
+	std::vector<GLuint> oldIndices;
+	oldIndices.swap(m_indices);
+	m_indices.reserve(oldIndices.size());
+
+	osg::ref_ptr<osg::Vec3Array> vertexArr = new osg::Vec3Array;
+	osg::ref_ptr<osg::Vec3Array> normalArr = new osg::Vec3Array;
+	if (oldVertexArr.valid())
+	{
+		vertexArr->reserve(oldVertexArr->size());
+		normalArr->reserve(oldVertexArr->size());
+	}
+
+	for (size_t i = 0; i < m_items.size(); ++i)
+	{
+		Item &item = m_items[i];
+		unsigned int firstVertex = vertexArr->size();
+		unsigned int firstIndex = m_indices.size();
+
+		if (item.geometry->needRedraw() || !oldVertexArr.valid() || !oldNormalArr.valid())
+			appendGeometry(*item.geometry, *vertexArr, *normalArr);
+		else
+		{
+			// unchanged primitive, move its range from the old pool
+			vertexArr->insert(vertexArr->end(), oldVertexArr->begin() + item.firstVertex,
+				oldVertexArr->begin() + item.firstVertex + item.numVertices);
+			normalArr->insert(normalArr->end(), oldNormalArr->begin() + item.firstVertex,
+				oldNormalArr->begin() + item.firstVertex + item.numVertices);
+			for (unsigned int j = item.firstIndex; j < item.firstIndex + item.numIndices; ++j)
+				m_indices.push_back(oldIndices[j] - item.firstVertex + firstVertex);
+		}
+
+		item.firstVertex = firstVertex;
+		item.numVertices = vertexArr->size() - firstVertex;
+		item.firstIndex = firstIndex;
+		item.numIndices = m_indices.size() - firstIndex;
+	}
+
+	setVertexArray(vertexArr);
+	setNormalArray(normalArr, osg::Array::BIND_PER_VERTEX);
+
+	osg::BoundingBox bb;
+	for (size_t i = 0; i < vertexArr->size(); ++i)
+		bb.expandBy((*vertexArr)[i]);
+	setInitialBound(bb);
+}
+
+void BatchGeometry::appendGeometry(BaseGeometry &geometry, osg::Vec3Array &vertexArr, osg::Vec3Array &normalArr)
+{
+	geometry.draw();
+
+	osg::Vec3Array *geoVertexArr = dynamic_cast<osg::Vec3Array*>(geometry.getVertexArray());
+	osg::Vec3Array *geoNormalArr = dynamic_cast<osg::Vec3Array*>(geometry.getNormalArray());
+	if (geoVertexArr == NULL || geoNormalArr == NULL || geoVertexArr->size() != geoNormalArr->size())
+		return;
+
+	CollectTriangles(geometry, m_indices, vertexArr.size());
+
+	vertexArr.insert(vertexArr.end(), geoVertexArr->begin(), geoVertexArr->end());
+	normalArr.insert(normalArr.end(), geoNormalArr->begin(), geoNormalArr->end());
+
+	// the tessellation now lives in the pool
+	geometry.setVertexArray(NULL);
+	geometry.setNormalArray(NULL);
+	geometry.setColorArray(NULL);
+	geometry.getPrimitiveSetList().clear();
+}
+
+void BatchGeometry::updateIndices()
+{
+	osg::ref_ptr<osg::DrawElementsUInt> drawEle = new osg::DrawElementsUInt(osg::PrimitiveSet::TRIANGLES);
+	drawEle->reserve(m_indices.size());
+	for (size_t i = 0; i < m_items.size(); ++i)
+	{
+		const Item &item = m_items[i];
+		if (item.culled || item.numIndices == 0)
+			continue;
+		drawEle->insert(drawEle->end(), m_indices.begin() + item.firstIndex,
+			m_indices.begin() + item.firstIndex + item.numIndices);
+	}
+
+	getPrimitiveSetList().clear();
+	if (!drawEle->empty())
+		addPrimitiveSet(drawEle);
+	dirtyDisplayList();
+}
+
+} // namespace Geometry
@@ -16,6 +16,11 @@ Box::~Box()
 {
 }
 
+BaseGeometry *Box::cloneGeometry() const
+{
+	return new Box(*this);
+}
+
 void Box::subDraw()
 {
 	computeAssistVar();
@@ -33,6 +38,8 @@ void Box::subDraw()
 	osg::ref_ptr<osg::Vec4Array> colArr = new osg::Vec4Array();
 	colArr->push_back(m_color);
 	setColorArray(colArr, osg::Array::BIND_OVERALL);
+	if (drawPrototype())
+		return;
 
 	osg::ref_ptr<osg::Vec3Array> vertexArr = new osg::Vec3Array;
 	osg::ref_ptr<osg::Vec3Array> normalArr = new osg::Vec3Array;
@@ -100,6 +107,18 @@ void Box::subDraw()
 	addPrimitiveSet(new osg::DrawArrays(osg::PrimitiveSet::QUADS, 0, vertexArr->size()));
 }
 
+bool Box::getCullShape(CullShape &shape)
+{
+	// culled when two of the lengths are under the small feature size, as
+	// the middle one is
+	shape.probes[0].center = m_center;
+	shape.probes[0].size = (float)osg::maximum(osg::minimum(m_dblXLen, m_dblYLen),
+		osg::minimum(osg::maximum(m_dblXLen, m_dblYLen), m_dblZLen));
+	shape.numProbes = 1;
+	shape.divided = false;
+	return true;
+}
+
 bool Box::doCullAndUpdate(const osg::CullStack &cullStack)
 {
 	float psx = cullStack.clampedPixelSize(m_center, m_dblXLen);
@@ -116,6 +135,38 @@ bool Box::doCullAndUpdate(const osg::CullStack &cullStack)
 	return count >= 2;
 }
 
+osg::Matrix Box::getInstanceMatrix()
+{
+	return osg::Matrix(m_xLen[0], m_xLen[1], m_xLen[2], 0.0,
+		m_yLen[0], m_yLen[1], m_yLen[2], 0.0,
+		m_zLen[0], m_zLen[1], m_zLen[2], 0.0,
+		m_org[0], m_org[1], m_org[2], 1.0);
+}
+
+bool Box::isOccluder() const
+{
+	return true;
+}
+
+bool Box::getPrototypeKey(PrototypeKey &key)
+{
+	// mirrored boxes would flip the winding of the shared faces
+	if ((m_xLen ^ m_yLen) * m_zLen <= GetEpsilon())
+		return false;
+
+	key.type = PrototypeKey::BOX;
+	return true;
+}
+
+BaseGeometry *Box::createPrototype()
+{
+	Box *box = new Box;
+	box->setXLen(osg::X_AXIS);
+	box->setYLen(osg::Y_AXIS);
+	box->setZLen(osg::Z_AXIS);
+	return box;
+}
+
 void Box::computeAssistVar()
 {
 	m_dblXLen = m_xLen.length();
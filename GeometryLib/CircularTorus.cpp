@@ -1,5 +1,6 @@
 #include "stdafx.h"
-#include "inc\CircularTorus.h"
+#include "inc/CircularTorus.h"
+#include "inc/RingTable.h"
 
 
 namespace Geometry
@@ -19,6 +20,21 @@ CircularTorus::~CircularTorus()
 {
 }
 
+BaseGeometry *CircularTorus::cloneGeometry() const
+{
+	return new CircularTorus(*this);
+}
+
+void CircularTorus::setDivision(int division)
+{
+	BaseGeometry::setDivision(division);
+	if (division == m_majorDivision && division == m_minorDivision)
+		return;
+	m_majorDivision = division;
+	m_minorDivision = division;
+	m_needRedraw = true;
+}
+
 void CircularTorus::subDraw()
 {
 	computeAssistVar();
@@ -37,12 +53,14 @@ void CircularTorus::subDraw()
 	{
 		m_angle = 2 * M_PI;
 	}
+	if (drawPrototype())
+		return;
 
 	int mainCount = (int)ceil(m_angle / (2 * M_PI / m_majorDivision));
 	double mainIncAngle = m_angle / mainCount;
 
 	int subCount = m_minorDivision;
-	double subIncAngle = 2 * M_PI / subCount;
+	const RingTable &ring = RingTable::get(subCount);
 
 	osg::Vec3 mainVec = m_startPnt - m_center;
 	osg::Quat mainQuat(mainIncAngle, m_normal);
@@ -52,45 +70,42 @@ void CircularTorus::subDraw()
 
 	// һȦ
 	osg::Vec3 faceNormal = torusNormal ^ m_normal;
-	osg::Quat torusQuat(subIncAngle, -faceNormal);
 	osg::Vec3 subVec = torusNormal;
 	double subRadius = m_startRadius;
 	osg::Vec3 subCenter = m_startPnt;
-	osg::Vec3 tmpSubVec = subVec * subRadius;
-	for (int i = 0; i < subCount; ++i)
-	{
-		vertexArr->push_back(subCenter + tmpSubVec);
-		tmpSubVec = torusQuat * tmpSubVec;
-	}
+	std::vector<osg::Vec3> ringPnts(subCount + 1), tangNormals(subCount + 1);
+	ring.rotate(subCenter, -faceNormal, subVec * subRadius, &ringPnts[0]);
+	vertexArr->insert(vertexArr->end(), ringPnts.begin(), ringPnts.end() - 1);
 
-	// м
 	osg::DrawElementsUShort *pDrawEle = new osg::DrawElementsUShort(osg::PrimitiveSet::TRIANGLE_STRIP, 0);
 	pDrawEle->push_back(subCount - 1);
-	double factor = (m_endRadius - m_startRadius) / mainCount;
-	for (int i = 1; i < mainCount; ++i)
-	{
-		faceNormal = mainQuat * faceNormal;
-		mainVec = mainQuat * mainVec;
-		subVec = mainQuat * subVec;
-		subCenter = m_center + mainVec;
-		torusQuat.makeRotate(subIncAngle, -faceNormal);
-		subRadius += factor;
-
-		tmpSubVec = subVec * subRadius;
-		osg::Vec3 tangNormal = m_normal;
+	auto addRing = [&](const osg::Vec3 &center, const osg::Vec3 &vec, const osg::Vec3 &face) {
+		ring.rotate(center, -face, vec, &ringPnts[0]);
+		ring.rotate(osg::Vec3(), -face, m_normal, &tangNormals[0]);
 		for (int j = 0; j < subCount; ++j)
 		{
-			vertexArr->push_back(subCenter + tmpSubVec);
-			tmpSubVec = torusQuat * tmpSubVec;
+			vertexArr->push_back(ringPnts[j]);
 
 			int size = vertexArr->size();
-			normalArr->push_back(tangNormal ^ ((*vertexArr)[size - subCount - 1] - vertexArr->back()));
+			normalArr->push_back(tangNormals[j] ^ ((*vertexArr)[size - subCount - 1] - vertexArr->back()));
 			normalArr->back().normalize();
-			tangNormal = torusQuat * tangNormal;
 
 			pDrawEle->push_back(size - subCount - 1);
 			pDrawEle->push_back(size - 1);
 		}
+	};
+
+	// м
+	double factor = (m_endRadius - m_startRadius) / mainCount;
+	for (int i = 1; i < mainCount; ++i)
+	{
+		faceNormal = mainQuat * faceNormal;
+		mainVec = mainQuat * mainVec;
+		subVec = mainQuat * subVec;
+		subCenter = m_center + mainVec;
+		subRadius += factor;
+
+		addRing(subCenter, subVec * subRadius, faceNormal);
 	}
 
 	// һȦ
@@ -99,23 +114,7 @@ void CircularTorus::subDraw()
 	mainVec = fullQuat * (m_startPnt - m_center);
 	subVec = fullQuat * (torusNormal * m_endRadius);
 	subCenter = m_center + mainVec;
-
-	torusQuat.makeRotate(subIncAngle, -faceNormal);
-	tmpSubVec = subVec;
-	osg::Vec3 tangNormal = m_normal;
-	for (int j = 0; j < subCount; ++j)
-	{
-		vertexArr->push_back(subCenter + tmpSubVec);
-		tmpSubVec = torusQuat * tmpSubVec;
-
-		int size = vertexArr->size();
-		normalArr->push_back(tangNormal ^ ((*vertexArr)[size - subCount - 1] - vertexArr->back()));
-		normalArr->back().normalize();
-		tangNormal = torusQuat * tangNormal;
-
-		pDrawEle->push_back(size - subCount - 1);
-		pDrawEle->push_back(size - 1);
-	}
+	addRing(subCenter, subVec, faceNormal);
 	pDrawEle->push_back(vertexArr->size() - subCount);
 	// һȦ
 	for (int i = 0; i < subCount; ++i)
@@ -166,14 +165,15 @@ bool CircularTorus::doCullAndUpdate(const osg::CullStack &cullStack)
 		return true;
 
 	const float majorPs = cullStack.clampedPixelSize(m_center, m_majorRadius * 2.0);
-	const int majorDiv = computeDivision(majorPs);
+	m_pixelSize = osg::maximum(majorPs, ps);
+	const int majorDiv = computeDivision(majorPs, m_majorDivision);
 	if (majorDiv != m_majorDivision)
 	{
 		m_majorDivision = majorDiv;
 		m_needRedraw = true;
 	}
 
-	const int minorDiv = computeDivision(ps);
+	const int minorDiv = computeDivision(ps, m_minorDivision);
 	if (minorDiv != m_minorDivision)
 	{
 		m_minorDivision = minorDiv;
@@ -182,6 +182,62 @@ bool CircularTorus::doCullAndUpdate(const osg::CullStack &cullStack)
 	return false;
 }
 
+osg::Matrix CircularTorus::getInstanceMatrix()
+{
+	osg::Vec3 xAxis = m_startPnt - m_center;
+	xAxis.normalize();
+	osg::Vec3 zAxis = m_normal;
+	zAxis.normalize();
+	osg::Vec3 yAxis = zAxis ^ xAxis;
+	yAxis.normalize();
+	zAxis = xAxis ^ yAxis;
+
+	xAxis *= m_majorRadius;
+	yAxis *= m_majorRadius;
+	zAxis *= m_majorRadius;
+	return osg::Matrix(xAxis[0], xAxis[1], xAxis[2], 0.0,
+		yAxis[0], yAxis[1], yAxis[2], 0.0,
+		zAxis[0], zAxis[1], zAxis[2], 0.0,
+		m_center[0], m_center[1], m_center[2], 1.0);
+}
+
+bool CircularTorus::getPrototypeKey(PrototypeKey &key)
+{
+	if (m_majorRadius <= GetEpsilon())
+		return false;
+	osg::Vec3 xAxis = m_startPnt - m_center;
+	xAxis.normalize();
+	osg::Vec3 zAxis = m_normal;
+	zAxis.normalize();
+	if ((zAxis ^ xAxis).length() <= GetEpsilon())
+		return false;
+
+	// major radius 1, the ratios and the sweep angle keep the shape
+	key.type = PrototypeKey::CIRCULAR_TORUS;
+	key.divisions[0] = m_majorDivision;
+	key.divisions[1] = m_minorDivision;
+	key.flags = (m_topVis ? 1 : 0) | (m_bottomVis ? 2 : 0);
+	key.shape[0] = QuantizeShape(m_startRadius / m_majorRadius);
+	key.shape[1] = QuantizeShape(m_endRadius / m_majorRadius);
+	key.shape[2] = QuantizeShape(m_angle);
+	return true;
+}
+
+BaseGeometry *CircularTorus::createPrototype()
+{
+	CircularTorus *torus = new CircularTorus;
+	torus->setStartPnt(osg::X_AXIS);
+	torus->setNormal(osg::Z_AXIS);
+	torus->setStartRadius(m_startRadius / m_majorRadius);
+	torus->setEndRadius(m_endRadius / m_majorRadius);
+	torus->setAngle(m_angle);
+	torus->setTopVis(m_topVis);
+	torus->setBottomVis(m_bottomVis);
+	torus->m_majorDivision = m_majorDivision;
+	torus->m_minorDivision = m_minorDivision;
+	return torus;
+}
+
 void CircularTorus::computeAssistVar()
 {
 	m_majorRadius = (m_startPnt - m_center).length();
@@ -1,5 +1,5 @@
 #include "stdafx.h"
-#include "inc\CombineGeometry.h"
+#include "inc/CombineGeometry.h"
 
 
 namespace Geometry
@@ -14,8 +14,15 @@ CombineGeometry::~CombineGeometry()
 {
 }
 
+BaseGeometry *CombineGeometry::cloneGeometry() const
+{
+	return new CombineGeometry(*this);
+}
+
 void CombineGeometry::subDraw()
 {
+	getPrimitiveSetList().clear();
+
 	osg::ref_ptr<osg::Vec3Array> vertexArr = new osg::Vec3Array;
 	osg::ref_ptr<osg::Vec3Array> normalArr = new osg::Vec3Array;
 	setVertexArray(vertexArr);
@@ -24,39 +31,45 @@ void CombineGeometry::subDraw()
 	colArr->push_back(m_color);
 	setColorArray(colArr, osg::Array::BIND_OVERALL);
 
+	// faces share a source vertex when their normals agree, otherwise it is
+	// split, shared[i] holds the output vertices made from source vertex i
+	std::vector<GLuint> indices;
+	std::vector<std::vector<GLuint>> shared;
+	auto addVertex = [&](const osg::Vec3 &vertex, size_t i, const osg::Vec3 &normal) {
+		for (GLuint index : shared[i])
+		{
+			if ((*normalArr)[index] * normal > 1.0f - GetEpsilon())
+			{
+				indices.push_back(index);
+				return;
+			}
+		}
+		GLuint index = vertexArr->size();
+		shared[i].push_back(index);
+		indices.push_back(index);
+		vertexArr->push_back(vertex);
+		normalArr->push_back(normal);
+	};
+
 	// shell
-	std::vector<osg::Vec3> triVertexArr, triNormalArr;
-	for each(const auto &shell in m_shells)
+	for (const auto &shell : m_shells)
 	{
+		shared.assign(shell->vertexs.size(), std::vector<GLuint>());
 		for (size_t i = 0; i < shell->faces.size();)
 		{
-			if (shell->faces[i] == 4)
+			const int *face = &shell->faces[i + 1];
+			if (shell->faces[i] == 4 || shell->faces[i] == 3)
 			{
-				for (int j = 0; j < shell->faces[i]; ++j)
-				{
-					vertexArr->push_back(shell->vertexs[shell->faces[i + j + 1]]);
-				}
-
-				osg::Vec3 vec1 = shell->vertexs[shell->faces[i + 2]] - shell->vertexs[shell->faces[i + 1]];
-				osg::Vec3 vec2 = shell->vertexs[shell->faces[i + 3]] - shell->vertexs[shell->faces[i + 2]];
+				osg::Vec3 vec1 = shell->vertexs[face[1]] - shell->vertexs[face[0]];
+				osg::Vec3 vec2 = shell->vertexs[face[2]] - shell->vertexs[face[1]];
 				osg::Vec3 normal = vec1 ^ vec2;
 				normal.normalize();
-				for (int j = 0; j < shell->faces[i]; ++j)
-					normalArr->push_back(normal);
-			}
-			else if (shell->faces[i] == 3)
-			{
-				for (int j = 0; j < shell->faces[i]; ++j)
+				for (int j = 2; j < shell->faces[i]; ++j)
 				{
-					triVertexArr.push_back(shell->vertexs[shell->faces[i + j + 1]]);
+					addVertex(shell->vertexs[face[0]], face[0], normal);
+					addVertex(shell->vertexs[face[j - 1]], face[j - 1], normal);
+					addVertex(shell->vertexs[face[j]], face[j], normal);
 				}
-
-				osg::Vec3 vec1 = shell->vertexs[shell->faces[i + 2]] - shell->vertexs[shell->faces[i + 1]];
-				osg::Vec3 vec2 = shell->vertexs[shell->faces[i + 3]] - shell->vertexs[shell->faces[i + 2]];
-				osg::Vec3 normal = vec1 ^ vec2;
-				normal.normalize();
-				for (int j = 0; j < shell->faces[i]; ++j)
-					triNormalArr.push_back(normal);
 			}
 
 			i += shell->faces[i] + 1;
@@ -64,45 +77,38 @@ void CombineGeometry::subDraw()
 	}
 
 	// mesh
-	for each (const auto &mesh in m_meshs)
+	for (const auto &mesh : m_meshs)
 	{
+		shared.assign(mesh->vertexs.size(), std::vector<GLuint>());
 		for (int i = 0; i < mesh->rows - 1; ++i)
 		{
 			for (int j = 0; j < mesh->colums - 1; ++j)
 			{
-				osg::Vec3 pnt1 = mesh->vertexs[i * mesh->colums + j];
-				osg::Vec3 pnt2 = mesh->vertexs[i * mesh->colums + j + 1];
-				osg::Vec3 pnt3 = mesh->vertexs[(i + 1) * mesh->colums + j + 1];
-				osg::Vec3 pnt4 = mesh->vertexs[(i + 1) * mesh->colums + j];
-				vertexArr->push_back(pnt1);
-				vertexArr->push_back(pnt2);
-				vertexArr->push_back(pnt3);
-				vertexArr->push_back(pnt4);
+				size_t idx1 = i * mesh->colums + j;
+				size_t idx2 = i * mesh->colums + j + 1;
+				size_t idx3 = (i + 1) * mesh->colums + j + 1;
+				size_t idx4 = (i + 1) * mesh->colums + j;
+				const osg::Vec3 &pnt1 = mesh->vertexs[idx1];
+				const osg::Vec3 &pnt2 = mesh->vertexs[idx2];
+				const osg::Vec3 &pnt3 = mesh->vertexs[idx3];
+				const osg::Vec3 &pnt4 = mesh->vertexs[idx4];
 
 				osg::Vec3 normal = (pnt2 - pnt1) ^ (pnt1 - pnt4);
 				normal.normalize();
-				for (int k = 0; k < 4; ++k)
-					normalArr->push_back(normal);
+				addVertex(pnt1, idx1, normal);
+				addVertex(pnt2, idx2, normal);
+				addVertex(pnt3, idx3, normal);
+				addVertex(pnt1, idx1, normal);
+				addVertex(pnt3, idx3, normal);
+				addVertex(pnt4, idx4, normal);
 			}
 		}
 	}
 
-	if (!vertexArr->empty())
-		addPrimitiveSet(new osg::DrawArrays(osg::PrimitiveSet::QUADS, 0, vertexArr->size()));
-
-	size_t first = vertexArr->size();
-	for (size_t i = 0; i < triVertexArr.size(); ++i)
-	{
-		vertexArr->push_back(triVertexArr[i]);
-		normalArr->push_back(triNormalArr[i]);
-	}
-	if (!triVertexArr.empty())
-		addPrimitiveSet(new osg::DrawArrays(osg::PrimitiveSet::TRIANGLES, first, vertexArr->size() - first));
-
 	// polygon
-	for each (const auto &polygon in m_polygons)
+	for (const auto &polygon : m_polygons)
 	{
-		first = vertexArr->size();
+		GLuint first = vertexArr->size();
 		osg::Vec3 normal = (polygon->vertexs[1] - polygon->vertexs[0]) ^ (polygon->vertexs[2] - polygon->vertexs[1]);
 		normal.normalize();
 		for (size_t i = 0; i < polygon->vertexs.size(); ++i)
@@ -110,8 +116,26 @@ void CombineGeometry::subDraw()
 			vertexArr->push_back(polygon->vertexs[i]);
 			normalArr->push_back(normal);
 		}
-		addPrimitiveSet(new osg::DrawArrays(osg::PrimitiveSet::POLYGON, first, vertexArr->size() - first));
+		for (GLuint i = first + 2; i < vertexArr->size(); ++i)
+		{
+			indices.push_back(first);
+			indices.push_back(i - 1);
+			indices.push_back(i);
+		}
 	}
+
+	if (!indices.empty())
+		addPrimitiveSet(CreateTriangles(indices, vertexArr->size()));
+}
+
+void CombineGeometry::indexVertices()
+{
+	// subDraw() already shares the vertices of the shells and meshs
+}
+
+bool CombineGeometry::isOccluder() const
+{
+	return true;
 }
 
 void CombineGeometry::addMesh(std::shared_ptr<Mesh> &mesh)
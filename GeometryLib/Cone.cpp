@@ -1,5 +1,6 @@
 #include "stdafx.h"
-#include "inc\Cone.h"
+#include "inc/Cone.h"
+#include "inc/RingTable.h"
 
 
 namespace Geometry
@@ -15,6 +16,11 @@ Cone::~Cone()
 {
 }
 
+BaseGeometry *Cone::cloneGeometry() const
+{
+	return new Cone(*this);
+}
+
 void Cone::subDraw()
 {
 	getPrimitiveSetList().clear();
@@ -34,32 +40,27 @@ void Cone::subDraw()
 	osg::Vec3 xVec = localToWorld * osg::X_AXIS;
 	
 	int count = (int)getDivision();
-	double incAng = 2 * M_PI / count;
-	osg::Quat quat(incAng, bottomNormal);
+	const RingTable &ring = RingTable::get(count);
 
 	osg::Vec3 yVec = m_height ^ xVec;
 	yVec.normalize();
-	std::vector<osg::Vec3> pntArr;
-	xVec *= m_radius;
+	std::vector<osg::Vec3> pntArr(count + 1), yVecArr(count + 1);
+	ring.rotate(m_org, bottomNormal, xVec * m_radius, &pntArr[0]);
+	ring.rotate(osg::Vec3(), bottomNormal, yVec, &yVecArr[0]);
 	osg::Vec3 topPnt = m_org + m_height;
 	const GLint first = vertexArr->size();
 	for (int i = 0; i < count; ++i)
 	{
-		osg::Vec3 pnt = m_org + xVec;
-		pntArr.push_back(pnt);
-
+		const osg::Vec3 &pnt = pntArr[i];
 		vertexArr->push_back(pnt);
 		vertexArr->push_back(topPnt);
 
-		osg::Vec3 normal = yVec ^ (topPnt - pnt);
+		osg::Vec3 normal = yVecArr[i] ^ (topPnt - pnt);
 		normal.normalize();
 		normalArr->push_back(normal);
 		normalArr->push_back(normal);
-
-		xVec = quat * xVec;
-		yVec = quat * yVec;
 	}
-	size_t pntCount = pntArr.size();
+	size_t pntCount = count;
 
 	vertexArr->push_back(topPnt);
 	vertexArr->push_back(pntArr[0]);
@@ -83,6 +84,15 @@ void Cone::subDraw()
 	}
 }
 
+bool Cone::getCullShape(CullShape &shape)
+{
+	shape.probes[0].center = m_org;
+	shape.probes[0].size = (float)(m_radius * 2.0);
+	shape.numProbes = 1;
+	shape.divided = true;
+	return true;
+}
+
 bool Cone::doCullAndUpdate(const osg::CullStack &cullStack)
 {
 	float ps = cullStack.clampedPixelSize(m_org, m_radius * 2.0);
@@ -0,0 +1,103 @@
+#include "stdafx.h"
+#include "inc/CullArrays.h"
+#include <cmath>
+
+#if defined(__AVX__)
+#define CULL_AVX
+#include <immintrin.h>
+#elif defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define CULL_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace Geometry
+{
+
+void CullArrays::resize(unsigned int count)
+{
+	m_x0.assign(count, 0.0f);
+	m_y0.assign(count, 0.0f);
+	m_z0.assign(count, 0.0f);
+	m_size0.assign(count, 0.0f);
+	m_x1.assign(count, 0.0f);
+	m_y1.assign(count, 0.0f);
+	m_z1.assign(count, 0.0f);
+	m_size1.assign(count, 0.0f);
+	m_kinds.assign(count, UNSUPPORTED);
+	m_results.assign(count, NOT_WRITTEN);
+	m_divisions.assign(count, 0);
+}
+
+void CullArrays::set(unsigned int pos, const BaseGeometry::CullShape &shape, int division)
+{
+	const BaseGeometry::CullProbe &probe0 = shape.probes[0];
+	const BaseGeometry::CullProbe &probe1 = shape.numProbes > 1 ? shape.probes[1] : shape.probes[0];
+	m_x0[pos] = probe0.center.x();
+	m_y0[pos] = probe0.center.y();
+	m_z0[pos] = probe0.center.z();
+	m_size0[pos] = probe0.size;
+	m_x1[pos] = probe1.center.x();
+	m_y1[pos] = probe1.center.y();
+	m_z1[pos] = probe1.center.z();
+	m_size1[pos] = probe1.size;
+	m_kinds[pos] = shape.divided ? DIVIDED : UNDIVIDED;
+	m_results[pos] = NOT_WRITTEN;
+	m_divisions[pos] = shape.divided ? division : 0;
+}
+
+void CullArrays::computePixelSizes(unsigned int first, unsigned int count, const osg::Vec4 &pixelSizeVector,
+	float *pixelSizes) const
+{
+	const float px = pixelSizeVector.x();
+	const float py = pixelSizeVector.y();
+	const float pz = pixelSizeVector.z();
+	const float pw = pixelSizeVector.w();
+	float *out = pixelSizes;
+	unsigned int i = 0;
+
+	// the same sums in the same order as osg::Vec3 * osg::Vec4
+#if defined(CULL_AVX)
+	const __m256 vx = _mm256_set1_ps(px);
+	const __m256 vy = _mm256_set1_ps(py);
+	const __m256 vz = _mm256_set1_ps(pz);
+	const __m256 vw = _mm256_set1_ps(pw);
+	const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+	for (; i + 8 <= count; i += 8)
+	{
+		const unsigned int j = first + i;
+		__m256 d0 = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(&m_x0[j]), vx),
+			_mm256_mul_ps(_mm256_loadu_ps(&m_y0[j]), vy)), _mm256_mul_ps(_mm256_loadu_ps(&m_z0[j]), vz)), vw);
+		__m256 d1 = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(&m_x1[j]), vx),
+			_mm256_mul_ps(_mm256_loadu_ps(&m_y1[j]), vy)), _mm256_mul_ps(_mm256_loadu_ps(&m_z1[j]), vz)), vw);
+		__m256 ps0 = _mm256_and_ps(_mm256_div_ps(_mm256_loadu_ps(&m_size0[j]), d0), absMask);
+		__m256 ps1 = _mm256_and_ps(_mm256_div_ps(_mm256_loadu_ps(&m_size1[j]), d1), absMask);
+		_mm256_storeu_ps(out + i, _mm256_max_ps(ps0, ps1));
+	}
+#elif defined(CULL_SSE2)
+	const __m128 vx = _mm_set1_ps(px);
+	const __m128 vy = _mm_set1_ps(py);
+	const __m128 vz = _mm_set1_ps(pz);
+	const __m128 vw = _mm_set1_ps(pw);
+	const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+	for (; i + 4 <= count; i += 4)
+	{
+		const unsigned int j = first + i;
+		__m128 d0 = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&m_x0[j]), vx),
+			_mm_mul_ps(_mm_loadu_ps(&m_y0[j]), vy)), _mm_mul_ps(_mm_loadu_ps(&m_z0[j]), vz)), vw);
+		__m128 d1 = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&m_x1[j]), vx),
+			_mm_mul_ps(_mm_loadu_ps(&m_y1[j]), vy)), _mm_mul_ps(_mm_loadu_ps(&m_z1[j]), vz)), vw);
+		__m128 ps0 = _mm_and_ps(_mm_div_ps(_mm_loadu_ps(&m_size0[j]), d0), absMask);
+		__m128 ps1 = _mm_and_ps(_mm_div_ps(_mm_loadu_ps(&m_size1[j]), d1), absMask);
+		_mm_storeu_ps(out + i, _mm_max_ps(ps0, ps1));
+	}
+#endif
+	for (; i < count; ++i)
+	{
+		const unsigned int j = first + i;
+		float ps0 = fabs(m_size0[j] / (m_x0[j] * px + m_y0[j] * py + m_z0[j] * pz + pw));
+		float ps1 = fabs(m_size1[j] / (m_x1[j] * px + m_y1[j] * py + m_z1[j] * pz + pw));
+		out[i] = ps0 > ps1 ? ps0 : ps1;
+	}
+}
+
+} // namespace Geometry
@@ -1,5 +1,6 @@
 #include "stdafx.h"
 #include "Cylinder.h"
+#include "RingTable.h"
 
 
 namespace Geometry
@@ -16,6 +17,11 @@ Cylinder::~Cylinder()
 {
 }
 
+BaseGeometry *Cylinder::cloneGeometry() const
+{
+	return new Cylinder(*this);
+}
+
 void Cylinder::subDraw()
 {
 	getPrimitiveSetList().clear();
@@ -23,37 +29,32 @@ void Cylinder::subDraw()
 	osg::ref_ptr<osg::Vec4Array> colArr = new osg::Vec4Array();
 	colArr->push_back(m_color);
 	setColorArray(colArr, osg::Array::BIND_OVERALL);
+	if (drawPrototype())
+		return;
+
 	osg::ref_ptr<osg::Vec3Array> vertexArr = new osg::Vec3Array;
 	osg::ref_ptr<osg::Vec3Array> normalArr = new osg::Vec3Array;
 	setVertexArray(vertexArr);
 	setNormalArray(normalArr, osg::Array::BIND_PER_VERTEX);
 
 	unsigned int count = getDivision();
-	double incAng = 2 * M_PI / count;
+	const RingTable &ring = RingTable::get(count);
 	osg::Vec3 topNormal = m_height;
 	topNormal.normalize();
-	osg::Quat quat(incAng, topNormal);
 
 	osg::Quat localToWorld;
 	localToWorld.makeRotate(osg::Z_AXIS, topNormal);
-	osg::Vec3 normal = localToWorld * osg::X_AXIS;
-	normal.normalize();
+	osg::Vec3 xAxis = localToWorld * osg::X_AXIS;
+	xAxis.normalize();
+	osg::Vec3 yAxis = topNormal ^ xAxis;
 
-	osg::Vec3 vertex;
-	for (unsigned int i = 0; i < count; ++i)
-	{
-		vertex = m_org + normal * m_radius;
-		vertexArr->push_back(vertex + m_height);
-		vertexArr->push_back(vertex);
-		normalArr->push_back(normal);
-		normalArr->push_back(normal);
-
-		normal = quat * normal;
-	}
-	vertexArr->push_back((*vertexArr)[0]);
-	vertexArr->push_back((*vertexArr)[1]);
-	normalArr->push_back((*normalArr)[0]);
-	normalArr->push_back((*normalArr)[1]);
+	// top and bottom rings interleaved for the strip
+	vertexArr->resize((count + 1) * 2);
+	normalArr->resize((count + 1) * 2);
+	ring.generate(m_org + m_height, xAxis * m_radius, yAxis * m_radius, &(*vertexArr)[0], 2);
+	ring.generate(m_org, xAxis * m_radius, yAxis * m_radius, &(*vertexArr)[1], 2);
+	ring.generate(osg::Vec3(), xAxis, yAxis, &(*normalArr)[0], 2);
+	ring.generate(osg::Vec3(), xAxis, yAxis, &(*normalArr)[1], 2);
 	addPrimitiveSet(new osg::DrawArrays(osg::PrimitiveSet::TRIANGLE_STRIP, 0, vertexArr->size()));
 
 	if (m_topVis)
@@ -84,6 +85,17 @@ void Cylinder::subDraw()
 	}
 }
 
+bool Cylinder::getCullShape(CullShape &shape)
+{
+	shape.probes[0].center = m_org;
+	shape.probes[0].size = (float)(m_radius * 2.0);
+	shape.probes[1].center = m_org + m_height;
+	shape.probes[1].size = (float)(m_radius * 2.0);
+	shape.numProbes = 2;
+	shape.divided = true;
+	return true;
+}
+
 bool Cylinder::doCullAndUpdate(const osg::CullStack &cullStack)
 {
 	double dia = m_radius * 2.0;
@@ -96,4 +108,47 @@ bool Cylinder::doCullAndUpdate(const osg::CullStack &cullStack)
 	updateDivision(ps);
 	return false;
 }
+
+osg::Matrix Cylinder::getInstanceMatrix()
+{
+	osg::Vec3 topNormal = m_height;
+	topNormal.normalize();
+	osg::Quat localToWorld;
+	localToWorld.makeRotate(osg::Z_AXIS, topNormal);
+	osg::Vec3 xAxis = localToWorld * osg::X_AXIS * m_radius;
+	osg::Vec3 yAxis = localToWorld * osg::Y_AXIS * m_radius;
+
+	return osg::Matrix(xAxis[0], xAxis[1], xAxis[2], 0.0,
+		yAxis[0], yAxis[1], yAxis[2], 0.0,
+		m_height[0], m_height[1], m_height[2], 0.0,
+		m_org[0], m_org[1], m_org[2], 1.0);
+}
+
+bool Cylinder::isOccluder() const
+{
+	return true;
+}
+
+bool Cylinder::getPrototypeKey(PrototypeKey &key)
+{
+	if (m_radius <= GetEpsilon() || m_height.length() <= GetEpsilon())
+		return false;
+
+	// unit radius and height, both scaled by the instance matrix
+	key.type = PrototypeKey::CYLINDER;
+	key.divisions[0] = getDivision();
+	key.flags = (m_topVis ? 1 : 0) | (m_bottomVis ? 2 : 0);
+	return true;
+}
+
+BaseGeometry *Cylinder::createPrototype()
+{
+	Cylinder *cylinder = new Cylinder;
+	cylinder->setHeight(osg::Z_AXIS);
+	cylinder->setRadius(1.0);
+	cylinder->setTopVisible(m_topVis);
+	cylinder->setBottomVisible(m_bottomVis);
+	cylinder->m_division = m_division;
+	return cylinder;
+}
 } // namespace Geometry
\ No newline at end of file
@@ -1,9 +1,16 @@
 #include "stdafx.h"
-#include "inc\DynamicLOD.h"
+#include "inc/DynamicLOD.h"
 #include <algorithm>
+#include <functional>
 #include <osg/CullStack>
 #include <osg/Geode>
-#include "inc\BaseGeometry.h"
+#include <osg/Transform>
+#include <OpenThreads/ScopedLock>
+#include "inc/BaseGeometry.h"
+#include "inc/TessellationPool.h"
+#include "inc/LODPolicy.h"
+#include "inc/LODStats.h"
+#include "inc/OcclusionCuller.h"
 using namespace osg;
 
 namespace Geometry
@@ -11,13 +18,42 @@ namespace Geometry
 
 //osg::ref_ptr<RedrawCallback> updateCallback(new RedrawCallback);
 
+// primitive drawn from a prototype: Transform -> Geode -> BaseGeometry
+static BaseGeometry *GetInstanceGeometry(Node *node)
+{
+	Transform *transform = node->asTransform();
+	if (transform == NULL || transform->getNumChildren() != 1)
+		return NULL;
+
+	Geode *geode = transform->getChild(0)->asGeode();
+	if (geode == NULL || geode->getNumDrawables() != 1)
+		return NULL;
+	return dynamic_cast<BaseGeometry*>(geode->getDrawable(0));
+}
+
 DynamicLOD::DynamicLOD()
 	: m_manipulator(NULL)
+	, m_cullFrame(~0u)
+	, m_frameCulls(0)
+	, m_bestPixelSize(0.0f)
+	, m_shared(false)
+	, m_updateFrame(~0u)
+	, m_asyncTessellation(true)
+	, m_vectorizedCull(true)
+	, m_bvhDirty(true)
 {
 }
 
 DynamicLOD::DynamicLOD(ViewCenterManipulator *manipulator)
 	: m_manipulator(manipulator)
+	, m_cullFrame(~0u)
+	, m_frameCulls(0)
+	, m_bestPixelSize(0.0f)
+	, m_shared(false)
+	, m_updateFrame(~0u)
+	, m_asyncTessellation(true)
+	, m_vectorizedCull(true)
+	, m_bvhDirty(true)
 {
 
 }
@@ -25,8 +61,18 @@ DynamicLOD::DynamicLOD(ViewCenterManipulator *manipulator)
 DynamicLOD::DynamicLOD(const DynamicLOD& lod, const CopyOp& copyop /*= CopyOp::SHALLOW_COPY*/)
 	: Group(lod, copyop)
 	, m_manipulator(lod.m_manipulator)
+	, m_cullFrame(~0u)
+	, m_frameCulls(0)
+	, m_bestPixelSize(0.0f)
+	, m_shared(false)
+	, m_updateFrame(~0u)
+	, m_asyncTessellation(lod.m_asyncTessellation)
+	, m_vectorizedCull(lod.m_vectorizedCull)
+	, m_bvhDirty(true)
 {
-
+	// Group's copy added the children before childInserted() was ours
+	for (unsigned int i = 0; i < _children.size(); ++i)
+		m_cullRecords.push_back(makeCullRecord(_children[i].get()));
 }
 
 void DynamicLOD::traverse(osg::NodeVisitor& nv)
@@ -36,7 +82,7 @@ void DynamicLOD::traverse(osg::NodeVisitor& nv)
 		if (nv.getVisitorType() == osg::NodeVisitor::CULL_VISITOR)
 			quickTraverse(nv);
 		else
-			__super::traverse(nv);
+			osg::Group::traverse(nv);
 		return;
 	}
 
@@ -49,7 +95,7 @@ void DynamicLOD::traverse(osg::NodeVisitor& nv)
 		cullTraverse(nv);
 		break;
 	default:
-		__super::traverse(nv);
+		osg::Group::traverse(nv);
 		break;
 	}
 }
@@ -60,69 +106,507 @@ void DynamicLOD::cullTraverse(osg::NodeVisitor& nv)
 	if (cullStack == NULL)
 		return;
 
-	std::for_each(_children.begin(), _children.end(), [&](ref_ptr<Node> &node) {
-		if (node->asGroup() != NULL)
-			node->asGroup()->traverse(nv);
-		else if (node->asGeode() == NULL)
-			node->accept(nv);
+	bool updatesLOD = false;
+	{
+		// the BVH is only marked dirty outside the cull traversals, the
+		// first one of a frame rebuilds it for all
+		OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_cullMutex);
+		if (m_bvhDirty)
+			buildBVH();
+		if (m_bvh.empty())
+			return;
+		updatesLOD = beginCull(nv, *cullStack);
+	}
+
+	const Vec3 eye = cullStack->getEyeLocal();
+	const float smallFeature = cullStack->getSmallFeatureCullingPixelSize();
+	const Vec4 &pixelSizeVector = cullStack->getCurrentCullingSet().getPixelSizeVector();
+	CullTraversal traversal;
+	std::vector<int> stack;
+	stack.push_back(0);
+	while (!stack.empty())
+	{
+		const int index = stack.back();
+		const BVHNode &bvhNode = m_bvh[index];
+		stack.pop_back();
+
+		if (cullStack->isCulled(bvhNode.box))
+			continue;
+
+		// nothing below is bigger than the whole subtree, measured at its
+		// point nearest to the eye
+		const float radius = bvhNode.box.radius();
+		Vec3 vec = eye - bvhNode.box.center();
+		if (vec.normalize() > radius)
+		{
+			float ps = cullStack->clampedPixelSize(bvhNode.box.center() + vec * radius, radius * 2.0f);
+			if (ps <= smallFeature)
+			{
+				traversal.smallFeatureCulled += bvhNode.count;
+				continue;
+			}
+		}
+
+		if (bvhNode.left < 0)
+			traversal.visibleLeaves.push_back(index);
 		else
 		{
-			Geode *geode = node->asGeode();
-			for (unsigned int i = 0; i < geode->getNumDrawables(); ++i)
+			stack.push_back(bvhNode.right);
+			stack.push_back(bvhNode.left);
+		}
+	}
+
+	// the occluders of this node are drawn before its children are tested,
+	// on top of the ones the DynamicLODs culled before it drew this frame
+	OcclusionBuffer *buffer = OcclusionCuller::instance()->getBuffer(nv);
+	Matrix modelViewProjection;
+	if (buffer != NULL)
+	{
+		modelViewProjection = *cullStack->getModelViewMatrix() * *cullStack->getProjectionMatrix();
+		drawOccluders(traversal, *buffer, *cullStack, modelViewProjection);
+	}
+
+	for (size_t i = 0; i < traversal.visibleLeaves.size(); ++i)
+	{
+		const BVHNode &bvhNode = m_bvh[traversal.visibleLeaves[i]];
+		if (buffer != NULL && buffer->isOccluded(bvhNode.box, modelViewProjection))
+		{
+			traversal.occlusionCulled += bvhNode.count;
+			continue;
+		}
+
+		// the pixel sizes of the whole leaf at once, its children are next
+		// to each other in m_bvhChildren
+		const float *pixelSizes = NULL;
+		if (m_cullArrays.size() != 0)
+		{
+			traversal.pixelSizes.resize(bvhNode.count);
+			m_cullArrays.computePixelSizes(bvhNode.first, bvhNode.count, pixelSizeVector, &traversal.pixelSizes[0]);
+			pixelSizes = &traversal.pixelSizes[0];
+		}
+		for (unsigned int j = bvhNode.first; j < bvhNode.first + bvhNode.count; ++j)
+		{
+			const unsigned int child = m_bvhChildren[j];
+			if (buffer != NULL && bvhNode.count > 1 && buffer->isOccluded(m_childBoxs[child], modelViewProjection))
+			{
+				++traversal.occlusionCulled;
+				continue;
+			}
+
+			// a child replaced by setChild() since the shapes were taken has
+			// none
+			const bool hasPixelSize = pixelSizes != NULL && m_cullArrays.getKind(j) != CullArrays::UNSUPPORTED &&
+				m_cullRecords[child].node == _children[child].get();
+			if (!hasPixelSize)
+			{
+				cullChild(traversal, child, *cullStack, nv, updatesLOD);
+				continue;
+			}
+
+			const CullRecord &record = m_cullRecords[child];
+			if (!updatesLOD)
 			{
-				BaseGeometry *geo = dynamic_cast<BaseGeometry*>(geode->getDrawable(i));
-				if (!geo->cullAndUpdate(*cullStack))
+				// another reference of a shared definition: drawn as the
+				// largest one left it, culled without writing to it
+				++traversal.visited;
+				if (pixelSizes[j - bvhNode.first] <= smallFeature)
 				{
-					node->accept(nv);
-					break;
+					++traversal.smallFeatureCulled;
+					continue;
+				}
+				traversal.triangles += record.geometry->getNumTriangles();
+				record.node->accept(nv);
+				continue;
+			}
+
+			// the primitive is written to when its result changes only
+			++traversal.visited;
+			const float ps = pixelSizes[j - bvhNode.first];
+			if (ps <= smallFeature)
+			{
+				if (m_cullArrays.getResult(j) != CullArrays::CULLED)
+				{
+					record.geometry->setCullResult(true, ps, 0);
+					m_cullArrays.setResult(j, CullArrays::CULLED, m_cullArrays.getDivision(j));
 				}
+				++traversal.smallFeatureCulled;
+				continue;
+			}
+			traversal.drawnSlots.push_back(j);
+			traversal.drawnPixelSizes.push_back(ps);
+			traversal.drawnDivisions.push_back(m_cullArrays.getDivision(j));
+		}
+	}
+
+	if (!traversal.drawnSlots.empty())
+	{
+		LODPolicy::instance()->computeDivisions(&traversal.drawnPixelSizes[0], &traversal.drawnDivisions[0],
+			traversal.drawnSlots.size());
+		for (size_t i = 0; i < traversal.drawnSlots.size(); ++i)
+		{
+			// the pixel size goes with a new division, it orders the
+			// re-tessellation that requests
+			const unsigned int j = traversal.drawnSlots[i];
+			const CullRecord &record = m_cullRecords[m_bvhChildren[j]];
+			const int division = traversal.drawnDivisions[i];
+			if (m_cullArrays.getResult(j) != CullArrays::DRAWN || division != m_cullArrays.getDivision(j))
+			{
+				record.geometry->setCullResult(false, traversal.drawnPixelSizes[i], division);
+				m_cullArrays.setResult(j, CullArrays::DRAWN, division);
 			}
+			traversal.triangles += record.geometry->getNumTriangles();
+			record.node->accept(nv);
 		}
-	});
+	}
+
+	LODStats::instance()->addCull(traversal.visited, traversal.smallFeatureCulled, traversal.occlusionCulled,
+		traversal.triangles);
+	LODPolicy::instance()->addTriangles(traversal.triangles);
 }
 
-void DynamicLOD::updateTraverse(osg::NodeVisitor& nv)
+bool DynamicLOD::beginCull(osg::NodeVisitor &nv, osg::CullStack &cullStack)
+{
+	const FrameStamp *frameStamp = nv.getFrameStamp();
+	const unsigned int frameNumber = frameStamp != NULL ? frameStamp->getFrameNumber() : nv.getTraversalNumber();
+	if (frameNumber != m_cullFrame)
+	{
+		m_shared = m_frameCulls > 1;
+		m_lodPath.swap(m_bestPath);
+		m_bestPath.clear();
+		m_bestPixelSize = -1.0f;
+		m_frameCulls = 0;
+		m_cullFrame = frameNumber;
+	}
+	++m_frameCulls;
+
+	const BoundingSphere &bs = getBound();
+	const float ps = cullStack.clampedPixelSize(bs.center(), bs.radius() * 2.0f);
+	const NodePath &path = nv.getNodePath();
+	if (ps > m_bestPixelSize)
+	{
+		m_bestPixelSize = ps;
+		m_bestPath.assign(path.begin(), path.end());
+	}
+	return !m_shared || path == m_lodPath;
+}
+
+void DynamicLOD::cullChild(CullTraversal &traversal, unsigned int pos, osg::CullStack &cullStack,
+	osg::NodeVisitor &nv, bool updatesLOD)
 {
-	std::for_each(_children.begin(), _children.end(), [&](ref_ptr<Node> &node) {
-		if (typeid(*node) == typeid(Group))
-			node->asGroup()->traverse(nv);
-		else if (typeid(*node) != typeid(Geode))
-			node->accept(nv);
+	++traversal.visited;
+	const CullRecord record = findCullRecord(pos);
+	switch (record.type)
+	{
+	case INSTANCE:
+	case GEOMETRY:
+		// an instance is culled in world space and drawn through its transform
+		if (!updatesLOD || !record.geometry->cullAndUpdate(cullStack))
+		{
+			traversal.triangles += record.geometry->getNumTriangles();
+			record.node->accept(nv);
+		}
 		else
+			++traversal.smallFeatureCulled;
+		break;
+	case GEODE:
+	{
+		Geode *geode = static_cast<Geode*>(record.node);
+		for (unsigned int i = 0; i < geode->getNumDrawables(); ++i)
 		{
-			Geode *geode = node->asGeode();
-			for (unsigned int i = 0; i < geode->getNumDrawables(); ++i)
+			// drawables of other types are not culled here
+			BaseGeometry *geo = dynamic_cast<BaseGeometry*>(geode->getDrawable(i));
+			if (geo == NULL || !updatesLOD || !geo->cullAndUpdate(cullStack))
 			{
-				BaseGeometry *geo = dynamic_cast<BaseGeometry*>(geode->getDrawable(i));
-				if (geo->needRedraw())
-					geo->draw();
-					//geo->setUpdateCallback(updateCallback);
+				if (geo != NULL)
+					traversal.triangles += geo->getNumTriangles();
+				geode->accept(nv);
+				break;
 			}
-			node->accept(nv);
+			++traversal.smallFeatureCulled;
 		}
-	});
+		break;
+	}
+	case GROUP:
+		static_cast<Group*>(record.node)->traverse(nv);
+		break;
+	default:
+		record.node->accept(nv);
+		break;
+	}
 }
 
-void DynamicLOD::quickTraverse(osg::NodeVisitor& nv)
+void DynamicLOD::drawOccluders(CullTraversal &traversal, OcclusionBuffer &buffer, osg::CullStack &cullStack,
+	const osg::Matrix &modelViewProjection)
+{
+	OcclusionCuller *culler = OcclusionCuller::instance();
+	const unsigned int maxTriangles = culler->getMaxOccluderTriangles();
+	if (buffer.getNumTriangles() >= maxTriangles)
+		return;
+
+	const float minPixelSize = culler->getMinOccluderPixelSize();
+	std::vector<std::pair<float, unsigned int> > &occluders = traversal.occluders;
+	for (size_t i = 0; i < traversal.visibleLeaves.size(); ++i)
+	{
+		const BVHNode &bvhNode = m_bvh[traversal.visibleLeaves[i]];
+		for (unsigned int j = bvhNode.first; j < bvhNode.first + bvhNode.count; ++j)
+		{
+			const unsigned int child = m_bvhChildren[j];
+			const CullRecord record = findCullRecord(child);
+			if (!record.occluder)
+				continue;
+
+			const BoundingSphere &bs = record.node->getBound();
+			float ps = cullStack.clampedPixelSize(bs.center(), bs.radius() * 2.0f);
+			if (ps >= minPixelSize && !cullStack.isCulled(*record.node))
+				occluders.push_back(std::make_pair(ps, child));
+		}
+	}
+
+	// largest on screen first, as many as the triangle budget allows
+	std::sort(occluders.begin(), occluders.end(), std::greater<std::pair<float, unsigned int> >());
+	for (size_t i = 0; i < occluders.size() && buffer.getNumTriangles() < maxTriangles; ++i)
+	{
+		const CullRecord record = findCullRecord(occluders[i].second);
+		if (buffer.getNumTriangles() + record.geometry->getNumTriangles() > maxTriangles)
+			continue;
+
+		// from the prototype space of an instance to the DynamicLOD
+		Matrix matrix;
+		if (record.type == INSTANCE)
+			static_cast<Transform*>(record.node)->computeLocalToWorldMatrix(matrix, NULL);
+		buffer.drawGeometry(*record.geometry, matrix * modelViewProjection);
+	}
+}
+
+void DynamicLOD::childRemoved(unsigned int pos, unsigned int numChildrenToRemove)
+{
+	m_cullRecords.erase(m_cullRecords.begin() + pos, m_cullRecords.begin() + pos + numChildrenToRemove);
+	m_bvhDirty = true;
+}
+
+void DynamicLOD::childInserted(unsigned int pos)
+{
+	m_cullRecords.insert(m_cullRecords.begin() + pos, makeCullRecord(_children[pos].get()));
+	m_bvhDirty = true;
+}
+
+DynamicLOD::CullRecord DynamicLOD::makeCullRecord(osg::Node *node)
 {
-	std::for_each(_children.begin(), _children.end(), [&](ref_ptr<Node> &node) {
-		if (node->asGroup() != NULL)
-			node->asGroup()->traverse(nv);
-		else if (node->asGeode() == NULL)
-			node->accept(nv);
+	CullRecord record;
+	record.node = node;
+	record.geometry = GetInstanceGeometry(node);
+	record.type = INSTANCE;
+	if (record.geometry == NULL)
+	{
+		Geode *geode = node->asGeode();
+		if (geode != NULL && geode->getNumDrawables() == 1)
+			record.geometry = dynamic_cast<BaseGeometry*>(geode->getDrawable(0));
+
+		if (record.geometry != NULL)
+			record.type = GEOMETRY;
+		else if (geode != NULL)
+			record.type = GEODE;
+		else if (typeid(*node) == typeid(Group))
+			record.type = GROUP;
 		else
+			record.type = OTHER;
+	}
+	record.occluder = record.geometry != NULL && record.geometry->isOccluder();
+	return record;
+}
+
+const DynamicLOD::CullRecord &DynamicLOD::getCullRecord(unsigned int pos)
+{
+	CullRecord &record = m_cullRecords[pos];
+	if (record.node != _children[pos].get())
+	{
+		record = makeCullRecord(_children[pos].get());
+		m_bvhDirty = true;
+	}
+	return record;
+}
+
+DynamicLOD::CullRecord DynamicLOD::findCullRecord(unsigned int pos) const
+{
+	const CullRecord &record = m_cullRecords[pos];
+	return record.node == _children[pos].get() ? record : makeCullRecord(_children[pos].get());
+}
+
+DynamicLOD::CullTraversal::CullTraversal()
+	: visited(0)
+	, smallFeatureCulled(0)
+	, occlusionCulled(0)
+	, triangles(0)
+{
+}
+
+void DynamicLOD::buildBVH()
+{
+	m_bvh.clear();
+	m_bvhChildren.clear();
+
+	// boxes around the bounding spheres, they also hold a finer tessellation
+	m_childBoxs.assign(_children.size(), BoundingBox());
+	for (unsigned int i = 0; i < _children.size(); ++i)
+	{
+		const BoundingSphere &bs = _children[i]->getBound();
+		if (!bs.valid())
+			continue;
+		m_childBoxs[i].expandBy(bs);
+		m_bvhChildren.push_back(i);
+	}
+
+	if (!m_bvhChildren.empty())
+		buildBVHNode(0, m_bvhChildren.size(), m_childBoxs);
+
+	m_cullArrays.resize(m_vectorizedCull ? m_bvhChildren.size() : 0);
+	for (unsigned int i = 0; i < m_cullArrays.size(); ++i)
+	{
+		const CullRecord &record = getCullRecord(m_bvhChildren[i]);
+		BaseGeometry::CullShape shape;
+		if (record.geometry != NULL && record.geometry->getCullShape(shape))
+			m_cullArrays.set(i, shape, record.geometry->getDivision());
+	}
+	m_bvhDirty = false;
+}
+
+int DynamicLOD::buildBVHNode(unsigned int first, unsigned int count, const std::vector<osg::BoundingBox> &boxs)
+{
+	const unsigned int MAX_LEAF_SIZE = 8;
+
+	int index = m_bvh.size();
+	m_bvh.push_back(BVHNode());
+	BVHNode bvhNode;
+	bvhNode.first = first;
+	bvhNode.count = count;
+	bvhNode.left = -1;
+	bvhNode.right = -1;
+
+	BoundingBox centers;
+	for (unsigned int i = first; i < first + count; ++i)
+	{
+		bvhNode.box.expandBy(boxs[m_bvhChildren[i]]);
+		centers.expandBy(boxs[m_bvhChildren[i]].center());
+	}
+
+	if (count > MAX_LEAF_SIZE)
+	{
+		// median split along the longest axis of the centers
+		Vec3 extent = centers._max - centers._min;
+		int axis = 0;
+		if (extent[1] > extent[axis])
+			axis = 1;
+		if (extent[2] > extent[axis])
+			axis = 2;
+
+		unsigned int half = count / 2;
+		std::nth_element(m_bvhChildren.begin() + first, m_bvhChildren.begin() + first + half,
+			m_bvhChildren.begin() + first + count, [&](unsigned int a, unsigned int b) {
+			return boxs[a].center()[axis] < boxs[b].center()[axis];
+		});
+
+		bvhNode.left = buildBVHNode(first, half, boxs);
+		bvhNode.right = buildBVHNode(first + half, count - half, boxs);
+	}
+
+	m_bvh[index] = bvhNode;
+	return index;
+}
+
+void DynamicLOD::updateTraverse(osg::NodeVisitor& nv)
+{
+	const FrameStamp *frameStamp = nv.getFrameStamp();
+	const unsigned int frameNumber = frameStamp != NULL ? frameStamp->getFrameNumber() : nv.getTraversalNumber();
+	// reached again through another reference of a shared definition
+	if (frameNumber == m_updateFrame)
+		return;
+	m_updateFrame = frameNumber;
+
+	TessellationPool *pool = TessellationPool::instance();
+	pool->applyFinished(frameNumber);
+
+	for (unsigned int i = 0; i < _children.size(); ++i)
+	{
+		const CullRecord &record = getCullRecord(i);
+		switch (record.type)
+		{
+		case INSTANCE:
+		case GEOMETRY:
+			requestRedraw(record.geometry);
+			record.node->accept(nv);
+			break;
+		case GEODE:
+		{
+			Geode *geode = static_cast<Geode*>(record.node);
+			for (unsigned int j = 0; j < geode->getNumDrawables(); ++j)
+				requestRedraw(dynamic_cast<BaseGeometry*>(geode->getDrawable(j)));
+			geode->accept(nv);
+			break;
+		}
+		case GROUP:
+			static_cast<Group*>(record.node)->traverse(nv);
+			break;
+		default:
+			record.node->accept(nv);
+			break;
+		}
+	}
+	LODStats::instance()->addRetessellated(pool->processRequests(frameNumber));
+}
+
+void DynamicLOD::requestRedraw(BaseGeometry *geo)
+{
+	if (geo == NULL || !geo->needRedraw() || geo->isTessellating())
+		return;
+
+	TessellationPool::instance()->request(geo, m_asyncTessellation);
+}
+
+void DynamicLOD::quickTraverse(osg::NodeVisitor& nv)
+{
+	// the cull flags are those of the largest reference
+	bool lodPath = true;
+	{
+		OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_cullMutex);
+		lodPath = !m_shared || nv.getNodePath() == m_lodPath;
+	}
+	if (!lodPath)
+	{
+		osg::Group::traverse(nv);
+		return;
+	}
+
+	for (unsigned int i = 0; i < _children.size(); ++i)
+	{
+		const CullRecord record = findCullRecord(i);
+		switch (record.type)
+		{
+		case INSTANCE:
+		case GEOMETRY:
+			if (!record.geometry->isCulled())
+				record.node->accept(nv);
+			break;
+		case GEODE:
 		{
-			Geode *geode = node->asGeode();
-			for (unsigned int i = 0; i < geode->getNumDrawables(); ++i)
+			Geode *geode = static_cast<Geode*>(record.node);
+			for (unsigned int j = 0; j < geode->getNumDrawables(); ++j)
 			{
-				BaseGeometry *geo = dynamic_cast<BaseGeometry*>(geode->getDrawable(i));
-				if (!geo->isCulled())
+				BaseGeometry *geo = dynamic_cast<BaseGeometry*>(geode->getDrawable(j));
+				if (geo == NULL || !geo->isCulled())
 				{
-					node->accept(nv);
+					geode->accept(nv);
 					break;
 				}
 			}
+			break;
 		}
-	});
+		case GROUP:
+			static_cast<Group*>(record.node)->traverse(nv);
+			break;
+		default:
+			record.node->accept(nv);
+			break;
+		}
+	}
 }
 } // namespace Geometry
\ No newline at end of file
@@ -1,5 +1,6 @@
 #include "stdafx.h"
-#include "inc\Ellipsoid.h"
+#include "inc/Ellipsoid.h"
+#include "inc/RingTable.h"
 
 
 namespace Geometry
@@ -18,6 +19,21 @@ Ellipsoid::~Ellipsoid()
 {
 }
 
+BaseGeometry *Ellipsoid::cloneGeometry() const
+{
+	return new Ellipsoid(*this);
+}
+
+void Ellipsoid::setDivision(int division)
+{
+	BaseGeometry::setDivision(division);
+	if (division == m_aDivision && division == m_bDivision)
+		return;
+	m_aDivision = division;
+	m_bDivision = division;
+	m_needRedraw = true;
+}
+
 void Ellipsoid::subDraw()
 {
 	computeAssistVar();
@@ -44,8 +60,7 @@ void Ellipsoid::subDraw()
 	osg::Vec3 xVec = localToWold * osg::X_AXIS;
 	osg::Vec3 yVec = xVec ^ bottomNormal;
 	int hCount = m_bDivision;
-	double hIncAng = 2 * M_PI / hCount;
-	osg::Quat hQuat(hIncAng, bottomNormal);
+	const RingTable &ring = RingTable::get(hCount);
 
 	int vCount = (int)ceil(m_angle / (2 * M_PI / m_aDivision));
 	if (vCount & 1) // ż
@@ -71,28 +86,13 @@ void Ellipsoid::subDraw()
 	const GLint first = vertexArr->size();
 	for (int i = 0; i < vCount / 2; ++i)
 	{
-		osg::Vec3 hVec1 = vec1;
-		osg::Vec3 hVec2 = vec2;
-		osg::Vec3 hNormal1 = normal1;
-		osg::Vec3 hNormal2 = normal2;
 		const size_t hFirst = vertexArr->size();
-		for (int j = 0; j < hCount; ++j)
-		{
-			vertexArr->push_back(m_center + hVec1);
-			vertexArr->push_back(m_center + hVec2);
-			normalArr->push_back(hNormal1);
-			normalArr->push_back(hNormal2);
-
-			hVec1 = hQuat * hVec1;
-			hVec2 = hQuat * hVec2;
-
-			hNormal1 = hQuat * hNormal1;
-			hNormal2 = hQuat * hNormal2;
-		}
-		vertexArr->push_back((*vertexArr)[hFirst]);
-		vertexArr->push_back((*vertexArr)[hFirst + 1]);
-		normalArr->push_back((*normalArr)[hFirst]);
-		normalArr->push_back((*normalArr)[hFirst + 1]);
+		vertexArr->resize(hFirst + (hCount + 1) * 2);
+		normalArr->resize(hFirst + (hCount + 1) * 2);
+		ring.rotate(m_center, bottomNormal, vec1, &(*vertexArr)[hFirst], 2);
+		ring.rotate(m_center, bottomNormal, vec2, &(*vertexArr)[hFirst + 1], 2);
+		ring.rotate(osg::Vec3(), bottomNormal, normal1, &(*normalArr)[hFirst], 2);
+		ring.rotate(osg::Vec3(), bottomNormal, normal2, &(*normalArr)[hFirst + 1], 2);
 
 		vec1 = vec2;
 		currAngle -= vIncAng;
@@ -116,15 +116,9 @@ void Ellipsoid::subDraw()
 		vec2 = localToWold * vec2;
 
 		vertexArr->push_back(m_center + vec2);
-		normalArr->push_back(bottomNormal);
-		for (int i = 0; i < hCount; ++i)
-		{
-			vertexArr->push_back(m_center + vec1);
-			normalArr->push_back(bottomNormal);
-			vec1 = hQuat * vec1;
-		}
-		vertexArr->push_back((*vertexArr)[first + 1]);
-		normalArr->push_back(bottomNormal);
+		vertexArr->resize(first + hCount + 2);
+		ring.rotate(m_center, bottomNormal, vec1, &(*vertexArr)[first + 1]);
+		normalArr->resize(vertexArr->size(), bottomNormal);
 		addPrimitiveSet(new osg::DrawArrays(osg::PrimitiveSet::TRIANGLE_FAN, first, vertexArr->size() - first));
 	}
 }
@@ -137,14 +131,15 @@ bool Ellipsoid::doCullAndUpdate(const osg::CullStack &cullStack)
 	if (ps <= cullStack.getSmallFeatureCullingPixelSize())
 		return true;
 
-	const int aDiv = computeDivision(psa);
+	m_pixelSize = ps;
+	const int aDiv = computeDivision(psa, m_aDivision);
 	if (aDiv != m_aDivision)
 	{
 		m_aDivision = aDiv;
 		m_needRedraw = true;
 	}
 
-	const int bDiv = computeDivision(psb);
+	const int bDiv = computeDivision(psb, m_bDivision);
 	if (bDiv != m_bDivision)
 	{
 		m_bDivision = bDiv;
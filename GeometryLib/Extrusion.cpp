@@ -0,0 +1,192 @@
+#include "stdafx.h"
+#include "inc/Extrusion.h"
+#include <osgUtil/Tessellator>
+#include "inc/Profile.h"
+
+
+namespace Geometry
+{
+
+Extrusion::Extrusion()
+	: m_radius(-1.0)
+{
+}
+
+
+Extrusion::~Extrusion()
+{
+}
+
+BaseGeometry *Extrusion::cloneGeometry() const
+{
+	return new Extrusion(*this);
+}
+
+void Extrusion::subDraw()
+{
+	getPrimitiveSetList().clear();
+
+	osg::ref_ptr<osg::Vec3Array> vertexArr = new osg::Vec3Array;
+	osg::ref_ptr<osg::Vec3Array> normalArr = new osg::Vec3Array;
+	setVertexArray(vertexArr);
+	setNormalArray(normalArr, osg::Array::BIND_PER_VERTEX);
+	osg::ref_ptr<osg::Vec4Array> colArr = new osg::Vec4Array();
+	colArr->push_back(m_color);
+	setColorArray(colArr, osg::Array::BIND_OVERALL);
+
+	osg::Vec3 dir = m_height;
+	if (dir.normalize() <= GetEpsilon() || m_flags.size() != m_vertexs.size())
+		return;
+
+	// the loops as closed polylines, cut into the segments of the walls
+	osg::ref_ptr<osg::Vec3Array> capArr = new osg::Vec3Array;
+	osg::ref_ptr<osg::Geometry> cap = new osg::Geometry;
+	cap->setVertexArray(capArr);
+	std::vector<GLuint> indices;
+	std::vector<ProfileSegment> segments;
+	std::vector<osg::Vec3> points, normals;
+	size_t first = 0;
+	for (size_t l = 0; l < m_loopSizes.size(); ++l)
+	{
+		size_t size = m_loopSizes[l];
+		if (first + size > m_vertexs.size())
+			break;
+		FlattenProfile(&m_vertexs[first], &m_flags[first], size, m_division, true, segments);
+		JoinProfile(segments, points);
+		first += size;
+		if (points.size() < 3)
+			continue;
+
+		cap->addPrimitiveSet(new osg::DrawArrays(osg::PrimitiveSet::POLYGON, capArr->size(), points.size()));
+		capArr->insert(capArr->end(), points.begin(), points.end());
+
+		// the walls face away from the outline and into the holes, a loop
+		// turning counterclockwise about height has them on its right
+		double area = 0.0;
+		for (size_t i = 1; i + 1 < points.size(); ++i)
+			area += ((points[i] - points[0]) ^ (points[i + 1] - points[0])) * dir;
+		const float sign = (area < 0.0 ? -1.0f : 1.0f) * (l == 0 ? 1.0f : -1.0f);
+
+		for (size_t s = 0; s < segments.size(); ++s)
+		{
+			const ProfileSegment &segment = segments[s];
+			int count = (int)segment.size();
+
+			// smooth along an arc, the segments meet at an edge
+			normals.resize(count);
+			for (int i = 0; i < count; ++i)
+			{
+				osg::Vec3 tangent = segment[osg::minimum(i + 1, count - 1)] - segment[osg::maximum(i - 1, 0)];
+				normals[i] = (tangent ^ dir) * sign;
+				normals[i].normalize();
+			}
+
+			GLuint base = vertexArr->size();
+			for (int i = 0; i < count; ++i)
+			{
+				vertexArr->push_back(segment[i]);
+				vertexArr->push_back(segment[i] + m_height);
+				normalArr->push_back(normals[i]);
+				normalArr->push_back(normals[i]);
+			}
+			for (int i = 0; i + 1 < count; ++i)
+			{
+				GLuint p00 = base + i * 2;
+				GLuint p01 = p00 + 1;
+				GLuint p10 = p00 + 2;
+				GLuint p11 = p00 + 3;
+				if (sign > 0.0f)
+				{
+					GLuint tris[] = { p00, p10, p11, p00, p11, p01 };
+					indices.insert(indices.end(), tris, tris + 6);
+				}
+				else
+				{
+					GLuint tris[] = { p00, p11, p10, p00, p01, p11 };
+					indices.insert(indices.end(), tris, tris + 6);
+				}
+			}
+		}
+	}
+
+	// the holes are cut out of the caps by the odd winding rule
+	if (cap->getNumPrimitiveSets() != 0)
+	{
+		osg::ref_ptr<osgUtil::Tessellator> tessellator = new osgUtil::Tessellator;
+		tessellator->setTessellationType(osgUtil::Tessellator::TESS_TYPE_GEOMETRY);
+		tessellator->setWindingType(osgUtil::Tessellator::TESS_WINDING_ODD);
+		tessellator->setBoundaryOnly(false);
+		tessellator->setTessellationNormal(dir);
+		tessellator->retessellatePolygons(*cap);
+
+		std::vector<GLuint> triangles;
+		CollectTriangles(*cap, triangles);
+
+		// the tessellator may add vertices where the loops cross
+		const osg::Vec3Array &tessArr = *static_cast<const osg::Vec3Array*>(cap->getVertexArray());
+		GLuint bottom = vertexArr->size();
+		GLuint top = bottom + tessArr.size();
+		for (size_t i = 0; i < tessArr.size(); ++i)
+		{
+			vertexArr->push_back(tessArr[i]);
+			normalArr->push_back(-dir);
+		}
+		for (size_t i = 0; i < tessArr.size(); ++i)
+		{
+			vertexArr->push_back(tessArr[i] + m_height);
+			normalArr->push_back(dir);
+		}
+		for (size_t i = 0; i + 2 < triangles.size(); i += 3)
+		{
+			GLuint p1 = triangles[i], p2 = triangles[i + 1], p3 = triangles[i + 2];
+			if (((tessArr[p2] - tessArr[p1]) ^ (tessArr[p3] - tessArr[p1])) * dir > 0.0f)
+				std::swap(p2, p3);
+			GLuint tris[] = { bottom + p1, bottom + p2, bottom + p3, top + p1, top + p3, top + p2 };
+			indices.insert(indices.end(), tris, tris + 6);
+		}
+	}
+
+	if (!indices.empty())
+		addPrimitiveSet(CreateTriangles(indices, vertexArr->size()));
+}
+
+bool Extrusion::getCullShape(CullShape &shape)
+{
+	if (m_radius < 0.0)
+		computeAssistVar();
+	shape.probes[0].center = m_center;
+	shape.probes[0].size = (float)(m_radius * 2.0);
+	shape.numProbes = 1;
+	shape.divided = true;
+	return true;
+}
+
+bool Extrusion::doCullAndUpdate(const osg::CullStack &cullStack)
+{
+	if (m_radius < 0.0)
+		computeAssistVar();
+	float ps = cullStack.clampedPixelSize(m_center, m_radius * 2.0);
+	if (ps <= cullStack.getSmallFeatureCullingPixelSize())
+		return true;
+
+	updateDivision(ps);
+	return false;
+}
+
+void Extrusion::computeAssistVar()
+{
+	// the outline and the holes inside it
+	size_t size = m_loopSizes.empty() ? m_vertexs.size() : osg::minimum((size_t)m_loopSizes[0], m_vertexs.size());
+	osg::BoundingBox box;
+	for (size_t i = 0; i < size; ++i)
+	{
+		box.expandBy(m_vertexs[i]);
+		box.expandBy(m_vertexs[i] + m_height);
+	}
+	if (!box.valid())
+		box.expandBy(osg::Vec3());
+
+	m_center = box.center();
+	m_radius = box.radius();
+}
+} // namespace Geometry
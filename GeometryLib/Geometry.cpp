@@ -1,12 +1,12 @@
 #include "stdafx.h"
 #include "Geometry.hpp"
+#include "LODPolicy.h"
 
 using namespace osg;
 
 namespace Geometry
 {
 	const double g_epsilon = 0.00001;
-	const double g_deflection = 0.5;
 	const double g_defaultIncAngle = 10.0 * M_PI / 180.0;
 
 	osg::ref_ptr<osg::Geometry> BuildCircularTorus(const osg::Vec3 &center, const osg::Vec3 &startPnt, const osg::Vec3 &normal,
@@ -29,20 +29,12 @@ namespace Geometry
 
 		Vec3 mainVec = startPnt - center;
 		double mainRadius = mainVec.length() + radius;
-		double mainIncAng = 0.0;
-		if (g_deflection > mainRadius)
-			mainIncAng = angle / 4.0;
-		else
-			mainIncAng = 2 * acos((mainRadius - g_deflection) / mainRadius);
+		double mainIncAng = 2 * M_PI / LODPolicy::instance()->computeModelDivision(mainRadius);
 		int mainCount = (int)ceil(angle / mainIncAng);
 		mainIncAng = angle / mainCount;
 		Quat mainQuat(mainIncAng, normal);
 
-		double subIncAng = 0.0;
-		if (g_deflection > radius)
-			subIncAng = M_PI_2;
-		else
-			subIncAng = 2.0 * acos((radius - g_deflection) / radius);
+		double subIncAng = 2 * M_PI / LODPolicy::instance()->computeModelDivision(radius);
 		int subCount = (int)ceil(2 * M_PI / subIncAng);
 		subIncAng = 2 * M_PI / subCount;
 		Vec3 subNormal = normal ^ mainVec;
@@ -344,7 +336,7 @@ namespace Geometry
 
 		Vec3 mainVec = startPnt - center;
 		double mainRadius = mainVec.length() + width / 2.0;
-		double mainIncAng = 2 * acos((mainRadius - g_deflection) / mainRadius);
+		double mainIncAng = 2 * M_PI / LODPolicy::instance()->computeModelDivision(mainRadius);
 		int mainCount = (int)ceil(angle / mainIncAng);
 		mainIncAng = angle / mainCount;
 		Quat mainQuat(mainIncAng, normal);
@@ -750,11 +742,7 @@ namespace Geometry
 		Vec3 xVec = bottomNormal ^ osg::Z_AXIS;
 		if (xVec.length2() < g_epsilon)
 			xVec = osg::X_AXIS;
-		double incAng = 0.0;
-		if (radius < g_deflection)
-			incAng = 60.0 * M_PI / 180.0;
-		else
-			incAng = 2 * acos((radius - g_deflection) / radius);
+		double incAng = 2 * M_PI / LODPolicy::instance()->computeModelDivision(radius);
 		int count = (int)ceil(2 * M_PI / incAng);
 		incAng = 2 * M_PI / count;
 		Quat quat(incAng, bottomNormal);
@@ -838,11 +826,7 @@ namespace Geometry
 			mainRadius = bottomRadius;
 		else
 			mainRadius = topRadius;
-		double incAng = 0.0;
-		if (mainRadius < g_deflection)
-			incAng = 60.0 * M_PI / 180.0;
-		else
-			incAng = 2.0 * acos((mainRadius - g_deflection) / mainRadius);
+		double incAng = 2 * M_PI / LODPolicy::instance()->computeModelDivision(mainRadius);
 		int count = (int)ceil(2 * M_PI / incAng);
 		incAng = 2 * M_PI / count;
 		Quat quat(incAng, bottomNormal);
@@ -1032,7 +1016,7 @@ namespace Geometry
 		quat.makeRotate(osg::Z_AXIS, bottomNormal);
 		Vec3 xVec = quat * osg::X_AXIS;
 		Vec3 yVec = xVec ^ bottomNormal;
-		double incAng = 2 * acos((sphereRadius - g_deflection) / sphereRadius);
+		double incAng = 2 * M_PI / LODPolicy::instance()->computeModelDivision(sphereRadius);
 		int hCount = (int)ceil(2 * M_PI / incAng);
 		double hIncAng = 2 * M_PI / hCount;
 		Quat hQuat(hIncAng, -bottomNormal);
@@ -1129,7 +1113,7 @@ namespace Geometry
 		localToWold.makeRotate(osg::Z_AXIS, -bottomNormal);
 		Vec3 xVec = localToWold * osg::X_AXIS;
 		Vec3 yVec = xVec ^ bottomNormal;
-		double incAng = 2 * acos((bRadius - g_deflection) / bRadius);
+		double incAng = 2 * M_PI / LODPolicy::instance()->computeModelDivision(bRadius);
 		int hCount = (int)ceil(2 * M_PI / incAng);
 		double hIncAng = 2 * M_PI / hCount;
 		Quat hQuat(hIncAng, -bottomNormal);
@@ -1773,7 +1757,7 @@ namespace Geometry
 
 		// shell
 		std::vector<osg::Vec3> triVertexArr, triNormalArr;
-		for each(const auto &shell in cg.shells)
+		for (const auto &shell : cg.shells)
 		{
 			for (size_t i = 0; i < shell->faces.size();)
 			{
@@ -1811,7 +1795,7 @@ namespace Geometry
 		}
 
 		// mesh
-		for each (const auto &mesh in cg.meshs)
+		for (const auto &mesh : cg.meshs)
 		{
 			for (int i = 0; i < mesh->rows-1; ++i)
 			{
@@ -1847,7 +1831,7 @@ namespace Geometry
 			geometry->addPrimitiveSet(new osg::DrawArrays(osg::PrimitiveSet::TRIANGLES, first, vertexArr->size() - first));
 
 		// polygon
-		for each (const auto &polygon in cg.polygons)
+		for (const auto &polygon : cg.polygons)
 		{
 			first = vertexArr->size();
 			osg::Vec3 normal = (polygon->vertexs[1] - polygon->vertexs[0]) ^ (polygon->vertexs[2] - polygon->vertexs[1]);
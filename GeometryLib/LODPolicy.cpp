@@ -0,0 +1,178 @@
+#include "stdafx.h"
+#include "inc/LODPolicy.h"
+#include <cmath>
+#include <osg/Math>
+#include <OpenThreads/ScopedLock>
+
+namespace Geometry
+{
+
+namespace
+{
+
+const int DIVISION_LEVELS[] = { 5, 8, 12, 16, 24, 32, 48, 64 };
+const size_t NUM_DIVISION_LEVELS = sizeof(DIVISION_LEVELS) / sizeof(DIVISION_LEVELS[0]);
+const float MAX_TOLERANCE_SCALE = 64.0f;
+// the scale stays while the triangles are between this share of the budget
+// and the budget, every change of it re-tessellates
+const float BUDGET_LOW = 0.7f;
+
+// the smallest level with a chord error of at most chordError on a circle of
+// radius, the segment angle is 2 * acos(1 - chordError / radius)
+int QuantizeDivision(double radius, double chordError)
+{
+	if (chordError >= radius)
+		return DIVISION_LEVELS[0];
+	double division = osg::PI / acos(1.0 - chordError / radius);
+	for (size_t i = 0; i < NUM_DIVISION_LEVELS; ++i)
+	{
+		if (DIVISION_LEVELS[i] >= division)
+			return DIVISION_LEVELS[i];
+	}
+	return DIVISION_LEVELS[NUM_DIVISION_LEVELS - 1];
+}
+
+// the same level as QuantizeDivision() for a circle covering pixelSize pixels,
+// thresholds[i] is the smallest pixel size drawn at level i + 1
+int LevelIndex(const float *thresholds, float pixelSize)
+{
+	int level = 0;
+	for (size_t i = 0; i + 1 < NUM_DIVISION_LEVELS; ++i)
+		level += pixelSize > thresholds[i] ? 1 : 0;
+	return level;
+}
+
+} // namespace
+
+LODPolicy::LODPolicy()
+	: m_pixelTolerance(2.0f)
+	, m_modelTolerance(0.5)
+	, m_hysteresis(0.15f)
+	, m_triangleBudget(0)
+	, m_toleranceScale(1.0f)
+	, m_triangles(0)
+{
+}
+
+LODPolicy *LODPolicy::instance()
+{
+	static LODPolicy policy;
+	return &policy;
+}
+
+void LODPolicy::setPixelTolerance(float pixels)
+{
+	m_pixelTolerance = osg::maximum(pixels, 0.01f);
+}
+
+void LODPolicy::setModelTolerance(double tolerance)
+{
+	m_modelTolerance = osg::maximum(tolerance, 1.0e-6);
+}
+
+void LODPolicy::setHysteresis(float hysteresis)
+{
+	m_hysteresis = osg::maximum(hysteresis, 0.0f);
+}
+
+void LODPolicy::setTriangleBudget(unsigned int triangles)
+{
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+	m_triangleBudget = triangles;
+	if (m_triangleBudget == 0)
+		m_toleranceScale.store(1.0f, std::memory_order_relaxed);
+}
+
+int LODPolicy::computeDivision(float pixelSize) const
+{
+	return QuantizeDivision(pixelSize * 0.5, getScaledTolerance());
+}
+
+int LODPolicy::computeDivision(float pixelSize, int current) const
+{
+	const double tolerance = getScaledTolerance();
+	int division = QuantizeDivision(pixelSize * 0.5, tolerance);
+	if (division > current)
+		return osg::maximum(current, QuantizeDivision(pixelSize / (1.0f + m_hysteresis) * 0.5, tolerance));
+	if (division < current)
+		return osg::minimum(current, QuantizeDivision(pixelSize * (1.0f + m_hysteresis) * 0.5, tolerance));
+	return division;
+}
+
+void LODPolicy::computeDivisions(const float *pixelSizes, int *divisions, unsigned int count) const
+{
+	// level i + 1 once the chord error of level i is over the tolerance, as
+	// in getDivisionLevels()
+	const double tolerance = getScaledTolerance();
+	float thresholds[NUM_DIVISION_LEVELS - 1];
+	for (size_t i = 0; i + 1 < NUM_DIVISION_LEVELS; ++i)
+		thresholds[i] = static_cast<float>(2.0 * tolerance / (1.0 - cos(osg::PI / DIVISION_LEVELS[i])));
+
+	const float band = 1.0f + m_hysteresis;
+	for (unsigned int i = 0; i < count; ++i)
+	{
+		const int current = divisions[i];
+		if (current == 0)
+			continue;
+
+		const float pixelSize = pixelSizes[i];
+		int division = DIVISION_LEVELS[LevelIndex(thresholds, pixelSize)];
+		if (division > current)
+			division = osg::maximum(current, DIVISION_LEVELS[LevelIndex(thresholds, pixelSize / band)]);
+		else if (division < current)
+			division = osg::minimum(current, DIVISION_LEVELS[LevelIndex(thresholds, pixelSize * band)]);
+		divisions[i] = division;
+	}
+}
+
+int LODPolicy::computeModelDivision(double radius) const
+{
+	return QuantizeDivision(radius, m_modelTolerance);
+}
+
+double LODPolicy::getScaledTolerance() const
+{
+	return m_pixelTolerance * m_toleranceScale.load(std::memory_order_relaxed);
+}
+
+// Level i is drawn once the circle is too big for level i - 1:
+// pixelSize / 2 * (1 - cos(pi / division)) > tolerance.
+void LODPolicy::getDivisionLevels(std::vector<int> &divisions, std::vector<float> &minPixelSizes) const
+{
+	divisions.assign(DIVISION_LEVELS, DIVISION_LEVELS + NUM_DIVISION_LEVELS);
+	minPixelSizes.clear();
+	minPixelSizes.push_back(0.0f);
+	for (size_t i = 1; i < NUM_DIVISION_LEVELS; ++i)
+	{
+		double sagitta = 1.0 - cos(osg::PI / DIVISION_LEVELS[i - 1]);
+		minPixelSizes.push_back(static_cast<float>(2.0 * m_pixelTolerance / sagitta));
+	}
+}
+
+void LODPolicy::addTriangles(unsigned int triangles)
+{
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+	m_triangles += triangles;
+}
+
+void LODPolicy::endFrame()
+{
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+	unsigned int triangles = m_triangles;
+	m_triangles = 0;
+	// frames without a full cull, while the view moves, say nothing
+	if (m_triangleBudget == 0 || triangles == 0)
+		return;
+
+	// The triangles grow with the division for a cylinder and with its
+	// square for a sphere, the division with 1 / sqrt(tolerance): scaling by
+	// the ratio undershoots rather than overshoots.
+	float ratio = static_cast<float>(triangles) / m_triangleBudget;
+	if (ratio > 1.0f || ratio < BUDGET_LOW)
+	{
+		const float scale = m_toleranceScale.load(std::memory_order_relaxed);
+		m_toleranceScale.store(osg::clampBetween(scale * ratio, 1.0f, MAX_TOLERANCE_SCALE), std::memory_order_relaxed);
+	}
+}
+
+} // namespace Geometry
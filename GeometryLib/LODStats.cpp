@@ -0,0 +1,116 @@
+#include "stdafx.h"
+#include "LODStats.h"
+#include <OpenThreads/ScopedLock>
+
+namespace Geometry
+{
+
+const char *LODStats::VISITED = "LOD visited";
+const char *LODStats::SMALL_FEATURE_CULLED = "LOD small feature culled";
+const char *LODStats::OCCLUSION_CULLED = "LOD occlusion culled";
+const char *LODStats::RETESSELLATED = "LOD retessellated";
+const char *LODStats::VERTICES = "LOD vertices";
+const char *LODStats::TRIANGLES = "LOD triangles";
+const char *LODStats::TESSELLATION_TIME = "LOD tessellation time";
+
+LODStats::LODStats()
+	: m_visited(0)
+	, m_smallFeatureCulled(0)
+	, m_occlusionCulled(0)
+	, m_retessellated(0)
+	, m_vertices(0)
+	, m_triangles(0)
+	, m_tessellationTime(0.0)
+	, m_csv(NULL)
+{
+}
+
+LODStats::~LODStats()
+{
+	setCsvFile("");
+}
+
+LODStats *LODStats::instance()
+{
+	static LODStats stats;
+	return &stats;
+}
+
+void LODStats::addCull(unsigned int visited, unsigned int smallFeatureCulled, unsigned int occlusionCulled,
+	unsigned int triangles)
+{
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+	m_visited += visited;
+	m_smallFeatureCulled += smallFeatureCulled;
+	m_occlusionCulled += occlusionCulled;
+	m_triangles += triangles;
+}
+
+void LODStats::addRetessellated(unsigned int count)
+{
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+	m_retessellated += count;
+}
+
+void LODStats::addTessellation(unsigned int vertices, osg::Timer_t start, osg::Timer_t end)
+{
+	double time = osg::Timer::instance()->delta_s(start, end);
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+	m_vertices += vertices;
+	m_tessellationTime += time;
+}
+
+void LODStats::publish(osg::Stats *stats, unsigned int frameNumber)
+{
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+	if (stats != NULL)
+	{
+		stats->setAttribute(frameNumber, VISITED, m_visited);
+		stats->setAttribute(frameNumber, SMALL_FEATURE_CULLED, m_smallFeatureCulled);
+		stats->setAttribute(frameNumber, OCCLUSION_CULLED, m_occlusionCulled);
+		stats->setAttribute(frameNumber, RETESSELLATED, m_retessellated);
+		stats->setAttribute(frameNumber, VERTICES, m_vertices);
+		stats->setAttribute(frameNumber, TRIANGLES, m_triangles);
+		stats->setAttribute(frameNumber, TESSELLATION_TIME, m_tessellationTime);
+	}
+
+	if (m_csv != NULL)
+	{
+		fprintf(m_csv, "%u,%u,%u,%u,%u,%u,%u,%.3f\n", frameNumber, m_visited, m_smallFeatureCulled,
+			m_occlusionCulled, m_retessellated, m_vertices, m_triangles, m_tessellationTime * 1000.0);
+	}
+
+	m_visited = 0;
+	m_smallFeatureCulled = 0;
+	m_occlusionCulled = 0;
+	m_retessellated = 0;
+	m_vertices = 0;
+	m_triangles = 0;
+	m_tessellationTime = 0.0;
+}
+
+bool LODStats::setCsvFile(const std::string &fileName)
+{
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+	if (m_csv != NULL)
+	{
+		fclose(m_csv);
+		m_csv = NULL;
+	}
+	if (fileName.empty())
+		return true;
+
+	m_csv = fopen(fileName.c_str(), "w");
+	if (m_csv == NULL)
+		return false;
+	fprintf(m_csv, "frame,visited,small_feature_culled,occlusion_culled,retessellated,vertices,triangles,tessellation_ms\n");
+	return true;
+}
+
+bool LODStats::isWritingCsv() const
+{
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+	return m_csv != NULL;
+}
+
+} // namespace Geometry
@@ -0,0 +1,298 @@
+#include "stdafx.h"
+#include "inc/OcclusionBuffer.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <osg/TriangleIndexFunctor>
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define OCCLUSION_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace Geometry
+{
+
+namespace
+{
+
+// clip space w below which a point is behind the eye, triangles are clipped
+// to it and boxes reaching it are visible
+const float NEAR_W = 1.0e-5f;
+const float EMPTY_DEPTH = FLT_MAX;
+
+struct IndexCollector
+{
+	std::vector<unsigned int> *indices;
+
+	void operator()(unsigned int i1, unsigned int i2, unsigned int i3)
+	{
+		indices->push_back(i1);
+		indices->push_back(i2);
+		indices->push_back(i3);
+	}
+};
+
+// a x + b y + c, positive inside, scaled to about one per pixel so that it
+// stays precise for the huge triangles of vertices next to the eye
+struct Edge
+{
+	float a;
+	float b;
+	// at the center of the first pixel of the rectangle, moved in by half a
+	// pixel: positive at a center means the whole pixel is inside
+	float c;
+
+	Edge(const osg::Vec3 &p, const osg::Vec3 &q, double originX, double originY)
+	{
+		double da = (double)p.y() - q.y();
+		double db = (double)q.x() - p.x();
+		double dc = da * (originX - p.x()) + db * (originY - p.y());
+		double scale = std::max(fabs(da), fabs(db));
+		if (scale > 0.0)
+		{
+			da /= scale;
+			db /= scale;
+			dc /= scale;
+		}
+		a = (float)da;
+		b = (float)db;
+		c = (float)(dc - 0.5 * (fabs(da) + fabs(db)));
+	}
+};
+
+} // namespace
+
+OcclusionBuffer::OcclusionBuffer()
+	: m_width(0)
+	, m_height(0)
+	, m_numTriangles(0)
+{
+	setSize(256, 128);
+}
+
+void OcclusionBuffer::setSize(unsigned int width, unsigned int height)
+{
+	m_width = std::max(4u, (width + 3) & ~3u);
+	m_height = std::max(1u, height);
+	m_depths.assign(m_width * m_height, EMPTY_DEPTH);
+	m_numTriangles = 0;
+}
+
+void OcclusionBuffer::clear()
+{
+	std::fill(m_depths.begin(), m_depths.end(), EMPTY_DEPTH);
+	m_numTriangles = 0;
+}
+
+unsigned int OcclusionBuffer::drawGeometry(const osg::Geometry &geometry, const osg::Matrix &modelViewProjection)
+{
+	const osg::Vec3Array *vertices = dynamic_cast<const osg::Vec3Array*>(geometry.getVertexArray());
+	if (vertices == NULL || vertices->empty())
+		return 0;
+
+	m_clips.resize(vertices->size());
+	for (size_t i = 0; i < vertices->size(); ++i)
+		m_clips[i] = osg::Vec4((*vertices)[i], 1.0f) * modelViewProjection;
+
+	m_indices.clear();
+	osg::TriangleIndexFunctor<IndexCollector> collector;
+	collector.indices = &m_indices;
+	geometry.accept(collector);
+
+	unsigned int count = 0;
+	for (size_t i = 0; i + 2 < m_indices.size(); i += 3)
+	{
+		if (m_indices[i] >= m_clips.size() || m_indices[i + 1] >= m_clips.size() || m_indices[i + 2] >= m_clips.size())
+			continue;
+		drawTriangle(m_clips[m_indices[i]], m_clips[m_indices[i + 1]], m_clips[m_indices[i + 2]]);
+		++count;
+	}
+	m_numTriangles += count;
+	return count;
+}
+
+void OcclusionBuffer::drawTriangle(const osg::Vec4 &c0, const osg::Vec4 &c1, const osg::Vec4 &c2)
+{
+	// clipped to the plane w = NEAR_W, a triangle or a quad is left
+	const osg::Vec4 *corners[] = { &c0, &c1, &c2 };
+	osg::Vec4 polygon[4];
+	int count = 0;
+	for (int i = 0; i < 3; ++i)
+	{
+		const osg::Vec4 &a = *corners[i];
+		const osg::Vec4 &b = *corners[(i + 1) % 3];
+		bool aInside = a.w() >= NEAR_W;
+		if (aInside)
+			polygon[count++] = a;
+		if (aInside != (b.w() >= NEAR_W))
+			polygon[count++] = a + (b - a) * ((NEAR_W - a.w()) / (b.w() - a.w()));
+	}
+	if (count < 3)
+		return;
+
+	osg::Vec3 v0 = toScreen(polygon[0]);
+	osg::Vec3 v2 = toScreen(polygon[2]);
+	rasterize(v0, toScreen(polygon[1]), v2);
+	if (count == 4)
+		rasterize(v0, v2, toScreen(polygon[3]));
+}
+
+osg::Vec3 OcclusionBuffer::toScreen(const osg::Vec4 &clip) const
+{
+	float inv = 1.0f / clip.w();
+	return osg::Vec3((clip.x() * inv * 0.5f + 0.5f) * m_width, (clip.y() * inv * 0.5f + 0.5f) * m_height,
+		clip.z() * inv);
+}
+
+void OcclusionBuffer::rasterize(const osg::Vec3 &v0, const osg::Vec3 &v1, const osg::Vec3 &v2)
+{
+	double area = ((double)v1.x() - v0.x()) * ((double)v2.y() - v0.y()) -
+		((double)v2.x() - v0.x()) * ((double)v1.y() - v0.y());
+	if (!(fabs(area) > 0.0))
+		return;
+
+	// either winding, both sides of an occluder hide what is behind it
+	const osg::Vec3 &a = v0;
+	const osg::Vec3 &b = area > 0.0 ? v1 : v2;
+	const osg::Vec3 &c = area > 0.0 ? v2 : v1;
+	area = fabs(area);
+
+	float minX = std::max(0.0f, std::min(a.x(), std::min(b.x(), c.x())));
+	float maxX = std::min((float)m_width, std::max(a.x(), std::max(b.x(), c.x())));
+	float minY = std::max(0.0f, std::min(a.y(), std::min(b.y(), c.y())));
+	float maxY = std::min((float)m_height, std::max(a.y(), std::max(b.y(), c.y())));
+	if (!(minX < maxX && minY < maxY))
+		return;
+
+	// whole groups of 4 pixels, the width is a multiple of 4
+	const int x0 = (int)minX & ~3;
+	const int x1 = (int)ceil(maxX);
+	const int y0 = (int)minY;
+	const int y1 = (int)ceil(maxY);
+	const double originX = x0 + 0.5;
+	const double originY = y0 + 0.5;
+
+	const Edge e0(b, c, originX, originY);
+	const Edge e1(c, a, originX, originY);
+	const Edge e2(a, b, originX, originY);
+
+	const double dzdx = (((double)b.z() - a.z()) * ((double)c.y() - a.y()) -
+		((double)c.z() - a.z()) * ((double)b.y() - a.y())) / area;
+	const double dzdy = (((double)b.x() - a.x()) * ((double)c.z() - a.z()) -
+		((double)c.x() - a.x()) * ((double)b.z() - a.z())) / area;
+	const float za = (float)dzdx;
+	const float zb = (float)dzdy;
+	// the farthest depth over the pixel rather than the one at its center
+	const float zc = (float)(a.z() + dzdx * (originX - a.x()) + dzdy * (originY - a.y()) +
+		0.5 * (fabs(dzdx) + fabs(dzdy)));
+
+#ifdef OCCLUSION_SSE2
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 offsets = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+	const __m128 a0 = _mm_set1_ps(e0.a);
+	const __m128 a1 = _mm_set1_ps(e1.a);
+	const __m128 a2 = _mm_set1_ps(e2.a);
+	const __m128 az = _mm_set1_ps(za);
+	for (int y = y0; y < y1; ++y)
+	{
+		const float dy = (float)(y - y0);
+		const __m128 r0 = _mm_set1_ps(e0.c + e0.b * dy);
+		const __m128 r1 = _mm_set1_ps(e1.c + e1.b * dy);
+		const __m128 r2 = _mm_set1_ps(e2.c + e2.b * dy);
+		const __m128 rz = _mm_set1_ps(zc + zb * dy);
+		float *row = &m_depths[y * m_width];
+		for (int x = x0; x < x1; x += 4)
+		{
+			const __m128 dx = _mm_add_ps(_mm_set1_ps((float)(x - x0)), offsets);
+			__m128 inside = _mm_cmpge_ps(_mm_add_ps(r0, _mm_mul_ps(a0, dx)), zero);
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(r1, _mm_mul_ps(a1, dx)), zero));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(r2, _mm_mul_ps(a2, dx)), zero));
+			if (_mm_movemask_ps(inside) == 0)
+				continue;
+
+			const __m128 depth = _mm_loadu_ps(row + x);
+			const __m128 z = _mm_min_ps(_mm_add_ps(rz, _mm_mul_ps(az, dx)), depth);
+			_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, z), _mm_andnot_ps(inside, depth)));
+		}
+	}
+#else
+	for (int y = y0; y < y1; ++y)
+	{
+		const float dy = (float)(y - y0);
+		float *row = &m_depths[y * m_width];
+		for (int x = x0; x < x1; ++x)
+		{
+			const float dx = (float)(x - x0);
+			if (e0.c + e0.b * dy + e0.a * dx < 0.0f || e1.c + e1.b * dy + e1.a * dx < 0.0f ||
+				e2.c + e2.b * dy + e2.a * dx < 0.0f)
+				continue;
+			row[x] = std::min(row[x], zc + zb * dy + za * dx);
+		}
+	}
+#endif
+}
+
+bool OcclusionBuffer::isOccluded(const osg::BoundingBox &box, const osg::Matrix &modelViewProjection) const
+{
+	if (m_numTriangles == 0 || !box.valid())
+		return false;
+
+	float minX = FLT_MAX;
+	float maxX = -FLT_MAX;
+	float minY = FLT_MAX;
+	float maxY = -FLT_MAX;
+	float minZ = FLT_MAX;
+	for (unsigned int i = 0; i < 8; ++i)
+	{
+		osg::Vec4 clip = osg::Vec4(box.corner(i), 1.0f) * modelViewProjection;
+		if (clip.w() < NEAR_W)
+			return false;
+		osg::Vec3 screen = toScreen(clip);
+		minX = std::min(minX, screen.x());
+		maxX = std::max(maxX, screen.x());
+		minY = std::min(minY, screen.y());
+		maxY = std::max(maxY, screen.y());
+		minZ = std::min(minZ, screen.z());
+	}
+	if (!(maxX > 0.0f && maxY > 0.0f && minX < m_width && minY < m_height))
+		return false;
+
+	// every pixel the box touches, not only the ones whose center it covers
+	const int x0 = std::max(0, (int)floor(minX));
+	const int x1 = std::min((int)m_width - 1, (int)floor(maxX));
+	const int y0 = std::max(0, (int)floor(minY));
+	const int y1 = std::min((int)m_height - 1, (int)floor(maxY));
+
+#ifdef OCCLUSION_SSE2
+	const __m128 offsets = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+	const __m128 first = _mm_set1_ps((float)x0);
+	const __m128 last = _mm_set1_ps((float)x1);
+	const __m128 nearest = _mm_set1_ps(minZ);
+	for (int y = y0; y <= y1; ++y)
+	{
+		const float *row = &m_depths[y * m_width];
+		for (int x = x0 & ~3; x <= x1; x += 4)
+		{
+			const __m128 xs = _mm_add_ps(_mm_set1_ps((float)x), offsets);
+			__m128 visible = _mm_and_ps(_mm_cmpge_ps(xs, first), _mm_cmple_ps(xs, last));
+			visible = _mm_and_ps(visible, _mm_cmpge_ps(_mm_loadu_ps(row + x), nearest));
+			if (_mm_movemask_ps(visible) != 0)
+				return false;
+		}
+	}
+#else
+	for (int y = y0; y <= y1; ++y)
+	{
+		const float *row = &m_depths[y * m_width];
+		for (int x = x0; x <= x1; ++x)
+		{
+			if (row[x] >= minZ)
+				return false;
+		}
+	}
+#endif
+	return true;
+}
+
+} // namespace Geometry
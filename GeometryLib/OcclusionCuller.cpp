@@ -0,0 +1,83 @@
+#include "stdafx.h"
+#include "inc/OcclusionCuller.h"
+#include <osg/FrameStamp>
+#include <OpenThreads/ScopedLock>
+
+namespace Geometry
+{
+
+OcclusionCuller::OcclusionCuller()
+	: m_enabled(true)
+	, m_width(256)
+	, m_height(128)
+	, m_minOccluderPixelSize(64.0f)
+	, m_maxOccluderTriangles(20000)
+{
+}
+
+OcclusionCuller::~OcclusionCuller()
+{
+	for (std::map<const osg::NodeVisitor*, Entry>::iterator it = m_buffers.begin(); it != m_buffers.end(); ++it)
+		delete it->second.buffer;
+}
+
+OcclusionCuller *OcclusionCuller::instance()
+{
+	static OcclusionCuller culler;
+	return &culler;
+}
+
+void OcclusionCuller::setEnabled(bool enabled)
+{
+	m_enabled = enabled;
+}
+
+void OcclusionCuller::setBufferSize(unsigned int width, unsigned int height)
+{
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+	m_width = width;
+	m_height = height;
+}
+
+void OcclusionCuller::setMinOccluderPixelSize(float pixels)
+{
+	m_minOccluderPixelSize = pixels;
+}
+
+void OcclusionCuller::setMaxOccluderTriangles(unsigned int triangles)
+{
+	m_maxOccluderTriangles = triangles;
+}
+
+OcclusionBuffer *OcclusionCuller::getBuffer(osg::NodeVisitor &nv)
+{
+	if (!m_enabled)
+		return NULL;
+
+	const osg::FrameStamp *frameStamp = nv.getFrameStamp();
+	const unsigned int frameNumber = frameStamp != NULL ? frameStamp->getFrameNumber() : nv.getTraversalNumber();
+
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+	std::map<const osg::NodeVisitor*, Entry>::iterator it = m_buffers.find(&nv);
+	if (it == m_buffers.end())
+	{
+		Entry entry = { new OcclusionBuffer, frameNumber };
+		entry.buffer->setSize(m_width, m_height);
+		m_buffers[&nv] = entry;
+		return entry.buffer;
+	}
+
+	// only the cull thread of nv uses its buffer, the lock guards the map
+	Entry &entry = it->second;
+	if (entry.frameNumber != frameNumber)
+	{
+		if (entry.buffer->getWidth() != ((m_width + 3) & ~3u) || entry.buffer->getHeight() != m_height)
+			entry.buffer->setSize(m_width, m_height);
+		else
+			entry.buffer->clear();
+		entry.frameNumber = frameNumber;
+	}
+	return entry.buffer;
+}
+
+} // namespace Geometry
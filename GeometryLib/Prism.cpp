@@ -1,5 +1,5 @@
 #include "stdafx.h"
-#include "inc\Prism.h"
+#include "inc/Prism.h"
 
 
 namespace Geometry
@@ -15,6 +15,11 @@ Prism::~Prism()
 {
 }
 
+BaseGeometry *Prism::cloneGeometry() const
+{
+	return new Prism(*this);
+}
+
 void Prism::subDraw()
 {
 	computeAssistVar();
@@ -76,6 +81,17 @@ void Prism::subDraw()
 	addPrimitiveSet(new osg::DrawArrays(osg::PrimitiveSet::QUADS, first, vertexArr->size() - first));
 }
 
+bool Prism::getCullShape(CullShape &shape)
+{
+	shape.probes[0].center = m_org;
+	shape.probes[0].size = (float)(m_radius * 2.0);
+	shape.probes[1].center = m_org + m_height;
+	shape.probes[1].size = (float)(m_radius * 2.0);
+	shape.numProbes = 2;
+	shape.divided = false;
+	return true;
+}
+
 bool Prism::doCullAndUpdate(const osg::CullStack &cullStack)
 {
 	float psb = cullStack.clampedPixelSize(m_org, m_radius * 2.0);
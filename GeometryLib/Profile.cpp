@@ -0,0 +1,133 @@
+#include "stdafx.h"
+#include "inc/Profile.h"
+#include <osg/Vec3d>
+#include <osg/Math>
+#include "inc/BaseGeometry.h"
+
+namespace Geometry
+{
+
+namespace
+{
+
+void AddLine(const osg::Vec3 &start, const osg::Vec3 &end, std::vector<ProfileSegment> &segments)
+{
+	if ((end - start).length() <= GetEpsilon())
+		return;
+	ProfileSegment segment(2);
+	segment[0] = start;
+	segment[1] = end;
+	segments.push_back(segment);
+}
+
+// from start through middle to end, the whole circle through them when full
+void AddArc(const osg::Vec3 &start, const osg::Vec3 &middle, const osg::Vec3 &end, bool full, int division,
+	std::vector<ProfileSegment> &segments)
+{
+	osg::Vec3d ab = osg::Vec3d(middle) - osg::Vec3d(start);
+	osg::Vec3d ac = osg::Vec3d(end) - osg::Vec3d(start);
+	osg::Vec3d normal = ab ^ ac;
+	double normal2 = normal.length2();
+	if (normal2 <= GetEpsilon() * ab.length2() * ac.length2())
+	{
+		// three points on a line
+		if (!full)
+			AddLine(start, end, segments);
+		return;
+	}
+
+	osg::Vec3d center = osg::Vec3d(start)
+		+ ((normal ^ ab) * ac.length2() + (ac ^ normal) * ab.length2()) / (2.0 * normal2);
+	osg::Vec3d xAxis = osg::Vec3d(start) - center;
+	normal.normalize();
+	osg::Vec3d yAxis = normal ^ xAxis;
+
+	// start, middle and end turn counterclockwise about normal
+	double sweep = 2.0 * M_PI;
+	if (!full)
+	{
+		osg::Vec3d toEnd = osg::Vec3d(end) - center;
+		sweep = atan2(toEnd * yAxis, toEnd * xAxis);
+		if (sweep <= 0.0)
+			sweep += 2.0 * M_PI;
+	}
+
+	int count = osg::maximum(1, (int)ceil(division * sweep / (2.0 * M_PI)));
+	ProfileSegment segment(count + 1);
+	segment[0] = start;
+	for (int i = 1; i < count; ++i)
+	{
+		double angle = sweep * i / count;
+		segment[i] = center + xAxis * cos(angle) + yAxis * sin(angle);
+	}
+	segment[count] = full ? start : end;
+	segments.push_back(segment);
+}
+
+} // namespace
+
+bool FlattenProfile(const osg::Vec3 *vertexs, const int *flags, unsigned int numVertexs, int division, bool closed,
+	std::vector<ProfileSegment> &segments)
+{
+	segments.clear();
+	bool isClosed = false;
+	for (unsigned int i = 0; i < numVertexs && !isClosed;)
+	{
+		switch (flags[i])
+		{
+		case PROFILE_LINE:
+			if (i + 1 < numVertexs)
+				AddLine(vertexs[i], vertexs[i + 1], segments);
+			else if (closed)
+			{
+				AddLine(vertexs[i], vertexs[0], segments);
+				isClosed = true;
+			}
+			++i;
+			break;
+		case PROFILE_ARC:
+			if (i + 2 < numVertexs)
+				AddArc(vertexs[i], vertexs[i + 1], vertexs[i + 2], false, division, segments);
+			else if (i + 2 == numVertexs && closed)
+			{
+				AddArc(vertexs[i], vertexs[i + 1], vertexs[0], false, division, segments);
+				isClosed = true;
+			}
+			i += 2;
+			break;
+		case PROFILE_LINE_CLOSE:
+			AddLine(vertexs[i], vertexs[0], segments);
+			isClosed = true;
+			break;
+		case PROFILE_ARC_CLOSE:
+			if (i + 1 < numVertexs)
+				AddArc(vertexs[i], vertexs[i + 1], vertexs[0], false, division, segments);
+			isClosed = true;
+			break;
+		case PROFILE_CIRCLE:
+			if (i + 2 < numVertexs)
+				AddArc(vertexs[i], vertexs[i + 1], vertexs[i + 2], true, division, segments);
+			isClosed = true;
+			break;
+		default:
+			++i;
+			break;
+		}
+	}
+	return isClosed;
+}
+
+void JoinProfile(const std::vector<ProfileSegment> &segments, std::vector<osg::Vec3> &points)
+{
+	points.clear();
+	for (size_t i = 0; i < segments.size(); ++i)
+	{
+		const ProfileSegment &segment = segments[i];
+		size_t first = !points.empty() && (points.back() - segment.front()).length() <= GetEpsilon() ? 1 : 0;
+		points.insert(points.end(), segment.begin() + first, segment.end());
+	}
+	if (points.size() > 1 && (points.back() - points.front()).length() <= GetEpsilon())
+		points.pop_back();
+}
+
+} // namespace Geometry
@@ -0,0 +1,134 @@
+#include "stdafx.h"
+#include "PrototypeCache.h"
+#include <osg/Geode>
+#include <osg/MatrixTransform>
+#include <OpenThreads/ScopedLock>
+#include "BaseGeometry.h"
+
+namespace Geometry
+{
+
+PrototypeKey::PrototypeKey()
+	: type(NONE)
+	, flags(0)
+{
+	divisions[0] = divisions[1] = 0;
+	shape[0] = shape[1] = shape[2] = 0;
+}
+
+bool PrototypeKey::operator<(const PrototypeKey &key) const
+{
+	if (type != key.type)
+		return type < key.type;
+	for (int i = 0; i < 2; ++i)
+	{
+		if (divisions[i] != key.divisions[i])
+			return divisions[i] < key.divisions[i];
+	}
+	if (flags != key.flags)
+		return flags < key.flags;
+	for (int i = 0; i < 3; ++i)
+	{
+		if (shape[i] != key.shape[i])
+			return shape[i] < key.shape[i];
+	}
+	return false;
+}
+
+int QuantizeShape(double val)
+{
+	return static_cast<int>(floor(val * 10000.0 + 0.5));
+}
+
+PrototypeCache::PrototypeCache()
+	: m_hitCount(0)
+	, m_missCount(0)
+{
+}
+
+PrototypeCache *PrototypeCache::instance()
+{
+	static PrototypeCache cache;
+	return &cache;
+}
+
+osg::Geometry *PrototypeCache::find(const PrototypeKey &key)
+{
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+	auto iter = m_prototypes.find(key);
+	if (iter == m_prototypes.end())
+	{
+		++m_missCount;
+		return NULL;
+	}
+
+	++m_hitCount;
+	return iter->second.get();
+}
+
+osg::Geometry *PrototypeCache::insert(const PrototypeKey &key, osg::Geometry *prototype)
+{
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+	osg::ref_ptr<osg::Geometry> &entry = m_prototypes[key];
+	if (!entry.valid())
+	{
+		// instances are scaled, keep their lighting right
+		prototype->getOrCreateStateSet()->setMode(GL_NORMALIZE, osg::StateAttribute::ON);
+		prototype->setUseDisplayList(false);
+		prototype->setUseVertexBufferObjects(true);
+		entry = prototype;
+	}
+	return entry.get();
+}
+
+void PrototypeCache::clear()
+{
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+	m_prototypes.clear();
+}
+
+unsigned int PrototypeCache::getSize() const
+{
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+	return m_prototypes.size();
+}
+
+unsigned int PrototypeCache::getHitCount() const
+{
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+	return m_hitCount;
+}
+
+unsigned int PrototypeCache::getMissCount() const
+{
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+	return m_missCount;
+}
+
+double PrototypeCache::getHitRate() const
+{
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+	unsigned int total = m_hitCount + m_missCount;
+	return total == 0 ? 0.0 : static_cast<double>(m_hitCount) / total;
+}
+
+void PrototypeCache::resetStatistics()
+{
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+	m_hitCount = 0;
+	m_missCount = 0;
+}
+
+osg::ref_ptr<osg::Node> CreateGeometryNode(BaseGeometry *geometry)
+{
+	osg::ref_ptr<osg::Geode> geode(new osg::Geode);
+	geode->addDrawable(geometry);
+	if (!geometry->isInstanced())
+		return geode;
+
+	osg::ref_ptr<osg::MatrixTransform> transform(new osg::MatrixTransform(geometry->getInstanceMatrix()));
+	transform->addChild(geode);
+	return transform;
+}
+
+} // namespace Geometry
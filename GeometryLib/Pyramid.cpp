@@ -1,5 +1,5 @@
 #include "stdafx.h"
-#include "inc\Pyramid.h"
+#include "inc/Pyramid.h"
 
 
 namespace Geometry
@@ -14,6 +14,11 @@ Pyramid::~Pyramid()
 {
 }
 
+BaseGeometry *Pyramid::cloneGeometry() const
+{
+	return new Pyramid(*this);
+}
+
 void Pyramid::subDraw()
 {
 	osg::Vec3 yAxis = m_height ^ m_xAxis;
@@ -1,5 +1,6 @@
 #include "stdafx.h"
-#include "inc\RectCirc.h"
+#include "inc/RectCirc.h"
+#include "inc/RingTable.h"
 
 
 namespace Geometry
@@ -14,6 +15,11 @@ RectCirc::~RectCirc()
 {
 }
 
+BaseGeometry *RectCirc::cloneGeometry() const
+{
+	return new RectCirc(*this);
+}
+
 void RectCirc::subDraw()
 {
 	computeAssistVar();
@@ -41,21 +47,14 @@ void RectCirc::subDraw()
 	int t = count % 4;
 	if (t != 0)
 		count += 4 - t;
-	double incAng = M_PI * 2.0 / count;
-	osg::Quat quat(incAng, topNormal);
+	const RingTable &ring = RingTable::get(count);
 
 	// top
 	size_t topFirst = vertexArr->size();
 	vertexArr->push_back(circCenter);
-	normalArr->push_back(topNormal);
-	for (int i = 0; i < count; ++i)
-	{
-		vertexArr->push_back(circCenter + circVec);
-		normalArr->push_back(topNormal);
-		circVec = quat * circVec;
-	}
-	vertexArr->push_back((*vertexArr)[topFirst + 1]);
-	normalArr->push_back(topNormal);
+	vertexArr->resize(topFirst + count + 2);
+	ring.rotate(circCenter, topNormal, circVec, &(*vertexArr)[topFirst + 1]);
+	normalArr->resize(vertexArr->size(), topNormal);
 	addPrimitiveSet(new osg::DrawArrays(osg::PrimitiveSet::TRIANGLE_FAN, topFirst, vertexArr->size() - topFirst));
 
 	// bottom
@@ -113,17 +112,17 @@ void RectCirc::subDraw()
 	// back right
 	first = vertexArr->size();
 	size_t vertexIdx = topFirst + 1;
+	std::vector<osg::Vec3> vecArr(count + 1);
 	osg::Vec3 vec = m_xLen;
 	vec.normalize();
+	ring.rotate(osg::Vec3(), topNormal, vec, &vecArr[0]);
 	for (int i = 0; i < count_4 + 1; ++i, ++vertexIdx)
 	{
 		vertexArr->push_back((*vertexArr)[vertexIdx]);
 		vertexArr->push_back(bp2);
-		normalArr->push_back((bp2 - (*vertexArr)[vertexIdx]) ^ vec);
+		normalArr->push_back((bp2 - (*vertexArr)[vertexIdx]) ^ vecArr[i]);
 		normalArr->back().normalize();
 		normalArr->push_back(normalArr->back());
-
-		vec = quat * vec;
 	}
 	addPrimitiveSet(new osg::DrawArrays(osg::PrimitiveSet::QUAD_STRIP, first, vertexArr->size() - first));
 
@@ -132,15 +131,14 @@ void RectCirc::subDraw()
 	--vertexIdx;
 	vec = yVec;
 	vec.normalize();
+	ring.rotate(osg::Vec3(), topNormal, vec, &vecArr[0]);
 	for (int i = 0; i < count_4 + 1; ++i, ++vertexIdx)
 	{
 		vertexArr->push_back((*vertexArr)[vertexIdx]);
 		vertexArr->push_back(bp3);
-		normalArr->push_back((bp3 - (*vertexArr)[vertexIdx]) ^ vec);
+		normalArr->push_back((bp3 - (*vertexArr)[vertexIdx]) ^ vecArr[i]);
 		normalArr->back().normalize();
 		normalArr->push_back(normalArr->back());
-
-		vec = quat * vec;
 	}
 	addPrimitiveSet(new osg::DrawArrays(osg::PrimitiveSet::QUAD_STRIP, first, vertexArr->size() - first));
 
@@ -149,15 +147,14 @@ void RectCirc::subDraw()
 	--vertexIdx;
 	vec = -m_xLen;
 	vec.normalize();
+	ring.rotate(osg::Vec3(), topNormal, vec, &vecArr[0]);
 	for (int i = 0; i < count_4 + 1; ++i, ++vertexIdx)
 	{
 		vertexArr->push_back((*vertexArr)[vertexIdx]);
 		vertexArr->push_back(bp4);
-		normalArr->push_back((bp4 - (*vertexArr)[vertexIdx]) ^ vec);
+		normalArr->push_back((bp4 - (*vertexArr)[vertexIdx]) ^ vecArr[i]);
 		normalArr->back().normalize();
 		normalArr->push_back(normalArr->back());
-
-		vec = quat * vec;
 	}
 	addPrimitiveSet(new osg::DrawArrays(osg::PrimitiveSet::QUAD_STRIP, first, vertexArr->size() - first));
 
@@ -166,15 +163,14 @@ void RectCirc::subDraw()
 	--vertexIdx;
 	vec = -yVec;
 	vec.normalize();
+	ring.rotate(osg::Vec3(), topNormal, vec, &vecArr[0]);
 	for (int i = 0; i < count_4 + 1; ++i, ++vertexIdx)
 	{
 		vertexArr->push_back((*vertexArr)[vertexIdx]);
 		vertexArr->push_back(bp1);
-		normalArr->push_back((bp1 - (*vertexArr)[vertexIdx]) ^ vec);
+		normalArr->push_back((bp1 - (*vertexArr)[vertexIdx]) ^ vecArr[i]);
 		normalArr->back().normalize();
 		normalArr->push_back(normalArr->back());
-
-		vec = quat * vec;
 	}
 	addPrimitiveSet(new osg::DrawArrays(osg::PrimitiveSet::QUAD_STRIP, first, vertexArr->size() - first));
 }
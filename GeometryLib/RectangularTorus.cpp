@@ -1,5 +1,5 @@
 #include "stdafx.h"
-#include "inc\RectangularTorus.h"
+#include "inc/RectangularTorus.h"
 
 
 namespace Geometry
@@ -16,6 +16,11 @@ RectangularTorus::~RectangularTorus()
 {
 }
 
+BaseGeometry *RectangularTorus::cloneGeometry() const
+{
+	return new RectangularTorus(*this);
+}
+
 void RectangularTorus::subDraw()
 {
 	computeAssistVar();
@@ -254,6 +259,15 @@ void RectangularTorus::subDraw()
 	}
 }
 
+bool RectangularTorus::getCullShape(CullShape &shape)
+{
+	shape.probes[0].center = m_center;
+	shape.probes[0].size = (float)(m_radius * 2.0);
+	shape.numProbes = 1;
+	shape.divided = true;
+	return true;
+}
+
 bool RectangularTorus::doCullAndUpdate(const osg::CullStack &cullStack)
 {
 	float ps = cullStack.clampedPixelSize(m_center, m_radius * 2.0);
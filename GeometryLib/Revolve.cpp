@@ -0,0 +1,199 @@
+#include "stdafx.h"
+#include "inc/Revolve.h"
+#include <cfloat>
+#include <osg/Quat>
+#include "inc/Profile.h"
+
+
+namespace Geometry
+{
+
+Revolve::Revolve()
+	: m_angle(0.0)
+	, m_radius(-1.0)
+{
+}
+
+
+Revolve::~Revolve()
+{
+}
+
+BaseGeometry *Revolve::cloneGeometry() const
+{
+	return new Revolve(*this);
+}
+
+void Revolve::subDraw()
+{
+	getPrimitiveSetList().clear();
+
+	osg::ref_ptr<osg::Vec3Array> vertexArr = new osg::Vec3Array;
+	osg::ref_ptr<osg::Vec3Array> normalArr = new osg::Vec3Array;
+	setVertexArray(vertexArr);
+	setNormalArray(normalArr, osg::Array::BIND_PER_VERTEX);
+	osg::ref_ptr<osg::Vec4Array> colArr = new osg::Vec4Array();
+	colArr->push_back(m_color);
+	setColorArray(colArr, osg::Array::BIND_OVERALL);
+
+	if (m_vertexs.empty() || m_flags.size() != m_vertexs.size())
+		return;
+
+	// a negative sweep turns the other way around the axis
+	osg::Vec3 axis = m_angle < 0.0 ? -m_axis : m_axis;
+	axis.normalize();
+	double angle = osg::minimum(fabs(m_angle), 2 * M_PI);
+	if (osg::equivalent(angle, 2 * M_PI, GetEpsilon()))
+		angle = 2 * M_PI;
+
+	// the profile lies in the plane of the axis and the radial to its
+	// farthest vertex
+	osg::Vec3 radial;
+	for (size_t i = 0; i < m_vertexs.size(); ++i)
+	{
+		osg::Vec3 vec = m_vertexs[i] - m_axisPnt;
+		vec -= axis * (vec * axis);
+		if (vec.length2() > radial.length2())
+			radial = vec;
+	}
+	if (radial.length() <= GetEpsilon())
+		return;
+	radial.normalize();
+	osg::Vec3 tangential = axis ^ radial;
+
+	std::vector<ProfileSegment> segments;
+	bool closed = FlattenProfile(&m_vertexs[0], &m_flags[0], m_vertexs.size(), m_division, false, segments);
+	std::vector<osg::Vec3> points;
+	JoinProfile(segments, points);
+	if (points.size() < 2)
+		return;
+
+	// the normals point out of the area of a closed profile, counterclockwise
+	// with the radial as x and the axis as y, and away from the axis where an
+	// open one rises along it
+	double area = 0.0;
+	if (closed)
+	{
+		for (size_t i = 0; i < points.size(); ++i)
+		{
+			osg::Vec3 vec1 = points[i] - m_axisPnt;
+			osg::Vec3 vec2 = points[(i + 1) % points.size()] - m_axisPnt;
+			area += (vec1 * radial) * (vec2 * axis) - (vec2 * radial) * (vec1 * axis);
+		}
+	}
+	else
+		area = (points.back() - points.front()) * axis;
+	const float sign = area < 0.0 ? -1.0f : 1.0f;
+
+	int count = (int)ceil(angle / (2 * M_PI / m_division));
+	std::vector<osg::Quat> quats(count + 1);
+	for (int i = 0; i <= count; ++i)
+		quats[i].makeRotate(angle * i / count, axis);
+
+	std::vector<GLuint> indices;
+	std::vector<osg::Vec3> normals;
+	for (size_t s = 0; s < segments.size(); ++s)
+	{
+		const ProfileSegment &segment = segments[s];
+		int size = (int)segment.size();
+
+		// a segment on the axis sweeps no area
+		bool onAxis = true;
+		for (int i = 0; i < size && onAxis; ++i)
+		{
+			osg::Vec3 vec = segment[i] - m_axisPnt;
+			onAxis = (vec - axis * (vec * axis)).length() <= GetEpsilon();
+		}
+		if (onAxis)
+			continue;
+
+		// smooth along an arc, the segments meet at an edge
+		normals.resize(size);
+		for (int i = 0; i < size; ++i)
+		{
+			osg::Vec3 tangent = segment[osg::minimum(i + 1, size - 1)] - segment[osg::maximum(i - 1, 0)];
+			normals[i] = (tangential ^ tangent) * sign;
+			normals[i].normalize();
+		}
+
+		GLuint first = vertexArr->size();
+		for (int j = 0; j <= count; ++j)
+		{
+			for (int i = 0; i < size; ++i)
+			{
+				vertexArr->push_back(m_axisPnt + quats[j] * (segment[i] - m_axisPnt));
+				normalArr->push_back(quats[j] * normals[i]);
+			}
+		}
+
+		for (int j = 0; j < count; ++j)
+		{
+			for (int i = 0; i + 1 < size; ++i)
+			{
+				GLuint p00 = first + j * size + i;
+				GLuint p01 = p00 + 1;
+				GLuint p10 = p00 + size;
+				GLuint p11 = p10 + 1;
+				if (sign > 0.0f)
+				{
+					GLuint tris[] = { p00, p10, p11, p00, p11, p01 };
+					indices.insert(indices.end(), tris, tris + 6);
+				}
+				else
+				{
+					GLuint tris[] = { p00, p11, p10, p00, p01, p11 };
+					indices.insert(indices.end(), tris, tris + 6);
+				}
+			}
+		}
+	}
+
+	if (!indices.empty())
+		addPrimitiveSet(CreateTriangles(indices, vertexArr->size()));
+}
+
+bool Revolve::getCullShape(CullShape &shape)
+{
+	if (m_radius < 0.0)
+		computeAssistVar();
+	shape.probes[0].center = m_center;
+	shape.probes[0].size = (float)(m_radius * 2.0);
+	shape.numProbes = 1;
+	shape.divided = true;
+	return true;
+}
+
+bool Revolve::doCullAndUpdate(const osg::CullStack &cullStack)
+{
+	if (m_radius < 0.0)
+		computeAssistVar();
+	float ps = cullStack.clampedPixelSize(m_center, m_radius * 2.0);
+	if (ps <= cullStack.getSmallFeatureCullingPixelSize())
+		return true;
+
+	updateDivision(ps);
+	return false;
+}
+
+void Revolve::computeAssistVar()
+{
+	// the profile turned all around the axis
+	osg::Vec3 axis = m_axis;
+	axis.normalize();
+	float minHeight = FLT_MAX, maxHeight = -FLT_MAX, maxRadius = 0.0f;
+	for (size_t i = 0; i < m_vertexs.size(); ++i)
+	{
+		osg::Vec3 vec = m_vertexs[i] - m_axisPnt;
+		float height = vec * axis;
+		minHeight = osg::minimum(minHeight, height);
+		maxHeight = osg::maximum(maxHeight, height);
+		maxRadius = osg::maximum(maxRadius, (vec - axis * height).length());
+	}
+	if (m_vertexs.empty())
+		minHeight = maxHeight = 0.0f;
+
+	float halfHeight = (maxHeight - minHeight) / 2.0f;
+	m_center = m_axisPnt + axis * (minHeight + halfHeight);
+	m_radius = sqrt(maxRadius * maxRadius + halfHeight * halfHeight);
+}
+} // namespace Geometry
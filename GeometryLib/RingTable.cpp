@@ -0,0 +1,129 @@
+#include "stdafx.h"
+#include "inc/RingTable.h"
+#include "inc/LODPolicy.h"
+#include <map>
+#include <OpenThreads/Mutex>
+#include <OpenThreads/ScopedLock>
+
+namespace Geometry
+{
+
+namespace
+{
+
+class RingTableRegistry
+{
+public:
+	RingTableRegistry()
+	{
+		std::vector<int> divisions;
+		std::vector<float> minPixelSizes;
+		LODPolicy::instance()->getDivisionLevels(divisions, minPixelSizes);
+		for (size_t i = 0; i < divisions.size(); ++i)
+			m_standard.push_back(RingTable(divisions[i]));
+	}
+
+	const RingTable &get(unsigned int count)
+	{
+		for (size_t i = 0; i < m_standard.size(); ++i)
+		{
+			if (m_standard[i].getCount() == count)
+				return m_standard[i];
+		}
+
+		OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+		auto iter = m_tables.find(count);
+		if (iter == m_tables.end())
+			iter = m_tables.insert(std::make_pair(count, RingTable(count))).first;
+		return iter->second;
+	}
+
+private:
+	// never changed after construction, read without the lock
+	std::vector<RingTable> m_standard;
+	std::map<unsigned int, RingTable> m_tables;
+	OpenThreads::Mutex m_mutex;
+};
+
+// built on first use, after LODPolicy, whatever the static init order
+RingTableRegistry &Registry()
+{
+	static RingTableRegistry registry;
+	return registry;
+}
+
+} // namespace
+
+RingTable::RingTable(unsigned int count, double angle)
+	: m_count(osg::maximum(count, 1u))
+	, m_angle(angle)
+	, m_cos(m_count + 1)
+	, m_sin(m_count + 1)
+{
+	double incAng = angle / m_count;
+	for (unsigned int i = 0; i <= m_count; ++i)
+	{
+		m_cos[i] = static_cast<float>(cos(incAng * i));
+		m_sin[i] = static_cast<float>(sin(incAng * i));
+	}
+
+	// closed rings end exactly on the first point
+	if (osg::equivalent(angle, 2.0 * osg::PI))
+	{
+		m_cos[m_count] = m_cos[0];
+		m_sin[m_count] = m_sin[0];
+	}
+}
+
+const RingTable &RingTable::get(unsigned int count)
+{
+	return Registry().get(count);
+}
+
+unsigned int RingTable::getCount() const
+{
+	return m_count;
+}
+
+double RingTable::getAngle() const
+{
+	return m_angle;
+}
+
+const float *RingTable::getCos() const
+{
+	return &m_cos[0];
+}
+
+const float *RingTable::getSin() const
+{
+	return &m_sin[0];
+}
+
+void RingTable::generate(const osg::Vec3 &center, const osg::Vec3 &xAxis, const osg::Vec3 &yAxis,
+	osg::Vec3 *out, unsigned int stride) const
+{
+	const float cx = center.x(), cy = center.y(), cz = center.z();
+	const float xx = xAxis.x(), xy = xAxis.y(), xz = xAxis.z();
+	const float yx = yAxis.x(), yy = yAxis.y(), yz = yAxis.z();
+	const float *cosArr = &m_cos[0];
+	const float *sinArr = &m_sin[0];
+	for (unsigned int i = 0; i <= m_count; ++i, out += stride)
+	{
+		const float c = cosArr[i], s = sinArr[i];
+		out->set(cx + xx * c + yx * s, cy + xy * c + yy * s, cz + xz * c + yz * s);
+	}
+}
+
+void RingTable::rotate(const osg::Vec3 &center, const osg::Vec3 &axis, const osg::Vec3 &vec,
+	osg::Vec3 *out, unsigned int stride) const
+{
+	// split vec into its part along the axis, which stays, and the part in the
+	// plane of the ring
+	osg::Vec3 k = axis;
+	k.normalize();
+	osg::Vec3 along = k * (k * vec);
+	generate(center + along, vec - along, k ^ vec, out, stride);
+}
+
+} // namespace Geometry
@@ -1,5 +1,6 @@
 #include "stdafx.h"
-#include "inc\SCylinder.h"
+#include "inc/SCylinder.h"
+#include "inc/RingTable.h"
 
 
 namespace Geometry
@@ -16,6 +17,11 @@ SCylinder::~SCylinder()
 {
 }
 
+BaseGeometry *SCylinder::cloneGeometry() const
+{
+	return new SCylinder(*this);
+}
+
 void SCylinder::subDraw()
 {
 	getPrimitiveSetList().clear();
@@ -28,7 +34,7 @@ void SCylinder::subDraw()
 	setColorArray(colArr, osg::Array::BIND_OVERALL);
 
 	int count = (int)getDivision();
-	double incAng = 2 * M_PI / count;
+	const RingTable &ring = RingTable::get(count);
 	osg::Vec3 topNormal = m_height;
 	topNormal.normalize();
 	double angleCos = m_bottomNormal * (-topNormal) / m_bottomNormal.length() / topNormal.length();
@@ -37,40 +43,25 @@ void SCylinder::subDraw()
 	double b = m_radius / sin(M_PI_2 - angle);
 	osg::Vec3 vec = m_bottomNormal ^ topNormal;
 	vec.normalize();
-	osg::Quat bottomQuat(incAng, m_bottomNormal);
-	double currAngle = 0;
 	osg::Quat localToWorldQuat;
 	localToWorldQuat.makeRotate(osg::Z_AXIS, m_bottomNormal);
 	osg::Vec3 yAxis = localToWorldQuat * osg::Y_AXIS;
 	osg::Quat localToWorldQuat2;
 	localToWorldQuat2.makeRotate(yAxis, vec);
 	localToWorldQuat *= localToWorldQuat2;
-	osg::Vec3 bottomVec(b * sin(currAngle), a * cos(currAngle), 0);
-	bottomVec = localToWorldQuat * bottomVec;
-	//bottomVec = localToWorldQuat2 * bottomVec;
+	// bottom ellipse (b * sin, a * cos, 0) in the bottom plane
+	osg::Vec3 bottomX = localToWorldQuat * osg::Vec3(0, a, 0);
+	osg::Vec3 bottomY = localToWorldQuat * osg::Vec3(b, 0, 0);
 
-	osg::Quat topQuat(incAng, topNormal);
-	osg::Vec3 topVec = vec * m_radius;
+	osg::Vec3 topY = topNormal ^ vec;
 	osg::Vec3 topCenter = m_org + m_height;
 	size_t first = vertexArr->size();
-	for (int i = 0; i < count; ++i)
-	{
-		vertexArr->push_back(topCenter + topVec);
-		vertexArr->push_back(m_org + bottomVec);
-		normalArr->push_back(topVec);
-		normalArr->back().normalize();
-		normalArr->push_back(normalArr->back());
-
-		currAngle += incAng;
-		bottomVec.set(b * sin(currAngle), a * cos(currAngle), 0);
-		bottomVec = localToWorldQuat * bottomVec;
-		//bottomVec = localToWorldQuat2 * bottomVec;
-		topVec = topQuat * topVec;
-	}
-	vertexArr->push_back((*vertexArr)[first]);
-	vertexArr->push_back((*vertexArr)[first + 1]);
-	normalArr->push_back((*normalArr)[first]);
-	normalArr->push_back((*normalArr)[first + 1]);
+	vertexArr->resize(first + (count + 1) * 2);
+	normalArr->resize(first + (count + 1) * 2);
+	ring.generate(topCenter, vec * m_radius, topY * m_radius, &(*vertexArr)[first], 2);
+	ring.generate(m_org, bottomX, bottomY, &(*vertexArr)[first + 1], 2);
+	ring.generate(osg::Vec3(), vec, topY, &(*normalArr)[first], 2);
+	ring.generate(osg::Vec3(), vec, topY, &(*normalArr)[first + 1], 2);
 	addPrimitiveSet(new osg::DrawArrays(osg::PrimitiveSet::TRIANGLE_STRIP, first, vertexArr->size() - first));
 
 	if (m_bottomVis)
@@ -100,6 +91,17 @@ void SCylinder::subDraw()
 	}
 }
 
+bool SCylinder::getCullShape(CullShape &shape)
+{
+	shape.probes[0].center = m_org;
+	shape.probes[0].size = (float)(m_radius * 2.0);
+	shape.probes[1].center = m_org + m_height;
+	shape.probes[1].size = (float)(m_radius * 2.0);
+	shape.numProbes = 2;
+	shape.divided = true;
+	return true;
+}
+
 bool SCylinder::doCullAndUpdate(const osg::CullStack &cullStack)
 {
 	float psb = cullStack.clampedPixelSize(m_org, m_radius * 2.0);
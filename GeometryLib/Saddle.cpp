@@ -1,5 +1,6 @@
 #include "stdafx.h"
-#include "inc\Saddle.h"
+#include "inc/Saddle.h"
+#include "inc/RingTable.h"
 
 
 namespace Geometry
@@ -14,6 +15,11 @@ Saddle::~Saddle()
 {
 }
 
+BaseGeometry *Saddle::cloneGeometry() const
+{
+	return new Saddle(*this);
+}
+
 void Saddle::subDraw()
 {
 	osg::ref_ptr<osg::Vec3Array> vertexArr = new osg::Vec3Array;
@@ -108,24 +114,21 @@ void Saddle::subDraw()
 		circCenter = tp1 + yVec / 2.0;
 	}
 	count = (int)ceil(angle / incAng);
-	incAng = angle / count;
 
 	first = vertexArr->size();
 	osg::Vec3 circPnt(tp1);
 	if (isCircLessThenRect)
 		circPnt = tp1 + width;
 	osg::Vec3 circVec = circCenter - circPnt;
-	osg::Quat quat(incAng, m_xLen);
-	for (int i = 0; i < count + 1; ++i)
-	{
-		vertexArr->push_back(circCenter - circVec);
-		vertexArr->push_back(vertexArr->back() + m_xLen);
-		normalArr->push_back(circVec);
-		normalArr->back().normalize();
-		normalArr->push_back(normalArr->back());
-
-		circVec = quat * circVec;
-	}
+	osg::Vec3 circNormal = circVec;
+	circNormal.normalize();
+	RingTable arc(count, angle);
+	vertexArr->resize(first + (count + 1) * 2);
+	normalArr->resize(first + (count + 1) * 2);
+	arc.rotate(circCenter, m_xLen, -circVec, &(*vertexArr)[first], 2);
+	arc.rotate(circCenter + m_xLen, m_xLen, -circVec, &(*vertexArr)[first + 1], 2);
+	arc.rotate(osg::Vec3(), m_xLen, circNormal, &(*normalArr)[first], 2);
+	arc.rotate(osg::Vec3(), m_xLen, circNormal, &(*normalArr)[first + 1], 2);
 	addPrimitiveSet(new osg::DrawArrays(osg::PrimitiveSet::QUAD_STRIP, first, vertexArr->size() - first));
 
 	// left
@@ -1,5 +1,6 @@
 #include "stdafx.h"
-#include "inc\Snout.h"
+#include "inc/Snout.h"
+#include "inc/RingTable.h"
 
 
 namespace Geometry
@@ -16,6 +17,11 @@ Snout::~Snout()
 {
 }
 
+BaseGeometry *Snout::cloneGeometry() const
+{
+	return new Snout(*this);
+}
+
 void Snout::subDraw()
 {
 	getPrimitiveSetList().clear();
@@ -35,20 +41,12 @@ void Snout::subDraw()
 	osg::Vec3 xVec = localToWorld * osg::X_AXIS;
 
 	int count = (int)getDivision();
-	double incAng = 2 * M_PI / count;
-	osg::Quat quat(incAng, bottomNormal);
+	const RingTable &ring = RingTable::get(count);
 
 	osg::Vec3 topCenter = m_org + m_height + m_offset;
-	std::vector<osg::Vec3> bottomPntArr, topPntArr;
-	for (int i = 0; i < count; ++i)
-	{
-		bottomPntArr.push_back(m_org + xVec * m_bottomRadius);
-		topPntArr.push_back(topCenter + xVec * m_topRadius);
-
-		xVec = quat * xVec;
-	}
-	bottomPntArr.push_back(bottomPntArr[0]);
-	topPntArr.push_back(topPntArr[0]);
+	std::vector<osg::Vec3> bottomPntArr(count + 1), topPntArr(count + 1);
+	ring.rotate(m_org, bottomNormal, xVec * m_bottomRadius, &bottomPntArr[0]);
+	ring.rotate(topCenter, bottomNormal, xVec * m_topRadius, &topPntArr[0]);
 	size_t pntCount = bottomPntArr.size();
 
 	if (m_bottomVis)
@@ -80,22 +78,33 @@ void Snout::subDraw()
 
 	osg::Vec3 yVec = m_height ^ xVec;
 	yVec.normalize();
+	std::vector<osg::Vec3> yVecArr(count + 1);
+	ring.rotate(osg::Vec3(), bottomNormal, yVec, &yVecArr[0]);
 	const GLint first = vertexArr->size();
 	for (size_t i = 0; i < pntCount; ++i)
 	{
 		vertexArr->push_back(bottomPntArr[i]);
 		vertexArr->push_back(topPntArr[i]);
 
-		osg::Vec3 normal = yVec ^ (topPntArr[i] - bottomPntArr[i]);
+		osg::Vec3 normal = yVecArr[i] ^ (topPntArr[i] - bottomPntArr[i]);
 		normal.normalize();
 		normalArr->push_back(normal);
 		normalArr->push_back(normal);
-
-		yVec = quat * yVec;
 	}
 	addPrimitiveSet(new osg::DrawArrays(osg::PrimitiveSet::QUAD_STRIP, first, vertexArr->size() - first));
 }
 
+bool Snout::getCullShape(CullShape &shape)
+{
+	shape.probes[0].center = m_org;
+	shape.probes[0].size = (float)(m_bottomRadius * 2.0);
+	shape.probes[1].center = m_org + m_height;
+	shape.probes[1].size = (float)(m_topRadius * 2.0);
+	shape.numProbes = 2;
+	shape.divided = true;
+	return true;
+}
+
 bool Snout::doCullAndUpdate(const osg::CullStack &cullStack)
 {
 	float psb = cullStack.clampedPixelSize(m_org, m_bottomRadius * 2.0);
@@ -1,5 +1,6 @@
 #include "stdafx.h"
-#include "inc\Sphere.h"
+#include "inc/Sphere.h"
+#include "inc/RingTable.h"
 
 
 namespace Geometry
@@ -15,6 +16,11 @@ Sphere::~Sphere()
 {
 }
 
+BaseGeometry *Sphere::cloneGeometry() const
+{
+	return new Sphere(*this);
+}
+
 void Sphere::subDraw()
 {
 	getPrimitiveSetList().clear();
@@ -39,7 +45,7 @@ void Sphere::subDraw()
 	osg::Vec3 yVec = xVec ^ m_bottomNormal;
 	int hCount = (int)getDivision();
 	double hIncAng = 2 * M_PI / hCount;
-	osg::Quat hQuat(hIncAng, m_bottomNormal);
+	const RingTable &ring = RingTable::get(hCount);
 
 	int vCount = (int)ceil(m_angle / hIncAng);
 	if (vCount & 1) // ż
@@ -66,40 +72,26 @@ void Sphere::subDraw()
 			bottomCenter = m_center - m_bottomNormal * len;
 		}
 		vertexArr->push_back(bottomCenter);
-		normalArr->push_back(m_bottomNormal);
-		for (int i = 0; i < hCount; ++i)
-		{
-			vertexArr->push_back(m_center + bVec);
-			normalArr->push_back(m_bottomNormal);
-			bVec = hQuat * bVec;
-		}
-		vertexArr->push_back((*vertexArr)[first + 1]);
-		normalArr->push_back(m_bottomNormal);
+		vertexArr->resize(first + hCount + 2);
+		ring.rotate(m_center, m_bottomNormal, bVec, &(*vertexArr)[first + 1]);
+		normalArr->resize(vertexArr->size(), m_bottomNormal);
 		addPrimitiveSet(new osg::DrawArrays(osg::PrimitiveSet::TRIANGLE_FAN, first, vertexArr->size() - first));
 	}
 
 	const GLint first = vertexArr->size();
 	for (int i = 0; i < vCount / 2; ++i)
 	{
-		osg::Vec3 hVec1 = vec1;
-		osg::Vec3 hVec2 = vec2;
+		osg::Vec3 hNormal1 = vec1;
+		hNormal1.normalize();
+		osg::Vec3 hNormal2 = vec2;
+		hNormal2.normalize();
 		const size_t hFirst = vertexArr->size();
-		for (int j = 0; j < hCount; ++j)
-		{
-			vertexArr->push_back(m_center + hVec1);
-			vertexArr->push_back(m_center + hVec2);
-			normalArr->push_back(hVec1);
-			normalArr->back().normalize();
-			normalArr->push_back(hVec2);
-			normalArr->back().normalize();
-
-			hVec1 = hQuat * hVec1;
-			hVec2 = hQuat * hVec2;
-		}
-		vertexArr->push_back((*vertexArr)[hFirst]);
-		vertexArr->push_back((*vertexArr)[hFirst + 1]);
-		normalArr->push_back((*normalArr)[hFirst]);
-		normalArr->push_back((*normalArr)[hFirst + 1]);
+		vertexArr->resize(hFirst + (hCount + 1) * 2);
+		normalArr->resize(hFirst + (hCount + 1) * 2);
+		ring.rotate(m_center, m_bottomNormal, vec1, &(*vertexArr)[hFirst], 2);
+		ring.rotate(m_center, m_bottomNormal, vec2, &(*vertexArr)[hFirst + 1], 2);
+		ring.rotate(osg::Vec3(), m_bottomNormal, hNormal1, &(*normalArr)[hFirst], 2);
+		ring.rotate(osg::Vec3(), m_bottomNormal, hNormal2, &(*normalArr)[hFirst + 1], 2);
 
 		vec1 = vec2;
 		vec2 = vQuat * vec2;
@@ -107,6 +99,15 @@ void Sphere::subDraw()
 	addPrimitiveSet(new osg::DrawArrays(osg::PrimitiveSet::QUAD_STRIP, first, vertexArr->size() - first));
 }
 
+bool Sphere::getCullShape(CullShape &shape)
+{
+	shape.probes[0].center = m_center;
+	shape.probes[0].size = (float)(m_radius * 2.0);
+	shape.numProbes = 1;
+	shape.divided = true;
+	return true;
+}
+
 bool Sphere::doCullAndUpdate(const osg::CullStack &cullStack)
 {
 	float ps = cullStack.clampedPixelSize(m_center, m_radius * 2.0);
@@ -0,0 +1,247 @@
+#include "stdafx.h"
+#include "TessellationPool.h"
+#include <OpenThreads/ScopedLock>
+
+namespace Geometry
+{
+
+TessellationPool::WorkerThread::WorkerThread(TessellationPool *pool)
+	: m_pool(pool)
+{
+}
+
+void TessellationPool::WorkerThread::run()
+{
+	while (m_pool->runJob())
+		;
+}
+
+TessellationPool::TessellationPool()
+	: m_numThreads(osg::maximum(OpenThreads::GetNumberOfProcessors() - 1, 1))
+	, m_swapBudget(200)
+	, m_frameNumber(0)
+	, m_frameSwaps(0)
+	, m_frameTimeBudget(0.004)
+	, m_maxQueuedJobs(256)
+	, m_frameTime(0.0)
+	, m_frameRequests(0)
+	, m_done(false)
+{
+}
+
+TessellationPool::~TessellationPool()
+{
+	stopThreads();
+}
+
+TessellationPool *TessellationPool::instance()
+{
+	static TessellationPool pool;
+	return &pool;
+}
+
+bool TessellationPool::submit(BaseGeometry *geometry)
+{
+	Job job;
+	job.back = geometry->beginTessellation();
+	if (!job.back.valid())
+		return false;
+	job.target = geometry;
+
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+	if (m_threads.empty())
+		startThreads();
+	m_jobs.push_back(job);
+	m_condition.signal();
+	return true;
+}
+
+unsigned int TessellationPool::applyFinished(unsigned int frameNumber)
+{
+	osg::Timer_t start = osg::Timer::instance()->tick();
+	std::vector<Job> jobs;
+	{
+		OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+		beginFrame(frameNumber);
+
+		while (!m_finished.empty() && m_frameSwaps < m_swapBudget)
+		{
+			jobs.push_back(m_finished.front());
+			m_finished.pop_front();
+			++m_frameSwaps;
+		}
+	}
+
+	for (size_t i = 0; i < jobs.size(); ++i)
+		jobs[i].target->endTessellation(*jobs[i].back);
+	m_frameTime += osg::Timer::instance()->delta_s(start, osg::Timer::instance()->tick());
+	return jobs.size();
+}
+
+bool TessellationPool::Request::operator<(const Request &other) const
+{
+	return pixelSize < other.pixelSize;
+}
+
+bool TessellationPool::request(BaseGeometry *geometry, bool async)
+{
+	if (geometry->isRedrawRequested())
+		return false;
+
+	Request request;
+	request.pixelSize = geometry->getPixelSize();
+	request.geometry = geometry;
+	request.async = async;
+	m_requests.push(request);
+	geometry->setRedrawRequested(true);
+	return true;
+}
+
+unsigned int TessellationPool::processRequests(unsigned int frameNumber)
+{
+	{
+		OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+		beginFrame(frameNumber);
+	}
+
+	unsigned int count = 0;
+	while (!m_requests.empty() && hasFrameTime())
+	{
+		const Request &request = m_requests.top();
+		if (request.async && request.geometry->needRedraw() && !request.geometry->isTessellating())
+		{
+			OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+			if (m_jobs.size() >= m_maxQueuedJobs)
+				break;
+		}
+
+		osg::Timer_t start = osg::Timer::instance()->tick();
+		osg::ref_ptr<BaseGeometry> geometry = request.geometry;
+		bool async = request.async;
+		m_requests.pop();
+		geometry->setRedrawRequested(false);
+		// drawn since, or changed back
+		if (!geometry->needRedraw() || geometry->isTessellating())
+			continue;
+
+		// the old arrays stay on screen until the pool swaps the new ones in
+		if (!async || !submit(geometry))
+			geometry->draw();
+		++count;
+		++m_frameRequests;
+		m_frameTime += osg::Timer::instance()->delta_s(start, osg::Timer::instance()->tick());
+	}
+	return count;
+}
+
+unsigned int TessellationPool::getNumRequests() const
+{
+	return (unsigned int)m_requests.size();
+}
+
+void TessellationPool::beginFrame(unsigned int frameNumber)
+{
+	if (frameNumber == m_frameNumber)
+		return;
+
+	m_frameNumber = frameNumber;
+	m_frameSwaps = 0;
+	m_frameTime = 0.0;
+	m_frameRequests = 0;
+}
+
+bool TessellationPool::hasFrameTime() const
+{
+	return m_frameRequests == 0 || m_frameTime < m_frameTimeBudget;
+}
+
+void TessellationPool::setSwapBudget(unsigned int budget)
+{
+	m_swapBudget = budget;
+}
+
+unsigned int TessellationPool::getSwapBudget() const
+{
+	return m_swapBudget;
+}
+
+void TessellationPool::setFrameTimeBudget(double seconds)
+{
+	m_frameTimeBudget = seconds;
+}
+
+double TessellationPool::getFrameTimeBudget() const
+{
+	return m_frameTimeBudget;
+}
+
+void TessellationPool::setMaxQueuedJobs(unsigned int maxJobs)
+{
+	m_maxQueuedJobs = osg::maximum(maxJobs, 1u);
+}
+
+unsigned int TessellationPool::getMaxQueuedJobs() const
+{
+	return m_maxQueuedJobs;
+}
+
+void TessellationPool::setNumThreads(unsigned int numThreads)
+{
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+	m_numThreads = osg::maximum(numThreads, 1u);
+}
+
+unsigned int TessellationPool::getNumThreads() const
+{
+	return m_numThreads;
+}
+
+void TessellationPool::startThreads()
+{
+	m_done = false;
+	for (unsigned int i = 0; i < m_numThreads; ++i)
+	{
+		WorkerThread *thread = new WorkerThread(this);
+		thread->start();
+		m_threads.push_back(thread);
+	}
+}
+
+void TessellationPool::stopThreads()
+{
+	{
+		OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+		m_done = true;
+		m_condition.broadcast();
+	}
+
+	for (size_t i = 0; i < m_threads.size(); ++i)
+	{
+		m_threads[i]->join();
+		delete m_threads[i];
+	}
+	m_threads.clear();
+}
+
+bool TessellationPool::runJob()
+{
+	Job job;
+	{
+		OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+		while (m_jobs.empty() && !m_done)
+			m_condition.wait(&m_mutex);
+		if (m_done)
+			return false;
+
+		job = m_jobs.front();
+		m_jobs.pop_front();
+	}
+
+	job.back->draw();
+
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+	m_finished.push_back(job);
+	return true;
+}
+
+} // namespace Geometry
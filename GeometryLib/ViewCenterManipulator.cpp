@@ -1,5 +1,5 @@
 #include "stdafx.h"
-#include "inc\ViewCenterManipulator.h"
+#include "inc/ViewCenterManipulator.h"
 
 
 ViewCenterManipulator::ViewCenterManipulator()
@@ -16,11 +16,11 @@ ViewCenterManipulator::~ViewCenterManipulator()
 bool ViewCenterManipulator::handleMousePush(const osgGA::GUIEventAdapter& ea, osgGA::GUIActionAdapter& us)
 {
 	m_isMouseRelease = false;
-	return __super::handleMousePush(ea, us);
+	return osgGA::TrackballManipulator::handleMousePush(ea, us);
 }
 
 bool ViewCenterManipulator::handleMouseRelease(const osgGA::GUIEventAdapter& ea, osgGA::GUIActionAdapter& us)
 {
 	m_isMouseRelease = true;
-	return __super::handleMouseRelease(ea, us);
+	return osgGA::TrackballManipulator::handleMouseRelease(ea, us);
 }
\ No newline at end of file
@@ -1,5 +1,5 @@
 #include "stdafx.h"
-#include "inc\Wedge.h"
+#include "inc/Wedge.h"
 
 
 namespace Geometry
@@ -14,6 +14,11 @@ Wedge::~Wedge()
 {
 }
 
+BaseGeometry *Wedge::cloneGeometry() const
+{
+	return new Wedge(*this);
+}
+
 void Wedge::subDraw()
 {
 	osg::ref_ptr<osg::Vec3Array> vertexArr = new osg::Vec3Array;
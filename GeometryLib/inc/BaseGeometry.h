@@ -2,6 +2,8 @@
 #include <osg/Geometry>
 #include <osg/CullStack>
 #include <functional>
+#include <vector>
+#include "PrototypeCache.h"
 
 namespace Geometry
 {
@@ -12,37 +14,131 @@ class BaseGeometry :
 	public osg::Geometry
 {
 public:
+	// point whose pixel size on screen at size culls a primitive
+	struct CullProbe
+	{
+		osg::Vec3 center;
+		float size;
+	};
+
+	// How doCullAndUpdate() measures a primitive, for the vectorized cull of
+	// DynamicLOD: culled when the largest pixel size of its probes is at
+	// most the small feature size, its division computed from that size
+	// when divided.
+	struct CullShape
+	{
+		CullProbe probes[2];
+		unsigned int numProbes;
+		bool divided;
+	};
+
 	BaseGeometry();
 	virtual ~BaseGeometry();
 
 	void draw();
 	unsigned int getDivision();
+	// division of the next draw(), in place of g_defaultDivision before the
+	// first cull picks one
+	virtual void setDivision(int division);
 	bool needRedraw() const;
 	bool cullAndUpdate(const osg::CullStack &cullStack);
 	bool isCulled() const;
+	// triangles of the current tessellation, as the triangle budget counts them
+	unsigned int getNumTriangles() const;
+	// size on screen at the last cull, the priority of its re-tessellation
+	float getPixelSize() const;
+	// queued in the TessellationPool requests
+	bool isRedrawRequested() const;
+	void setRedrawRequested(bool requested);
+	// solid enough to hide what is behind it, drawn into the OcclusionBuffer
+	// when it is big on screen
+	virtual bool isOccluder() const;
+	// false when the cull of the type does not fit a CullShape
+	virtual bool getCullShape(CullShape &shape);
+	// what cullAndUpdate() leaves, for a pixel size measured by the caller;
+	// division 0 keeps the division
+	void setCullResult(bool culled, float pixelSize, int division);
+
+	// Draw from a shared unit space prototype placed by getInstanceMatrix()
+	// instead of baking world space vertices, when the type supports it.
+	void setInstancing(bool instancing);
+	bool isInstanced() const;
+	virtual osg::Matrix getInstanceMatrix();
+
+	// Copy to tessellate on a worker thread, NULL if the type does not
+	// support it. endTessellation() takes the copy's arrays over and must
+	// run in the update traversal.
+	BaseGeometry *beginTessellation();
+	void endTessellation(BaseGeometry &back);
+	bool isTessellating() const;
 
 protected:
 	virtual void subDraw();
+	virtual BaseGeometry *cloneGeometry() const;
+	// Merges vertices with equal position and normal and replaces the
+	// primitive sets by one indexed triangle list, run after subDraw().
+	virtual void indexVertices();
 	virtual bool doCullAndUpdate(const osg::CullStack &cullStack);
 	void updateDivision(float pixelSize);
-	int computeDivision(float pixelSize);
+	int computeDivision(float pixelSize, int current);
+
+	virtual bool getPrototypeKey(PrototypeKey &key);
+	virtual BaseGeometry *createPrototype();
+	bool drawPrototype();
 
 protected:
 	unsigned int m_division;
+	float m_pixelSize;
 	bool m_needRedraw;
 	bool m_isCulled;
+	bool m_instancing;
+	bool m_instanced;
+	bool m_tessellating;
+	bool m_redrawRequested;
+	// counted into LODStats by draw()
+	bool m_countStats;
 };
 
 double GetEpsilon();
+// TRIANGLES over numVertices vertices, 16 bit indices when they fit
+osg::DrawElements *CreateTriangles(const std::vector<GLuint> &indices, unsigned int numVertices);
+// appends the triangles of all primitive sets of drawable, offset added to
+// each index
+void CollectTriangles(const osg::Drawable &drawable, std::vector<GLuint> &indices, GLuint offset = 0);
 
 inline bool BaseGeometry::needRedraw() const
 {
 	return m_needRedraw;
 }
 
+inline float BaseGeometry::getPixelSize() const
+{
+	return m_pixelSize;
+}
+
+inline bool BaseGeometry::isRedrawRequested() const
+{
+	return m_redrawRequested;
+}
+
+inline void BaseGeometry::setRedrawRequested(bool requested)
+{
+	m_redrawRequested = requested;
+}
+
 inline bool BaseGeometry::isCulled() const
 {
 	return m_isCulled;
 }
 
+inline bool BaseGeometry::isInstanced() const
+{
+	return m_instanced;
+}
+
+inline bool BaseGeometry::isTessellating() const
+{
+	return m_tessellating;
+}
+
 } // namespace Geometry
@@ -0,0 +1,75 @@
+#pragma once
+#include "BaseGeometry.h"
+#include <vector>
+
+namespace Geometry
+{
+
+// Many primitives of one type and color merged into one vertex pool and one
+// index buffer. Each primitive keeps its own index range, so it is still
+// culled and re-tessellated on its own; only the ranges of visible primitives
+// are copied into the drawn DrawElements.
+class BatchGeometry :
+	public BaseGeometry
+{
+public:
+	BatchGeometry();
+	~BatchGeometry();
+
+	void addGeometry(BaseGeometry *geometry);
+	unsigned int getNumGeometries() const;
+	BaseGeometry *getGeometry(unsigned int i);
+
+	void setColor(const osg::Vec4 &color);
+	const osg::Vec4 &getColor() const;
+
+protected:
+	virtual void subDraw();
+	virtual void indexVertices();
+	virtual bool doCullAndUpdate(const osg::CullStack &cullStack);
+
+private:
+	struct Item
+	{
+		osg::ref_ptr<BaseGeometry> geometry;
+		unsigned int firstVertex;
+		unsigned int numVertices;
+		unsigned int firstIndex;
+		unsigned int numIndices;
+		bool culled;
+	};
+
+	void mergeGeometries();
+	void appendGeometry(BaseGeometry &geometry, osg::Vec3Array &vertexArr, osg::Vec3Array &normalArr);
+	void updateIndices();
+
+private:
+	std::vector<Item> m_items;
+	std::vector<GLuint> m_indices;
+	osg::Vec4 m_color;
+	bool m_needMerge;
+};
+
+
+
+inline unsigned int BatchGeometry::getNumGeometries() const
+{
+	return m_items.size();
+}
+
+inline BaseGeometry *BatchGeometry::getGeometry(unsigned int i)
+{
+	return m_items[i].geometry.get();
+}
+
+inline void BatchGeometry::setColor(const osg::Vec4 &color)
+{
+	m_color = color;
+}
+
+inline const osg::Vec4 & BatchGeometry::getColor() const
+{
+	return m_color;
+}
+
+} // namespace Geometry
@@ -26,9 +26,16 @@ public:
 	void setColor(const osg::Vec4 &color);
 	const osg::Vec4 &getColor() const;
 
+	virtual osg::Matrix getInstanceMatrix();
+	virtual bool isOccluder() const;
+	virtual bool getCullShape(CullShape &shape);
+
 protected:
 	virtual void subDraw();
+	virtual BaseGeometry *cloneGeometry() const;
 	virtual bool doCullAndUpdate(const osg::CullStack &cullStack);
+	virtual bool getPrototypeKey(PrototypeKey &key);
+	virtual BaseGeometry *createPrototype();
 	void computeAssistVar();
 
 private:
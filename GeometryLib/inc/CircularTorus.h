@@ -30,10 +30,16 @@ public:
 	const bool &getTopVis() const;
 	void setBottomVis(const bool &val);
 	const bool &getBottomVis() const;
+
+	virtual osg::Matrix getInstanceMatrix();
+	virtual void setDivision(int division);
 	
 protected:
 	virtual void subDraw();
+	virtual BaseGeometry *cloneGeometry() const;
 	virtual bool doCullAndUpdate(const osg::CullStack &cullStack);
+	virtual bool getPrototypeKey(PrototypeKey &key);
+	virtual BaseGeometry *createPrototype();
 	void computeAssistVar();
 
 private:
@@ -45,8 +45,12 @@ public:
 	void addShell(std::shared_ptr<Shell> &shell);
 	void addPolygon(std::shared_ptr<Polygon> &polygon);
 
+	virtual bool isOccluder() const;
+
 protected:
 	virtual void subDraw();
+	virtual BaseGeometry *cloneGeometry() const;
+	virtual void indexVertices();
 
 private:
 	std::vector<std::shared_ptr<Mesh>> m_meshs;
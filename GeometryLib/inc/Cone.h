@@ -25,8 +25,11 @@ public:
 	void setBottomVisible(bool visible);
 	bool isBottomVisible() const;
 
+	virtual bool getCullShape(CullShape &shape);
+
 protected:
 	virtual void subDraw();
+	virtual BaseGeometry *cloneGeometry() const;
 	virtual bool doCullAndUpdate(const osg::CullStack &cullStack);
 
 private:
@@ -0,0 +1,96 @@
+#pragma once
+#include <vector>
+#include <osg/Vec4>
+#include "BaseGeometry.h"
+
+namespace Geometry
+{
+
+// The CullShapes of a run of primitives as structure of arrays, so that the
+// pixel sizes of all of them are computed by one loop over packed floats
+// instead of a virtual doCullAndUpdate() each. A probe's pixel size is
+// CullStack::clampedPixelSize(): fabs(size / (center * pixelSizeVector)).
+//
+// Eight probes are computed at once with AVX, or four with SSE2, where the
+// compiler targets it.
+class CullArrays
+{
+public:
+	enum Kind
+	{
+		// culled by its own doCullAndUpdate()
+		UNSUPPORTED,
+		// culled by the pixel size, its division never changes
+		UNDIVIDED,
+		// culled by the pixel size, which also gives its division
+		DIVIDED
+	};
+
+	// the cull result last written to the primitive of a slot, which is
+	// written again only when it changes
+	enum Result
+	{
+		NOT_WRITTEN,
+		DRAWN,
+		CULLED
+	};
+
+	// count slots, all UNSUPPORTED
+	void resize(unsigned int count);
+	unsigned int size() const;
+	// the shape of a primitive of division, its result NOT_WRITTEN
+	void set(unsigned int pos, const BaseGeometry::CullShape &shape, int division);
+	unsigned char getKind(unsigned int pos) const;
+	unsigned char getResult(unsigned int pos) const;
+	// 0 for UNDIVIDED
+	int getDivision(unsigned int pos) const;
+	void setResult(unsigned int pos, unsigned char result, int division);
+
+	// largest pixel size of the probes of each of the slots first to
+	// first + count - 1 into pixelSizes; meaningless for UNSUPPORTED
+	void computePixelSizes(unsigned int first, unsigned int count, const osg::Vec4 &pixelSizeVector,
+		float *pixelSizes) const;
+
+private:
+	// first and second probe of each slot, the second repeats the first for
+	// a single probe
+	std::vector<float> m_x0;
+	std::vector<float> m_y0;
+	std::vector<float> m_z0;
+	std::vector<float> m_size0;
+	std::vector<float> m_x1;
+	std::vector<float> m_y1;
+	std::vector<float> m_z1;
+	std::vector<float> m_size1;
+	std::vector<unsigned char> m_kinds;
+	std::vector<unsigned char> m_results;
+	std::vector<int> m_divisions;
+};
+
+inline unsigned int CullArrays::size() const
+{
+	return m_kinds.size();
+}
+
+inline unsigned char CullArrays::getKind(unsigned int pos) const
+{
+	return m_kinds[pos];
+}
+
+inline unsigned char CullArrays::getResult(unsigned int pos) const
+{
+	return m_results[pos];
+}
+
+inline int CullArrays::getDivision(unsigned int pos) const
+{
+	return m_divisions[pos];
+}
+
+inline void CullArrays::setResult(unsigned int pos, unsigned char result, int division)
+{
+	m_results[pos] = result;
+	m_divisions[pos] = division;
+}
+
+} // namespace Geometry
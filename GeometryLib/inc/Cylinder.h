@@ -25,9 +25,16 @@ public:
 	void setTopVisible(bool visible);
 	bool isTopVisible() const;
 
+	virtual osg::Matrix getInstanceMatrix();
+	virtual bool isOccluder() const;
+	virtual bool getCullShape(CullShape &shape);
+
 protected:
 	virtual void subDraw();
+	virtual BaseGeometry *cloneGeometry() const;
 	virtual bool doCullAndUpdate(const osg::CullStack &cullStack);
+	virtual bool getPrototypeKey(PrototypeKey &key);
+	virtual BaseGeometry *createPrototype();
 
 private:
 	osg::Vec3 m_org;
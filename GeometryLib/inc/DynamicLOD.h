@@ -1,11 +1,26 @@
 #pragma once
+#include <typeinfo>
+#include <vector>
+#include <osg/BoundingBox>
 #include <osg/Group>
+#include <OpenThreads/Mutex>
 #include "BaseGeometry.h"
+#include "CullArrays.h"
+#include "OcclusionBuffer.h"
 #include "ViewCenterManipulator.h"
 
 namespace Geometry
 {
 
+// A DynamicLOD under a block definition shared by several references is
+// culled once per reference in a frame. Only the reference that was largest
+// on screen the frame before updates the divisions and cull flags of the
+// primitives, the others draw them as they are; the update traversal runs
+// once per frame.
+//
+// The cull threads of several cameras may cull it at the same time. Each
+// cull traversal keeps its scratch memory and counters to itself, the
+// choice of the reference and the rebuild of the BVH are locked.
 class DynamicLOD :
 	public osg::Group
 {
@@ -17,15 +32,160 @@ public:
 
 	virtual void traverse(osg::NodeVisitor& nv);
 
+	// Re-tessellate in the TessellationPool instead of inside the update
+	// traversal, on by default. Either way the primitives wait in the pool's
+	// requests, largest on screen first, within its frame time budget.
+	void setAsyncTessellation(bool async);
+	bool isAsyncTessellation() const;
+	// Cull the primitives whose type has a CullShape from packed arrays,
+	// many pixel sizes per instruction and their divisions in one batch,
+	// instead of a virtual call each; on by default. The results stay in the
+	// arrays, a primitive is only written to when its cull flag or division
+	// changes. The shapes and divisions are taken when the children change,
+	// a primitive edited in place afterwards must be removed and inserted
+	// again.
+	void setVectorizedCull(bool vectorized);
+	bool isVectorizedCull() const;
+
+protected:
+	virtual void childRemoved(unsigned int pos, unsigned int numChildrenToRemove);
+	virtual void childInserted(unsigned int pos);
+
 private:
 	void cullTraverse(osg::NodeVisitor& nv);
 	void updateTraverse(osg::NodeVisitor& nv);
 	void quickTraverse(osg::NodeVisitor& nv);
+	struct CullTraversal;
+
+	// counts the cull of nv's node path in its frame, true when that path
+	// updates the primitives; with m_cullMutex held
+	bool beginCull(osg::NodeVisitor &nv, osg::CullStack &cullStack);
+	// queues geo in the TessellationPool when its division changed
+	void requestRedraw(BaseGeometry *geo);
+	// culls and draws the child at pos by its type; without updatesLOD it is
+	// drawn as it is, nothing written to its primitives
+	void cullChild(CullTraversal &traversal, unsigned int pos, osg::CullStack &cullStack, osg::NodeVisitor &nv,
+		bool updatesLOD);
+	// draws the largest occluders among the children of the visible leaves
+	void drawOccluders(CullTraversal &traversal, OcclusionBuffer &buffer, osg::CullStack &cullStack,
+		const osg::Matrix &modelViewProjection);
+
+	void buildBVH();
+	int buildBVHNode(unsigned int first, unsigned int count, const std::vector<osg::BoundingBox> &boxs);
 
 private:
+	// What a child is, found once when it is inserted instead of by RTTI in
+	// every traversal. A child changed in place afterwards, a drawable added
+	// to its Geode, must be removed and inserted again.
+	enum ChildType
+	{
+		// Geode of one BaseGeometry
+		GEOMETRY,
+		// primitive drawn from a prototype: Transform -> Geode -> BaseGeometry
+		INSTANCE,
+		// any other Geode, its drawables are cast in every traversal
+		GEODE,
+		// plain osg::Group, traversed in place
+		GROUP,
+		// anything else, accepted as it is
+		OTHER
+	};
+
+	// one per child, in the order of _children
+	struct CullRecord
+	{
+		osg::Node *node;
+		// of GEOMETRY and INSTANCE
+		BaseGeometry *geometry;
+		unsigned char type;
+		bool occluder;
+	};
+
+	// scratch memory and LODStats counters of one cull traversal
+	struct CullTraversal
+	{
+		CullTraversal();
+
+		// leaves in the frustum and occluder candidates
+		std::vector<int> visibleLeaves;
+		std::vector<std::pair<float, unsigned int> > occluders;
+		// pixel sizes of the children of a leaf from the CullArrays
+		std::vector<float> pixelSizes;
+		// slots of the CullArrays drawn by the vectorized cull, with their
+		// pixel sizes and divisions, 0 for the undivided ones
+		std::vector<unsigned int> drawnSlots;
+		std::vector<float> drawnPixelSizes;
+		std::vector<int> drawnDivisions;
+		unsigned int visited;
+		unsigned int smallFeatureCulled;
+		unsigned int occlusionCulled;
+		unsigned int triangles;
+	};
+
+	static CullRecord makeCullRecord(osg::Node *node);
+	// record of the child at pos, made again when setChild() replaced it
+	const CullRecord &getCullRecord(unsigned int pos);
+	// the same for the cull traversals, which leave m_cullRecords as it is:
+	// a replaced child gets a record of its own until the next update
+	// traversal stores it
+	CullRecord findCullRecord(unsigned int pos) const;
+
+	// bounding volume hierarchy over the children, leaves index m_bvhChildren
+	struct BVHNode
+	{
+		osg::BoundingBox box;
+		unsigned int first;
+		unsigned int count;
+		int left;
+		int right;
+	};
+
 	ViewCenterManipulator *m_manipulator;
+	// guards the choice of the reference and the rebuild of the BVH
+	OpenThreads::Mutex m_cullMutex;
+	// culls of the frame m_cullFrame, and the path of the largest on screen
+	unsigned int m_cullFrame;
+	unsigned int m_frameCulls;
+	float m_bestPixelSize;
+	osg::NodePath m_bestPath;
+	// culled through more than one path the frame before, m_lodPath was the
+	// largest of them
+	bool m_shared;
+	osg::NodePath m_lodPath;
+	unsigned int m_updateFrame;
+	bool m_asyncTessellation;
+	bool m_vectorizedCull;
+	std::vector<CullRecord> m_cullRecords;
+	std::vector<BVHNode> m_bvh;
+	std::vector<unsigned int> m_bvhChildren;
+	// of each child, tested against the OcclusionBuffer
+	std::vector<osg::BoundingBox> m_childBoxs;
+	bool m_bvhDirty;
+	// CullShape of each child, in the order of m_bvhChildren
+	CullArrays m_cullArrays;
 };
 
+inline void DynamicLOD::setAsyncTessellation(bool async)
+{
+	m_asyncTessellation = async;
+}
+
+inline bool DynamicLOD::isAsyncTessellation() const
+{
+	return m_asyncTessellation;
+}
+
+inline void DynamicLOD::setVectorizedCull(bool vectorized)
+{
+	m_vectorizedCull = vectorized;
+	m_bvhDirty = true;
+}
+
+inline bool DynamicLOD::isVectorizedCull() const
+{
+	return m_vectorizedCull;
+}
+
 class DynamicLODUpdateCallback : public osg::NodeCallback
 {
 public:
@@ -25,8 +25,11 @@ public:
 	void setBottomVis(const bool &val);
 	const bool &getBottomVis() const;
 
+	virtual void setDivision(int division);
+
 protected:
 	virtual void subDraw();
+	virtual BaseGeometry *cloneGeometry() const;
 	virtual bool doCullAndUpdate(const osg::CullStack &cullStack);
 	void computeAssistVar();
 
@@ -0,0 +1,104 @@
+#pragma once
+#include "BaseGeometry.h"
+#include <vector>
+
+namespace Geometry
+{
+
+// Closed profiles moved along height, the loops of a PDSpolygon: the first
+// loop is the outline and the others are holes, loopSizes holds the number
+// of vertexs of each.
+class Extrusion :
+	public BaseGeometry
+{
+public:
+	Extrusion();
+	~Extrusion();
+
+	void setHeight(const osg::Vec3 &val);
+	const osg::Vec3 &getHeight() const;
+	void setVertexs(const std::vector<osg::Vec3> &val);
+	const std::vector<osg::Vec3> &getVertexs() const;
+	void setFlags(const std::vector<int> &val);
+	const std::vector<int> &getFlags() const;
+	void setLoopSizes(const std::vector<int> &val);
+	const std::vector<int> &getLoopSizes() const;
+	void setColor(const osg::Vec4 &val);
+	const osg::Vec4 &getColor() const;
+
+	virtual bool getCullShape(CullShape &shape);
+
+protected:
+	virtual void subDraw();
+	virtual BaseGeometry *cloneGeometry() const;
+	virtual bool doCullAndUpdate(const osg::CullStack &cullStack);
+	void computeAssistVar();
+
+private:
+	osg::Vec3 m_height;
+	std::vector<osg::Vec3> m_vertexs;
+	std::vector<int> m_flags;
+	std::vector<int> m_loopSizes;
+	osg::Vec4 m_color;
+
+	// bounding sphere of the outline moved along height, radius < 0 until
+	// computed
+	osg::Vec3 m_center;
+	double m_radius;
+};
+
+
+
+inline void Extrusion::setHeight(const osg::Vec3 &val)
+{
+	m_height = val;
+	m_radius = -1.0;
+}
+
+inline const osg::Vec3 &Extrusion::getHeight() const
+{
+	return m_height;
+}
+
+inline void Extrusion::setVertexs(const std::vector<osg::Vec3> &val)
+{
+	m_vertexs = val;
+	m_radius = -1.0;
+}
+
+inline const std::vector<osg::Vec3> &Extrusion::getVertexs() const
+{
+	return m_vertexs;
+}
+
+inline void Extrusion::setFlags(const std::vector<int> &val)
+{
+	m_flags = val;
+}
+
+inline const std::vector<int> &Extrusion::getFlags() const
+{
+	return m_flags;
+}
+
+inline void Extrusion::setLoopSizes(const std::vector<int> &val)
+{
+	m_loopSizes = val;
+}
+
+inline const std::vector<int> &Extrusion::getLoopSizes() const
+{
+	return m_loopSizes;
+}
+
+inline void Extrusion::setColor(const osg::Vec4 &val)
+{
+	m_color = val;
+}
+
+inline const osg::Vec4 &Extrusion::getColor() const
+{
+	return m_color;
+}
+
+} // namespace Geometry
@@ -0,0 +1,107 @@
+#pragma once
+#include <atomic>
+#include <vector>
+#include <OpenThreads/Mutex>
+
+namespace Geometry
+{
+
+// Divisions of the circles of the primitives, the number of segments of a
+// full circle, from the chord error: the largest distance between a circle
+// and its polygon. BaseGeometry takes it in pixels on screen, so a primitive
+// gets as many segments as its size on screen needs at every distance; the
+// Build* functions, drawn once without a camera, take it in model units.
+// Divisions are rounded up to a few levels, which keeps the prototypes and
+// ring tables shared.
+//
+// A division changes only once the pixel size is past a level threshold by a
+// hysteresis band, so a primitive on a threshold does not re-tessellate on
+// every small zoom.
+//
+// A triangle budget scales the pixel tolerance up while the primitives drawn
+// in a frame hold more triangles than it allows, and back down to the
+// configured tolerance when they fit again.
+class LODPolicy
+{
+public:
+	static LODPolicy *instance();
+
+	// chord error on screen, 2 pixels by default
+	void setPixelTolerance(float pixels);
+	float getPixelTolerance() const;
+	// chord error of the Build* functions, 0.5 model units by default
+	void setModelTolerance(double tolerance);
+	double getModelTolerance() const;
+	// share of the pixel size a primitive must move past a threshold before
+	// its division changes, 0.15 by default
+	void setHysteresis(float hysteresis);
+	float getHysteresis() const;
+	// triangles drawn per frame, 0 (default) for no limit
+	void setTriangleBudget(unsigned int triangles);
+	unsigned int getTriangleBudget() const;
+
+	// division of a circle covering pixelSize pixels on screen
+	int computeDivision(float pixelSize) const;
+	// the same for a circle drawn at division current now, with hysteresis
+	int computeDivision(float pixelSize, int current) const;
+	// computeDivision(pixelSizes[i], divisions[i]) into divisions[i] for
+	// count primitives at once, from one table of thresholds; a division of
+	// 0 stays 0
+	void computeDivisions(const float *pixelSizes, int *divisions, unsigned int count) const;
+	// division of a circle of radius in model units
+	int computeModelDivision(double radius) const;
+	// the divisions computeDivision() returns, ascending, with the smallest
+	// pixel size drawn at each at the pixel tolerance, without the budget
+	void getDivisionLevels(std::vector<int> &divisions, std::vector<float> &minPixelSizes) const;
+
+	// triangles drawn by one cull traversal
+	void addTriangles(unsigned int triangles);
+	// moves the tolerance scale towards the budget by the triangles added
+	// since the last call, once per frame
+	void endFrame();
+	// factor of the pixel tolerance the budget currently asks for
+	float getToleranceScale() const;
+
+private:
+	LODPolicy();
+	// pixel tolerance times the tolerance scale, read once per call so a
+	// concurrent endFrame() cannot change it halfway
+	double getScaledTolerance() const;
+
+private:
+	float m_pixelTolerance;
+	double m_modelTolerance;
+	float m_hysteresis;
+	unsigned int m_triangleBudget;
+	// written by endFrame() under m_mutex, read by the cull threads without it
+	std::atomic<float> m_toleranceScale;
+	unsigned int m_triangles;
+	mutable OpenThreads::Mutex m_mutex;
+};
+
+inline float LODPolicy::getPixelTolerance() const
+{
+	return m_pixelTolerance;
+}
+
+inline double LODPolicy::getModelTolerance() const
+{
+	return m_modelTolerance;
+}
+
+inline float LODPolicy::getHysteresis() const
+{
+	return m_hysteresis;
+}
+
+inline unsigned int LODPolicy::getTriangleBudget() const
+{
+	return m_triangleBudget;
+}
+
+inline float LODPolicy::getToleranceScale() const
+{
+	return m_toleranceScale.load(std::memory_order_relaxed);
+}
+
+} // namespace Geometry
@@ -0,0 +1,59 @@
+#pragma once
+#include <cstdio>
+#include <string>
+#include <osg/Stats>
+#include <osg/Timer>
+#include <OpenThreads/Mutex>
+
+namespace Geometry
+{
+
+// Counters of the DynamicLOD traversals and BaseGeometry::draw(), summed over
+// one frame. publish() hands them to osg::Stats under the names below, where
+// osgViewer::StatsHandler user stats lines can show them, and optionally
+// appends them to a CSV file.
+class LODStats
+{
+public:
+	static const char *VISITED;
+	static const char *SMALL_FEATURE_CULLED;
+	// hidden behind the occluders of the OcclusionBuffer
+	static const char *OCCLUSION_CULLED;
+	static const char *RETESSELLATED;
+	static const char *VERTICES;
+	// of the primitives drawn
+	static const char *TRIANGLES;
+	// seconds
+	static const char *TESSELLATION_TIME;
+
+	static LODStats *instance();
+	~LODStats();
+
+	void addCull(unsigned int visited, unsigned int smallFeatureCulled, unsigned int occlusionCulled,
+		unsigned int triangles);
+	void addRetessellated(unsigned int count);
+	void addTessellation(unsigned int vertices, osg::Timer_t start, osg::Timer_t end);
+
+	// stores the counters as attributes of frameNumber and clears them
+	void publish(osg::Stats *stats, unsigned int frameNumber);
+
+	// one line per published frame, an empty name closes the file
+	bool setCsvFile(const std::string &fileName);
+	bool isWritingCsv() const;
+
+private:
+	LODStats();
+
+private:
+	unsigned int m_visited;
+	unsigned int m_smallFeatureCulled;
+	unsigned int m_occlusionCulled;
+	unsigned int m_retessellated;
+	unsigned int m_vertices;
+	unsigned int m_triangles;
+	double m_tessellationTime;
+	FILE *m_csv;
+	mutable OpenThreads::Mutex m_mutex;
+};
+
+} // namespace Geometry
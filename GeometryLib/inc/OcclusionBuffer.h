@@ -0,0 +1,78 @@
+#pragma once
+#include <vector>
+#include <osg/BoundingBox>
+#include <osg/Geometry>
+#include <osg/Matrix>
+
+namespace Geometry
+{
+
+// Low resolution depth buffer rasterized on the CPU, without GPU occlusion
+// queries. Occluders are drawn with their own triangles, nearest depth per
+// pixel, into the pixels they cover whole and with the farthest depth over
+// the pixel, so an occluder thinner than a pixel draws nothing; a box is
+// occluded when every pixel it touches holds an occluder nearer than its
+// nearest corner. Depths are the normalized device z of the
+// modelViewProjection matrices, every matrix used between two clear() calls
+// must end in the same projection.
+//
+// Four pixels of a row are drawn and tested at once with SSE2 where the
+// compiler targets it.
+class OcclusionBuffer
+{
+public:
+	OcclusionBuffer();
+
+	// pixels, the width is rounded up to a multiple of 4; 256 x 128 by default
+	void setSize(unsigned int width, unsigned int height);
+	unsigned int getWidth() const;
+	unsigned int getHeight() const;
+
+	// empties the buffer, nothing is occluded
+	void clear();
+	// draws the triangles of geometry, returns how many were drawn
+	unsigned int drawGeometry(const osg::Geometry &geometry, const osg::Matrix &modelViewProjection);
+	// triangles drawn since clear()
+	unsigned int getNumTriangles() const;
+
+	bool isOccluded(const osg::BoundingBox &box, const osg::Matrix &modelViewProjection) const;
+
+	// getWidth() * getHeight() depths, row by row from the bottom
+	const float *getDepths() const;
+
+private:
+	void drawTriangle(const osg::Vec4 &c0, const osg::Vec4 &c1, const osg::Vec4 &c2);
+	void rasterize(const osg::Vec3 &v0, const osg::Vec3 &v1, const osg::Vec3 &v2);
+	osg::Vec3 toScreen(const osg::Vec4 &clip) const;
+
+private:
+	unsigned int m_width;
+	unsigned int m_height;
+	std::vector<float> m_depths;
+	unsigned int m_numTriangles;
+	// scratch of drawGeometry()
+	std::vector<osg::Vec4> m_clips;
+	std::vector<unsigned int> m_indices;
+};
+
+inline unsigned int OcclusionBuffer::getWidth() const
+{
+	return m_width;
+}
+
+inline unsigned int OcclusionBuffer::getHeight() const
+{
+	return m_height;
+}
+
+inline unsigned int OcclusionBuffer::getNumTriangles() const
+{
+	return m_numTriangles;
+}
+
+inline const float *OcclusionBuffer::getDepths() const
+{
+	return m_depths.empty() ? NULL : &m_depths[0];
+}
+
+} // namespace Geometry
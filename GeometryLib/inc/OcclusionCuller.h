@@ -0,0 +1,72 @@
+#pragma once
+#include <map>
+#include <osg/NodeVisitor>
+#include <OpenThreads/Mutex>
+#include "OcclusionBuffer.h"
+
+namespace Geometry
+{
+
+// Settings of the software occlusion culling of DynamicLOD and the
+// OcclusionBuffer of each cull visitor. The buffer is cleared by the first
+// DynamicLOD culled in a frame and shared by the ones after it: each draws
+// its largest occluders on screen, within the frame's triangle budget,
+// before testing its children, so the occluders of the DynamicLODs culled
+// earlier hide the children of the later ones too.
+class OcclusionCuller
+{
+public:
+	static OcclusionCuller *instance();
+	~OcclusionCuller();
+
+	// on by default
+	void setEnabled(bool enabled);
+	bool isEnabled() const;
+	// of each buffer, 256 x 128 by default
+	void setBufferSize(unsigned int width, unsigned int height);
+	// pixel size on screen of the smallest occluder drawn, 64 by default
+	void setMinOccluderPixelSize(float pixels);
+	float getMinOccluderPixelSize() const;
+	// occluder triangles drawn per frame and cull visitor, 20000 by default
+	void setMaxOccluderTriangles(unsigned int triangles);
+	unsigned int getMaxOccluderTriangles() const;
+
+	// buffer of the cull traversal nv, cleared at its first call in a frame;
+	// NULL when disabled
+	OcclusionBuffer *getBuffer(osg::NodeVisitor &nv);
+
+private:
+	struct Entry
+	{
+		OcclusionBuffer *buffer;
+		unsigned int frameNumber;
+	};
+
+	OcclusionCuller();
+
+private:
+	bool m_enabled;
+	unsigned int m_width;
+	unsigned int m_height;
+	float m_minOccluderPixelSize;
+	unsigned int m_maxOccluderTriangles;
+	std::map<const osg::NodeVisitor*, Entry> m_buffers;
+	OpenThreads::Mutex m_mutex;
+};
+
+inline bool OcclusionCuller::isEnabled() const
+{
+	return m_enabled;
+}
+
+inline float OcclusionCuller::getMinOccluderPixelSize() const
+{
+	return m_minOccluderPixelSize;
+}
+
+inline unsigned int OcclusionCuller::getMaxOccluderTriangles() const
+{
+	return m_maxOccluderTriangles;
+}
+
+} // namespace Geometry
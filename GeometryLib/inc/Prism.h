@@ -23,8 +23,11 @@ public:
 	void setColor(const osg::Vec4 &val);
 	const osg::Vec4 &getColor() const;
 
+	virtual bool getCullShape(CullShape &shape);
+
 protected:
 	virtual void subDraw();
+	virtual BaseGeometry *cloneGeometry() const;
 	virtual bool doCullAndUpdate(const osg::CullStack &cullStack);
 	void computeAssistVar();
 
@@ -0,0 +1,38 @@
+#pragma once
+#include <osg/Vec3>
+#include <vector>
+
+namespace Geometry
+{
+
+// t_PolylineVertex flags of the PDRevolve and PDSpolygon profiles
+enum ProfileFlag
+{
+	// a line to the next vertex
+	PROFILE_LINE = 1,
+	// an arc through the next vertex to the one after it
+	PROFILE_ARC,
+	// the middle of an arc
+	PROFILE_ARC_MIDDLE,
+	// the last vertex, closed by a line to the first
+	PROFILE_LINE_CLOSE,
+	// the last vertex but one, closed by an arc through the last to the first
+	PROFILE_ARC_CLOSE,
+	// the three vertexs of a circle
+	PROFILE_CIRCLE
+};
+
+// the points of one line or arc of a profile
+typedef std::vector<osg::Vec3> ProfileSegment;
+
+// Cuts the profile into segments, an arc into division pieces per full
+// circle. A closed profile, as PDSpolygon draws it, ends with a line or an
+// arc back to the first vertex even without a closing flag. Returns whether
+// the segments end at the first vertex.
+bool FlattenProfile(const osg::Vec3 *vertexs, const int *flags, unsigned int numVertexs, int division, bool closed,
+	std::vector<ProfileSegment> &segments);
+
+// the points of the segments in order, each shared point once
+void JoinProfile(const std::vector<ProfileSegment> &segments, std::vector<osg::Vec3> &points);
+
+} // namespace Geometry
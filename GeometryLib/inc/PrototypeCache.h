@@ -0,0 +1,66 @@
+#pragma once
+#include <map>
+#include <osg/Geometry>
+#include <osg/Node>
+#include <OpenThreads/Mutex>
+
+namespace Geometry
+{
+
+class BaseGeometry;
+
+// Normalized shape of a primitive: type, divisions, cap flags and the shape
+// parameters left after moving the primitive into its unit space.
+struct PrototypeKey
+{
+	enum Type
+	{
+		NONE,
+		BOX,
+		CYLINDER,
+		CIRCULAR_TORUS
+	};
+
+	PrototypeKey();
+
+	bool operator<(const PrototypeKey &key) const;
+
+	int type;
+	int divisions[2];
+	int flags;
+	int shape[3];
+};
+
+int QuantizeShape(double val);
+
+// Unit space tessellations shared by all instances with the same key.
+class PrototypeCache
+{
+public:
+	static PrototypeCache *instance();
+
+	osg::Geometry *find(const PrototypeKey &key);
+	osg::Geometry *insert(const PrototypeKey &key, osg::Geometry *prototype);
+	void clear();
+
+	unsigned int getSize() const;
+	unsigned int getHitCount() const;
+	unsigned int getMissCount() const;
+	double getHitRate() const;
+	void resetStatistics();
+
+private:
+	PrototypeCache();
+
+private:
+	std::map<PrototypeKey, osg::ref_ptr<osg::Geometry>> m_prototypes;
+	unsigned int m_hitCount;
+	unsigned int m_missCount;
+	mutable OpenThreads::Mutex m_mutex;
+};
+
+// Geode holding the primitive, under a MatrixTransform when the primitive is
+// drawn from a prototype.
+osg::ref_ptr<osg::Node> CreateGeometryNode(BaseGeometry *geometry);
+
+} // namespace Geometry
@@ -33,6 +33,7 @@ public:
 
 protected:
 	virtual void subDraw();
+	virtual BaseGeometry *cloneGeometry() const;
 
 private:
 	osg::Vec3 m_org;
@@ -29,6 +29,7 @@ public:
 
 protected:
 	virtual void subDraw();
+	virtual BaseGeometry *cloneGeometry() const;
 	virtual bool doCullAndUpdate(const osg::CullStack &cullStack);
 	void computeAssistVar();
 
@@ -0,0 +1,116 @@
+#pragma once
+#include "BaseGeometry.h"
+#include <vector>
+
+namespace Geometry
+{
+
+// Profile swept around an axis, the vertexs and ProfileFlag flags of a
+// PDRevolve. Like PDRevolve the ends of a partial sweep stay open.
+class Revolve :
+	public BaseGeometry
+{
+public:
+	Revolve();
+	~Revolve();
+
+	void setAxisPnt(const osg::Vec3 &val);
+	const osg::Vec3 &getAxisPnt() const;
+	void setAxis(const osg::Vec3 &val);
+	const osg::Vec3 &getAxis() const;
+	void setAngle(double val);
+	double getAngle() const;
+	void setVertexs(const std::vector<osg::Vec3> &val);
+	const std::vector<osg::Vec3> &getVertexs() const;
+	void setFlags(const std::vector<int> &val);
+	const std::vector<int> &getFlags() const;
+	void setColor(const osg::Vec4 &val);
+	const osg::Vec4 &getColor() const;
+
+	virtual bool getCullShape(CullShape &shape);
+
+protected:
+	virtual void subDraw();
+	virtual BaseGeometry *cloneGeometry() const;
+	virtual bool doCullAndUpdate(const osg::CullStack &cullStack);
+	void computeAssistVar();
+
+private:
+	osg::Vec3 m_axisPnt;
+	osg::Vec3 m_axis;
+	double m_angle;
+	std::vector<osg::Vec3> m_vertexs;
+	std::vector<int> m_flags;
+	osg::Vec4 m_color;
+
+	// bounding sphere of the swept profile, radius < 0 until computed
+	osg::Vec3 m_center;
+	double m_radius;
+};
+
+
+
+inline void Revolve::setAxisPnt(const osg::Vec3 &val)
+{
+	m_axisPnt = val;
+	m_radius = -1.0;
+}
+
+inline const osg::Vec3 &Revolve::getAxisPnt() const
+{
+	return m_axisPnt;
+}
+
+inline void Revolve::setAxis(const osg::Vec3 &val)
+{
+	m_axis = val;
+	m_radius = -1.0;
+}
+
+inline const osg::Vec3 &Revolve::getAxis() const
+{
+	return m_axis;
+}
+
+inline void Revolve::setAngle(double val)
+{
+	m_angle = val;
+}
+
+inline double Revolve::getAngle() const
+{
+	return m_angle;
+}
+
+inline void Revolve::setVertexs(const std::vector<osg::Vec3> &val)
+{
+	m_vertexs = val;
+	m_radius = -1.0;
+}
+
+inline const std::vector<osg::Vec3> &Revolve::getVertexs() const
+{
+	return m_vertexs;
+}
+
+inline void Revolve::setFlags(const std::vector<int> &val)
+{
+	m_flags = val;
+}
+
+inline const std::vector<int> &Revolve::getFlags() const
+{
+	return m_flags;
+}
+
+inline void Revolve::setColor(const osg::Vec4 &val)
+{
+	m_color = val;
+}
+
+inline const osg::Vec4 &Revolve::getColor() const
+{
+	return m_color;
+}
+
+} // namespace Geometry
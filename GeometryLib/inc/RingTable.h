@@ -0,0 +1,38 @@
+#pragma once
+#include <vector>
+#include <osg/Math>
+#include <osg/Vec3>
+
+namespace Geometry
+{
+
+// cos/sin of count + 1 equally spaced angles over [0, angle], the last entry
+// closes the ring. Full circle tables for the division levels of LODPolicy
+// are built once and shared by all primitives and tessellation threads.
+class RingTable
+{
+public:
+	RingTable(unsigned int count, double angle = 2.0 * osg::PI);
+
+	static const RingTable &get(unsigned int count);
+
+	unsigned int getCount() const;
+	double getAngle() const;
+	const float *getCos() const;
+	const float *getSin() const;
+
+	// out[i * stride] = center + xAxis * cos[i] + yAxis * sin[i], i in [0, count]
+	void generate(const osg::Vec3 &center, const osg::Vec3 &xAxis, const osg::Vec3 &yAxis,
+		osg::Vec3 *out, unsigned int stride = 1) const;
+	// center + vec rotated around axis, same as osg::Quat(angle * i / count, axis) * vec
+	void rotate(const osg::Vec3 &center, const osg::Vec3 &axis, const osg::Vec3 &vec,
+		osg::Vec3 *out, unsigned int stride = 1) const;
+
+private:
+	unsigned int m_count;
+	double m_angle;
+	std::vector<float> m_cos;
+	std::vector<float> m_sin;
+};
+
+} // namespace Geometry
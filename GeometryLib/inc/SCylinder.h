@@ -27,8 +27,11 @@ public:
 	void setTopVisible(bool visible);
 	bool isTopVisible() const;
 
+	virtual bool getCullShape(CullShape &shape);
+
 protected:
 	virtual void subDraw();
+	virtual BaseGeometry *cloneGeometry() const;
 	virtual bool doCullAndUpdate(const osg::CullStack &cullStack);
 
 private:
@@ -25,8 +25,11 @@ public:
 	void setBottomVis(const bool &val);
 	const bool &getBottomVis() const;
 
+	virtual bool getCullShape(CullShape &shape);
+
 protected:
 	virtual void subDraw();
+	virtual BaseGeometry *cloneGeometry() const;
 	virtual bool doCullAndUpdate(const osg::CullStack &cullStack);
 
 private:
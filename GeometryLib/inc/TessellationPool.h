@@ -0,0 +1,108 @@
+#pragma once
+#include <deque>
+#include <queue>
+#include <vector>
+#include <osg/ref_ptr>
+#include <osg/Timer>
+#include <OpenThreads/Condition>
+#include <OpenThreads/Mutex>
+#include <OpenThreads/Thread>
+#include "BaseGeometry.h"
+
+namespace Geometry
+{
+
+// Worker threads re-tessellating primitives whose division changed. The new
+// arrays are built into a copy of the primitive and swapped in by
+// applyFinished() during the update traversal, at most getSwapBudget()
+// primitives per frame.
+//
+// The update traversal requests the primitives to re-tessellate instead of
+// drawing or submitting them at once. processRequests() takes them largest on
+// screen first until the frame time budget is spent and keeps the rest for
+// the next frames, so a big zoom refines what the eye sees most first and
+// does not stall one frame. Only getMaxQueuedJobs() jobs wait for the workers,
+// the others keep their priority in the requests.
+class TessellationPool
+{
+public:
+	static TessellationPool *instance();
+	~TessellationPool();
+
+	bool submit(BaseGeometry *geometry);
+	unsigned int applyFinished(unsigned int frameNumber);
+
+	// Queue geometry for processRequests(), in the update traversal; false
+	// when it is queued already. async submits it to the workers, otherwise
+	// it is drawn on the calling thread.
+	bool request(BaseGeometry *geometry, bool async);
+	// re-tessellates requests, returns how many
+	unsigned int processRequests(unsigned int frameNumber);
+	unsigned int getNumRequests() const;
+
+	void setSwapBudget(unsigned int budget);
+	unsigned int getSwapBudget() const;
+	// seconds per frame spent swapping and processing requests, 4 ms by
+	// default; one request is processed each frame whatever the budget
+	void setFrameTimeBudget(double seconds);
+	double getFrameTimeBudget() const;
+	void setMaxQueuedJobs(unsigned int maxJobs);
+	unsigned int getMaxQueuedJobs() const;
+	void setNumThreads(unsigned int numThreads);
+	unsigned int getNumThreads() const;
+
+private:
+	struct Job
+	{
+		osg::ref_ptr<BaseGeometry> target;
+		osg::ref_ptr<BaseGeometry> back;
+	};
+
+	struct Request
+	{
+		float pixelSize;
+		osg::ref_ptr<BaseGeometry> geometry;
+		bool async;
+
+		bool operator<(const Request &other) const;
+	};
+
+	class WorkerThread : public OpenThreads::Thread
+	{
+	public:
+		WorkerThread(TessellationPool *pool);
+		virtual void run();
+
+	private:
+		TessellationPool *m_pool;
+	};
+
+	TessellationPool();
+	void startThreads();
+	void stopThreads();
+	bool runJob();
+	// starts the accounting of frameNumber when it is a new frame
+	void beginFrame(unsigned int frameNumber);
+	bool hasFrameTime() const;
+
+private:
+	std::deque<Job> m_jobs;
+	std::deque<Job> m_finished;
+	// touched by the update traversal only
+	std::priority_queue<Request> m_requests;
+	std::vector<WorkerThread*> m_threads;
+	unsigned int m_numThreads;
+	unsigned int m_swapBudget;
+	unsigned int m_frameNumber;
+	unsigned int m_frameSwaps;
+	double m_frameTimeBudget;
+	unsigned int m_maxQueuedJobs;
+	// swap and request time of the frame, and the requests processed
+	double m_frameTime;
+	unsigned int m_frameRequests;
+	bool m_done;
+	OpenThreads::Mutex m_mutex;
+	OpenThreads::Condition m_condition;
+};
+
+} // namespace Geometry
@@ -0,0 +1,608 @@
+#include "stdafx.h"
+#include "Benchmark.h"
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <osg/AnimationPath>
+#include <osg/MatrixTransform>
+#include <osg/Timer>
+#include <osgUtil/CullVisitor>
+#include <osgUtil/RenderStage>
+#include <osgUtil/StateGraph>
+#include <BatchGeometry.h>
+#include <Box.h>
+#include <CircularTorus.h>
+#include <CombineGeometry.h>
+#include <Cone.h>
+#include <Cylinder.h>
+#include <DynamicLOD.h>
+#include <Ellipsoid.h>
+#include <LODPolicy.h>
+#include <LODStats.h>
+#include <OcclusionCuller.h>
+#include <RectCirc.h>
+#include <RingTable.h>
+#include <Saddle.h>
+#include <SCylinder.h>
+#include <Snout.h>
+#include <Sphere.h>
+
+namespace
+{
+
+const int BENCH_FRAMES = 300;
+const unsigned int MAX_BATCH_SIZE = 4096;
+// plant of the occlusion benchmark, in millimeters
+const int PLANT_BAYS = 20;
+const float PLANT_BAY_LENGTH = 10000.0f;
+const int PLANT_PIPES = 400;
+const int PLANT_PATH_FRAMES = 600;
+const int VIEWPORT_WIDTH = 1280;
+const int VIEWPORT_HEIGHT = 720;
+
+class MemoryStatVisitor : public osg::NodeVisitor
+{
+public:
+	MemoryStatVisitor()
+		: osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN)
+		, m_nodes(0)
+		, m_drawables(0)
+		, m_bytes(0)
+	{
+	}
+
+	virtual void apply(osg::Node &node)
+	{
+		++m_nodes;
+		traverse(node);
+	}
+
+	virtual void apply(osg::Geode &geode)
+	{
+		++m_nodes;
+		for (unsigned int i = 0; i < geode.getNumDrawables(); ++i)
+		{
+			osg::Geometry *geo = geode.getDrawable(i)->asGeometry();
+			if (geo == NULL)
+				continue;
+
+			++m_drawables;
+			addArray(geo->getVertexArray());
+			addArray(geo->getNormalArray());
+			addArray(geo->getColorArray());
+			for (unsigned int j = 0; j < geo->getNumPrimitiveSets(); ++j)
+				m_bytes += geo->getPrimitiveSet(j)->getTotalDataSize();
+		}
+	}
+
+	unsigned int getNodeCount() const { return m_nodes; }
+	unsigned int getDrawableCount() const { return m_drawables; }
+	unsigned int getBytes() const { return m_bytes; }
+
+private:
+	void addArray(const osg::Array *arr)
+	{
+		if (arr != NULL)
+			m_bytes += arr->getTotalDataSize();
+	}
+
+private:
+	unsigned int m_nodes;
+	unsigned int m_drawables;
+	unsigned int m_bytes;
+};
+
+osg::ref_ptr<Geometry::Cylinder> CreateCylinder(int i, int side)
+{
+	osg::ref_ptr<Geometry::Cylinder> cylinder = new Geometry::Cylinder;
+	cylinder->setOrg(osg::Vec3((i % side) * 300.0f, (i / side) * 300.0f, 0.0f));
+	cylinder->setHeight(osg::Vec3(0.0f, 0.0f, 200.0f + (i % 7) * 50.0f));
+	cylinder->setRadius(50.0 + (i % 5) * 10.0);
+	return cylinder;
+}
+
+osg::Vec4 GetColor(int i)
+{
+	static const osg::Vec4 colors[] = {
+		osg::Vec4(1, 0, 0, 1), osg::Vec4(0, 1, 0, 1), osg::Vec4(0, 0, 1, 1), osg::Vec4(1, 1, 0, 1)
+	};
+	return colors[i % 4];
+}
+
+osg::ref_ptr<osg::Group> CreateScene(int count, bool batch)
+{
+	osg::ref_ptr<osg::Group> root = new osg::Group;
+	osg::ref_ptr<Geometry::DynamicLOD> lod = new Geometry::DynamicLOD;
+	std::map<int, osg::ref_ptr<Geometry::BatchGeometry>> batchs;
+	int side = static_cast<int>(sqrt(static_cast<double>(count))) + 1;
+
+	for (int i = 0; i < count; ++i)
+	{
+		osg::ref_ptr<Geometry::Cylinder> cylinder = CreateCylinder(i, side);
+		cylinder->setColor(GetColor(i));
+		if (!batch)
+		{
+			cylinder->draw();
+			osg::ref_ptr<osg::Geode> geode = new osg::Geode;
+			geode->addDrawable(cylinder);
+			lod->addChild(geode);
+			continue;
+		}
+
+		osg::ref_ptr<Geometry::BatchGeometry> &bg = batchs[i % 4];
+		if (!bg.valid() || bg->getNumGeometries() >= MAX_BATCH_SIZE)
+		{
+			bg = new Geometry::BatchGeometry;
+			bg->setColor(GetColor(i));
+			osg::ref_ptr<osg::Geode> geode = new osg::Geode;
+			geode->addDrawable(bg);
+			lod->addChild(geode);
+		}
+		bg->addGeometry(cylinder);
+	}
+
+	for (unsigned int i = 0; batch && i < lod->getNumChildren(); ++i)
+	{
+		osg::Geode *geode = lod->getChild(i)->asGeode();
+		static_cast<Geometry::BaseGeometry*>(geode->getDrawable(0))->draw();
+	}
+
+	root->addChild(lod);
+	root->setUpdateCallback(new Geometry::DynamicLODUpdateCallback);
+	return root;
+}
+
+void RunScene(osgViewer::Viewer &viewer, osg::Group *scene, const char *name)
+{
+	MemoryStatVisitor msv;
+	scene->accept(msv);
+
+	viewer.setSceneData(scene);
+	const osg::BoundingSphere &bs = scene->getBound();
+	osg::Vec3d center(bs.center());
+
+	osgViewer::Viewer::Cameras cameras;
+	viewer.getCameras(cameras);
+	osg::Stats *stats = cameras.empty() ? NULL : cameras[0]->getStats();
+	if (stats != NULL)
+		stats->collectStats("rendering", true);
+
+	unsigned int firstFrame = viewer.getFrameStamp()->getFrameNumber() + 1;
+	osg::Timer_t start = osg::Timer::instance()->tick();
+	for (int i = 0; i < BENCH_FRAMES && !viewer.done(); ++i)
+	{
+		// orbit the scene and zoom in, so LOD and culling change every frame
+		double angle = 2.0 * M_PI * i / BENCH_FRAMES;
+		double distance = bs.radius() * (2.5 - 2.0 * i / BENCH_FRAMES);
+		osg::Vec3d eye = center + osg::Vec3d(cos(angle), sin(angle), 0.5) * distance;
+		viewer.getCamera()->setViewMatrixAsLookAt(eye, center, osg::Z_AXIS);
+		viewer.frame();
+	}
+	double elapsed = osg::Timer::instance()->delta_m(start, osg::Timer::instance()->tick());
+	unsigned int lastFrame = viewer.getFrameStamp()->getFrameNumber();
+
+	double cullTime = 0.0, drawTime = 0.0;
+	if (stats != NULL)
+	{
+		stats->getAveragedAttribute(firstFrame, lastFrame, "Cull traversal time taken", cullTime);
+		stats->getAveragedAttribute(firstFrame, lastFrame, "Draw traversal time taken", drawTime);
+	}
+
+	printf("%-8s nodes %8u drawables %8u memory %10.2f MB frame %8.3f ms cull %8.3f ms draw %8.3f ms\n",
+		name, msv.getNodeCount(), msv.getDrawableCount(), msv.getBytes() / (1024.0 * 1024.0),
+		elapsed / BENCH_FRAMES, cullTime * 1000.0, drawTime * 1000.0);
+}
+
+void AddPrimitive(Geometry::DynamicLOD *lod, Geometry::BaseGeometry *geo)
+{
+	geo->draw();
+	osg::ref_ptr<osg::Geode> geode = new osg::Geode;
+	geode->addDrawable(geo);
+	lod->addChild(geode);
+}
+
+float Random(float min, float max)
+{
+	return min + (max - min) * rand() / RAND_MAX;
+}
+
+// wall of a bay as the shell of a combine geometry, from its origin corner
+osg::ref_ptr<Geometry::CombineGeometry> CreateWallShell()
+{
+	const float length = PLANT_BAY_LENGTH - 1000.0f;
+	std::shared_ptr<Geometry::Shell> shell(new Geometry::Shell);
+	for (int i = 0; i < 8; ++i)
+		shell->vertexs.push_back(osg::Vec3(i & 1 ? length : 0.0f, i & 2 ? 300.0f : 0.0f, i & 4 ? 8000.0f : 0.0f));
+	const int faces[] = {
+		4, 0, 2, 3, 1, 4, 4, 5, 7, 6, 4, 0, 1, 5, 4,
+		4, 2, 6, 7, 3, 4, 0, 4, 6, 2, 4, 1, 3, 7, 5 };
+	shell->faces.assign(faces, faces + sizeof(faces) / sizeof(faces[0]));
+
+	osg::ref_ptr<Geometry::CombineGeometry> wall = new Geometry::CombineGeometry;
+	wall->addShell(shell);
+	wall->setColor(GetColor(0));
+	wall->draw();
+	return wall;
+}
+
+// An aisle along x between walls, with a vessel behind the wall of each bay
+// and pipe racks behind them. The walls are a DynamicLOD of their own culled
+// before the cylinders, as SqliteLoad loads its tables: boxes, or with
+// combineWalls one combine geometry placed by a transform per wall, as
+// SqliteLoad places a shape used more than once.
+osg::ref_ptr<osg::Group> CreatePlantScene(bool combineWalls)
+{
+	osg::ref_ptr<Geometry::DynamicLOD> walls = new Geometry::DynamicLOD;
+	osg::ref_ptr<Geometry::DynamicLOD> cylinders = new Geometry::DynamicLOD;
+	osg::ref_ptr<osg::Geode> wallShell = new osg::Geode;
+	if (combineWalls)
+		wallShell->addDrawable(CreateWallShell());
+	srand(1);
+	for (int bay = 0; bay < PLANT_BAYS; ++bay)
+	{
+		const float x = bay * PLANT_BAY_LENGTH;
+		for (int side = -1; side <= 1; side += 2)
+		{
+			const osg::Vec3 org(x + 500.0f, side > 0 ? 2000.0f : -2300.0f, 0.0f);
+			if (combineWalls)
+			{
+				osg::ref_ptr<osg::MatrixTransform> transform = new osg::MatrixTransform(osg::Matrix::translate(org));
+				transform->addChild(wallShell);
+				walls->addChild(transform);
+			}
+			else
+			{
+				osg::ref_ptr<Geometry::Box> wall = new Geometry::Box;
+				wall->setOrg(org);
+				wall->setXLen(osg::Vec3(PLANT_BAY_LENGTH - 1000.0f, 0.0f, 0.0f));
+				wall->setYLen(osg::Vec3(0.0f, 300.0f, 0.0f));
+				wall->setZLen(osg::Vec3(0.0f, 0.0f, 8000.0f));
+				wall->setColor(GetColor(bay));
+				AddPrimitive(walls, wall);
+			}
+
+			osg::ref_ptr<Geometry::Cylinder> vessel = new Geometry::Cylinder;
+			vessel->setOrg(osg::Vec3(x + PLANT_BAY_LENGTH / 2.0f, side * 4000.0f, 0.0f));
+			vessel->setHeight(osg::Vec3(0.0f, 0.0f, 9000.0f));
+			vessel->setRadius(1200.0);
+			vessel->setColor(GetColor(bay + 1));
+			AddPrimitive(cylinders, vessel);
+
+			for (int i = 0; i < PLANT_PIPES; ++i)
+			{
+				osg::ref_ptr<Geometry::Cylinder> pipe = new Geometry::Cylinder;
+				pipe->setOrg(osg::Vec3(x + Random(0.0f, PLANT_BAY_LENGTH), side * Random(3000.0f, 15000.0f),
+					Random(300.0f, 7500.0f)));
+				pipe->setHeight(osg::Vec3(Random(1500.0f, 4000.0f), 0.0f, 0.0f));
+				pipe->setRadius(Random(50.0f, 200.0f));
+				pipe->setColor(GetColor(i));
+				AddPrimitive(cylinders, pipe);
+			}
+		}
+	}
+
+	osg::ref_ptr<osg::Group> root = new osg::Group;
+	root->addChild(walls);
+	root->addChild(cylinders);
+	return root;
+}
+
+// walks down the aisle at eye height, looking left and right
+osg::ref_ptr<osg::AnimationPath> CreatePlantPath()
+{
+	osg::ref_ptr<osg::AnimationPath> path = new osg::AnimationPath;
+	for (int i = 0; i < PLANT_PATH_FRAMES; ++i)
+	{
+		double x = -2000.0 + (PLANT_BAYS * PLANT_BAY_LENGTH + 2000.0) * i / PLANT_PATH_FRAMES;
+		double yaw = osg::DegreesToRadians(40.0) * sin(2.0 * M_PI * i / 150.0);
+		osg::Vec3d eye(x, 0.0, 1700.0);
+		osg::Vec3d dir(cos(yaw), sin(yaw), -0.05);
+		osg::Matrixd world = osg::Matrixd::inverse(osg::Matrixd::lookAt(eye, eye + dir, osg::Z_AXIS));
+		path->insert(i / 60.0, osg::AnimationPath::ControlPoint(eye, world.getRotate()));
+	}
+	return path;
+}
+
+// circles scene twice, closing in to about half its radius and back out
+osg::ref_ptr<osg::AnimationPath> CreateOrbitPath(const osg::BoundingSphere &bs)
+{
+	osg::ref_ptr<osg::AnimationPath> path = new osg::AnimationPath;
+	for (int i = 0; i < PLANT_PATH_FRAMES; ++i)
+	{
+		double angle = 4.0 * M_PI * i / PLANT_PATH_FRAMES;
+		double distance = bs.radius() * (1.25 + 0.75 * cos(2.0 * M_PI * i / PLANT_PATH_FRAMES));
+		osg::Vec3d center(bs.center());
+		osg::Vec3d eye = center + osg::Vec3d(cos(angle), sin(angle), 0.5) * distance;
+		osg::Matrixd world = osg::Matrixd::inverse(osg::Matrixd::lookAt(eye, center, osg::Z_AXIS));
+		path->insert(i / 60.0, osg::AnimationPath::ControlPoint(eye, world.getRotate()));
+	}
+	return path;
+}
+
+unsigned int CountLeaves(const osgUtil::StateGraph &graph)
+{
+	unsigned int count = graph._leaves.size();
+	for (osgUtil::StateGraph::ChildList::const_iterator it = graph._children.begin(); it != graph._children.end(); ++it)
+		count += CountLeaves(*it->second);
+	return count;
+}
+
+// culls scene from every control point of path as osgUtil::SceneView does,
+// without a graphics context
+void CullPath(osg::Node *scene, const osg::AnimationPath &path, unsigned int &frameNumber, const char *name)
+{
+	osg::ref_ptr<osgUtil::CullVisitor> cv = new osgUtil::CullVisitor;
+	osg::ref_ptr<osgUtil::StateGraph> stateGraph = new osgUtil::StateGraph;
+	osg::ref_ptr<osgUtil::RenderStage> renderStage = new osgUtil::RenderStage;
+	osg::ref_ptr<osg::Viewport> viewport = new osg::Viewport(0, 0, VIEWPORT_WIDTH, VIEWPORT_HEIGHT);
+	osg::ref_ptr<osg::FrameStamp> frameStamp = new osg::FrameStamp;
+	osg::ref_ptr<osg::Stats> stats = new osg::Stats(name, path.getTimeControlPointMap().size());
+	renderStage->setViewport(viewport);
+	cv->setFrameStamp(frameStamp);
+	cv->setSmallFeatureCullingPixelSize(4.0f);
+	const osg::Matrixd projection = osg::Matrixd::perspective(45.0, (double)VIEWPORT_WIDTH / VIEWPORT_HEIGHT,
+		10.0, 1.0e6);
+
+	double cullTime = 0.0;
+	double leaves = 0.0;
+	double occluded = 0.0;
+	const osg::AnimationPath::TimeControlPointMap &points = path.getTimeControlPointMap();
+	for (osg::AnimationPath::TimeControlPointMap::const_iterator it = points.begin(); it != points.end(); ++it)
+	{
+		osg::Matrixd world;
+		it->second.getMatrix(world);
+
+		frameStamp->setFrameNumber(++frameNumber);
+		cv->reset();
+		stateGraph->clean();
+		renderStage->reset();
+		cv->setStateGraph(stateGraph);
+		cv->setRenderStage(renderStage);
+		cv->setTraversalNumber(frameNumber);
+		cv->pushViewport(viewport);
+		cv->pushProjectionMatrix(new osg::RefMatrix(projection));
+		cv->pushModelViewMatrix(new osg::RefMatrix(osg::Matrixd::inverse(world)), osg::Transform::ABSOLUTE_RF);
+
+		osg::Timer_t start = osg::Timer::instance()->tick();
+		scene->accept(*cv);
+		cullTime += osg::Timer::instance()->delta_m(start, osg::Timer::instance()->tick());
+
+		cv->popModelViewMatrix();
+		cv->popProjectionMatrix();
+		cv->popViewport();
+		leaves += CountLeaves(*stateGraph);
+		stateGraph->prune();
+
+		double value = 0.0;
+		Geometry::LODStats::instance()->publish(stats, frameNumber);
+		if (stats->getAttribute(frameNumber, Geometry::LODStats::OCCLUSION_CULLED, value))
+			occluded += value;
+	}
+
+	const double frames = points.empty() ? 1.0 : (double)points.size();
+	printf("%-10s frames %6u cull %8.3f ms drawn %10.1f occluded %10.1f\n", name, (unsigned int)points.size(),
+		cullTime / frames, leaves / frames, occluded / frames);
+}
+
+// ring generation as the primitives did it before the shared tables
+void QuatRing(unsigned int count, const osg::Vec3 &center, const osg::Vec3 &axis, osg::Vec3 vec, osg::Vec3 *out)
+{
+	osg::Quat quat(2 * M_PI / count, axis);
+	for (unsigned int i = 0; i <= count; ++i)
+	{
+		out[i] = center + vec;
+		vec = quat * vec;
+	}
+}
+
+void BenchmarkRing(unsigned int division, int count)
+{
+	std::vector<osg::Vec3> ring(division + 1);
+	const osg::Vec3 axis(0.0f, 0.0f, 1.0f);
+	float sum = 0.0f;
+
+	osg::Timer_t start = osg::Timer::instance()->tick();
+	for (int i = 0; i < count; ++i)
+	{
+		QuatRing(division, osg::Vec3(i, 0.0f, 0.0f), axis, osg::X_AXIS * 50.0f, &ring[0]);
+		sum += ring[division / 2].x();
+	}
+	double quatTime = osg::Timer::instance()->delta_m(start, osg::Timer::instance()->tick());
+
+	const Geometry::RingTable &table = Geometry::RingTable::get(division);
+	start = osg::Timer::instance()->tick();
+	for (int i = 0; i < count; ++i)
+	{
+		table.rotate(osg::Vec3(i, 0.0f, 0.0f), axis, osg::X_AXIS * 50.0f, &ring[0]);
+		sum += ring[division / 2].x();
+	}
+	double tableTime = osg::Timer::instance()->delta_m(start, osg::Timer::instance()->tick());
+
+	printf("ring %2u  quat %10.3f Mrings/s table %10.3f Mrings/s speedup %6.2fx (%g)\n",
+		division, count / quatTime / 1000.0, count / tableTime / 1000.0, quatTime / tableTime, sum);
+}
+
+void BenchmarkDraw(Geometry::BaseGeometry *geometry, const char *name, int count)
+{
+	unsigned int vertices = 0;
+	osg::Timer_t start = osg::Timer::instance()->tick();
+	for (int i = 0; i < count; ++i)
+	{
+		geometry->draw();
+		vertices += geometry->getVertexArray()->getNumElements();
+	}
+	double elapsed = osg::Timer::instance()->delta_m(start, osg::Timer::instance()->tick());
+
+	printf("%-14s %10.1f k/s %10.3f Mvertices/s\n", name, count / elapsed, vertices / elapsed / 1000.0);
+}
+
+} // namespace
+
+int BenchmarkBatch(int count)
+{
+	osgViewer::Viewer viewer;
+	viewer.setUpViewInWindow(40, 40, 800, 600);
+	viewer.setThreadingModel(osgViewer::Viewer::SingleThreaded);
+	viewer.getCamera()->setSmallFeatureCullingPixelSize(4.0f);
+	viewer.realize();
+
+	printf("%d cylinders, %d frames\n", count, BENCH_FRAMES);
+
+	osg::Timer_t start = osg::Timer::instance()->tick();
+	osg::ref_ptr<osg::Group> geodes = CreateScene(count, false);
+	printf("geode    build %8.3f ms\n", osg::Timer::instance()->delta_m(start, osg::Timer::instance()->tick()));
+	RunScene(viewer, geodes, "geode");
+	geodes = NULL;
+
+	start = osg::Timer::instance()->tick();
+	osg::ref_ptr<osg::Group> batchs = CreateScene(count, true);
+	printf("batch    build %8.3f ms\n", osg::Timer::instance()->delta_m(start, osg::Timer::instance()->tick()));
+	RunScene(viewer, batchs, "batch");
+
+	return 0;
+}
+
+int BenchmarkTessellation(int count)
+{
+	// the divisions the primitives are actually drawn at
+	std::vector<int> divisions;
+	std::vector<float> minPixelSizes;
+	Geometry::LODPolicy::instance()->getDivisionLevels(divisions, minPixelSizes);
+	for (size_t i = 0; i < divisions.size(); ++i)
+		BenchmarkRing(divisions[i], count * 10);
+
+	const osg::Vec3 org(100.0f, 200.0f, 300.0f);
+	const osg::Vec3 height(0.0f, 100.0f, 500.0f);
+
+	osg::ref_ptr<Geometry::Cylinder> cylinder = new Geometry::Cylinder;
+	cylinder->setOrg(org);
+	cylinder->setHeight(height);
+	cylinder->setRadius(50.0);
+	// drawn as itself, not from a shared prototype
+	cylinder->setInstancing(false);
+	BenchmarkDraw(cylinder, "Cylinder", count);
+
+	osg::ref_ptr<Geometry::SCylinder> scylinder = new Geometry::SCylinder;
+	scylinder->setOrg(org);
+	scylinder->setHeight(height);
+	scylinder->setBottomNormal(osg::Vec3(0.0f, -0.2f, -1.0f));
+	scylinder->setRadius(50.0);
+	BenchmarkDraw(scylinder, "SCylinder", count);
+
+	osg::ref_ptr<Geometry::Snout> snout = new Geometry::Snout;
+	snout->setOrg(org);
+	snout->setHeight(height);
+	snout->setOffset(osg::Vec3(20.0f, 0.0f, 0.0f));
+	snout->setBottomRadius(80.0);
+	snout->setTopRadius(40.0);
+	BenchmarkDraw(snout, "Snout", count);
+
+	osg::ref_ptr<Geometry::Cone> cone = new Geometry::Cone;
+	cone->setOrg(org);
+	cone->setHeight(height);
+	cone->setRadius(50.0);
+	BenchmarkDraw(cone, "Cone", count);
+
+	osg::ref_ptr<Geometry::CircularTorus> torus = new Geometry::CircularTorus;
+	torus->setCenter(org);
+	torus->setStartPnt(org + osg::Vec3(300.0f, 0.0f, 0.0f));
+	torus->setNormal(osg::Z_AXIS);
+	torus->setStartRadius(50.0);
+	torus->setEndRadius(50.0);
+	torus->setAngle(M_PI / 2);
+	torus->setInstancing(false);
+	BenchmarkDraw(torus, "CircularTorus", count);
+
+	osg::ref_ptr<Geometry::Sphere> sphere = new Geometry::Sphere;
+	sphere->setCenter(org);
+	sphere->setBottomNormal(-osg::Z_AXIS);
+	sphere->setRadius(100.0);
+	sphere->setAngle(M_PI);
+	sphere->setBottomVis(true);
+	BenchmarkDraw(sphere, "Sphere", count);
+
+	osg::ref_ptr<Geometry::Ellipsoid> ellipsoid = new Geometry::Ellipsoid;
+	ellipsoid->setCenter(org);
+	ellipsoid->setALen(osg::Vec3(0.0f, 0.0f, 50.0f));
+	ellipsoid->setBRadius(100.0);
+	ellipsoid->setAngle(M_PI);
+	ellipsoid->setBottomVis(true);
+	BenchmarkDraw(ellipsoid, "Ellipsoid", count);
+
+	osg::ref_ptr<Geometry::Saddle> saddle = new Geometry::Saddle;
+	saddle->setOrg(org);
+	saddle->setXLen(osg::Vec3(100.0f, 0.0f, 0.0f));
+	saddle->setYLen(200.0);
+	saddle->setZLen(osg::Vec3(0.0f, 0.0f, 100.0f));
+	saddle->setRadius(60.0);
+	BenchmarkDraw(saddle, "Saddle", count);
+
+	osg::ref_ptr<Geometry::RectCirc> rectCirc = new Geometry::RectCirc;
+	rectCirc->setRectCenter(org);
+	rectCirc->setXLen(osg::Vec3(100.0f, 0.0f, 0.0f));
+	rectCirc->setYLen(100.0);
+	rectCirc->setHeight(height);
+	rectCirc->setOffset(osg::Vec3());
+	rectCirc->setRadius(40.0);
+	BenchmarkDraw(rectCirc, "RectCirc", count);
+
+	return 0;
+}
+
+int BenchmarkOcclusion(const char *pathFile)
+{
+	osg::ref_ptr<osg::AnimationPath> path = new osg::AnimationPath;
+	std::ifstream in(pathFile);
+	if (in.is_open())
+		path->read(in);
+	if (path->empty())
+	{
+		path = CreatePlantPath();
+		std::ofstream out(pathFile);
+		path->write(out);
+		printf("camera path written to %s\n", pathFile);
+	}
+
+	Geometry::OcclusionCuller *culler = Geometry::OcclusionCuller::instance();
+	unsigned int frameNumber = 0;
+	const char *names[][3] = {
+		{ "warm up", "frustum", "occlusion" },
+		{ "warm up, combine walls", "frustum, combine walls", "occlusion, combine walls" } };
+	for (int combineWalls = 0; combineWalls < 2; ++combineWalls)
+	{
+		osg::Timer_t start = osg::Timer::instance()->tick();
+		osg::ref_ptr<osg::Group> scene = CreatePlantScene(combineWalls != 0);
+		printf("%d primitives build %8.3f ms\n", PLANT_BAYS * 2 * (PLANT_PIPES + 2),
+			osg::Timer::instance()->delta_m(start, osg::Timer::instance()->tick()));
+
+		// builds the bounding volume hierarchies
+		culler->setEnabled(false);
+		CullPath(scene, *path, frameNumber, names[combineWalls][0]);
+		CullPath(scene, *path, frameNumber, names[combineWalls][1]);
+		culler->setEnabled(true);
+		CullPath(scene, *path, frameNumber, names[combineWalls][2]);
+	}
+	return 0;
+}
+
+int BenchmarkCull(int count)
+{
+	osg::Timer_t start = osg::Timer::instance()->tick();
+	osg::ref_ptr<osg::Group> scene = CreateScene(count, false);
+	printf("%d cylinders build %8.3f ms\n", count, osg::Timer::instance()->delta_m(start, osg::Timer::instance()->tick()));
+
+	Geometry::DynamicLOD *lod = static_cast<Geometry::DynamicLOD*>(scene->getChild(0));
+	osg::ref_ptr<osg::AnimationPath> path = CreateOrbitPath(scene->getBound());
+	unsigned int frameNumber = 0;
+	// the pixel sizes only, the same primitives are drawn by both
+	Geometry::OcclusionCuller::instance()->setEnabled(false);
+
+	// each warm up rebuilds the bounding volume hierarchy and the shapes
+	lod->setVectorizedCull(false);
+	CullPath(scene, *path, frameNumber, "warm up");
+	CullPath(scene, *path, frameNumber, "virtual");
+	lod->setVectorizedCull(true);
+	CullPath(scene, *path, frameNumber, "warm up");
+	CullPath(scene, *path, frameNumber, "vectorized");
+	return 0;
+}
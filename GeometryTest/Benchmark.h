@@ -0,0 +1,22 @@
+#pragma once
+
+// Renders count cylinders first with one Geode per primitive, then merged
+// into BatchGeometry, and prints cull/draw time and memory of both layouts.
+int BenchmarkBatch(int count);
+
+// Rotates rings with osg::Quat steps and with the shared RingTable at every
+// division, then tessellates count of each circular primitive, and prints the
+// throughput of both.
+int BenchmarkTessellation(int count);
+
+// Culls a plant of walls, vessels and pipe racks along a camera path without
+// a window, first without then with the software occlusion culling, and
+// prints the cull time and the primitives drawn of both. pathFile is an
+// osg::AnimationPath, as osgViewer records it; when it cannot be read a walk
+// down the aisle is generated and written to it.
+int BenchmarkOcclusion(const char *pathFile);
+
+// Culls count cylinders along an orbit that moves in and out, first with a
+// virtual cull per primitive then with the vectorized cull of DynamicLOD,
+// and prints the cull time and the primitives drawn of both.
+int BenchmarkCull(int count);
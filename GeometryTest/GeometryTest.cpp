@@ -3,6 +3,7 @@
 
 #include "stdafx.h"
 #include <Geometry.hpp>
+#include "Benchmark.h"
 
 osg::ref_ptr<osg::Geode> TestCircularTorus()
 {
@@ -204,6 +205,15 @@ void InitWnd(osgViewer::Viewer &viewer)
 
 int main(int argc, char* argv[])
 {
+	if (argc > 1 && strcmp(argv[1], "-bench-batch") == 0)
+		return BenchmarkBatch(argc > 2 ? atoi(argv[2]) : 20000);
+	if (argc > 1 && strcmp(argv[1], "-bench-tess") == 0)
+		return BenchmarkTessellation(argc > 2 ? atoi(argv[2]) : 100000);
+	if (argc > 1 && strcmp(argv[1], "-bench-occlusion") == 0)
+		return BenchmarkOcclusion(argc > 2 ? argv[2] : "occlusion.path");
+	if (argc > 1 && strcmp(argv[1], "-bench-cull") == 0)
+		return BenchmarkCull(argc > 2 ? atoi(argv[2]) : 100000);
+
 	osgViewer::Viewer myViewer;
 	InitWnd(myViewer);
 	osg::ref_ptr<osg::Group> root = new osg::Group();
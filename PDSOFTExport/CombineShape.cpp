@@ -0,0 +1,136 @@
+#include "CombineShape.h"
+#include <algorithm>
+#include <cmath>
+
+CombineShape::CombineShape()
+	: m_origin(AcGePoint3d::kOrigin)
+	, m_xAxis(AcGeVector3d::kXAxis)
+	, m_yAxis(AcGeVector3d::kYAxis)
+	, m_zAxis(AcGeVector3d::kZAxis)
+	, m_hash(14695981039346656037ull)
+{
+}
+
+void CombineShape::clear()
+{
+	m_parts.clear();
+	m_vertexs.clear();
+	m_faces.clear();
+	m_origin = AcGePoint3d::kOrigin;
+	m_xAxis = AcGeVector3d::kXAxis;
+	m_yAxis = AcGeVector3d::kYAxis;
+	m_zAxis = AcGeVector3d::kZAxis;
+	m_hash = 14695981039346656037ull;
+}
+
+void CombineShape::addMesh(Adesk::UInt32 rows, Adesk::UInt32 columns, const AcGePoint3d *pVertexList)
+{
+	addPart(MESH, rows, columns, rows * columns, pVertexList, 0, NULL);
+}
+
+void CombineShape::addShell(Adesk::UInt32 nbVertex, const AcGePoint3d *pVertexList,
+	Adesk::UInt32 faceListSize, const Adesk::Int32 *pFaceList)
+{
+	addPart(SHELL, 0, 0, nbVertex, pVertexList, faceListSize, pFaceList);
+}
+
+void CombineShape::addPolygon(Adesk::UInt32 nbPoints, const AcGePoint3d *pVertexList)
+{
+	addPart(POLYGON, 0, 0, nbPoints, pVertexList, 0, NULL);
+}
+
+void CombineShape::canonicalize(double tolerance)
+{
+	computeFrame();
+	for (size_t i = 0; i < m_vertexs.size(); ++i)
+	{
+		AcGeVector3d vec = m_vertexs[i] - m_origin;
+		m_vertexs[i].set(vec.dotProduct(m_xAxis), vec.dotProduct(m_yAxis), vec.dotProduct(m_zAxis));
+	}
+
+	m_hash = 14695981039346656037ull;
+	for (size_t i = 0; i < m_parts.size(); ++i)
+	{
+		const Part &part = m_parts[i];
+		Adesk::UInt32 header[] = { (Adesk::UInt32)part.type, part.rows, part.columns, part.numVertexs, part.numFaces };
+		hash(header, sizeof(header));
+		for (Adesk::UInt32 j = 0; j < part.numVertexs; ++j)
+		{
+			const AcGePoint3d &pnt = m_vertexs[part.firstVertex + j];
+			long long rounded[] = { (long long)floor(pnt.x / tolerance + 0.5), (long long)floor(pnt.y / tolerance + 0.5),
+				(long long)floor(pnt.z / tolerance + 0.5) };
+			hash(rounded, sizeof(rounded));
+		}
+		if (part.numFaces > 0)
+			hash(&m_faces[part.firstFace], part.numFaces * sizeof(Adesk::Int32));
+	}
+}
+
+void CombineShape::addPart(PartType type, Adesk::UInt32 rows, Adesk::UInt32 columns, Adesk::UInt32 numVertexs,
+	const AcGePoint3d *pVertexList, Adesk::UInt32 numFaces, const Adesk::Int32 *pFaceList)
+{
+	Part part = { type, rows, columns, (Adesk::UInt32)m_vertexs.size(), numVertexs,
+		(Adesk::UInt32)m_faces.size(), numFaces };
+	m_parts.push_back(part);
+	m_vertexs.insert(m_vertexs.end(), pVertexList, pVertexList + numVertexs);
+	m_faces.insert(m_faces.end(), pFaceList, pFaceList + numFaces);
+}
+
+// Half the largest distance, and not the largest one, picks the axes: the
+// vertex found stays the same when the copies round differently.
+void CombineShape::computeFrame()
+{
+	m_origin = m_vertexs.empty() ? AcGePoint3d::kOrigin : m_vertexs[0];
+	m_xAxis = AcGeVector3d::kXAxis;
+	m_yAxis = AcGeVector3d::kYAxis;
+	m_zAxis = AcGeVector3d::kZAxis;
+
+	double maxDist = 0.0;
+	for (size_t i = 1; i < m_vertexs.size(); ++i)
+		maxDist = std::max(maxDist, m_vertexs[i].distanceTo(m_origin));
+	if (maxDist <= 0.0)
+		return;
+
+	for (size_t i = 1; i < m_vertexs.size(); ++i)
+	{
+		if (m_vertexs[i].distanceTo(m_origin) > maxDist * 0.5)
+		{
+			m_xAxis = (m_vertexs[i] - m_origin).normal();
+			break;
+		}
+	}
+
+	double maxPerp = 0.0;
+	for (size_t i = 1; i < m_vertexs.size(); ++i)
+	{
+		AcGeVector3d vec = m_vertexs[i] - m_origin;
+		maxPerp = std::max(maxPerp, (vec - m_xAxis * vec.dotProduct(m_xAxis)).length());
+	}
+	// all on a line, any perpendicular y axis gives the same vertexs
+	if (maxPerp <= maxDist * 1.0e-9)
+		m_yAxis = m_xAxis.perpVector().normal();
+	else
+	{
+		for (size_t i = 1; i < m_vertexs.size(); ++i)
+		{
+			AcGeVector3d vec = m_vertexs[i] - m_origin;
+			AcGeVector3d perp = vec - m_xAxis * vec.dotProduct(m_xAxis);
+			if (perp.length() > maxPerp * 0.5)
+			{
+				m_yAxis = perp.normal();
+				break;
+			}
+		}
+	}
+	m_zAxis = m_xAxis.crossProduct(m_yAxis);
+}
+
+void CombineShape::hash(const void *data, size_t size)
+{
+	const unsigned char *bytes = static_cast<const unsigned char*>(data);
+	for (size_t i = 0; i < size; ++i)
+	{
+		m_hash ^= bytes[i];
+		m_hash *= 1099511628211ull;
+	}
+}
@@ -0,0 +1,119 @@
+#pragma once
+#include <vector>
+#include <adesk.h>
+#include <gepnt3d.h>
+#include <gevec3d.h>
+
+// The parts of one combine geometry, kept until it ends so that identical
+// geometries are written once. canonicalize() moves the vertexs into a frame
+// taken from the vertexs themselves: the first vertex is the origin, the x
+// axis points to the first vertex farther from it than half the largest
+// distance, the y axis to the first vertex farther from the x axis than half
+// the largest such distance. Copies of a geometry moved by a rigid transform
+// draw their vertexs in the same order, so they get the same canonical
+// vertexs and hash, and their frames place them back. A mirrored copy is
+// another shape.
+class CombineShape
+{
+public:
+	enum PartType
+	{
+		MESH, SHELL, POLYGON
+	};
+
+	struct Part
+	{
+		PartType type;
+		Adesk::UInt32 rows;
+		Adesk::UInt32 columns;
+		Adesk::UInt32 firstVertex;
+		Adesk::UInt32 numVertexs;
+		Adesk::UInt32 firstFace;
+		Adesk::UInt32 numFaces;
+	};
+
+	CombineShape();
+
+	void clear();
+	bool isEmpty() const;
+
+	void addMesh(Adesk::UInt32 rows, Adesk::UInt32 columns, const AcGePoint3d *pVertexList);
+	void addShell(Adesk::UInt32 nbVertex, const AcGePoint3d *pVertexList,
+		Adesk::UInt32 faceListSize, const Adesk::Int32 *pFaceList);
+	void addPolygon(Adesk::UInt32 nbPoints, const AcGePoint3d *pVertexList);
+
+	// moves the vertexs into their frame and hashes the parts with the
+	// vertexs rounded to tolerance
+	void canonicalize(double tolerance);
+
+	Adesk::UInt64 getHash() const;
+	const AcGePoint3d &getOrigin() const;
+	const AcGeVector3d &getXAxis() const;
+	const AcGeVector3d &getYAxis() const;
+	const AcGeVector3d &getZAxis() const;
+
+	const std::vector<Part> &getParts() const;
+	const AcGePoint3d *getVertexs(const Part &part) const;
+	const Adesk::Int32 *getFaces(const Part &part) const;
+
+private:
+	void addPart(PartType type, Adesk::UInt32 rows, Adesk::UInt32 columns, Adesk::UInt32 numVertexs,
+		const AcGePoint3d *pVertexList, Adesk::UInt32 numFaces, const Adesk::Int32 *pFaceList);
+	void computeFrame();
+	void hash(const void *data, size_t size);
+
+private:
+	std::vector<Part> m_parts;
+	std::vector<AcGePoint3d> m_vertexs;
+	std::vector<Adesk::Int32> m_faces;
+	AcGePoint3d m_origin;
+	AcGeVector3d m_xAxis;
+	AcGeVector3d m_yAxis;
+	AcGeVector3d m_zAxis;
+	Adesk::UInt64 m_hash;
+};
+
+inline bool CombineShape::isEmpty() const
+{
+	return m_parts.empty();
+}
+
+inline Adesk::UInt64 CombineShape::getHash() const
+{
+	return m_hash;
+}
+
+inline const AcGePoint3d &CombineShape::getOrigin() const
+{
+	return m_origin;
+}
+
+inline const AcGeVector3d &CombineShape::getXAxis() const
+{
+	return m_xAxis;
+}
+
+inline const AcGeVector3d &CombineShape::getYAxis() const
+{
+	return m_yAxis;
+}
+
+inline const AcGeVector3d &CombineShape::getZAxis() const
+{
+	return m_zAxis;
+}
+
+inline const std::vector<CombineShape::Part> &CombineShape::getParts() const
+{
+	return m_parts;
+}
+
+inline const AcGePoint3d *CombineShape::getVertexs(const Part &part) const
+{
+	return part.numVertexs == 0 ? NULL : &m_vertexs[part.firstVertex];
+}
+
+inline const Adesk::Int32 *CombineShape::getFaces(const Part &part) const
+{
+	return part.numFaces == 0 ? NULL : &m_faces[part.firstFace];
+}
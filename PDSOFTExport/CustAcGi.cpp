@@ -13,12 +13,44 @@ ACRX_NO_CONS_DEFINE_MEMBERS(CustAcGiWorldGeometry, AcGiWorldGeometry)
 
 void CustAcGiWorldGeometry::setExtents(AcGePoint3d *pNewExtents) const { PRINT_FUNC(); }
 
-void CustAcGiWorldGeometry::getModelToWorldTransform(AcGeMatrix3d&) const { PRINT_FUNC(); }
-void CustAcGiWorldGeometry::getWorldToModelTransform(AcGeMatrix3d&) const { PRINT_FUNC(); }
+void CustAcGiWorldGeometry::getModelToWorldTransform(AcGeMatrix3d& mat) const
+{
+    PRINT_FUNC();
+    mat = transforms_.empty() ? AcGeMatrix3d::kIdentity : transforms_.back();
+}
+
+void CustAcGiWorldGeometry::getWorldToModelTransform(AcGeMatrix3d& mat) const
+{
+    PRINT_FUNC();
+    getModelToWorldTransform(mat);
+    mat.invert();
+}
+
+// the normal stands for the plane of the arbitrary axis algorithm
+Adesk::Boolean CustAcGiWorldGeometry::pushModelTransform(const AcGeVector3d & vNormal)
+{
+    PRINT_FUNC();
+    return pushModelTransform(AcGeMatrix3d::planeToWorld(vNormal));
+}
+
+Adesk::Boolean CustAcGiWorldGeometry::pushModelTransform(const AcGeMatrix3d & xMat)
+{
+    PRINT_FUNC();
+    AcGeMatrix3d modelToWorld;
+    getModelToWorldTransform(modelToWorld);
+    transforms_.push_back(modelToWorld * xMat);
+    return Adesk::kTrue;
+}
+
+Adesk::Boolean CustAcGiWorldGeometry::popModelTransform()
+{
+    PRINT_FUNC();
+    if (transforms_.empty())
+        return Adesk::kFalse;
+    transforms_.pop_back();
+    return Adesk::kTrue;
+}
 
-Adesk::Boolean CustAcGiWorldGeometry::pushModelTransform(const AcGeVector3d & vNormal) { PRINT_FUNC(); return Adesk::kFalse; }
-Adesk::Boolean CustAcGiWorldGeometry::pushModelTransform(const AcGeMatrix3d & xMat) { PRINT_FUNC(); return Adesk::kFalse; }
-Adesk::Boolean CustAcGiWorldGeometry::popModelTransform() { PRINT_FUNC(); return Adesk::kFalse; }
 AcGeMatrix3d CustAcGiWorldGeometry::pushPositionTransform(AcGiPositionTransformBehavior behavior, const AcGePoint3d& offset)
 { PRINT_FUNC(); return AcGeMatrix3d(); }
 AcGeMatrix3d CustAcGiWorldGeometry::pushPositionTransform(AcGiPositionTransformBehavior behavior, const AcGePoint2d& offset)
@@ -66,7 +98,7 @@ Adesk::Boolean  CustAcGiWorldGeometry::polygon(const Adesk::UInt32 nbPoints,
                                                const AcGePoint3d* pVertexList) const
 {
     PRINT_FUNC();
-    polygonEvent(nbPoints, pVertexList);
+    polygonEvent(nbPoints, toWorld(nbPoints, pVertexList));
     return Adesk::kFalse;
 }
 
@@ -93,7 +125,7 @@ Adesk::Boolean  CustAcGiWorldGeometry::mesh(const Adesk::UInt32 rows,
                                             const bool bAutoGenerateNormals) const
 {
     PRINT_FUNC();
-    meshEvent(rows, columns, pVertexList, pEdgeData, pFaceData, pVertexData, bAutoGenerateNormals);
+    meshEvent(rows, columns, toWorld(rows * columns, pVertexList), pEdgeData, pFaceData, pVertexData, bAutoGenerateNormals);
     return Adesk::kFalse;
 }
 
@@ -108,7 +140,7 @@ Adesk::Boolean  CustAcGiWorldGeometry::shell(const Adesk::UInt32 nbVertex,
                                              const bool bAutoGenerateNormals) const
 {
     PRINT_FUNC();
-    shellEvent(nbVertex, pVertexList, faceListSize, pFaceList, pEdgeData, pFaceData, pVertexData, pResBuf, bAutoGenerateNormals);
+    shellEvent(nbVertex, toWorld(nbVertex, pVertexList), faceListSize, pFaceList, pEdgeData, pFaceData, pVertexData, pResBuf, bAutoGenerateNormals);
     return Adesk::kFalse;
 }
 
@@ -180,6 +212,20 @@ Adesk::Boolean  CustAcGiWorldGeometry::ellipticalArc(const AcGePoint3d&
 Adesk::Boolean          CustAcGiWorldGeometry::pushClipBoundary(AcGiClipBoundary * pBoundary) { PRINT_FUNC(); return Adesk::kFalse; }
 void                    CustAcGiWorldGeometry::popClipBoundary() { PRINT_FUNC(); }
 
+// The vertexs moved by the current model transform, pVertexList itself when
+// none is pushed. Valid until the next call.
+const AcGePoint3d* CustAcGiWorldGeometry::toWorld(Adesk::UInt32 nbPoints, const AcGePoint3d* pVertexList) const
+{
+    if (transforms_.empty() || pVertexList == NULL)
+        return pVertexList;
+
+    const AcGeMatrix3d &modelToWorld = transforms_.back();
+    worldPoints_.resize(nbPoints);
+    for (Adesk::UInt32 i = 0; i < nbPoints; ++i)
+        worldPoints_[i] = modelToWorld * pVertexList[i];
+    return worldPoints_.empty() ? NULL : &worldPoints_[0];
+}
+
 // } CustAcGiWorldGeometry end
 
 // CustAcGiSubEntityTraits begin {
@@ -238,7 +284,15 @@ AcGiSubEntityTraits& CustAcGiWorldDraw::subEntityTraits() const { return *pTrait
 AcGiGeometry* CustAcGiWorldDraw::rawGeometry() const { return pGeometry_.get(); }
 Adesk::Boolean CustAcGiWorldDraw::isDragging() const { return Adesk::kFalse; }
 
-double CustAcGiWorldDraw::deviation(const AcGiDeviationType, const AcGePoint3d&) const { PRINT_FUNC(); return deviation_; }
+double CustAcGiWorldDraw::deviation(const AcGiDeviationType, const AcGePoint3d&) const
+{
+    PRINT_FUNC();
+    AcGeMatrix3d modelToWorld;
+    pGeometry_->getModelToWorldTransform(modelToWorld);
+    double scale = modelToWorld.scale();
+    return scale > 0.0 ? deviation_ / scale : deviation_;
+}
+
 void CustAcGiWorldDraw::setDeviation(const double deviation) { PRINT_FUNC(); deviation_ = deviation; }
 Adesk::UInt32 CustAcGiWorldDraw::numberOfIsolines() const { PRINT_FUNC(); return 1; }
 
@@ -5,7 +5,9 @@
 #include <boost/smart_ptr/scoped_ptr.hpp>
 #include <boost/function.hpp>
 #include <tchar.h>
+#include <vector>
 #include <acgi.h>
+#include <gemat3d.h>
 
 
 class CustAcGiWorldGeometry : public AcGiWorldGeometry
@@ -31,6 +33,8 @@ public:
                         const resbuf* /* pResbuf */,
                         bool /* bAutoGenerateNormals */)> shellEvent;
 
+    // The events get their vertexs in world coordinates: the vertexs drawn
+    // are moved by the model transforms pushed when they are drawn.
 public:
     virtual void setExtents(AcGePoint3d *pNewExtents) const;
 
@@ -181,6 +185,14 @@ public:
     //
     virtual Adesk::Boolean          pushClipBoundary(AcGiClipBoundary * pBoundary);
     virtual void                    popClipBoundary();
+
+private:
+    const AcGePoint3d* toWorld(Adesk::UInt32 nbPoints, const AcGePoint3d* pVertexList) const;
+
+private:
+    // model to world transform of every pushModelTransform, innermost last
+    std::vector<AcGeMatrix3d> transforms_;
+    mutable std::vector<AcGePoint3d> worldPoints_;
 };
 
 class CustAcGiSubEntityTraits : public AcGiSubEntityTraits
@@ -245,14 +257,17 @@ public:
 public:
     virtual AcGiWorldGeometry& geometry() const;
 
+    // Shaded, so the entities draw their faces and not their isolines.
     virtual AcGiRegenType regenType() const;
     virtual Adesk::Boolean regenAbort() const;
     virtual AcGiSubEntityTraits& subEntityTraits() const;
     virtual AcGiGeometry* rawGeometry() const;
     virtual Adesk::Boolean isDragging() const;
 
-    // This function operates against the current active viewport
-    //
+    // The chord tolerance of the capture for every deviation type: the
+    // largest distance of a chord or facet from its curve or surface in world
+    // units. Returned in model units, divided by the scale of the current
+    // model transform.
     virtual double deviation(const AcGiDeviationType, const AcGePoint3d&) const;
     virtual void setDeviation(const double deviation);
     virtual Adesk::UInt32 numberOfIsolines() const;
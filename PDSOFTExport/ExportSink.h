@@ -0,0 +1,94 @@
+#pragma once
+#include <adesk.h>
+#include <gemat3d.h>
+#include <gepnt3d.h>
+#include <gevec3d.h>
+
+// Destination of an export. ExportEntity() turns every entity into calls on
+// the sink, one add method per table of the model database; the parts of a
+// combine geometry arrive between beginCombineGeometry() and
+// endCombineGeometry(). Entities of a block definition are added between
+// beginBlockDefinition() and endBlockDefinition() in block coordinates,
+// definitions may nest; each insert of the block is one addBlockReference().
+// The rows of one entity of the model space or of a block definition are
+// added between beginEntity() and endEntity(); an incremental sink keeps the
+// rows of entities whose hash did not change since the last export.
+//
+// Revolves and extrusions carry their profiles as the t_PolylineVertex
+// flags and vertexs of PDRevolve and PDSpolygon: 1 starts a line, 2 an arc
+// through the next vertex (flagged 3), 4 and 5 end a profile closed by a
+// line or an arc, 6 marks the three points of a circle.
+class ExportSink
+{
+public:
+	virtual ~ExportSink() {}
+
+	virtual bool begin() = 0;
+	virtual bool commit() = 0;
+	virtual void rollback() = 0;
+
+	// rows written since begin()
+	virtual unsigned long long getNumRows() const = 0;
+
+	// true when begin() kept the rows of the last export, the same until
+	// commit() or rollback()
+	virtual bool isIncremental() const = 0;
+	// true when the rows of the entity were exported with the same hash,
+	// the entity is then kept and needs no beginEntity()
+	virtual bool hasEntity(Adesk::UInt64 handle, Adesk::UInt64 hash) = 0;
+	// replaces the rows the entity had
+	virtual void beginEntity(Adesk::UInt64 handle) = 0;
+	virtual void endEntity(Adesk::UInt64 hash) = 0;
+
+	virtual void addBox(const AcGePoint3d &org, const AcGeVector3d &xLen, const AcGeVector3d &yLen,
+		const AcGeVector3d &zLen, int color) = 0;
+	virtual void addCircularTorus(const AcGePoint3d &center, const AcGePoint3d &startPnt, const AcGeVector3d &normal,
+		double startRadius, double endRadius, double angle, int color) = 0;
+	virtual void addCone(const AcGePoint3d &org, const AcGeVector3d &height, const AcGeVector3d &offset,
+		double radius, int color) = 0;
+	virtual void addCylinder(const AcGePoint3d &org, const AcGeVector3d &height, double radius, int color) = 0;
+	virtual void addEllipsoid(const AcGePoint3d &center, const AcGeVector3d &aLen, double bRadius, double angle,
+		int color) = 0;
+	virtual void addPrism(const AcGePoint3d &org, const AcGeVector3d &height, const AcGePoint3d &bottomStartPnt,
+		int edgeNum, int color) = 0;
+	virtual void addPyramid(const AcGePoint3d &org, const AcGeVector3d &height, const AcGeVector3d &xAxis,
+		const AcGeVector3d &offset, double bottomXLen, double bottomYLen, double topXLen, double topYLen, int color) = 0;
+	virtual void addRectCirc(const AcGePoint3d &rectCenter, const AcGeVector3d &xLen, double yLen,
+		const AcGeVector3d &height, const AcGeVector3d &offset, double radius, int color) = 0;
+	virtual void addRectangularTorus(const AcGePoint3d &center, const AcGePoint3d &startPnt, const AcGeVector3d &normal,
+		double startWidth, double startHeight, double endWidth, double endHeight, double angle, int color) = 0;
+	virtual void addSaddle(const AcGePoint3d &org, const AcGeVector3d &xLen, double yLen, const AcGeVector3d &zLen,
+		double radius, int color) = 0;
+	virtual void addSCylinder(const AcGePoint3d &org, const AcGeVector3d &height, const AcGeVector3d &bottomNormal,
+		double radius, int color) = 0;
+	virtual void addSnout(const AcGePoint3d &org, const AcGeVector3d &height, const AcGeVector3d &offset,
+		double bottomRadius, double topRadius, int color) = 0;
+	virtual void addSphere(const AcGePoint3d &center, const AcGeVector3d &bottomNormal, double radius, double angle,
+		int color) = 0;
+	virtual void addWedge(const AcGePoint3d &org, const AcGeVector3d &edge1, const AcGeVector3d &edge2,
+		const AcGeVector3d &height, int color) = 0;
+
+	// false when the sink has no revolve and extrusion tables, the entities
+	// are then captured from worldDraw() as combine geometry
+	virtual bool acceptsProfiles() const = 0;
+	// the profile swept by angle around the axis through axisPnt
+	virtual void addRevolve(const AcGePoint3d &axisPnt, const AcGeVector3d &axis, double angle,
+		Adesk::UInt32 nbVertex, const AcGePoint3d *pVertexList, const Adesk::Int32 *pFlagList, int color) = 0;
+	// closed loops moved by height, pLoopList holds the number of vertexs of
+	// each; the first loop is the outline, the others are holes
+	virtual void addExtrusion(const AcGeVector3d &height, Adesk::UInt32 nbVertex, const AcGePoint3d *pVertexList,
+		const Adesk::Int32 *pFlagList, Adesk::UInt32 nbLoop, const Adesk::Int32 *pLoopList, int color) = 0;
+
+	virtual void beginCombineGeometry(int color) = 0;
+	virtual void addMesh(Adesk::UInt32 rows, Adesk::UInt32 columns, const AcGePoint3d *pVertexList) = 0;
+	virtual void addShell(Adesk::UInt32 nbVertex, const AcGePoint3d *pVertexList,
+		Adesk::UInt32 faceListSize, const Adesk::Int32 *pFaceList) = 0;
+	virtual void addPolygon(Adesk::UInt32 nbPoints, const AcGePoint3d *pVertexList) = 0;
+	virtual void endCombineGeometry() = 0;
+
+	// returns the id addBlockReference() refers to the definition by, the
+	// same for the same block table record handle in an incremental sink
+	virtual long long beginBlockDefinition(Adesk::UInt64 handle) = 0;
+	virtual void endBlockDefinition() = 0;
+	virtual void addBlockReference(long long definitionId, const AcGeMatrix3d &transform) = 0;
+};
@@ -0,0 +1,395 @@
+#include "HashSink.h"
+
+HashSink::HashSink(ExportSink *pNext)
+	: m_pNext(pNext)
+	, m_hash(14695981039346656037ull)
+{
+}
+
+bool HashSink::begin()
+{
+	return m_pNext == NULL || m_pNext->begin();
+}
+
+bool HashSink::commit()
+{
+	return m_pNext == NULL || m_pNext->commit();
+}
+
+void HashSink::rollback()
+{
+	if (m_pNext != NULL)
+		m_pNext->rollback();
+}
+
+unsigned long long HashSink::getNumRows() const
+{
+	return m_pNext != NULL ? m_pNext->getNumRows() : 0;
+}
+
+bool HashSink::isIncremental() const
+{
+	return m_pNext != NULL && m_pNext->isIncremental();
+}
+
+bool HashSink::hasEntity(Adesk::UInt64 handle, Adesk::UInt64 hash)
+{
+	return m_pNext != NULL && m_pNext->hasEntity(handle, hash);
+}
+
+void HashSink::beginEntity(Adesk::UInt64 handle)
+{
+	if (m_pNext != NULL)
+		m_pNext->beginEntity(handle);
+}
+
+void HashSink::endEntity(Adesk::UInt64 hash)
+{
+	if (m_pNext != NULL)
+		m_pNext->endEntity(hash);
+}
+
+void HashSink::addBox(const AcGePoint3d &org, const AcGeVector3d &xLen, const AcGeVector3d &yLen,
+	const AcGeVector3d &zLen, int color)
+{
+	hash(BOX);
+	hash(org);
+	hash(xLen);
+	hash(yLen);
+	hash(zLen);
+	hash(color);
+	if (m_pNext != NULL)
+		m_pNext->addBox(org, xLen, yLen, zLen, color);
+}
+
+void HashSink::addCircularTorus(const AcGePoint3d &center, const AcGePoint3d &startPnt, const AcGeVector3d &normal,
+	double startRadius, double endRadius, double angle, int color)
+{
+	hash(CIRCULAR_TORUS);
+	hash(center);
+	hash(startPnt);
+	hash(normal);
+	hash(startRadius);
+	hash(endRadius);
+	hash(angle);
+	hash(color);
+	if (m_pNext != NULL)
+		m_pNext->addCircularTorus(center, startPnt, normal, startRadius, endRadius, angle, color);
+}
+
+void HashSink::addCone(const AcGePoint3d &org, const AcGeVector3d &height, const AcGeVector3d &offset,
+	double radius, int color)
+{
+	hash(CONE);
+	hash(org);
+	hash(height);
+	hash(offset);
+	hash(radius);
+	hash(color);
+	if (m_pNext != NULL)
+		m_pNext->addCone(org, height, offset, radius, color);
+}
+
+void HashSink::addCylinder(const AcGePoint3d &org, const AcGeVector3d &height, double radius, int color)
+{
+	hash(CYLINDER);
+	hash(org);
+	hash(height);
+	hash(radius);
+	hash(color);
+	if (m_pNext != NULL)
+		m_pNext->addCylinder(org, height, radius, color);
+}
+
+void HashSink::addEllipsoid(const AcGePoint3d &center, const AcGeVector3d &aLen, double bRadius, double angle,
+	int color)
+{
+	hash(ELLIPSOID);
+	hash(center);
+	hash(aLen);
+	hash(bRadius);
+	hash(angle);
+	hash(color);
+	if (m_pNext != NULL)
+		m_pNext->addEllipsoid(center, aLen, bRadius, angle, color);
+}
+
+void HashSink::addPrism(const AcGePoint3d &org, const AcGeVector3d &height, const AcGePoint3d &bottomStartPnt,
+	int edgeNum, int color)
+{
+	hash(PRISM);
+	hash(org);
+	hash(height);
+	hash(bottomStartPnt);
+	hash(edgeNum);
+	hash(color);
+	if (m_pNext != NULL)
+		m_pNext->addPrism(org, height, bottomStartPnt, edgeNum, color);
+}
+
+void HashSink::addPyramid(const AcGePoint3d &org, const AcGeVector3d &height, const AcGeVector3d &xAxis,
+	const AcGeVector3d &offset, double bottomXLen, double bottomYLen, double topXLen, double topYLen, int color)
+{
+	hash(PYRAMID);
+	hash(org);
+	hash(height);
+	hash(xAxis);
+	hash(offset);
+	hash(bottomXLen);
+	hash(bottomYLen);
+	hash(topXLen);
+	hash(topYLen);
+	hash(color);
+	if (m_pNext != NULL)
+		m_pNext->addPyramid(org, height, xAxis, offset, bottomXLen, bottomYLen, topXLen, topYLen, color);
+}
+
+void HashSink::addRectCirc(const AcGePoint3d &rectCenter, const AcGeVector3d &xLen, double yLen,
+	const AcGeVector3d &height, const AcGeVector3d &offset, double radius, int color)
+{
+	hash(RECT_CIRC);
+	hash(rectCenter);
+	hash(xLen);
+	hash(yLen);
+	hash(height);
+	hash(offset);
+	hash(radius);
+	hash(color);
+	if (m_pNext != NULL)
+		m_pNext->addRectCirc(rectCenter, xLen, yLen, height, offset, radius, color);
+}
+
+void HashSink::addRectangularTorus(const AcGePoint3d &center, const AcGePoint3d &startPnt, const AcGeVector3d &normal,
+	double startWidth, double startHeight, double endWidth, double endHeight, double angle, int color)
+{
+	hash(RECTANGULAR_TORUS);
+	hash(center);
+	hash(startPnt);
+	hash(normal);
+	hash(startWidth);
+	hash(startHeight);
+	hash(endWidth);
+	hash(endHeight);
+	hash(angle);
+	hash(color);
+	if (m_pNext != NULL)
+		m_pNext->addRectangularTorus(center, startPnt, normal, startWidth, startHeight, endWidth, endHeight, angle, color);
+}
+
+void HashSink::addSaddle(const AcGePoint3d &org, const AcGeVector3d &xLen, double yLen, const AcGeVector3d &zLen,
+	double radius, int color)
+{
+	hash(SADDLE);
+	hash(org);
+	hash(xLen);
+	hash(yLen);
+	hash(zLen);
+	hash(radius);
+	hash(color);
+	if (m_pNext != NULL)
+		m_pNext->addSaddle(org, xLen, yLen, zLen, radius, color);
+}
+
+void HashSink::addSCylinder(const AcGePoint3d &org, const AcGeVector3d &height, const AcGeVector3d &bottomNormal,
+	double radius, int color)
+{
+	hash(SCYLINDER);
+	hash(org);
+	hash(height);
+	hash(bottomNormal);
+	hash(radius);
+	hash(color);
+	if (m_pNext != NULL)
+		m_pNext->addSCylinder(org, height, bottomNormal, radius, color);
+}
+
+void HashSink::addSnout(const AcGePoint3d &org, const AcGeVector3d &height, const AcGeVector3d &offset,
+	double bottomRadius, double topRadius, int color)
+{
+	hash(SNOUT);
+	hash(org);
+	hash(height);
+	hash(offset);
+	hash(bottomRadius);
+	hash(topRadius);
+	hash(color);
+	if (m_pNext != NULL)
+		m_pNext->addSnout(org, height, offset, bottomRadius, topRadius, color);
+}
+
+void HashSink::addSphere(const AcGePoint3d &center, const AcGeVector3d &bottomNormal, double radius, double angle,
+	int color)
+{
+	hash(SPHERE);
+	hash(center);
+	hash(bottomNormal);
+	hash(radius);
+	hash(angle);
+	hash(color);
+	if (m_pNext != NULL)
+		m_pNext->addSphere(center, bottomNormal, radius, angle, color);
+}
+
+void HashSink::addWedge(const AcGePoint3d &org, const AcGeVector3d &edge1, const AcGeVector3d &edge2,
+	const AcGeVector3d &height, int color)
+{
+	hash(WEDGE);
+	hash(org);
+	hash(edge1);
+	hash(edge2);
+	hash(height);
+	hash(color);
+	if (m_pNext != NULL)
+		m_pNext->addWedge(org, edge1, edge2, height, color);
+}
+
+bool HashSink::acceptsProfiles() const
+{
+	return m_pNext == NULL || m_pNext->acceptsProfiles();
+}
+
+void HashSink::addRevolve(const AcGePoint3d &axisPnt, const AcGeVector3d &axis, double angle,
+	Adesk::UInt32 nbVertex, const AcGePoint3d *pVertexList, const Adesk::Int32 *pFlagList, int color)
+{
+	hash(REVOLVE);
+	hash(axisPnt);
+	hash(axis);
+	hash(angle);
+	hash(color);
+	hash(&nbVertex, sizeof(nbVertex));
+	hash(pVertexList, nbVertex);
+	hash(pFlagList, nbVertex * sizeof(Adesk::Int32));
+	if (m_pNext != NULL)
+		m_pNext->addRevolve(axisPnt, axis, angle, nbVertex, pVertexList, pFlagList, color);
+}
+
+void HashSink::addExtrusion(const AcGeVector3d &height, Adesk::UInt32 nbVertex, const AcGePoint3d *pVertexList,
+	const Adesk::Int32 *pFlagList, Adesk::UInt32 nbLoop, const Adesk::Int32 *pLoopList, int color)
+{
+	hash(EXTRUSION);
+	hash(height);
+	hash(color);
+	hash(&nbVertex, sizeof(nbVertex));
+	hash(pVertexList, nbVertex);
+	hash(pFlagList, nbVertex * sizeof(Adesk::Int32));
+	hash(&nbLoop, sizeof(nbLoop));
+	hash(pLoopList, nbLoop * sizeof(Adesk::Int32));
+	if (m_pNext != NULL)
+		m_pNext->addExtrusion(height, nbVertex, pVertexList, pFlagList, nbLoop, pLoopList, color);
+}
+
+void HashSink::beginCombineGeometry(int color)
+{
+	hash(COMBINE_GEOMETRY);
+	hash(color);
+	if (m_pNext != NULL)
+		m_pNext->beginCombineGeometry(color);
+}
+
+void HashSink::addMesh(Adesk::UInt32 rows, Adesk::UInt32 columns, const AcGePoint3d *pVertexList)
+{
+	hash(MESH);
+	hash(&rows, sizeof(rows));
+	hash(&columns, sizeof(columns));
+	hash(pVertexList, rows * columns);
+	if (m_pNext != NULL)
+		m_pNext->addMesh(rows, columns, pVertexList);
+}
+
+void HashSink::addShell(Adesk::UInt32 nbVertex, const AcGePoint3d *pVertexList,
+	Adesk::UInt32 faceListSize, const Adesk::Int32 *pFaceList)
+{
+	hash(SHELL);
+	hash(pVertexList, nbVertex);
+	hash(&faceListSize, sizeof(faceListSize));
+	hash(pFaceList, faceListSize * sizeof(Adesk::Int32));
+	if (m_pNext != NULL)
+		m_pNext->addShell(nbVertex, pVertexList, faceListSize, pFaceList);
+}
+
+void HashSink::addPolygon(Adesk::UInt32 nbPoints, const AcGePoint3d *pVertexList)
+{
+	hash(POLYGON);
+	hash(pVertexList, nbPoints);
+	if (m_pNext != NULL)
+		m_pNext->addPolygon(nbPoints, pVertexList);
+}
+
+void HashSink::endCombineGeometry()
+{
+	hash(END_COMBINE_GEOMETRY);
+	if (m_pNext != NULL)
+		m_pNext->endCombineGeometry();
+}
+
+long long HashSink::beginBlockDefinition(Adesk::UInt64 handle)
+{
+	hash(BLOCK_DEFINITION);
+	hash(&handle, sizeof(handle));
+	return m_pNext != NULL ? m_pNext->beginBlockDefinition(handle) : 0;
+}
+
+void HashSink::endBlockDefinition()
+{
+	hash(END_BLOCK_DEFINITION);
+	if (m_pNext != NULL)
+		m_pNext->endBlockDefinition();
+}
+
+void HashSink::addBlockReference(long long definitionId, const AcGeMatrix3d &transform)
+{
+	hash(BLOCK_REFERENCE);
+	hash(&definitionId, sizeof(definitionId));
+	for (int r = 0; r < 4; ++r)
+	{
+		for (int c = 0; c < 4; ++c)
+			hash(transform(r, c));
+	}
+	if (m_pNext != NULL)
+		m_pNext->addBlockReference(definitionId, transform);
+}
+
+void HashSink::hash(const void *data, size_t size)
+{
+	const unsigned char *bytes = static_cast<const unsigned char*>(data);
+	for (size_t i = 0; i < size; ++i)
+	{
+		m_hash ^= bytes[i];
+		m_hash *= 1099511628211ull;
+	}
+}
+
+void HashSink::hash(Method method)
+{
+	hash(static_cast<int>(method));
+}
+
+void HashSink::hash(double value)
+{
+	hash(&value, sizeof(value));
+}
+
+void HashSink::hash(int value)
+{
+	hash(&value, sizeof(value));
+}
+
+void HashSink::hash(const AcGePoint3d &pnt)
+{
+	hash(pnt.x);
+	hash(pnt.y);
+	hash(pnt.z);
+}
+
+void HashSink::hash(const AcGeVector3d &vec)
+{
+	hash(vec.x);
+	hash(vec.y);
+	hash(vec.z);
+}
+
+void HashSink::hash(const AcGePoint3d *pVertexList, Adesk::UInt32 numVertexs)
+{
+	for (Adesk::UInt32 i = 0; i < numVertexs; ++i)
+		hash(pVertexList[i]);
+}
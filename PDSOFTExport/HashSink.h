@@ -0,0 +1,100 @@
+#pragma once
+#include <cstddef>
+#include "ExportSink.h"
+
+// Hashes everything added to it, FNV-1a over the method and the bits of its
+// arguments, and passes it on to next when there is one. The hash of an
+// entity is the same on every export as long as its exported geometry is,
+// which is what an incremental export compares.
+class HashSink : public ExportSink
+{
+public:
+	explicit HashSink(ExportSink *pNext = NULL);
+
+	Adesk::UInt64 getHash() const;
+
+	virtual bool begin();
+	virtual bool commit();
+	virtual void rollback();
+
+	virtual unsigned long long getNumRows() const;
+
+	virtual bool isIncremental() const;
+	virtual bool hasEntity(Adesk::UInt64 handle, Adesk::UInt64 hash);
+	virtual void beginEntity(Adesk::UInt64 handle);
+	virtual void endEntity(Adesk::UInt64 hash);
+
+	virtual void addBox(const AcGePoint3d &org, const AcGeVector3d &xLen, const AcGeVector3d &yLen,
+		const AcGeVector3d &zLen, int color);
+	virtual void addCircularTorus(const AcGePoint3d &center, const AcGePoint3d &startPnt, const AcGeVector3d &normal,
+		double startRadius, double endRadius, double angle, int color);
+	virtual void addCone(const AcGePoint3d &org, const AcGeVector3d &height, const AcGeVector3d &offset,
+		double radius, int color);
+	virtual void addCylinder(const AcGePoint3d &org, const AcGeVector3d &height, double radius, int color);
+	virtual void addEllipsoid(const AcGePoint3d &center, const AcGeVector3d &aLen, double bRadius, double angle,
+		int color);
+	virtual void addPrism(const AcGePoint3d &org, const AcGeVector3d &height, const AcGePoint3d &bottomStartPnt,
+		int edgeNum, int color);
+	virtual void addPyramid(const AcGePoint3d &org, const AcGeVector3d &height, const AcGeVector3d &xAxis,
+		const AcGeVector3d &offset, double bottomXLen, double bottomYLen, double topXLen, double topYLen, int color);
+	virtual void addRectCirc(const AcGePoint3d &rectCenter, const AcGeVector3d &xLen, double yLen,
+		const AcGeVector3d &height, const AcGeVector3d &offset, double radius, int color);
+	virtual void addRectangularTorus(const AcGePoint3d &center, const AcGePoint3d &startPnt, const AcGeVector3d &normal,
+		double startWidth, double startHeight, double endWidth, double endHeight, double angle, int color);
+	virtual void addSaddle(const AcGePoint3d &org, const AcGeVector3d &xLen, double yLen, const AcGeVector3d &zLen,
+		double radius, int color);
+	virtual void addSCylinder(const AcGePoint3d &org, const AcGeVector3d &height, const AcGeVector3d &bottomNormal,
+		double radius, int color);
+	virtual void addSnout(const AcGePoint3d &org, const AcGeVector3d &height, const AcGeVector3d &offset,
+		double bottomRadius, double topRadius, int color);
+	virtual void addSphere(const AcGePoint3d &center, const AcGeVector3d &bottomNormal, double radius, double angle,
+		int color);
+	virtual void addWedge(const AcGePoint3d &org, const AcGeVector3d &edge1, const AcGeVector3d &edge2,
+		const AcGeVector3d &height, int color);
+
+	virtual bool acceptsProfiles() const;
+	virtual void addRevolve(const AcGePoint3d &axisPnt, const AcGeVector3d &axis, double angle,
+		Adesk::UInt32 nbVertex, const AcGePoint3d *pVertexList, const Adesk::Int32 *pFlagList, int color);
+	virtual void addExtrusion(const AcGeVector3d &height, Adesk::UInt32 nbVertex, const AcGePoint3d *pVertexList,
+		const Adesk::Int32 *pFlagList, Adesk::UInt32 nbLoop, const Adesk::Int32 *pLoopList, int color);
+
+	virtual void beginCombineGeometry(int color);
+	virtual void addMesh(Adesk::UInt32 rows, Adesk::UInt32 columns, const AcGePoint3d *pVertexList);
+	virtual void addShell(Adesk::UInt32 nbVertex, const AcGePoint3d *pVertexList,
+		Adesk::UInt32 faceListSize, const Adesk::Int32 *pFaceList);
+	virtual void addPolygon(Adesk::UInt32 nbPoints, const AcGePoint3d *pVertexList);
+	virtual void endCombineGeometry();
+
+	virtual long long beginBlockDefinition(Adesk::UInt64 handle);
+	virtual void endBlockDefinition();
+	virtual void addBlockReference(long long definitionId, const AcGeMatrix3d &transform);
+
+private:
+	// one per add method, so equal arguments of different methods differ
+	enum Method
+	{
+		BOX = 1, CIRCULAR_TORUS, CONE, CYLINDER, ELLIPSOID, PRISM, PYRAMID, RECT_CIRC, RECTANGULAR_TORUS,
+		SADDLE, SCYLINDER, SNOUT, SPHERE, WEDGE,
+		COMBINE_GEOMETRY, MESH, SHELL, POLYGON, END_COMBINE_GEOMETRY,
+		BLOCK_DEFINITION, END_BLOCK_DEFINITION, BLOCK_REFERENCE,
+		// appended, the hashes of earlier exports stay valid
+		REVOLVE, EXTRUSION
+	};
+
+	void hash(const void *data, size_t size);
+	void hash(Method method);
+	void hash(double value);
+	void hash(int value);
+	void hash(const AcGePoint3d &pnt);
+	void hash(const AcGeVector3d &vec);
+	void hash(const AcGePoint3d *pVertexList, Adesk::UInt32 numVertexs);
+
+private:
+	ExportSink *m_pNext;
+	Adesk::UInt64 m_hash;
+};
+
+inline Adesk::UInt64 HashSink::getHash() const
+{
+	return m_hash;
+}
@@ -0,0 +1,361 @@
+#include "stdafx.h"
+#include "NHibernateSink.h"
+
+using namespace Iesi::Collections::Generic;
+
+namespace
+{
+
+DbModel::Point^ ToPnt(const AcGePoint3d &pnt)
+{
+	return gcnew DbModel::Point(pnt.x, pnt.y, pnt.z);
+}
+
+DbModel::Point^ ToPnt(const AcGeVector3d &vec)
+{
+	return gcnew DbModel::Point(vec.x, vec.y, vec.z);
+}
+
+} // namespace
+
+NHibernateSink::NHibernateSink(NHibernate::ISession^ session)
+	: m_numRows(0)
+{
+	m_session = session;
+}
+
+bool NHibernateSink::begin()
+{
+	m_numRows = 0;
+	m_tx = m_session->BeginTransaction();
+	return true;
+}
+
+bool NHibernateSink::commit()
+{
+	m_tx->Commit();
+	return true;
+}
+
+void NHibernateSink::rollback()
+{
+	m_tx->Rollback();
+}
+
+bool NHibernateSink::isIncremental() const
+{
+	return false;
+}
+
+bool NHibernateSink::hasEntity(Adesk::UInt64 handle, Adesk::UInt64 hash)
+{
+	return false;
+}
+
+void NHibernateSink::beginEntity(Adesk::UInt64 handle)
+{
+}
+
+void NHibernateSink::endEntity(Adesk::UInt64 hash)
+{
+}
+
+void NHibernateSink::addBox(const AcGePoint3d &org, const AcGeVector3d &xLen, const AcGeVector3d &yLen,
+	const AcGeVector3d &zLen, int color)
+{
+	DbModel::Box^ box = gcnew DbModel::Box();
+	box->Org = ToPnt(org);
+	box->XLen = ToPnt(xLen);
+	box->YLen = ToPnt(yLen);
+	box->ZLen = ToPnt(zLen);
+	box->Color = color;
+	save(box);
+}
+
+void NHibernateSink::addCircularTorus(const AcGePoint3d &center, const AcGePoint3d &startPnt, const AcGeVector3d &normal,
+	double startRadius, double endRadius, double angle, int color)
+{
+	DbModel::CircularTorus^ ct = gcnew DbModel::CircularTorus();
+	ct->Center = ToPnt(center);
+	ct->StartPnt = ToPnt(startPnt);
+	ct->Normal = ToPnt(normal);
+	ct->StartRadius = startRadius;
+	ct->EndRadius = endRadius;
+	ct->Angle = angle;
+	ct->Color = color;
+	save(ct);
+}
+
+void NHibernateSink::addCone(const AcGePoint3d &org, const AcGeVector3d &height, const AcGeVector3d &offset,
+	double radius, int color)
+{
+	DbModel::Cone^ cone = gcnew DbModel::Cone();
+	cone->Org = ToPnt(org);
+	cone->Height = ToPnt(height);
+	cone->Offset = ToPnt(offset);
+	cone->Radius = radius;
+	cone->Color = color;
+	save(cone);
+}
+
+void NHibernateSink::addCylinder(const AcGePoint3d &org, const AcGeVector3d &height, double radius, int color)
+{
+	DbModel::Cylinder^ cyl = gcnew DbModel::Cylinder();
+	cyl->Org = ToPnt(org);
+	cyl->Height = ToPnt(height);
+	cyl->Radius = radius;
+	cyl->Color = color;
+	save(cyl);
+}
+
+void NHibernateSink::addEllipsoid(const AcGePoint3d &center, const AcGeVector3d &aLen, double bRadius, double angle,
+	int color)
+{
+	DbModel::Ellipsoid^ ellipsoid = gcnew DbModel::Ellipsoid();
+	ellipsoid->Center = ToPnt(center);
+	ellipsoid->ALen = ToPnt(aLen);
+	ellipsoid->BRadius = bRadius;
+	ellipsoid->Angle = angle;
+	ellipsoid->Color = color;
+	save(ellipsoid);
+}
+
+void NHibernateSink::addPrism(const AcGePoint3d &org, const AcGeVector3d &height, const AcGePoint3d &bottomStartPnt,
+	int edgeNum, int color)
+{
+	DbModel::Prism^ prism = gcnew DbModel::Prism();
+	prism->Org = ToPnt(org);
+	prism->Height = ToPnt(height);
+	prism->BottomStartPnt = ToPnt(bottomStartPnt);
+	prism->EdgeNum = edgeNum;
+	prism->Color = color;
+	save(prism);
+}
+
+void NHibernateSink::addPyramid(const AcGePoint3d &org, const AcGeVector3d &height, const AcGeVector3d &xAxis,
+	const AcGeVector3d &offset, double bottomXLen, double bottomYLen, double topXLen, double topYLen, int color)
+{
+	DbModel::Pyramid^ pyramid = gcnew DbModel::Pyramid();
+	pyramid->Org = ToPnt(org);
+	pyramid->Height = ToPnt(height);
+	pyramid->Offset = ToPnt(offset);
+	pyramid->XAxis = ToPnt(xAxis);
+	pyramid->BottomXLen = bottomXLen;
+	pyramid->BottomYLen = bottomYLen;
+	pyramid->TopXLen = topXLen;
+	pyramid->TopYLen = topYLen;
+	pyramid->Color = color;
+	save(pyramid);
+}
+
+void NHibernateSink::addRectCirc(const AcGePoint3d &rectCenter, const AcGeVector3d &xLen, double yLen,
+	const AcGeVector3d &height, const AcGeVector3d &offset, double radius, int color)
+{
+	DbModel::RectCirc^ rectCirc = gcnew DbModel::RectCirc();
+	rectCirc->RectCenter = ToPnt(rectCenter);
+	rectCirc->XLen = ToPnt(xLen);
+	rectCirc->YLen = yLen;
+	rectCirc->Height = ToPnt(height);
+	rectCirc->Offset = ToPnt(offset);
+	rectCirc->Radius = radius;
+	rectCirc->Color = color;
+	save(rectCirc);
+}
+
+void NHibernateSink::addRectangularTorus(const AcGePoint3d &center, const AcGePoint3d &startPnt, const AcGeVector3d &normal,
+	double startWidth, double startHeight, double endWidth, double endHeight, double angle, int color)
+{
+	DbModel::RectangularTorus^ rt = gcnew DbModel::RectangularTorus();
+	rt->Center = ToPnt(center);
+	rt->StartPnt = ToPnt(startPnt);
+	rt->Normal = ToPnt(normal);
+	rt->StartWidth = startWidth;
+	rt->StartHeight = startHeight;
+	rt->EndWidth = endWidth;
+	rt->EndHeight = endHeight;
+	rt->Angle = angle;
+	rt->Color = color;
+	save(rt);
+}
+
+void NHibernateSink::addSaddle(const AcGePoint3d &org, const AcGeVector3d &xLen, double yLen, const AcGeVector3d &zLen,
+	double radius, int color)
+{
+	DbModel::Saddle^ saddle = gcnew DbModel::Saddle();
+	saddle->Org = ToPnt(org);
+	saddle->XLen = ToPnt(xLen);
+	saddle->YLen = yLen;
+	saddle->ZLen = ToPnt(zLen);
+	saddle->Radius = radius;
+	saddle->Color = color;
+	save(saddle);
+}
+
+void NHibernateSink::addSCylinder(const AcGePoint3d &org, const AcGeVector3d &height, const AcGeVector3d &bottomNormal,
+	double radius, int color)
+{
+	DbModel::SCylinder^ scylinder = gcnew DbModel::SCylinder();
+	scylinder->Org = ToPnt(org);
+	scylinder->Height = ToPnt(height);
+	scylinder->BottomNormal = ToPnt(bottomNormal);
+	scylinder->Radius = radius;
+	scylinder->Color = color;
+	save(scylinder);
+}
+
+void NHibernateSink::addSnout(const AcGePoint3d &org, const AcGeVector3d &height, const AcGeVector3d &offset,
+	double bottomRadius, double topRadius, int color)
+{
+	DbModel::Snout^ snout = gcnew DbModel::Snout();
+	snout->Org = ToPnt(org);
+	snout->Height = ToPnt(height);
+	snout->Offset = ToPnt(offset);
+	snout->BottomRadius = bottomRadius;
+	snout->TopRadius = topRadius;
+	snout->Color = color;
+	save(snout);
+}
+
+void NHibernateSink::addSphere(const AcGePoint3d &center, const AcGeVector3d &bottomNormal, double radius, double angle,
+	int color)
+{
+	DbModel::Sphere^ sphere = gcnew DbModel::Sphere();
+	sphere->Center = ToPnt(center);
+	sphere->Radius = radius;
+	sphere->BottomNormal = ToPnt(bottomNormal);
+	sphere->Angle = angle;
+	sphere->Color = color;
+	save(sphere);
+}
+
+void NHibernateSink::addWedge(const AcGePoint3d &org, const AcGeVector3d &edge1, const AcGeVector3d &edge2,
+	const AcGeVector3d &height, int color)
+{
+	DbModel::Wedge^ wedge = gcnew DbModel::Wedge();
+	wedge->Org = ToPnt(org);
+	wedge->Edge1 = ToPnt(edge1);
+	wedge->Edge2 = ToPnt(edge2);
+	wedge->Height = ToPnt(height);
+	wedge->Color = color;
+	save(wedge);
+}
+
+bool NHibernateSink::acceptsProfiles() const
+{
+	// DbModel has no revolve or extrusion tables
+	return false;
+}
+
+void NHibernateSink::addRevolve(const AcGePoint3d &axisPnt, const AcGeVector3d &axis, double angle,
+	Adesk::UInt32 nbVertex, const AcGePoint3d *pVertexList, const Adesk::Int32 *pFlagList, int color)
+{
+	throw gcnew System::NotSupportedException(L"revolves");
+}
+
+void NHibernateSink::addExtrusion(const AcGeVector3d &height, Adesk::UInt32 nbVertex, const AcGePoint3d *pVertexList,
+	const Adesk::Int32 *pFlagList, Adesk::UInt32 nbLoop, const Adesk::Int32 *pLoopList, int color)
+{
+	throw gcnew System::NotSupportedException(L"extrusions");
+}
+
+void NHibernateSink::beginCombineGeometry(int color)
+{
+	m_cg = gcnew DbModel::CombineGeometry();
+	m_cg->Color = color;
+}
+
+void NHibernateSink::addMesh(Adesk::UInt32 rows, Adesk::UInt32 columns, const AcGePoint3d *pVertexList)
+{
+	DbModel::Mesh^ mesh = gcnew DbModel::Mesh();
+	mesh->Rows = rows;
+	mesh->Colums = columns;
+	mesh->Vertexs = gcnew OrderedSet<DbModel::MeshVertex^>();
+	for (Adesk::UInt32 i = 0; i < rows * columns; ++i)
+	{
+		DbModel::MeshVertex^ vertex = gcnew DbModel::MeshVertex();
+		vertex->Mesh = mesh;
+		vertex->Pos = ToPnt(pVertexList[i]);
+		mesh->Vertexs->Add(vertex);
+		save(vertex);
+	}
+
+	if (m_cg->Meshs == nullptr)
+		m_cg->Meshs = gcnew OrderedSet<DbModel::Mesh^>();
+	m_cg->Meshs->Add(mesh);
+	save(mesh);
+}
+
+void NHibernateSink::addShell(Adesk::UInt32 nbVertex, const AcGePoint3d *pVertexList,
+	Adesk::UInt32 faceListSize, const Adesk::Int32 *pFaceList)
+{
+	DbModel::Shell^ shell = gcnew DbModel::Shell();
+	shell->Vertexs = gcnew OrderedSet<DbModel::ShellVertex^>();
+	for (Adesk::UInt32 i = 0; i < nbVertex; ++i)
+	{
+		DbModel::ShellVertex^ vertex = gcnew DbModel::ShellVertex();
+		vertex->Shell = shell;
+		vertex->Pos = ToPnt(pVertexList[i]);
+		shell->Vertexs->Add(vertex);
+		save(vertex);
+	}
+
+	shell->Faces = gcnew OrderedSet<DbModel::ShellFace^>();
+	for (Adesk::UInt32 i = 0; i < faceListSize; ++i)
+	{
+		DbModel::ShellFace^ face = gcnew DbModel::ShellFace();
+		face->Shell = shell;
+		face->VertexIndex = pFaceList[i];
+		shell->Faces->Add(face);
+		save(face);
+	}
+
+	if (m_cg->Shells == nullptr)
+		m_cg->Shells = gcnew OrderedSet<DbModel::Shell^>();
+	m_cg->Shells->Add(shell);
+	save(shell);
+}
+
+void NHibernateSink::addPolygon(Adesk::UInt32 nbPoints, const AcGePoint3d *pVertexList)
+{
+	DbModel::Polygon^ polygon = gcnew DbModel::Polygon();
+	polygon->Vertexs = gcnew OrderedSet<DbModel::PolygonVertex^>();
+	for (Adesk::UInt32 i = 0; i < nbPoints; ++i)
+	{
+		DbModel::PolygonVertex^ vertex = gcnew DbModel::PolygonVertex();
+		vertex->Polygon = polygon;
+		vertex->Pos = ToPnt(pVertexList[i]);
+		polygon->Vertexs->Add(vertex);
+		save(vertex);
+	}
+	if (m_cg->Polygons == nullptr)
+		m_cg->Polygons = gcnew OrderedSet<DbModel::Polygon^>();
+	m_cg->Polygons->Add(polygon);
+	save(polygon);
+}
+
+void NHibernateSink::endCombineGeometry()
+{
+	save(m_cg);
+	m_cg = nullptr;
+}
+
+long long NHibernateSink::beginBlockDefinition(Adesk::UInt64 handle)
+{
+	throw gcnew System::NotSupportedException(L"block definitions");
+}
+
+void NHibernateSink::endBlockDefinition()
+{
+	throw gcnew System::NotSupportedException(L"block definitions");
+}
+
+void NHibernateSink::addBlockReference(long long definitionId, const AcGeMatrix3d &transform)
+{
+	throw gcnew System::NotSupportedException(L"block references");
+}
+
+void NHibernateSink::save(System::Object^ obj)
+{
+	m_session->Save(obj);
+	++m_numRows;
+}
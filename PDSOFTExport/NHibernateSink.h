@@ -0,0 +1,84 @@
+#pragma once
+#include <vcclr.h>
+#include "ExportSink.h"
+
+// Saves every row through an NHibernate session, one Save per object. Much
+// slower than SqliteSink, kept for the PDNETExport command and for databases
+// the native writer does not handle. The DbModel schema has no blocks, so
+// block references are exported flattened, and no entity handles, so every
+// export writes everything again.
+class NHibernateSink : public ExportSink
+{
+public:
+	explicit NHibernateSink(NHibernate::ISession^ session);
+
+	virtual bool begin();
+	virtual bool commit();
+	virtual void rollback();
+
+	virtual unsigned long long getNumRows() const;
+
+	virtual bool isIncremental() const;
+	virtual bool hasEntity(Adesk::UInt64 handle, Adesk::UInt64 hash);
+	virtual void beginEntity(Adesk::UInt64 handle);
+	virtual void endEntity(Adesk::UInt64 hash);
+
+	virtual void addBox(const AcGePoint3d &org, const AcGeVector3d &xLen, const AcGeVector3d &yLen,
+		const AcGeVector3d &zLen, int color);
+	virtual void addCircularTorus(const AcGePoint3d &center, const AcGePoint3d &startPnt, const AcGeVector3d &normal,
+		double startRadius, double endRadius, double angle, int color);
+	virtual void addCone(const AcGePoint3d &org, const AcGeVector3d &height, const AcGeVector3d &offset,
+		double radius, int color);
+	virtual void addCylinder(const AcGePoint3d &org, const AcGeVector3d &height, double radius, int color);
+	virtual void addEllipsoid(const AcGePoint3d &center, const AcGeVector3d &aLen, double bRadius, double angle,
+		int color);
+	virtual void addPrism(const AcGePoint3d &org, const AcGeVector3d &height, const AcGePoint3d &bottomStartPnt,
+		int edgeNum, int color);
+	virtual void addPyramid(const AcGePoint3d &org, const AcGeVector3d &height, const AcGeVector3d &xAxis,
+		const AcGeVector3d &offset, double bottomXLen, double bottomYLen, double topXLen, double topYLen, int color);
+	virtual void addRectCirc(const AcGePoint3d &rectCenter, const AcGeVector3d &xLen, double yLen,
+		const AcGeVector3d &height, const AcGeVector3d &offset, double radius, int color);
+	virtual void addRectangularTorus(const AcGePoint3d &center, const AcGePoint3d &startPnt, const AcGeVector3d &normal,
+		double startWidth, double startHeight, double endWidth, double endHeight, double angle, int color);
+	virtual void addSaddle(const AcGePoint3d &org, const AcGeVector3d &xLen, double yLen, const AcGeVector3d &zLen,
+		double radius, int color);
+	virtual void addSCylinder(const AcGePoint3d &org, const AcGeVector3d &height, const AcGeVector3d &bottomNormal,
+		double radius, int color);
+	virtual void addSnout(const AcGePoint3d &org, const AcGeVector3d &height, const AcGeVector3d &offset,
+		double bottomRadius, double topRadius, int color);
+	virtual void addSphere(const AcGePoint3d &center, const AcGeVector3d &bottomNormal, double radius, double angle,
+		int color);
+	virtual void addWedge(const AcGePoint3d &org, const AcGeVector3d &edge1, const AcGeVector3d &edge2,
+		const AcGeVector3d &height, int color);
+
+	virtual bool acceptsProfiles() const;
+	virtual void addRevolve(const AcGePoint3d &axisPnt, const AcGeVector3d &axis, double angle,
+		Adesk::UInt32 nbVertex, const AcGePoint3d *pVertexList, const Adesk::Int32 *pFlagList, int color);
+	virtual void addExtrusion(const AcGeVector3d &height, Adesk::UInt32 nbVertex, const AcGePoint3d *pVertexList,
+		const Adesk::Int32 *pFlagList, Adesk::UInt32 nbLoop, const Adesk::Int32 *pLoopList, int color);
+
+	virtual void beginCombineGeometry(int color);
+	virtual void addMesh(Adesk::UInt32 rows, Adesk::UInt32 columns, const AcGePoint3d *pVertexList);
+	virtual void addShell(Adesk::UInt32 nbVertex, const AcGePoint3d *pVertexList,
+		Adesk::UInt32 faceListSize, const Adesk::Int32 *pFaceList);
+	virtual void addPolygon(Adesk::UInt32 nbPoints, const AcGePoint3d *pVertexList);
+	virtual void endCombineGeometry();
+
+	virtual long long beginBlockDefinition(Adesk::UInt64 handle);
+	virtual void endBlockDefinition();
+	virtual void addBlockReference(long long definitionId, const AcGeMatrix3d &transform);
+
+private:
+	void save(System::Object^ obj);
+
+private:
+	gcroot<NHibernate::ISession^> m_session;
+	gcroot<NHibernate::ITransaction^> m_tx;
+	gcroot<DbModel::CombineGeometry^> m_cg;
+	unsigned long long m_numRows;
+};
+
+inline unsigned long long NHibernateSink::getNumRows() const
+{
+	return m_numRows;
+}
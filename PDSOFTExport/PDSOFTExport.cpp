@@ -17,6 +17,10 @@ ISession
 #include <dbapserv.h>
 #include <dbsubd.h>
 
+#include <ctime>
+#include <map>
+#include <string>
+#include <vector>
 #include <boost/scope_exit.hpp>
 
 #include "PDBox.h"
@@ -41,13 +45,19 @@ ISession
 #include "PDRevolve.h"
 
 #include "TestModel.h"
+#include "HashSink.h"
+#include "NHibernateSink.h"
+#include "QueueSink.h"
+#include "SqliteSink.h"
 
 using namespace Autodesk::AutoCAD::Runtime;
 using namespace Autodesk::AutoCAD::ApplicationServices;
-using namespace Iesi::Collections::Generic;
 
 
 void Export();
+void ExportFlat();
+void ExportUpdate();
+void ExportTolerance();
 
 void InitApplication()
 {
@@ -105,6 +115,9 @@ void InitApplication()
 	acrxBuildClassHierarchy();
 
 	acedRegCmds->addCommand(_T("PDSOFT_EXPORT"), _T("PDExport"), _T("PDExport"), ACRX_CMD_TRANSPARENT | ACRX_CMD_USEPICKSET, Export);
+	acedRegCmds->addCommand(_T("PDSOFT_EXPORT"), _T("PDExportFlat"), _T("PDExportFlat"), ACRX_CMD_TRANSPARENT | ACRX_CMD_USEPICKSET, ExportFlat);
+	acedRegCmds->addCommand(_T("PDSOFT_EXPORT"), _T("PDExportUpdate"), _T("PDExportUpdate"), ACRX_CMD_TRANSPARENT | ACRX_CMD_USEPICKSET, ExportUpdate);
+	acedRegCmds->addCommand(_T("PDSOFT_EXPORT"), _T("PDExportTolerance"), _T("PDExportTolerance"), ACRX_CMD_TRANSPARENT, ExportTolerance);
 	acedRegCmds->addCommand(_T("PDSOFT_EXPORT"), _T("PDTestModel"), _T("PDTestModel"), ACRX_CMD_TRANSPARENT | ACRX_CMD_USEPICKSET, PDPRIMARY3D_MODEL);
 }
 
@@ -205,16 +218,6 @@ extern "C" AcRx::AppRetCode acrxEntryPoint(AcRx::AppMsgCode msg, void* ptr) {
 	return AcRx::kRetOK;
 }
 
-DbModel::Point^ ToPnt(const AcGePoint3d &pnt)
-{
-	return gcnew DbModel::Point(pnt.x, pnt.y, pnt.z);
-}
-
-DbModel::Point^ ToPnt(const AcGeVector3d &vec)
-{
-	return gcnew DbModel::Point(vec.x, vec.y, vec.z);
-}
-
 int GetColor(const AcDbEntity *pEnt)
 {
 	AcCmColor color = pEnt->color();
@@ -255,13 +258,79 @@ int GetColor(const AcDbEntity *pEnt)
 	}
 }
 
-#include <vcclr.h>
+// The meshes, shells and polygons of one worldDraw(), held until it is
+// known to be the draw that is exported
+struct CapturedGeometry
+{
+	enum Type
+	{
+		MESH, SHELL, POLYGON
+	};
+
+	struct Part
+	{
+		Type type;
+		// rows and columns of a mesh, the vertex count of a shell or polygon
+		Adesk::UInt32 rows;
+		Adesk::UInt32 columns;
+		size_t firstVertex;
+		Adesk::UInt32 faceListSize;
+		size_t firstFace;
+	};
+
+	CapturedGeometry()
+		: numTriangles(0)
+	{
+	}
+
+	void clear()
+	{
+		parts.clear();
+		vertexs.clear();
+		faces.clear();
+		numTriangles = 0;
+	}
+
+	void send(ExportSink &sink) const
+	{
+		// parts without vertexs or faces point at the end of the arrays
+		const AcGePoint3d *pVertexs = vertexs.empty() ? NULL : &vertexs[0];
+		const Adesk::Int32 *pFaces = faces.empty() ? NULL : &faces[0];
+		for (size_t i = 0; i < parts.size(); ++i)
+		{
+			const Part &part = parts[i];
+			const AcGePoint3d *pVertexList = pVertexs + part.firstVertex;
+			if (part.type == MESH)
+				sink.addMesh(part.rows, part.columns, pVertexList);
+			else if (part.type == SHELL)
+				sink.addShell(part.rows, pVertexList, part.faceListSize, pFaces + part.firstFace);
+			else
+				sink.addPolygon(part.rows, pVertexList);
+		}
+	}
+
+	void add(Type type, Adesk::UInt32 rows, Adesk::UInt32 columns, const AcGePoint3d *pVertexList,
+		Adesk::UInt32 faceListSize = 0, const Adesk::Int32 *pFaceList = NULL)
+	{
+		Part part = { type, rows, columns, vertexs.size(), faceListSize, faces.size() };
+		parts.push_back(part);
+		vertexs.insert(vertexs.end(), pVertexList, pVertexList + rows * columns);
+		faces.insert(faces.end(), pFaceList, pFaceList + faceListSize);
+	}
+
+	std::vector<Part> parts;
+	std::vector<AcGePoint3d> vertexs;
+	std::vector<Adesk::Int32> faces;
+	Adesk::UInt64 numTriangles;
+};
+
+// The operators append the captured geometry to geometry and count its
+// triangles.
 struct MeshOperator
 {
-	MeshOperator(DbModel::CombineGeometry^ cg, NHibernate::ISession^ session)
+	explicit MeshOperator(CapturedGeometry &geometry)
+		: m_pGeometry(&geometry)
 	{
-		m_cg = cg;
-		m_session = session;
 	}
 
 	void operator()(Adesk::UInt32 rows,
@@ -274,37 +343,19 @@ struct MeshOperator
 	{
 		if (rows <= 1 || columns <= 1)
 			return;
-		
-		DbModel::Mesh^ mesh = gcnew DbModel::Mesh();
-		mesh->Rows = rows;
-		mesh->Colums = columns;
-		mesh->Vertexs = gcnew OrderedSet<DbModel::MeshVertex^>();
-		for (Adesk::UInt32 i = 0; i < rows * columns; ++i)
-		{
-			DbModel::MeshVertex^ vertex = gcnew DbModel::MeshVertex();
-			vertex->Mesh = mesh;
-			vertex->Pos = ToPnt(pVertexList[i]);
-			mesh->Vertexs->Add(vertex);
-			m_session->Save(vertex);
-		}
-
-		if (m_cg->Meshs == nullptr)
-			m_cg->Meshs = gcnew OrderedSet<DbModel::Mesh^>();
-		m_cg->Meshs->Add(mesh);
-		m_session->Save(mesh);
+		m_pGeometry->add(CapturedGeometry::MESH, rows, columns, pVertexList);
+		m_pGeometry->numTriangles += (rows - 1) * (columns - 1) * 2;
 	}
 
 private:
-	gcroot<DbModel::CombineGeometry^> m_cg;
-	gcroot<NHibernate::ISession^> m_session;
+	CapturedGeometry *m_pGeometry;
 };
 
 struct ShellOperator
 {
-	ShellOperator(DbModel::CombineGeometry^ cg, NHibernate::ISession^ session)
+	explicit ShellOperator(CapturedGeometry &geometry)
+		: m_pGeometry(&geometry)
 	{
-		m_cg = cg;
-		m_session = session;
 	}
 
 	void operator()(Adesk::UInt32 nbVertex,
@@ -317,86 +368,150 @@ struct ShellOperator
 		const struct resbuf* pResBuf,
 		bool bAutoGenerateNormals)
 	{
-		DbModel::Shell^ shell = gcnew DbModel::Shell();
-		shell->Vertexs = gcnew OrderedSet<DbModel::ShellVertex^>();
-		for (Adesk::UInt32 i = 0; i < nbVertex; ++i)
-		{
-			DbModel::ShellVertex^ vertex = gcnew DbModel::ShellVertex();
-			vertex->Shell = shell;
-			vertex->Pos = ToPnt(pVertexList[i]);
-			shell->Vertexs->Add(vertex);
-			m_session->Save(vertex);
-		}
-
-		shell->Faces = gcnew OrderedSet<DbModel::ShellFace^>();
-		for (Adesk::UInt32 i = 0; i < faceListSize; ++i)
+		m_pGeometry->add(CapturedGeometry::SHELL, nbVertex, 1, pVertexList, faceListSize, pFaceList);
+		// a face is its vertex count and indices, negative for a hole
+		for (Adesk::UInt32 i = 0; i < faceListSize; i += abs(pFaceList[i]) + 1)
 		{
-			DbModel::ShellFace^ face = gcnew DbModel::ShellFace();
-			face->Shell = shell;
-			face->VertexIndex = pFaceList[i];
-			shell->Faces->Add(face);
-			m_session->Save(face);
+			if (pFaceList[i] > 2)
+				m_pGeometry->numTriangles += pFaceList[i] - 2;
 		}
-
-		if (m_cg->Shells == nullptr)
-			m_cg->Shells = gcnew OrderedSet<DbModel::Shell^>();
-		m_cg->Shells->Add(shell);
-		m_session->Save(shell);
 	}
 
 private:
-	gcroot<DbModel::CombineGeometry^> m_cg;
-	gcroot<NHibernate::ISession^> m_session;
+	CapturedGeometry *m_pGeometry;
 };
 
 struct PolygonOperator
 {
-	PolygonOperator(DbModel::CombineGeometry^ cg, NHibernate::ISession^ session)
+	explicit PolygonOperator(CapturedGeometry &geometry)
+		: m_pGeometry(&geometry)
 	{
-		m_cg = cg;
-		m_session = session;
 	}
 
 	void operator()(Adesk::UInt32 nbPoints, const AcGePoint3d* pVertexList)
 	{
-		DbModel::Polygon^ polygon = gcnew DbModel::Polygon();
-		polygon->Vertexs = gcnew OrderedSet<DbModel::PolygonVertex^>();
-		for (Adesk::UInt32 i = 0; i < nbPoints; ++i)
-		{
-			DbModel::PolygonVertex^ vertex = gcnew DbModel::PolygonVertex();
-			vertex->Polygon = polygon;
-			vertex->Pos = ToPnt(pVertexList[i]);
-			polygon->Vertexs->Add(vertex);
-			m_session->Save(vertex);
-		}
-		if (m_cg->Polygons == nullptr)
-			m_cg->Polygons = gcnew OrderedSet<DbModel::Polygon^>();
-		m_cg->Polygons->Add(polygon);
-		m_session->Save(polygon);
+		m_pGeometry->add(CapturedGeometry::POLYGON, nbPoints, 1, pVertexList);
+		if (nbPoints > 2)
+			m_pGeometry->numTriangles += nbPoints - 2;
 	}
 
 private:
-	gcroot<DbModel::CombineGeometry^> m_cg;
-	gcroot<NHibernate::ISession^> m_session;
+	CapturedGeometry *m_pGeometry;
+};
+
+// the vertexs of a PDRevolve or PDSpolygon profile moved by mtx, with their flags
+void AppendProfile(const std::vector<t_PolylineVertex> &profile, const AcGeMatrix3d &mtx,
+	std::vector<AcGePoint3d> &vertexs, std::vector<Adesk::Int32> &flags)
+{
+	for (size_t i = 0; i < profile.size(); ++i)
+	{
+		AcGePoint3d pnt = profile[i].m_vertex;
+		vertexs.push_back(pnt.transformBy(mtx));
+		flags.push_back(profile[i].m_vertexFlag);
+	}
+}
+
+struct CaptureCount
+{
+	CaptureCount()
+		: numEntities(0), numTriangles(0)
+	{
+	}
+
+	unsigned int numEntities;
+	Adesk::UInt64 numTriangles;
+};
+
+// entity class name to what was captured of its entities
+typedef std::map<std::wstring, CaptureCount> CaptureCounts;
+
+// Entities without an analytic export are captured from worldDraw() with
+// their curves and surfaces cut to chordTolerance, the largest distance of a
+// chord or facet from the entity in world units. Their triangles are counted
+// in pCounts when it is set, the entities written in pNumEntities.
+struct CaptureOptions
+{
+	double chordTolerance;
+	CaptureCounts *pCounts;
+	unsigned int *pNumEntities;
 };
 
 #include "CustAcGi.hpp"
-void ExportEntity(NHibernate::ISession^ session, const AcDbEntity *pEnt, int color)
+// the captured geometry is moved by mtx, the transform of the block the
+// entity is drawn in
+void ExportEntity(ExportSink &sink, const AcDbEntity *pEnt, const AcGeMatrix3d &mtx, int color,
+	const CaptureOptions &capture)
 {
-	DbModel::CombineGeometry^ cg = gcnew DbModel::CombineGeometry();
+	CapturedGeometry geometry;
 	CustAcGiWorldDraw worldDraw;
-	MeshOperator mo(cg, session);
-	ShellOperator so(cg, session);
-	PolygonOperator po(cg, session);
+	MeshOperator mo(geometry);
+	ShellOperator so(geometry);
+	PolygonOperator po(geometry);
 	worldDraw.geom().meshEvent = mo;
 	worldDraw.geom().shellEvent = so;
 	worldDraw.geom().polygonEvent = po;
+	if (mtx != AcGeMatrix3d::kIdentity)
+		worldDraw.geom().pushModelTransform(mtx);
+	worldDraw.setDeviation(capture.chordTolerance);
 	const_cast<AcDbEntity*>(pEnt)->worldDraw(&worldDraw);
-	cg->Color = color;
-	session->Save(cg);
+
+	// A PD entity whose circles have fewer than three segments at the
+	// tolerance draws its wireframe only. It is drawn again with a thousandth
+	// of its size, which leaves it at its own division precision, and only
+	// that draw is exported.
+	AcDbExtents extents;
+	if (geometry.numTriangles == 0 && pEnt->getGeomExtents(extents) == Acad::eOk)
+	{
+		double deviation = extents.minPoint().distanceTo(extents.maxPoint()) * 1.0e-3 * mtx.scale();
+		if (deviation > 0.0 && deviation < capture.chordTolerance)
+		{
+			geometry.clear();
+			worldDraw.setDeviation(deviation);
+			const_cast<AcDbEntity*>(pEnt)->worldDraw(&worldDraw);
+		}
+	}
+	sink.beginCombineGeometry(color);
+	geometry.send(sink);
+	sink.endCombineGeometry();
+
+	if (capture.pCounts != NULL)
+	{
+		CaptureCount &count = (*capture.pCounts)[pEnt->isA()->name()];
+		++count.numEntities;
+		count.numTriangles += geometry.numTriangles;
+	}
 }
 
-void ExportEntity(NHibernate::ISession^ session, const AcDbEntity *pEnt, const AcGeMatrix3d &mtx)
+// block table record id to the id of its definition in the sink
+typedef std::map<AcDbObjectId, long long> BlockDefinitions;
+
+Adesk::UInt64 GetHandle(AcDbObjectId id)
+{
+	AcDbHandle handle = id.handle();
+	return ((Adesk::UInt64)handle.high() << 32) | handle.low();
+}
+
+// Entities of the block are tracked one by one in the sink when track is
+// set; an entity of a block exported flattened belongs to the insert.
+void ExportBlock(ExportSink &sink, AcDbObjectId btrId, const AcGeMatrix3d &mtx, BlockDefinitions *pDefinitions,
+	const CaptureOptions &capture, bool track);
+
+// the definition is exported on its first reference
+long long GetBlockDefinition(ExportSink &sink, AcDbObjectId btrId, BlockDefinitions *pDefinitions,
+	const CaptureOptions &capture)
+{
+	BlockDefinitions::const_iterator iter = pDefinitions->find(btrId);
+	if (iter == pDefinitions->end())
+	{
+		iter = pDefinitions->insert(std::make_pair(btrId, sink.beginBlockDefinition(GetHandle(btrId)))).first;
+		ExportBlock(sink, btrId, AcGeMatrix3d::kIdentity, pDefinitions, capture, true);
+		sink.endBlockDefinition();
+	}
+	return iter->second;
+}
+
+void ExportEntity(ExportSink &sink, const AcDbEntity *pEnt, const AcGeMatrix3d &mtx, BlockDefinitions *pDefinitions,
+	const CaptureOptions &capture)
 {
 	if (pEnt->isKindOf(PDScylinder::desc()))
 	{
@@ -407,13 +522,7 @@ void ExportEntity(NHibernate::ISession^ session, const AcDbEntity *pEnt, const A
 		height.transformBy(mtx);
 		AcGeVector3d bottomNormal = pdscylinder.getBottomNormal();
 
-		DbModel::SCylinder^ scylinder = gcnew DbModel::SCylinder();
-		scylinder->Org = ToPnt(org);
-		scylinder->Height = ToPnt(height);
-		scylinder->BottomNormal = ToPnt(bottomNormal);
-		scylinder->Radius = pdscylinder.getDiameter() / 2.0;
-		scylinder->Color = GetColor(pEnt);
-		session->Save(scylinder);
+		sink.addSCylinder(org, height, bottomNormal, pdscylinder.getDiameter() / 2.0, GetColor(pEnt));
 	}
 	else if (pEnt->isKindOf(PDCylinder::desc()))
 	{
@@ -423,24 +532,17 @@ void ExportEntity(NHibernate::ISession^ session, const AcDbEntity *pEnt, const A
 		AcGeVector3d height = (pdcyl.getPtEnd() - pdcyl.getPtStart());
 		height.transformBy(mtx);
 
-		DbModel::Cylinder^ cyl = gcnew DbModel::Cylinder();
-		cyl->Org = ToPnt(org);
-		cyl->Height = ToPnt(height);
-		cyl->Radius = pdcyl.getDiameter() / 2.0;
-		cyl->Color = GetColor(pEnt);
-		session->Save(cyl);
+		sink.addCylinder(org, height, pdcyl.getDiameter() / 2.0, GetColor(pEnt));
 	}
 	else if (pEnt->isKindOf(PDBox::desc()))
 	{
 		const PDBox &pdbox = *PDBox::cast(pEnt);
-		DbModel::Box^ box = gcnew DbModel::Box();
 		AcGePoint3d org = pdbox.getOrign();
-		box->Org = ToPnt(org.transformBy(mtx));
-		box->XLen = ToPnt((pdbox.getXvec() * pdbox.getlength()).transformBy(mtx));
-		box->YLen = ToPnt((pdbox.getYvec() * pdbox.getwidth()).transformBy(mtx));
-		box->ZLen = ToPnt((pdbox.getZvec() * pdbox.getheight()).transformBy(mtx));
-		box->Color = GetColor(pEnt);
-		session->Save(box);
+		sink.addBox(org.transformBy(mtx),
+			(pdbox.getXvec() * pdbox.getlength()).transformBy(mtx),
+			(pdbox.getYvec() * pdbox.getwidth()).transformBy(mtx),
+			(pdbox.getZvec() * pdbox.getheight()).transformBy(mtx),
+			GetColor(pEnt));
 	}
 	else if (pEnt->isKindOf(PDBox1::desc()))
 	{
@@ -458,13 +560,7 @@ void ExportEntity(NHibernate::ISession^ session, const AcDbEntity *pEnt, const A
 		org.transformBy(mtx);
 		org -= (xLen + yLen + zLen) / 2.0;
 
-		DbModel::Box^ box = gcnew DbModel::Box();
-		box->Org = ToPnt(org);
-		box->XLen = ToPnt(xLen);
-		box->YLen = ToPnt(yLen);
-		box->ZLen = ToPnt(zLen);
-		box->Color = GetColor(pEnt);
-		session->Save(box);
+		sink.addBox(org, xLen, yLen, zLen, GetColor(pEnt));
 	}
 	else if (pEnt->isKindOf(PDConcone::desc()))
 	{
@@ -476,25 +572,14 @@ void ExportEntity(NHibernate::ISession^ session, const AcDbEntity *pEnt, const A
 
 		if (pdcone.getDiameter1() < 1.0e-5 || pdcone.getDiameter2() < 1.0e-5)
 		{
-			DbModel::Cone^ cone = gcnew DbModel::Cone();
-			cone->Org = ToPnt(org);
-			cone->Height = ToPnt(height);
-			cone->Offset = ToPnt(AcGeVector3d::kIdentity);
-			cone->Radius = pdcone.getDiameter1() > pdcone.getDiameter2() ? pdcone.getDiameter1() / 2.0
-				: pdcone.getDiameter2() / 2.0;
-			cone->Color = GetColor(pEnt);
-			session->Save(cone);
+			sink.addCone(org, height, AcGeVector3d::kIdentity,
+				pdcone.getDiameter1() > pdcone.getDiameter2() ? pdcone.getDiameter1() / 2.0
+					: pdcone.getDiameter2() / 2.0,
+				GetColor(pEnt));
 		}
 		else
 		{
-			DbModel::Snout^ snout = gcnew DbModel::Snout();
-			snout->Org = ToPnt(org);
-			snout->Height = ToPnt(height);
-			snout->Offset = ToPnt(AcGeVector3d::kIdentity);
-			snout->BottomRadius = pdcone.getDiameter1() / 2.0;
-			snout->TopRadius = pdcone.getDiameter2() / 2.0;
-			snout->Color = GetColor(pEnt);
-			session->Save(snout);
+			sink.addSnout(org, height, AcGeVector3d::kIdentity, pdcone.getDiameter1() / 2.0, pdcone.getDiameter2() / 2.0, GetColor(pEnt));
 		}
 	}
 	else if (pEnt->isKindOf(PDEcone::desc()))
@@ -517,25 +602,14 @@ void ExportEntity(NHibernate::ISession^ session, const AcDbEntity *pEnt, const A
 
 		if (pdcone.getDiameter1() < 1.0e-5 || pdcone.getDiameter2() < 1.0e-5)
 		{
-			DbModel::Cone^ cone = gcnew DbModel::Cone();
-			cone->Org = ToPnt(org);
-			cone->Height = ToPnt(height);
-			cone->Offset = ToPnt(offset);
-			cone->Radius = pdcone.getDiameter1() > pdcone.getDiameter2() ? pdcone.getDiameter1() / 2.0
-				: pdcone.getDiameter2() / 2.0;
-			cone->Color = GetColor(pEnt);
-			session->Save(cone);
+			sink.addCone(org, height, offset,
+				pdcone.getDiameter1() > pdcone.getDiameter2() ? pdcone.getDiameter1() / 2.0
+					: pdcone.getDiameter2() / 2.0,
+				GetColor(pEnt));
 		}
 		else
 		{
-			DbModel::Snout^ cone = gcnew DbModel::Snout();
-			cone->Org = ToPnt(org);
-			cone->Height = ToPnt(height);
-			cone->BottomRadius = pdcone.getDiameter1() / 2.0;
-			cone->TopRadius = pdcone.getDiameter2() / 2.0;
-			cone->Offset = ToPnt(offset);
-			cone->Color = GetColor(pEnt);
-			session->Save(cone);
+			sink.addSnout(org, height, offset, pdcone.getDiameter1() / 2.0, pdcone.getDiameter2() / 2.0, GetColor(pEnt));
 		}
 	}
 	else if (pEnt->isKindOf(PDOval::desc()))
@@ -549,13 +623,7 @@ void ExportEntity(NHibernate::ISession^ session, const AcDbEntity *pEnt, const A
 		aLen.transformBy(mtx);
 		double angle = atan((pdoval.getlengthA() - pdoval.getOvalHeight()) / pdoval.getlengthR());
 
-		DbModel::Ellipsoid^ ellipsoid = gcnew DbModel::Ellipsoid();
-		ellipsoid->Center = ToPnt(center);
-		ellipsoid->ALen = ToPnt(aLen);
-		ellipsoid->BRadius = pdoval.getlengthB();
-		ellipsoid->Angle = (M_PI_2 - angle) * 2.0;
-		ellipsoid->Color = GetColor(pEnt);
-		session->Save(ellipsoid);
+		sink.addEllipsoid(center, aLen, pdoval.getlengthB(), (M_PI_2 - angle) * 2.0, GetColor(pEnt));
 	}
 	else if (pEnt->isKindOf(PDPrism::desc()))
 	{
@@ -567,13 +635,7 @@ void ExportEntity(NHibernate::ISession^ session, const AcDbEntity *pEnt, const A
 		AcGePoint3d bottomStartPnt = pdprism.getBottomStartPnt();
 		bottomStartPnt.transformBy(mtx);
 
-		DbModel::Prism^ prism = gcnew DbModel::Prism();
-		prism->Org = ToPnt(org);
-		prism->Height = ToPnt(height);
-		prism->BottomStartPnt = ToPnt(bottomStartPnt);
-		prism->EdgeNum = (int)pdprism.getEdgeNum();
-		prism->Color = GetColor(pEnt);
-		session->Save(prism);
+		sink.addPrism(org, height, bottomStartPnt, (int)pdprism.getEdgeNum(), GetColor(pEnt));
 	}
 	else if (pEnt->isKindOf(PDPrism1::desc()))
 	{
@@ -592,13 +654,7 @@ void ExportEntity(NHibernate::ISession^ session, const AcDbEntity *pEnt, const A
 		vect.transformBy(xform).normalize();
 		AcGePoint3d bottomStartPnt = org + vect * radius;
 
-		DbModel::Prism^ prism = gcnew DbModel::Prism();
-		prism->Org = ToPnt(org);
-		prism->Height = ToPnt(height);
-		prism->BottomStartPnt = ToPnt(bottomStartPnt);
-		prism->EdgeNum = (int)pdprism.getEdgeNum();
-		prism->Color = GetColor(pEnt);
-		session->Save(prism);
+		sink.addPrism(org, height, bottomStartPnt, (int)pdprism.getEdgeNum(), GetColor(pEnt));
 	}
 	else if (pEnt->isKindOf(PDSqucone::desc()))
 	{
@@ -612,17 +668,8 @@ void ExportEntity(NHibernate::ISession^ session, const AcDbEntity *pEnt, const A
 		AcGeVector3d offset = squcone.getVectV() * squcone.getLean();
 		offset.transformBy(mtx);
 
-		DbModel::Pyramid^ pyramid = gcnew DbModel::Pyramid();
-		pyramid->Org = ToPnt(org);
-		pyramid->Height = ToPnt(height);
-		pyramid->Offset = ToPnt(offset);
-		pyramid->XAxis = ToPnt(xAxis);
-		pyramid->BottomXLen = squcone.getLength1();
-		pyramid->BottomYLen = squcone.getWidth1();
-		pyramid->TopXLen = squcone.getLength2();
-		pyramid->TopYLen = squcone.getWidth2();
-		pyramid->Color = GetColor(pEnt);
-		session->Save(pyramid);
+		sink.addPyramid(org, height, xAxis, offset, squcone.getLength1(), squcone.getWidth1(),
+			squcone.getLength2(), squcone.getWidth2(), GetColor(pEnt));
 	}
 	else if (pEnt->isKindOf(PDWedge::desc()))
 	{
@@ -636,13 +683,7 @@ void ExportEntity(NHibernate::ISession^ session, const AcDbEntity *pEnt, const A
 		AcGeVector3d height = pdwedge.getpointP4() - pdwedge.getpointP2();
 		height.transformBy(mtx);
 
-		DbModel::Wedge^ wedge = gcnew DbModel::Wedge();
-		wedge->Org = ToPnt(org);
-		wedge->Edge1 = ToPnt(edge1);
-		wedge->Edge2 = ToPnt(edge2);
-		wedge->Height = ToPnt(height);
-		wedge->Color = GetColor(pEnt);
-		session->Save(wedge);
+		sink.addWedge(org, edge1, edge2, height, GetColor(pEnt));
 	}
 	else if (pEnt->isKindOf(PDSphere::desc()))
 	{
@@ -650,13 +691,7 @@ void ExportEntity(NHibernate::ISession^ session, const AcDbEntity *pEnt, const A
 		AcGePoint3d center = pdsphere.getCenter();
 		center.transformBy(mtx);
 
-		DbModel::Sphere^ sphere = gcnew DbModel::Sphere();
-		sphere->Center = ToPnt(center);
-		sphere->Radius = pdsphere.getRadius();
-		sphere->BottomNormal = ToPnt(-AcGeVector3d::kZAxis);
-		sphere->Angle = 2.0 * M_PI;
-		sphere->Color = GetColor(pEnt);
-		session->Save(sphere);
+		sink.addSphere(center, -AcGeVector3d::kZAxis, pdsphere.getRadius(), 2.0 * M_PI, GetColor(pEnt));
 	}
 	else if (pEnt->isKindOf(PDTorus::desc()))
 	{
@@ -668,15 +703,8 @@ void ExportEntity(NHibernate::ISession^ session, const AcDbEntity *pEnt, const A
 		AcGeVector3d normal = pdtorus.getNormal();
 		normal.transformBy(mtx).normalize();
 
-		DbModel::CircularTorus^ ct = gcnew DbModel::CircularTorus();
-		ct->Center = ToPnt(center);
-		ct->StartPnt = ToPnt(startPnt);
-		ct->Normal = ToPnt(normal);
-		ct->StartRadius = pdtorus.getDiameter1() / 2.0;
-		ct->EndRadius = pdtorus.getDiameter2() / 2.0;
-		ct->Angle = pdtorus.getAngle();
-		ct->Color = GetColor(pEnt);
-		session->Save(ct);
+		sink.addCircularTorus(center, startPnt, normal, pdtorus.getDiameter1() / 2.0, pdtorus.getDiameter2() / 2.0,
+			pdtorus.getAngle(), GetColor(pEnt));
 	}
 	else if (pEnt->isKindOf(PDTorus1::desc()))
 	{
@@ -689,15 +717,8 @@ void ExportEntity(NHibernate::ISession^ session, const AcDbEntity *pEnt, const A
 		normal.transformBy(mtx);
 		normal.normalize();
 
-		DbModel::CircularTorus^ ct = gcnew DbModel::CircularTorus();
-		ct->Center = ToPnt(center);
-		ct->StartPnt = ToPnt(startPnt);
-		ct->Normal = ToPnt(normal);
-		ct->StartRadius = pdtorus.getDiameter1() / 2.0;
-		ct->EndRadius = pdtorus.getDiameter2() / 2.0;
-		ct->Angle = pdtorus.getAngle() * M_PI / 180.0;
-		ct->Color = GetColor(pEnt);
-		session->Save(ct);
+		sink.addCircularTorus(center, startPnt, normal, pdtorus.getDiameter1() / 2.0, pdtorus.getDiameter2() / 2.0,
+			pdtorus.getAngle() * M_PI / 180.0, GetColor(pEnt));
 	}
 	else if (pEnt->isKindOf(PDSqutorus::desc()))
 	{
@@ -709,17 +730,8 @@ void ExportEntity(NHibernate::ISession^ session, const AcDbEntity *pEnt, const A
 		AcGeVector3d normal = pdtorus.getNormal();
 		normal.transformBy(mtx).normalize();
 
-		DbModel::RectangularTorus^ rt = gcnew DbModel::RectangularTorus();
-		rt->Center = ToPnt(center);
-		rt->StartPnt = ToPnt(startPnt);
-		rt->Normal = ToPnt(normal);
-		rt->StartWidth = pdtorus.getLength1();
-		rt->StartHeight = pdtorus.getWidth1();
-		rt->EndWidth = pdtorus.getLength2();
-		rt->EndHeight = pdtorus.getWidth2();
-		rt->Angle = pdtorus.getAngle();
-		rt->Color = GetColor(pEnt);
-		session->Save(rt);
+		sink.addRectangularTorus(center, startPnt, normal, pdtorus.getLength1(), pdtorus.getWidth1(),
+			pdtorus.getLength2(), pdtorus.getWidth2(), pdtorus.getAngle(), GetColor(pEnt));
 	}
 	else if (pEnt->isKindOf(PDSqutorus1::desc()))
 	{
@@ -731,17 +743,8 @@ void ExportEntity(NHibernate::ISession^ session, const AcDbEntity *pEnt, const A
 		AcGeVector3d normal = pdtorus.getNormalP2();
 		normal.normalize();
 
-		DbModel::RectangularTorus^ rt = gcnew DbModel::RectangularTorus();
-		rt->Center = ToPnt(center);
-		rt->StartPnt = ToPnt(startPnt);
-		rt->Normal = ToPnt(normal);
-		rt->StartWidth = pdtorus.getLength1();
-		rt->StartHeight = pdtorus.getWidth1();
-		rt->EndWidth = pdtorus.getLength2();
-		rt->EndHeight = pdtorus.getWidth2();
-		rt->Angle = pdtorus.getAngle() * M_PI / 180.0;
-		rt->Color = GetColor(pEnt);
-		session->Save(rt);
+		sink.addRectangularTorus(center, startPnt, normal, pdtorus.getLength1(), pdtorus.getWidth1(),
+			pdtorus.getLength2(), pdtorus.getWidth2(), pdtorus.getAngle() * M_PI / 180.0, GetColor(pEnt));
 	}
 	else if (pEnt->isKindOf(PDSaddle::desc()))
 	{
@@ -762,14 +765,7 @@ void ExportEntity(NHibernate::ISession^ session, const AcDbEntity *pEnt, const A
 		AcGeVector3d xLen = insX * length;
 		AcGeVector3d zLen = insZ * height;
 
-		DbModel::Saddle^ saddle = gcnew DbModel::Saddle();
-		saddle->Org = ToPnt(org);
-		saddle->XLen = ToPnt(xLen);
-		saddle->YLen = width;
-		saddle->ZLen = ToPnt(zLen);
-		saddle->Radius = pdsaddle.getRadius();
-		saddle->Color = GetColor(pEnt);
-		session->Save(saddle);
+		sink.addSaddle(org, xLen, width, zLen, pdsaddle.getRadius(), GetColor(pEnt));
 	}
 	else if (pEnt->isKindOf(PDSqucir::desc()))
 	{
@@ -791,91 +787,110 @@ void ExportEntity(NHibernate::ISession^ session, const AcDbEntity *pEnt, const A
 		AcGeVector3d offset = vec.orthoProject(normal);
 		AcGeVector3d height = vec - offset;
 
-		DbModel::RectCirc^ rectCirc = gcnew DbModel::RectCirc();
-		rectCirc->RectCenter = ToPnt(rectCenter);
-		rectCirc->XLen = ToPnt(xLen);
-		rectCirc->YLen = pdsqucir.getWidth();
-		rectCirc->Height = ToPnt(height);
-		rectCirc->Offset = ToPnt(offset);
-		rectCirc->Radius = pdsqucir.getRadius();
-		rectCirc->Color = GetColor(pEnt);
-		session->Save(rectCirc);
+		sink.addRectCirc(rectCenter, xLen, pdsqucir.getWidth(), height, offset, pdsqucir.getRadius(), GetColor(pEnt));
+	}
+	else if (pEnt->isKindOf(PDRevolve::desc()) && sink.acceptsProfiles())
+	{
+		const PDRevolve &pdrevolve = *PDRevolve::cast(pEnt);
+		AcGePoint3d axisPnt = pdrevolve.getPtAxis();
+		axisPnt.transformBy(mtx);
+		AcGeVector3d axis = pdrevolve.getVecAxis();
+		axis.transformBy(mtx).normalize();
+		// a mirroring transform turns the sweep the other way around the axis
+		if (mtx.det() < 0.0)
+			axis.negate();
+
+		std::vector<AcGePoint3d> vertexs;
+		std::vector<Adesk::Int32> flags;
+		AppendProfile(pdrevolve.getPolylineVertex(), mtx, vertexs, flags);
+		if (vertexs.empty())
+			return;
+
+		sink.addRevolve(axisPnt, axis, pdrevolve.getAngle(), (Adesk::UInt32)vertexs.size(), &vertexs[0], &flags[0],
+			GetColor(pEnt));
 	}
-	else if (pEnt->isKindOf(PDRevolve::desc()))
+	else if (pEnt->isKindOf(PDSpolygon::desc()) && sink.acceptsProfiles())
 	{
-		ExportEntity(session, pEnt, GetColor(pEnt));
+		const PDSpolygon &pdspolygon = *PDSpolygon::cast(pEnt);
+		AcGeVector3d height = pdspolygon.getVh() * pdspolygon.getH();
+		height.transformBy(mtx);
+
+		// the outline first, then the holes
+		std::vector<AcGePoint3d> vertexs;
+		std::vector<Adesk::Int32> flags;
+		std::vector<Adesk::Int32> loops;
+		AppendProfile(pdspolygon.getOut(), mtx, vertexs, flags);
+		loops.push_back((Adesk::Int32)vertexs.size());
+		const std::vector< std::vector<t_PolylineVertex> > &holes = pdspolygon.getIn();
+		for (size_t i = 0; i < holes.size(); ++i)
+		{
+			size_t first = vertexs.size();
+			AppendProfile(holes[i], mtx, vertexs, flags);
+			if (vertexs.size() > first)
+				loops.push_back((Adesk::Int32)(vertexs.size() - first));
+		}
+		if (loops[0] < 3)
+			return;
+
+		sink.addExtrusion(height, (Adesk::UInt32)vertexs.size(), &vertexs[0], &flags[0], (Adesk::UInt32)loops.size(),
+			&loops[0], GetColor(pEnt));
 	}
-	else if (pEnt->isKindOf(PDSpolygon::desc()))
+	else if (pEnt->isKindOf(PDRevolve::desc()) || pEnt->isKindOf(PDSpolygon::desc()))
 	{
-		ExportEntity(session, pEnt, GetColor(pEnt));
+		ExportEntity(sink, pEnt, mtx, GetColor(pEnt), capture);
 	}
 	else if (pEnt->isKindOf(AcDb3dSolid::desc()))
 	{
-		ExportEntity(session, pEnt, GetColor(pEnt));
+		ExportEntity(sink, pEnt, mtx, GetColor(pEnt), capture);
 	}
 	else if (pEnt->isKindOf(AcDbBlockReference::desc()))
 	{
-		Acad::ErrorStatus es = Acad::eOk;
 		const AcDbBlockReference &blockRef = *AcDbBlockReference::cast(pEnt);
 		AcGeMatrix3d blockTransform = blockRef.blockTransform();
-		AcDbSmartObjectPointer<AcDbBlockTableRecord> pBtr(blockRef.blockTableRecord(), AcDb::kForRead);
-		if ((es = pBtr.openStatus()) != Acad::eOk)
-		{
-			acutPrintf(L"es = %s, function = %s:%d\n", acadErrorStatusText(es), __FUNCTIONW__, __LINE__);
-			return;
-		}
-		AcDbBlockTableRecordIterator *pBtri = NULL;
-		es = pBtr->newIterator(pBtri);
-		if (es != Acad::eOk)
-		{
-			acutPrintf(L"es = %s, function = %s:%d\n", acadErrorStatusText(es), __FUNCTIONW__, __LINE__);
-			return;
-		}
-
-		BOOST_SCOPE_EXIT(pBtri)
-		{
-			if (pBtri != NULL)
-				delete pBtri;
-		}
-		BOOST_SCOPE_EXIT_END;
-
-		for (; !pBtri->done(); pBtri->step())
-		{
-			AcDbObjectId id;
-			if ((es = pBtri->getEntityId(id)) != Acad::eOk)
-			{
-				acutPrintf(L"es = %s, function = %s:%d\n", acadErrorStatusText(es), __FUNCTIONW__, __LINE__);
-				continue;
-			}
-			AcDbSmartObjectPointer<AcDbEntity> pBlockEnt(id, AcDb::kForRead);
-			if ((es = pBlockEnt.openStatus()) != Acad::eOk)
-			{
-				acutPrintf(L"es = %s, function = %s:%d\n", acadErrorStatusText(es), __FUNCTIONW__, __LINE__);
-				continue;
-			}
-			ExportEntity(session, pBlockEnt, blockTransform);
-		}
+		AcDbObjectId btrId = blockRef.blockTableRecord();
+		if (pDefinitions == NULL)
+			ExportBlock(sink, btrId, mtx * blockTransform, NULL, capture, false);
+		else
+			sink.addBlockReference(GetBlockDefinition(sink, btrId, pDefinitions, capture), mtx * blockTransform);
 	}
 }
 
-void ExportModel(NHibernate::ISession^ session)
+// An incremental sink keeps the entity when the hash of its export did not
+// change, found by exporting it to a HashSink alone first. Otherwise the
+// rows and their hash are written in one pass. Only what is written is
+// counted.
+void ExportTrackedEntity(ExportSink &sink, const AcDbEntity *pEnt, const AcGeMatrix3d &mtx,
+	BlockDefinitions *pDefinitions, const CaptureOptions &capture)
 {
-	Acad::ErrorStatus es = Acad::eOk;
-	AcDbSmartObjectPointer<AcDbBlockTable> pBt(acdbCurDwg()->blockTableId(), AcDb::kForRead);
-	if ((es = pBt.openStatus()) != Acad::eOk)
-	{
-		acutPrintf(L"es = %s, function = %s:%d\n", acadErrorStatusText(es), __FUNCTIONW__, __LINE__);
-		return;
-	}
+	// the definition is not part of the hash of a reference
+	if (pDefinitions != NULL && pEnt->isKindOf(AcDbBlockReference::desc()))
+		GetBlockDefinition(sink, AcDbBlockReference::cast(pEnt)->blockTableRecord(), pDefinitions, capture);
 
-	AcDbObjectId recordId;
-	if ((es = pBt->getAt(ACDB_MODEL_SPACE, recordId)) != Acad::eOk)
+	Adesk::UInt64 handle = GetHandle(pEnt->objectId());
+	if (sink.isIncremental())
 	{
-		acutPrintf(L"es = %s, function = %s:%d\n", acadErrorStatusText(es), __FUNCTIONW__, __LINE__);
-		return;
+		CaptureOptions hashCapture = capture;
+		hashCapture.pCounts = NULL;
+		hashCapture.pNumEntities = NULL;
+		HashSink hashSink;
+		ExportEntity(hashSink, pEnt, mtx, pDefinitions, hashCapture);
+		if (sink.hasEntity(handle, hashSink.getHash()))
+			return;
 	}
 
-	AcDbSmartObjectPointer<AcDbBlockTableRecord> pBtr(recordId, AcDb::kForRead);
+	HashSink hashSink(&sink);
+	sink.beginEntity(handle);
+	ExportEntity(hashSink, pEnt, mtx, pDefinitions, capture);
+	sink.endEntity(hashSink.getHash());
+	if (capture.pNumEntities != NULL)
+		++*capture.pNumEntities;
+}
+
+void ExportBlock(ExportSink &sink, AcDbObjectId btrId, const AcGeMatrix3d &mtx, BlockDefinitions *pDefinitions,
+	const CaptureOptions &capture, bool track)
+{
+	Acad::ErrorStatus es = Acad::eOk;
+	AcDbSmartObjectPointer<AcDbBlockTableRecord> pBtr(btrId, AcDb::kForRead);
 	if ((es = pBtr.openStatus()) != Acad::eOk)
 	{
 		acutPrintf(L"es = %s, function = %s:%d\n", acadErrorStatusText(es), __FUNCTIONW__, __LINE__);
@@ -895,7 +910,6 @@ void ExportModel(NHibernate::ISession^ session)
 	}
 	BOOST_SCOPE_EXIT_END;
 
-	AcGeMatrix3d mtx;
 	for (; !pBtri->done(); pBtri->step())
 	{
 		AcDbObjectId id;
@@ -910,10 +924,37 @@ void ExportModel(NHibernate::ISession^ session)
 			acutPrintf(L"es = %s, function = %s:%d\n", acadErrorStatusText(es), __FUNCTIONW__, __LINE__);
 			continue;
 		}
-		ExportEntity(session, pBlockEnt, mtx);
+		if (track)
+			ExportTrackedEntity(sink, pBlockEnt, mtx, pDefinitions, capture);
+		else
+			ExportEntity(sink, pBlockEnt, mtx, pDefinitions, capture);
 	}
 }
 
+// Block references are written once per definition and referenced with
+// their transform when instanceBlocks is set, otherwise every insert is
+// exported again in model space.
+void ExportModel(ExportSink &sink, bool instanceBlocks, const CaptureOptions &capture)
+{
+	Acad::ErrorStatus es = Acad::eOk;
+	AcDbSmartObjectPointer<AcDbBlockTable> pBt(acdbCurDwg()->blockTableId(), AcDb::kForRead);
+	if ((es = pBt.openStatus()) != Acad::eOk)
+	{
+		acutPrintf(L"es = %s, function = %s:%d\n", acadErrorStatusText(es), __FUNCTIONW__, __LINE__);
+		return;
+	}
+
+	AcDbObjectId recordId;
+	if ((es = pBt->getAt(ACDB_MODEL_SPACE, recordId)) != Acad::eOk)
+	{
+		acutPrintf(L"es = %s, function = %s:%d\n", acadErrorStatusText(es), __FUNCTIONW__, __LINE__);
+		return;
+	}
+
+	BlockDefinitions definitions;
+	ExportBlock(sink, recordId, AcGeMatrix3d::kIdentity, instanceBlocks ? &definitions : NULL, capture, true);
+}
+
 //void ExportModel(NHibernate::ISession^ session)
 //{
 //	AcGeMatrix3d mtx;
@@ -944,20 +985,103 @@ void ExportModel(NHibernate::ISession^ session)
 //	nRet = acedSSFree(ss);
 //}
 
-void DoExport()
+const wchar_t *DB_PATH = L"d:/pdsoft.db";
+
+// the chord tolerance of the capture, set by PDExportTolerance
+double g_chordTolerance = 0.1;
+
+// The NHibernate export writes a row per vertex and face index where the
+// SQLite one writes a blob, so only the entities per second compare the two.
+void PrintRate(const ExportSink &sink, unsigned int numEntities, clock_t start)
+{
+	double seconds = double(clock() - start) / CLOCKS_PER_SEC;
+	acutPrintf(L"%I64u rows, %u entities in %.2f s, %.0f rows/s, %.0f entities/s\n", sink.getNumRows(), numEntities,
+		seconds, seconds > 0.0 ? sink.getNumRows() / seconds : 0.0, seconds > 0.0 ? numEntities / seconds : 0.0);
+}
+
+// the triangles captured per entity class, to weigh the size of the export
+// against its chord tolerance
+void PrintCaptureCounts(const CaptureCounts &counts)
+{
+	if (counts.empty())
+		return;
+
+	acutPrintf(L"captured at chord tolerance %g:\n", g_chordTolerance);
+	unsigned int numEntities = 0;
+	Adesk::UInt64 numTriangles = 0;
+	for (CaptureCounts::const_iterator iter = counts.begin(); iter != counts.end(); ++iter)
+	{
+		const CaptureCount &count = iter->second;
+		acutPrintf(L"  %s: %u entities, %I64u triangles, %.1f per entity\n", iter->first.c_str(),
+			count.numEntities, count.numTriangles, double(count.numTriangles) / count.numEntities);
+		numEntities += count.numEntities;
+		numTriangles += count.numTriangles;
+	}
+	acutPrintf(L"  total: %u entities, %I64u triangles\n", numEntities, numTriangles);
+}
+
+// An incremental export falls back to a full one when the database is
+// missing or of an older schema. The rows are written on a worker thread
+// while the entities are captured; the time of the capture alone is
+// reported next to the total.
+void DoExport(bool instanceBlocks, bool incremental)
+{
+	clock_t start = clock();
+	SqliteSink sink(DB_PATH, incremental);
+	QueueSink queue(sink);
+	CaptureCounts counts;
+	unsigned int numEntities = 0;
+	CaptureOptions capture = { g_chordTolerance, &counts, &numEntities };
+	bool ok = queue.begin();
+	if (ok)
+	{
+		ExportModel(queue, instanceBlocks, capture);
+		double seconds = double(clock() - start) / CLOCKS_PER_SEC;
+		acutPrintf(L"captured in %.2f s, %.2f s waiting for the writer\n", seconds, queue.getWaitSeconds());
+		ok = queue.commit();
+	}
+	else
+		queue.rollback();
+
+	if (!ok)
+	{
+		acutPrintf(L"sqlite error: %S\n", sink.getErrorMessage().c_str());
+		return;
+	}
+	PrintRate(sink, numEntities, start);
+	if (sink.isIncremental())
+		acutPrintf(L"%u entities unchanged, %u erased\n", sink.getNumKeptEntities(), sink.getNumErasedEntities());
+	if (sink.getNumCombineGeometries() > 0)
+	{
+		unsigned int numShared = sink.getNumCombineGeometries() - sink.getNumCombineShapes();
+		acutPrintf(L"%u combine geometries as %u new shapes, %.1f%% duplicates\n", sink.getNumCombineGeometries(),
+			sink.getNumCombineShapes(), 100.0 * numShared / sink.getNumCombineGeometries());
+	}
+	PrintCaptureCounts(counts);
+}
+
+// the former NHibernate export, one Save per row
+void DoNHibernateExport()
 {
+	clock_t start = clock();
 	DbModel::Util^ util = gcnew DbModel::Util();
 	try {
-		util->init(gcnew System::String(L"d:/pdsoft.db"), true);
+		util->init(gcnew System::String(DB_PATH), true);
 		NHibernate::ISession^ session = util->SessionFactory->OpenSession();
 		try {
-			NHibernate::ITransaction^ tx = session->BeginTransaction();
+			NHibernateSink sink(session);
+			CaptureCounts counts;
+			unsigned int numEntities = 0;
+			CaptureOptions capture = { g_chordTolerance, &counts, &numEntities };
+			sink.begin();
 			try {
-				ExportModel(session);
-				tx->Commit();
+				ExportModel(sink, false, capture);
+				sink.commit();
+				PrintRate(sink, numEntities, start);
+				PrintCaptureCounts(counts);
 			}
 			catch (System::Exception ^e) {
-				tx->Rollback();
+				sink.rollback();
 				
 				System::String^ msg = e->Message;
 				msg += L"\n" + e->StackTrace;
@@ -980,8 +1104,8 @@ public:
 	[CommandMethod("PDNETExport", CommandFlags::Session)]
 	static void NetExport()
 	{
-		acutPrintf(L"PDSOFT Export ...\n");
-		DoExport();
+		acutPrintf(L"PDSOFT Export (NHibernate) ...\n");
+		DoNHibernateExport();
 	}
 };
 
@@ -989,5 +1113,27 @@ public:
 void Export()
 {
 	acutPrintf(L"PDSOFT Export ...\n");
-	DoExport();
-}
\ No newline at end of file
+	DoExport(true, false);
+}
+
+void ExportFlat()
+{
+	acutPrintf(L"PDSOFT Export (blocks flattened) ...\n");
+	DoExport(false, false);
+}
+
+void ExportUpdate()
+{
+	acutPrintf(L"PDSOFT Export (changed entities only) ...\n");
+	DoExport(true, true);
+}
+
+void ExportTolerance()
+{
+	ads_real tolerance = g_chordTolerance;
+	wchar_t prompt[64];
+	swprintf_s(prompt, L"\nChord tolerance of the capture <%g>: ", g_chordTolerance);
+	acedInitGet(RSG_NONEG | RSG_NOZERO, NULL);
+	if (acedGetReal(prompt, &tolerance) == RTNORM)
+		g_chordTolerance = tolerance;
+}
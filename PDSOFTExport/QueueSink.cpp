@@ -0,0 +1,564 @@
+#include "QueueSink.h"
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+struct RecordHeader
+{
+	Adesk::UInt32 method;
+	// bytes of the payload, which is padded to 8
+	Adesk::UInt32 size;
+};
+
+size_t Align(size_t size)
+{
+	return (size + 7) & ~size_t(7);
+}
+
+// spins a little, then sleeps, while the other thread catches up
+class Backoff
+{
+public:
+	Backoff()
+		: m_count(0)
+	{
+	}
+
+	void wait()
+	{
+		if (++m_count < 64)
+			std::this_thread::yield();
+		else
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+
+private:
+	unsigned int m_count;
+};
+
+AcGePoint3d Pnt(const double *v)
+{
+	return AcGePoint3d(v[0], v[1], v[2]);
+}
+
+AcGeVector3d Vec(const double *v)
+{
+	return AcGeVector3d(v[0], v[1], v[2]);
+}
+
+} // namespace
+
+struct QueueSink::Ring
+{
+	explicit Ring(size_t bytes)
+		: buffer(bytes / sizeof(Adesk::UInt64))
+		, capacity(buffer.size() * sizeof(Adesk::UInt64))
+		, head(0)
+		, tail(0)
+		, waitSeconds(0.0)
+	{
+	}
+
+	char *at(unsigned long long pos)
+	{
+		return reinterpret_cast<char*>(&buffer[0]) + pos % capacity;
+	}
+
+	// records start 8 byte aligned
+	std::vector<Adesk::UInt64> buffer;
+	size_t capacity;
+	// bytes pushed by the producer and replayed by the worker since begin()
+	std::atomic<unsigned long long> head;
+	std::atomic<unsigned long long> tail;
+	std::thread worker;
+	// a record too big for the ring
+	std::vector<Adesk::UInt64> large;
+	double waitSeconds;
+};
+
+QueueSink::QueueSink(ExportSink &next, size_t capacity)
+	: m_pNext(&next)
+	, m_pRing(new Ring(capacity))
+{
+}
+
+QueueSink::~QueueSink()
+{
+	stop();
+	delete m_pRing;
+}
+
+bool QueueSink::begin()
+{
+	stop();
+	if (!m_pNext->begin())
+		return false;
+
+	m_pRing->head = 0;
+	m_pRing->tail = 0;
+	m_pRing->waitSeconds = 0.0;
+	m_pRing->worker = std::thread(&QueueSink::run, this);
+	return true;
+}
+
+bool QueueSink::commit()
+{
+	stop();
+	return m_pNext->commit();
+}
+
+void QueueSink::rollback()
+{
+	stop();
+	m_pNext->rollback();
+}
+
+// counts the rows the worker wrote so far until commit()
+unsigned long long QueueSink::getNumRows() const
+{
+	drain();
+	return m_pNext->getNumRows();
+}
+
+bool QueueSink::isIncremental() const
+{
+	// fixed by begin(), read while the worker writes
+	return m_pNext->isIncremental();
+}
+
+bool QueueSink::hasEntity(Adesk::UInt64 handle, Adesk::UInt64 hash)
+{
+	// marks the entity seen in the map the worker updates; the ring is empty
+	// already when the entities before were kept too
+	drain();
+	return m_pNext->hasEntity(handle, hash);
+}
+
+void QueueSink::beginEntity(Adesk::UInt64 handle)
+{
+	Part parts[] = { { &handle, sizeof(handle) } };
+	push(BEGIN_ENTITY, parts, _countof(parts));
+}
+
+void QueueSink::endEntity(Adesk::UInt64 hash)
+{
+	Part parts[] = { { &hash, sizeof(hash) } };
+	push(END_ENTITY, parts, _countof(parts));
+}
+
+void QueueSink::addBox(const AcGePoint3d &org, const AcGeVector3d &xLen, const AcGeVector3d &yLen,
+	const AcGeVector3d &zLen, int color)
+{
+	double values[] = { org.x, org.y, org.z, xLen.x, xLen.y, xLen.z, yLen.x, yLen.y, yLen.z,
+		zLen.x, zLen.y, zLen.z, color };
+	push(BOX, values, _countof(values));
+}
+
+void QueueSink::addCircularTorus(const AcGePoint3d &center, const AcGePoint3d &startPnt, const AcGeVector3d &normal,
+	double startRadius, double endRadius, double angle, int color)
+{
+	double values[] = { center.x, center.y, center.z, startPnt.x, startPnt.y, startPnt.z,
+		normal.x, normal.y, normal.z, startRadius, endRadius, angle, color };
+	push(CIRCULAR_TORUS, values, _countof(values));
+}
+
+void QueueSink::addCone(const AcGePoint3d &org, const AcGeVector3d &height, const AcGeVector3d &offset,
+	double radius, int color)
+{
+	double values[] = { org.x, org.y, org.z, height.x, height.y, height.z, offset.x, offset.y, offset.z,
+		radius, color };
+	push(CONE, values, _countof(values));
+}
+
+void QueueSink::addCylinder(const AcGePoint3d &org, const AcGeVector3d &height, double radius, int color)
+{
+	double values[] = { org.x, org.y, org.z, height.x, height.y, height.z, radius, color };
+	push(CYLINDER, values, _countof(values));
+}
+
+void QueueSink::addEllipsoid(const AcGePoint3d &center, const AcGeVector3d &aLen, double bRadius, double angle,
+	int color)
+{
+	double values[] = { center.x, center.y, center.z, aLen.x, aLen.y, aLen.z, bRadius, angle, color };
+	push(ELLIPSOID, values, _countof(values));
+}
+
+void QueueSink::addPrism(const AcGePoint3d &org, const AcGeVector3d &height, const AcGePoint3d &bottomStartPnt,
+	int edgeNum, int color)
+{
+	double values[] = { org.x, org.y, org.z, height.x, height.y, height.z,
+		bottomStartPnt.x, bottomStartPnt.y, bottomStartPnt.z, edgeNum, color };
+	push(PRISM, values, _countof(values));
+}
+
+void QueueSink::addPyramid(const AcGePoint3d &org, const AcGeVector3d &height, const AcGeVector3d &xAxis,
+	const AcGeVector3d &offset, double bottomXLen, double bottomYLen, double topXLen, double topYLen, int color)
+{
+	double values[] = { org.x, org.y, org.z, height.x, height.y, height.z, xAxis.x, xAxis.y, xAxis.z,
+		offset.x, offset.y, offset.z, bottomXLen, bottomYLen, topXLen, topYLen, color };
+	push(PYRAMID, values, _countof(values));
+}
+
+void QueueSink::addRectCirc(const AcGePoint3d &rectCenter, const AcGeVector3d &xLen, double yLen,
+	const AcGeVector3d &height, const AcGeVector3d &offset, double radius, int color)
+{
+	double values[] = { rectCenter.x, rectCenter.y, rectCenter.z, xLen.x, xLen.y, xLen.z, yLen,
+		height.x, height.y, height.z, offset.x, offset.y, offset.z, radius, color };
+	push(RECT_CIRC, values, _countof(values));
+}
+
+void QueueSink::addRectangularTorus(const AcGePoint3d &center, const AcGePoint3d &startPnt, const AcGeVector3d &normal,
+	double startWidth, double startHeight, double endWidth, double endHeight, double angle, int color)
+{
+	double values[] = { center.x, center.y, center.z, startPnt.x, startPnt.y, startPnt.z,
+		normal.x, normal.y, normal.z, startWidth, startHeight, endWidth, endHeight, angle, color };
+	push(RECTANGULAR_TORUS, values, _countof(values));
+}
+
+void QueueSink::addSaddle(const AcGePoint3d &org, const AcGeVector3d &xLen, double yLen, const AcGeVector3d &zLen,
+	double radius, int color)
+{
+	double values[] = { org.x, org.y, org.z, xLen.x, xLen.y, xLen.z, yLen, zLen.x, zLen.y, zLen.z, radius, color };
+	push(SADDLE, values, _countof(values));
+}
+
+void QueueSink::addSCylinder(const AcGePoint3d &org, const AcGeVector3d &height, const AcGeVector3d &bottomNormal,
+	double radius, int color)
+{
+	double values[] = { org.x, org.y, org.z, height.x, height.y, height.z,
+		bottomNormal.x, bottomNormal.y, bottomNormal.z, radius, color };
+	push(SCYLINDER, values, _countof(values));
+}
+
+void QueueSink::addSnout(const AcGePoint3d &org, const AcGeVector3d &height, const AcGeVector3d &offset,
+	double bottomRadius, double topRadius, int color)
+{
+	double values[] = { org.x, org.y, org.z, height.x, height.y, height.z, offset.x, offset.y, offset.z,
+		bottomRadius, topRadius, color };
+	push(SNOUT, values, _countof(values));
+}
+
+void QueueSink::addSphere(const AcGePoint3d &center, const AcGeVector3d &bottomNormal, double radius, double angle,
+	int color)
+{
+	double values[] = { center.x, center.y, center.z, bottomNormal.x, bottomNormal.y, bottomNormal.z,
+		radius, angle, color };
+	push(SPHERE, values, _countof(values));
+}
+
+void QueueSink::addWedge(const AcGePoint3d &org, const AcGeVector3d &edge1, const AcGeVector3d &edge2,
+	const AcGeVector3d &height, int color)
+{
+	double values[] = { org.x, org.y, org.z, edge1.x, edge1.y, edge1.z, edge2.x, edge2.y, edge2.z,
+		height.x, height.y, height.z, color };
+	push(WEDGE, values, _countof(values));
+}
+
+bool QueueSink::acceptsProfiles() const
+{
+	return m_pNext->acceptsProfiles();
+}
+
+void QueueSink::addRevolve(const AcGePoint3d &axisPnt, const AcGeVector3d &axis, double angle,
+	Adesk::UInt32 nbVertex, const AcGePoint3d *pVertexList, const Adesk::Int32 *pFlagList, int color)
+{
+	double values[] = { axisPnt.x, axisPnt.y, axisPnt.z, axis.x, axis.y, axis.z, angle, color };
+	Adesk::UInt32 counts[] = { nbVertex, 0 };
+	Part parts[] = { { values, sizeof(values) }, { counts, sizeof(counts) },
+		{ pVertexList, nbVertex * sizeof(AcGePoint3d) }, { pFlagList, nbVertex * sizeof(Adesk::Int32) } };
+	push(REVOLVE, parts, _countof(parts));
+}
+
+void QueueSink::addExtrusion(const AcGeVector3d &height, Adesk::UInt32 nbVertex, const AcGePoint3d *pVertexList,
+	const Adesk::Int32 *pFlagList, Adesk::UInt32 nbLoop, const Adesk::Int32 *pLoopList, int color)
+{
+	double values[] = { height.x, height.y, height.z, color };
+	Adesk::UInt32 counts[] = { nbVertex, nbLoop };
+	Part parts[] = { { values, sizeof(values) }, { counts, sizeof(counts) },
+		{ pVertexList, nbVertex * sizeof(AcGePoint3d) }, { pFlagList, nbVertex * sizeof(Adesk::Int32) },
+		{ pLoopList, nbLoop * sizeof(Adesk::Int32) } };
+	push(EXTRUSION, parts, _countof(parts));
+}
+
+void QueueSink::beginCombineGeometry(int color)
+{
+	double values[] = { color };
+	push(COMBINE_GEOMETRY, values, _countof(values));
+}
+
+void QueueSink::addMesh(Adesk::UInt32 rows, Adesk::UInt32 columns, const AcGePoint3d *pVertexList)
+{
+	Adesk::UInt32 counts[] = { rows, columns };
+	Part parts[] = { { counts, sizeof(counts) }, { pVertexList, rows * columns * sizeof(AcGePoint3d) } };
+	push(MESH, parts, _countof(parts));
+}
+
+void QueueSink::addShell(Adesk::UInt32 nbVertex, const AcGePoint3d *pVertexList,
+	Adesk::UInt32 faceListSize, const Adesk::Int32 *pFaceList)
+{
+	Adesk::UInt32 counts[] = { nbVertex, faceListSize };
+	Part parts[] = { { counts, sizeof(counts) }, { pVertexList, nbVertex * sizeof(AcGePoint3d) },
+		{ pFaceList, faceListSize * sizeof(Adesk::Int32) } };
+	push(SHELL, parts, _countof(parts));
+}
+
+void QueueSink::addPolygon(Adesk::UInt32 nbPoints, const AcGePoint3d *pVertexList)
+{
+	Adesk::UInt32 counts[] = { nbPoints, 0 };
+	Part parts[] = { { counts, sizeof(counts) }, { pVertexList, nbPoints * sizeof(AcGePoint3d) } };
+	push(POLYGON, parts, _countof(parts));
+}
+
+void QueueSink::endCombineGeometry()
+{
+	push(END_COMBINE_GEOMETRY);
+}
+
+// the worker is idle while next opens the definition, the rows pushed
+// after it belong to it
+long long QueueSink::beginBlockDefinition(Adesk::UInt64 handle)
+{
+	drain();
+	return m_pNext->beginBlockDefinition(handle);
+}
+
+void QueueSink::endBlockDefinition()
+{
+	push(END_BLOCK_DEFINITION);
+}
+
+void QueueSink::addBlockReference(long long definitionId, const AcGeMatrix3d &transform)
+{
+	double values[17] = { (double)definitionId };
+	for (int r = 0; r < 4; ++r)
+	{
+		for (int c = 0; c < 4; ++c)
+			values[1 + r * 4 + c] = transform(r, c);
+	}
+	push(BLOCK_REFERENCE, values, _countof(values));
+}
+
+double QueueSink::getWaitSeconds() const
+{
+	return m_pRing->waitSeconds;
+}
+
+void QueueSink::push(Method method, const Part *parts, unsigned int numParts)
+{
+	Ring &ring = *m_pRing;
+	size_t size = 0;
+	for (unsigned int i = 0; i < numParts; ++i)
+		size += parts[i].size;
+	size_t total = sizeof(RecordHeader) + Align(size);
+
+	char *payload = NULL;
+	unsigned long long head = ring.head.load(std::memory_order_relaxed);
+	if (total > ring.capacity / 2)
+	{
+		// replayed here once the worker caught up
+		drain();
+		ring.large.resize(Align(size) / sizeof(Adesk::UInt64) + 1);
+		payload = reinterpret_cast<char*>(&ring.large[0]);
+	}
+	else
+	{
+		// a record does not wrap around the end of the ring
+		size_t offset = static_cast<size_t>(head % ring.capacity);
+		size_t skip = offset + total > ring.capacity ? ring.capacity - offset : 0;
+		if (ring.capacity - (head - ring.tail.load(std::memory_order_acquire)) < skip + total)
+		{
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			Backoff backoff;
+			while (ring.capacity - (head - ring.tail.load(std::memory_order_acquire)) < skip + total)
+				backoff.wait();
+			ring.waitSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		}
+		if (skip != 0)
+		{
+			RecordHeader *wrap = reinterpret_cast<RecordHeader*>(ring.at(head));
+			wrap->method = WRAP;
+			wrap->size = 0;
+			head += skip;
+		}
+		RecordHeader *header = reinterpret_cast<RecordHeader*>(ring.at(head));
+		header->method = method;
+		header->size = static_cast<Adesk::UInt32>(size);
+		payload = reinterpret_cast<char*>(header + 1);
+	}
+
+	for (unsigned int i = 0; i < numParts; ++i)
+	{
+		if (parts[i].size > 0)
+			memcpy(payload, parts[i].data, parts[i].size);
+		payload += parts[i].size;
+	}
+
+	if (total > ring.capacity / 2)
+		replay(method, &ring.large[0]);
+	else
+		ring.head.store(head + total, std::memory_order_release);
+}
+
+void QueueSink::push(Method method, const double *values, size_t numValues)
+{
+	Part parts[] = { { values, numValues * sizeof(double) } };
+	push(method, parts, _countof(parts));
+}
+
+void QueueSink::drain() const
+{
+	Ring &ring = *m_pRing;
+	Backoff backoff;
+	while (ring.tail.load(std::memory_order_acquire) != ring.head.load(std::memory_order_relaxed))
+		backoff.wait();
+}
+
+void QueueSink::stop()
+{
+	if (!m_pRing->worker.joinable())
+		return;
+	push(FINISH);
+	m_pRing->worker.join();
+}
+
+void QueueSink::run()
+{
+	Ring &ring = *m_pRing;
+	unsigned long long tail = ring.tail.load(std::memory_order_relaxed);
+	for (;;)
+	{
+		Backoff backoff;
+		while (ring.head.load(std::memory_order_acquire) == tail)
+			backoff.wait();
+
+		const RecordHeader *header = reinterpret_cast<const RecordHeader*>(ring.at(tail));
+		if (header->method == WRAP)
+		{
+			tail += ring.capacity - tail % ring.capacity;
+		}
+		else
+		{
+			Method method = static_cast<Method>(header->method);
+			if (method != FINISH)
+				replay(method, header + 1);
+			tail += sizeof(RecordHeader) + Align(header->size);
+			if (method == FINISH)
+			{
+				ring.tail.store(tail, std::memory_order_release);
+				return;
+			}
+		}
+		ring.tail.store(tail, std::memory_order_release);
+	}
+}
+
+void QueueSink::replay(Method method, const void *payload)
+{
+	const double *v = static_cast<const double*>(payload);
+	const Adesk::UInt32 *counts = static_cast<const Adesk::UInt32*>(payload);
+	const AcGePoint3d *pVertexList = reinterpret_cast<const AcGePoint3d*>(counts + 2);
+	switch (method)
+	{
+	case BOX:
+		m_pNext->addBox(Pnt(v), Vec(v + 3), Vec(v + 6), Vec(v + 9), (int)v[12]);
+		break;
+	case CIRCULAR_TORUS:
+		m_pNext->addCircularTorus(Pnt(v), Pnt(v + 3), Vec(v + 6), v[9], v[10], v[11], (int)v[12]);
+		break;
+	case CONE:
+		m_pNext->addCone(Pnt(v), Vec(v + 3), Vec(v + 6), v[9], (int)v[10]);
+		break;
+	case CYLINDER:
+		m_pNext->addCylinder(Pnt(v), Vec(v + 3), v[6], (int)v[7]);
+		break;
+	case ELLIPSOID:
+		m_pNext->addEllipsoid(Pnt(v), Vec(v + 3), v[6], v[7], (int)v[8]);
+		break;
+	case PRISM:
+		m_pNext->addPrism(Pnt(v), Vec(v + 3), Pnt(v + 6), (int)v[9], (int)v[10]);
+		break;
+	case PYRAMID:
+		m_pNext->addPyramid(Pnt(v), Vec(v + 3), Vec(v + 6), Vec(v + 9), v[12], v[13], v[14], v[15], (int)v[16]);
+		break;
+	case RECT_CIRC:
+		m_pNext->addRectCirc(Pnt(v), Vec(v + 3), v[6], Vec(v + 7), Vec(v + 10), v[13], (int)v[14]);
+		break;
+	case RECTANGULAR_TORUS:
+		m_pNext->addRectangularTorus(Pnt(v), Pnt(v + 3), Vec(v + 6), v[9], v[10], v[11], v[12], v[13], (int)v[14]);
+		break;
+	case SADDLE:
+		m_pNext->addSaddle(Pnt(v), Vec(v + 3), v[6], Vec(v + 7), v[10], (int)v[11]);
+		break;
+	case SCYLINDER:
+		m_pNext->addSCylinder(Pnt(v), Vec(v + 3), Vec(v + 6), v[9], (int)v[10]);
+		break;
+	case SNOUT:
+		m_pNext->addSnout(Pnt(v), Vec(v + 3), Vec(v + 6), v[9], v[10], (int)v[11]);
+		break;
+	case SPHERE:
+		m_pNext->addSphere(Pnt(v), Vec(v + 3), v[6], v[7], (int)v[8]);
+		break;
+	case WEDGE:
+		m_pNext->addWedge(Pnt(v), Vec(v + 3), Vec(v + 6), Vec(v + 9), (int)v[12]);
+		break;
+	case REVOLVE:
+	{
+		// the values are followed by the counts, vertexs and flags
+		const Adesk::UInt32 *profile = reinterpret_cast<const Adesk::UInt32*>(v + 8);
+		const AcGePoint3d *pProfile = reinterpret_cast<const AcGePoint3d*>(profile + 2);
+		m_pNext->addRevolve(Pnt(v), Vec(v + 3), v[6], profile[0], pProfile,
+			reinterpret_cast<const Adesk::Int32*>(pProfile + profile[0]), (int)v[7]);
+		break;
+	}
+	case EXTRUSION:
+	{
+		const Adesk::UInt32 *profile = reinterpret_cast<const Adesk::UInt32*>(v + 4);
+		const AcGePoint3d *pProfile = reinterpret_cast<const AcGePoint3d*>(profile + 2);
+		const Adesk::Int32 *pFlagList = reinterpret_cast<const Adesk::Int32*>(pProfile + profile[0]);
+		m_pNext->addExtrusion(Vec(v), profile[0], pProfile, pFlagList, profile[1], pFlagList + profile[0], (int)v[3]);
+		break;
+	}
+	case BEGIN_ENTITY:
+		m_pNext->beginEntity(*static_cast<const Adesk::UInt64*>(payload));
+		break;
+	case END_ENTITY:
+		m_pNext->endEntity(*static_cast<const Adesk::UInt64*>(payload));
+		break;
+	case COMBINE_GEOMETRY:
+		m_pNext->beginCombineGeometry((int)v[0]);
+		break;
+	case MESH:
+		m_pNext->addMesh(counts[0], counts[1], pVertexList);
+		break;
+	case SHELL:
+		m_pNext->addShell(counts[0], pVertexList, counts[1], reinterpret_cast<const Adesk::Int32*>(pVertexList + counts[0]));
+		break;
+	case POLYGON:
+		m_pNext->addPolygon(counts[0], pVertexList);
+		break;
+	case END_COMBINE_GEOMETRY:
+		m_pNext->endCombineGeometry();
+		break;
+	case END_BLOCK_DEFINITION:
+		m_pNext->endBlockDefinition();
+		break;
+	case BLOCK_REFERENCE:
+	{
+		AcGeMatrix3d transform;
+		for (int r = 0; r < 4; ++r)
+		{
+			for (int c = 0; c < 4; ++c)
+				transform.entry[r][c] = v[1 + r * 4 + c];
+		}
+		m_pNext->addBlockReference((long long)v[0], transform);
+		break;
+	}
+	default:
+		break;
+	}
+}
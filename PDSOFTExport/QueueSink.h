@@ -0,0 +1,118 @@
+#pragma once
+#include <cstddef>
+#include "ExportSink.h"
+
+// Passes everything added to it on to next on a worker thread, so the
+// AutoCAD thread only opens and captures entities while the rows are packed
+// and written. The calls are copied into a lock-free single producer, single
+// consumer ring and replayed in order; the producer waits when the ring is
+// full. begin(), commit() and rollback() run on the calling thread with the
+// worker stopped. beginBlockDefinition(), hasEntity() and getNumRows() wait
+// for the ring to drain and then call next directly, their results are
+// needed at once; isIncremental() does not change after begin() and is
+// answered by next without waiting. A call too big for the ring is also made
+// directly once the ring is drained.
+//
+// The threads live in QueueSink.cpp, which is compiled native: <thread> and
+// <atomic> are not available to the /clr files including this header.
+class QueueSink : public ExportSink
+{
+public:
+	explicit QueueSink(ExportSink &next, size_t capacity = 16 * 1024 * 1024);
+	virtual ~QueueSink();
+
+	virtual bool begin();
+	virtual bool commit();
+	virtual void rollback();
+
+	virtual unsigned long long getNumRows() const;
+
+	virtual bool isIncremental() const;
+	virtual bool hasEntity(Adesk::UInt64 handle, Adesk::UInt64 hash);
+	virtual void beginEntity(Adesk::UInt64 handle);
+	virtual void endEntity(Adesk::UInt64 hash);
+
+	virtual void addBox(const AcGePoint3d &org, const AcGeVector3d &xLen, const AcGeVector3d &yLen,
+		const AcGeVector3d &zLen, int color);
+	virtual void addCircularTorus(const AcGePoint3d &center, const AcGePoint3d &startPnt, const AcGeVector3d &normal,
+		double startRadius, double endRadius, double angle, int color);
+	virtual void addCone(const AcGePoint3d &org, const AcGeVector3d &height, const AcGeVector3d &offset,
+		double radius, int color);
+	virtual void addCylinder(const AcGePoint3d &org, const AcGeVector3d &height, double radius, int color);
+	virtual void addEllipsoid(const AcGePoint3d &center, const AcGeVector3d &aLen, double bRadius, double angle,
+		int color);
+	virtual void addPrism(const AcGePoint3d &org, const AcGeVector3d &height, const AcGePoint3d &bottomStartPnt,
+		int edgeNum, int color);
+	virtual void addPyramid(const AcGePoint3d &org, const AcGeVector3d &height, const AcGeVector3d &xAxis,
+		const AcGeVector3d &offset, double bottomXLen, double bottomYLen, double topXLen, double topYLen, int color);
+	virtual void addRectCirc(const AcGePoint3d &rectCenter, const AcGeVector3d &xLen, double yLen,
+		const AcGeVector3d &height, const AcGeVector3d &offset, double radius, int color);
+	virtual void addRectangularTorus(const AcGePoint3d &center, const AcGePoint3d &startPnt, const AcGeVector3d &normal,
+		double startWidth, double startHeight, double endWidth, double endHeight, double angle, int color);
+	virtual void addSaddle(const AcGePoint3d &org, const AcGeVector3d &xLen, double yLen, const AcGeVector3d &zLen,
+		double radius, int color);
+	virtual void addSCylinder(const AcGePoint3d &org, const AcGeVector3d &height, const AcGeVector3d &bottomNormal,
+		double radius, int color);
+	virtual void addSnout(const AcGePoint3d &org, const AcGeVector3d &height, const AcGeVector3d &offset,
+		double bottomRadius, double topRadius, int color);
+	virtual void addSphere(const AcGePoint3d &center, const AcGeVector3d &bottomNormal, double radius, double angle,
+		int color);
+	virtual void addWedge(const AcGePoint3d &org, const AcGeVector3d &edge1, const AcGeVector3d &edge2,
+		const AcGeVector3d &height, int color);
+
+	virtual bool acceptsProfiles() const;
+	virtual void addRevolve(const AcGePoint3d &axisPnt, const AcGeVector3d &axis, double angle,
+		Adesk::UInt32 nbVertex, const AcGePoint3d *pVertexList, const Adesk::Int32 *pFlagList, int color);
+	virtual void addExtrusion(const AcGeVector3d &height, Adesk::UInt32 nbVertex, const AcGePoint3d *pVertexList,
+		const Adesk::Int32 *pFlagList, Adesk::UInt32 nbLoop, const Adesk::Int32 *pLoopList, int color);
+
+	virtual void beginCombineGeometry(int color);
+	virtual void addMesh(Adesk::UInt32 rows, Adesk::UInt32 columns, const AcGePoint3d *pVertexList);
+	virtual void addShell(Adesk::UInt32 nbVertex, const AcGePoint3d *pVertexList,
+		Adesk::UInt32 faceListSize, const Adesk::Int32 *pFaceList);
+	virtual void addPolygon(Adesk::UInt32 nbPoints, const AcGePoint3d *pVertexList);
+	virtual void endCombineGeometry();
+
+	virtual long long beginBlockDefinition(Adesk::UInt64 handle);
+	virtual void endBlockDefinition();
+	virtual void addBlockReference(long long definitionId, const AcGeMatrix3d &transform);
+
+	// seconds the producer spent waiting for room in the ring
+	double getWaitSeconds() const;
+
+private:
+	enum Method
+	{
+		BOX, CIRCULAR_TORUS, CONE, CYLINDER, ELLIPSOID, PRISM, PYRAMID, RECT_CIRC, RECTANGULAR_TORUS,
+		SADDLE, SCYLINDER, SNOUT, SPHERE, WEDGE, REVOLVE, EXTRUSION,
+		BEGIN_ENTITY, END_ENTITY, COMBINE_GEOMETRY, MESH, SHELL, POLYGON, END_COMBINE_GEOMETRY,
+		END_BLOCK_DEFINITION, BLOCK_REFERENCE,
+		// the rest of the ring is unused, the next record is at its start
+		WRAP,
+		// the worker stops
+		FINISH
+	};
+
+	struct Part
+	{
+		const void *data;
+		size_t size;
+	};
+
+	struct Ring;
+
+	QueueSink(const QueueSink&);
+	QueueSink &operator=(const QueueSink&);
+
+	void push(Method method, const Part *parts = NULL, unsigned int numParts = 0);
+	void push(Method method, const double *values, size_t numValues);
+	// waits until the worker replayed everything pushed
+	void drain() const;
+	void stop();
+	void run();
+	void replay(Method method, const void *payload);
+
+private:
+	ExportSink *m_pNext;
+	Ring *m_pRing;
+};
@@ -0,0 +1,820 @@
+#include "SqliteSink.h"
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "sqlite3.h"
+
+const SqliteSink::TableDef SqliteSink::TABLES[NUM_TABLES] =
+{
+	{ "box", "org_xyz, xlen_xyz, ylen_xyz, zlen_xyz, color, handle, block_id" },
+	{ "circular_torus", "center_xyz, start_pnt_xyz, normal_xyz, start_radius, end_radius, angle, color, handle, block_id" },
+	{ "cone", "org_xyz, height_xyz, offset_xyz, radius, color, handle, block_id" },
+	{ "cylinder", "org_xyz, height_xyz, radius, color, handle, block_id" },
+	{ "ellipsoid", "center_xyz, a_len_xyz, b_radius, angle, color, handle, block_id" },
+	{ "prism", "org_xyz, height_xyz, bottom_start_pnt_xyz, edge_num, color, handle, block_id" },
+	{ "pyramid", "org_xyz, height_xyz, xaxis_xyz, offset_xyz, bottom_xlen, bottom_ylen, top_xlen, top_ylen, color, handle, block_id" },
+	{ "rect_circ", "rect_center_xyz, xlen_xyz, ylen, height_xyz, offset_xyz, radius, color, handle, block_id" },
+	{ "rectangular_torus", "center_xyz, start_pnt_xyz, normal_xyz, start_width, start_height, end_width, end_height, angle, color, handle, block_id" },
+	{ "saddle", "org_xyz, xlen_xyz, ylen, zlen_xyz, radius, color, handle, block_id" },
+	{ "scylinder", "org_xyz, height_xyz, bottom_normal_xyz, radius, color, handle, block_id" },
+	{ "snout", "org_xyz, height_xyz, offset_xyz, bottom_radius, top_radius, color, handle, block_id" },
+	{ "sphere", "center_xyz, bottom_normal_xyz, radius, angle, color, handle, block_id" },
+	{ "wedge", "org_xyz, edge1_xyz, edge2_xyz, height_xyz, color, handle, block_id" },
+	{ "revolve", "axis_pnt_xyz, axis_xyz, angle, color, vertexs, flags, handle, block_id" },
+	{ "extrusion", "height_xyz, color, vertexs, flags, loops, handle, block_id" },
+	{ "combine_geometry", "color, shape_id, x_axis_xyz, y_axis_xyz, z_axis_xyz, origin_xyz, handle, block_id" },
+	{ "combine_shape", "hash" },
+	{ "mesh", "rows, columns, shape_id, vertexs" },
+	{ "shell", "shape_id, vertexs, faces" },
+	{ "polygon", "shape_id, vertexs" },
+	{ "block_reference", "definition_id, x_axis_xyz, y_axis_xyz, z_axis_xyz, origin_xyz, handle, block_id" },
+};
+
+namespace
+{
+
+// v1 tables replaced by the blob columns, dropped when a v1 database is
+// written again
+const char *OLD_TABLES[] = { "mesh_vertex", "shell_face", "shell_vertex", "polygon_vertex" };
+
+// canonical vertexs of combine geometries closer than this, in drawing
+// units, make the same shape
+const double SHAPE_TOLERANCE = 1.0e-3;
+
+} // namespace
+
+namespace
+{
+
+bool EndsWith(const std::string &str, const char *suffix)
+{
+	size_t len = strlen(suffix);
+	return str.size() >= len && str.compare(str.size() - len, len, suffix) == 0;
+}
+
+// splits "org_xyz, radius" into org_x, org_y, org_z, radius
+std::vector<std::string> ExpandColumns(const char *columns)
+{
+	std::vector<std::string> result;
+	std::string column;
+	for (const char *p = columns;; ++p)
+	{
+		if (*p == ',' || *p == '\0')
+		{
+			if (EndsWith(column, "_xyz"))
+			{
+				column.resize(column.size() - 3);
+				result.push_back(column + "x");
+				result.push_back(column + "y");
+				result.push_back(column + "z");
+			}
+			else
+				result.push_back(column);
+			column.clear();
+			if (*p == '\0')
+				break;
+		}
+		else if (*p != ' ')
+			column += *p;
+	}
+	return result;
+}
+
+bool IsIntegerColumn(const std::string &column)
+{
+	return column == "color" || column == "edge_num" || column == "rows" || column == "columns"
+		|| column == "handle" || EndsWith(column, "_id");
+}
+
+bool IsBlobColumn(const std::string &column)
+{
+	// the 64 bit hash does not fit the doubles the other columns are bound from
+	return column == "vertexs" || column == "faces" || column == "flags" || column == "loops" || column == "hash";
+}
+
+} // namespace
+
+SqliteSink::SqliteSink(const std::wstring &dbPath, bool incremental)
+	: m_dbPath(dbPath)
+	, m_incremental(incremental)
+	, m_db(NULL)
+	, m_pEntityInsert(NULL)
+	, m_pEntityDelete(NULL)
+	, m_pDefinitionInsert(NULL)
+	, m_keepRows(false)
+	, m_revision(0)
+	, m_handle(0)
+	, m_numKept(0)
+	, m_numErased(0)
+	, m_combineColor(0)
+	, m_numCombineGeometries(0)
+	, m_numCombineShapes(0)
+	, m_lastBlockId(0)
+	, m_numRows(0)
+	, m_failed(false)
+{
+	for (int i = 0; i < NUM_TABLES; ++i)
+	{
+		m_inserts[i].pStmt = NULL;
+		m_inserts[i].pDelete = NULL;
+	}
+}
+
+SqliteSink::~SqliteSink()
+{
+	finalize();
+}
+
+bool SqliteSink::begin()
+{
+	finalize();
+	m_numRows = 0;
+	m_lastBlockId = 0;
+	m_blockIds.clear();
+	m_entities.clear();
+	m_definitions.clear();
+	m_shapes.clear();
+	m_handle = 0;
+	m_numKept = 0;
+	m_numErased = 0;
+	m_numCombineGeometries = 0;
+	m_numCombineShapes = 0;
+	for (int i = 0; i < NUM_TABLES; ++i)
+		m_changed[i] = false;
+	m_failed = false;
+	m_errorMessage.clear();
+
+	if (sqlite3_open16(m_dbPath.c_str(), &m_db) != SQLITE_OK)
+		return fail();
+
+	// a database of an older schema is written again from scratch
+	m_keepRows = m_incremental && queryInt("select max(version) from schema_version", 0) == SCHEMA_VERSION;
+
+	// the rollback journal stays on disk so that a crash in the middle of an
+	// export leaves the previous one; syncing only at the commit is enough
+	// for that
+	if (!exec("PRAGMA synchronous = NORMAL"))
+		return false;
+	if (!exec("begin transaction"))
+		return false;
+
+	// kept by full exports too, so the revisions only grow
+	if (!exec("create table if not exists table_revision (name text primary key, revision integer)"))
+		return false;
+	m_revision = queryInt("select max(revision) from table_revision", 0) + 1;
+
+	if (!m_keepRows && !createTables())
+		return false;
+	for (int i = 0; i < NUM_TABLES; ++i)
+	{
+		if (!prepareTable((Table)i, !m_keepRows))
+			return false;
+	}
+	if (!prepare("insert or replace into entity (handle, hash) values (?, ?)", m_pEntityInsert)
+		|| !prepare("delete from entity where handle = ?", m_pEntityDelete)
+		|| !prepare("insert into block_definition (id, handle) values (?, ?)", m_pDefinitionInsert))
+		return false;
+	return !m_keepRows || loadEntities();
+}
+
+bool SqliteSink::commit()
+{
+	if (m_failed || (m_keepRows && (!deleteErased() || !deleteUnusedShapes())) || !createIndexes() || !writeRevisions()
+		|| !exec("commit transaction"))
+	{
+		rollback();
+		return false;
+	}
+
+	finalize();
+	return true;
+}
+
+void SqliteSink::rollback()
+{
+	if (m_db != NULL && !sqlite3_get_autocommit(m_db))
+		sqlite3_exec(m_db, "rollback transaction", NULL, NULL, NULL);
+	finalize();
+}
+
+bool SqliteSink::isIncremental() const
+{
+	return m_keepRows;
+}
+
+bool SqliteSink::hasEntity(Adesk::UInt64 handle, Adesk::UInt64 hash)
+{
+	if (!m_keepRows)
+		return false;
+
+	EntityMap::iterator iter = m_entities.find(handle);
+	if (iter == m_entities.end() || iter->second.hash != hash)
+		return false;
+	iter->second.seen = true;
+	++m_numKept;
+	return true;
+}
+
+void SqliteSink::beginEntity(Adesk::UInt64 handle)
+{
+	m_handle = handle;
+	if (!m_keepRows || m_failed)
+		return;
+
+	// changed since the last export, its rows are written again
+	EntityMap::iterator iter = m_entities.find(handle);
+	if (iter != m_entities.end())
+	{
+		iter->second.seen = true;
+		deleteRows(handle);
+	}
+}
+
+void SqliteSink::endEntity(Adesk::UInt64 hash)
+{
+	if (!m_failed)
+	{
+		sqlite3_bind_int64(m_pEntityInsert, 1, (sqlite3_int64)m_handle);
+		sqlite3_bind_int64(m_pEntityInsert, 2, (sqlite3_int64)hash);
+		int rc = sqlite3_step(m_pEntityInsert);
+		sqlite3_reset(m_pEntityInsert);
+		if (rc != SQLITE_DONE)
+			fail();
+	}
+	m_handle = 0;
+}
+
+void SqliteSink::addBox(const AcGePoint3d &org, const AcGeVector3d &xLen, const AcGeVector3d &yLen,
+	const AcGeVector3d &zLen, int color)
+{
+	double values[] = { org.x, org.y, org.z, xLen.x, xLen.y, xLen.z, yLen.x, yLen.y, yLen.z,
+		zLen.x, zLen.y, zLen.z, color };
+	insert(BOX, values, _countof(values));
+}
+
+void SqliteSink::addCircularTorus(const AcGePoint3d &center, const AcGePoint3d &startPnt, const AcGeVector3d &normal,
+	double startRadius, double endRadius, double angle, int color)
+{
+	double values[] = { center.x, center.y, center.z, startPnt.x, startPnt.y, startPnt.z,
+		normal.x, normal.y, normal.z, startRadius, endRadius, angle, color };
+	insert(CIRCULAR_TORUS, values, _countof(values));
+}
+
+void SqliteSink::addCone(const AcGePoint3d &org, const AcGeVector3d &height, const AcGeVector3d &offset,
+	double radius, int color)
+{
+	double values[] = { org.x, org.y, org.z, height.x, height.y, height.z, offset.x, offset.y, offset.z,
+		radius, color };
+	insert(CONE, values, _countof(values));
+}
+
+void SqliteSink::addCylinder(const AcGePoint3d &org, const AcGeVector3d &height, double radius, int color)
+{
+	double values[] = { org.x, org.y, org.z, height.x, height.y, height.z, radius, color };
+	insert(CYLINDER, values, _countof(values));
+}
+
+void SqliteSink::addEllipsoid(const AcGePoint3d &center, const AcGeVector3d &aLen, double bRadius, double angle,
+	int color)
+{
+	double values[] = { center.x, center.y, center.z, aLen.x, aLen.y, aLen.z, bRadius, angle, color };
+	insert(ELLIPSOID, values, _countof(values));
+}
+
+void SqliteSink::addPrism(const AcGePoint3d &org, const AcGeVector3d &height, const AcGePoint3d &bottomStartPnt,
+	int edgeNum, int color)
+{
+	double values[] = { org.x, org.y, org.z, height.x, height.y, height.z,
+		bottomStartPnt.x, bottomStartPnt.y, bottomStartPnt.z, edgeNum, color };
+	insert(PRISM, values, _countof(values));
+}
+
+void SqliteSink::addPyramid(const AcGePoint3d &org, const AcGeVector3d &height, const AcGeVector3d &xAxis,
+	const AcGeVector3d &offset, double bottomXLen, double bottomYLen, double topXLen, double topYLen, int color)
+{
+	double values[] = { org.x, org.y, org.z, height.x, height.y, height.z, xAxis.x, xAxis.y, xAxis.z,
+		offset.x, offset.y, offset.z, bottomXLen, bottomYLen, topXLen, topYLen, color };
+	insert(PYRAMID, values, _countof(values));
+}
+
+void SqliteSink::addRectCirc(const AcGePoint3d &rectCenter, const AcGeVector3d &xLen, double yLen,
+	const AcGeVector3d &height, const AcGeVector3d &offset, double radius, int color)
+{
+	double values[] = { rectCenter.x, rectCenter.y, rectCenter.z, xLen.x, xLen.y, xLen.z, yLen,
+		height.x, height.y, height.z, offset.x, offset.y, offset.z, radius, color };
+	insert(RECT_CIRC, values, _countof(values));
+}
+
+void SqliteSink::addRectangularTorus(const AcGePoint3d &center, const AcGePoint3d &startPnt, const AcGeVector3d &normal,
+	double startWidth, double startHeight, double endWidth, double endHeight, double angle, int color)
+{
+	double values[] = { center.x, center.y, center.z, startPnt.x, startPnt.y, startPnt.z,
+		normal.x, normal.y, normal.z, startWidth, startHeight, endWidth, endHeight, angle, color };
+	insert(RECTANGULAR_TORUS, values, _countof(values));
+}
+
+void SqliteSink::addSaddle(const AcGePoint3d &org, const AcGeVector3d &xLen, double yLen, const AcGeVector3d &zLen,
+	double radius, int color)
+{
+	double values[] = { org.x, org.y, org.z, xLen.x, xLen.y, xLen.z, yLen, zLen.x, zLen.y, zLen.z, radius, color };
+	insert(SADDLE, values, _countof(values));
+}
+
+void SqliteSink::addSCylinder(const AcGePoint3d &org, const AcGeVector3d &height, const AcGeVector3d &bottomNormal,
+	double radius, int color)
+{
+	double values[] = { org.x, org.y, org.z, height.x, height.y, height.z,
+		bottomNormal.x, bottomNormal.y, bottomNormal.z, radius, color };
+	insert(SCYLINDER, values, _countof(values));
+}
+
+void SqliteSink::addSnout(const AcGePoint3d &org, const AcGeVector3d &height, const AcGeVector3d &offset,
+	double bottomRadius, double topRadius, int color)
+{
+	double values[] = { org.x, org.y, org.z, height.x, height.y, height.z, offset.x, offset.y, offset.z,
+		bottomRadius, topRadius, color };
+	insert(SNOUT, values, _countof(values));
+}
+
+void SqliteSink::addSphere(const AcGePoint3d &center, const AcGeVector3d &bottomNormal, double radius, double angle,
+	int color)
+{
+	double values[] = { center.x, center.y, center.z, bottomNormal.x, bottomNormal.y, bottomNormal.z,
+		radius, angle, color };
+	insert(SPHERE, values, _countof(values));
+}
+
+void SqliteSink::addWedge(const AcGePoint3d &org, const AcGeVector3d &edge1, const AcGeVector3d &edge2,
+	const AcGeVector3d &height, int color)
+{
+	double values[] = { org.x, org.y, org.z, edge1.x, edge1.y, edge1.z, edge2.x, edge2.y, edge2.z,
+		height.x, height.y, height.z, color };
+	insert(WEDGE, values, _countof(values));
+}
+
+bool SqliteSink::acceptsProfiles() const
+{
+	return true;
+}
+
+void SqliteSink::addRevolve(const AcGePoint3d &axisPnt, const AcGeVector3d &axis, double angle,
+	Adesk::UInt32 nbVertex, const AcGePoint3d *pVertexList, const Adesk::Int32 *pFlagList, int color)
+{
+	double values[] = { axisPnt.x, axisPnt.y, axisPnt.z, axis.x, axis.y, axis.z, angle, color };
+	Blob flags = { pFlagList, static_cast<int>(nbVertex * sizeof(Adesk::Int32)) };
+	Blob blobs[] = { packVertexs(pVertexList, nbVertex), flags };
+	insert(REVOLVE, values, _countof(values), blobs, _countof(blobs));
+}
+
+void SqliteSink::addExtrusion(const AcGeVector3d &height, Adesk::UInt32 nbVertex, const AcGePoint3d *pVertexList,
+	const Adesk::Int32 *pFlagList, Adesk::UInt32 nbLoop, const Adesk::Int32 *pLoopList, int color)
+{
+	double values[] = { height.x, height.y, height.z, color };
+	Blob flags = { pFlagList, static_cast<int>(nbVertex * sizeof(Adesk::Int32)) };
+	Blob loops = { pLoopList, static_cast<int>(nbLoop * sizeof(Adesk::Int32)) };
+	Blob blobs[] = { packVertexs(pVertexList, nbVertex), flags, loops };
+	insert(EXTRUSION, values, _countof(values), blobs, _countof(blobs));
+}
+
+// the parts are kept until the end, the geometry is written as its shape
+void SqliteSink::beginCombineGeometry(int color)
+{
+	m_combineColor = color;
+	m_shape.clear();
+}
+
+void SqliteSink::addMesh(Adesk::UInt32 rows, Adesk::UInt32 columns, const AcGePoint3d *pVertexList)
+{
+	m_shape.addMesh(rows, columns, pVertexList);
+}
+
+void SqliteSink::addShell(Adesk::UInt32 nbVertex, const AcGePoint3d *pVertexList,
+	Adesk::UInt32 faceListSize, const Adesk::Int32 *pFaceList)
+{
+	m_shape.addShell(nbVertex, pVertexList, faceListSize, pFaceList);
+}
+
+void SqliteSink::addPolygon(Adesk::UInt32 nbPoints, const AcGePoint3d *pVertexList)
+{
+	m_shape.addPolygon(nbPoints, pVertexList);
+}
+
+// nothing is written for a geometry without parts
+void SqliteSink::endCombineGeometry()
+{
+	if (m_shape.isEmpty())
+		return;
+
+	m_shape.canonicalize(SHAPE_TOLERANCE);
+	ShapeMap::iterator iter = m_shapes.find(m_shape.getHash());
+	if (iter == m_shapes.end())
+		iter = m_shapes.insert(std::make_pair(m_shape.getHash(), insertShape())).first;
+
+	const AcGeVector3d &xAxis = m_shape.getXAxis();
+	const AcGeVector3d &yAxis = m_shape.getYAxis();
+	const AcGeVector3d &zAxis = m_shape.getZAxis();
+	const AcGePoint3d &origin = m_shape.getOrigin();
+	double values[] = { m_combineColor, (double)iter->second, xAxis.x, xAxis.y, xAxis.z, yAxis.x, yAxis.y, yAxis.z,
+		zAxis.x, zAxis.y, zAxis.z, origin.x, origin.y, origin.z };
+	insert(COMBINE_GEOMETRY, values, _countof(values));
+	++m_numCombineGeometries;
+	m_shape.clear();
+}
+
+long long SqliteSink::beginBlockDefinition(Adesk::UInt64 handle)
+{
+	DefinitionMap::iterator iter = m_definitions.find(handle);
+	if (iter == m_definitions.end())
+	{
+		Definition definition = { ++m_lastBlockId, false };
+		iter = m_definitions.insert(std::make_pair(handle, definition)).first;
+		if (!m_failed)
+		{
+			sqlite3_bind_int64(m_pDefinitionInsert, 1, definition.id);
+			sqlite3_bind_int64(m_pDefinitionInsert, 2, (sqlite3_int64)handle);
+			int rc = sqlite3_step(m_pDefinitionInsert);
+			sqlite3_reset(m_pDefinitionInsert);
+			if (rc != SQLITE_DONE)
+				fail();
+		}
+	}
+	iter->second.seen = true;
+	m_blockIds.push_back(iter->second.id);
+	return iter->second.id;
+}
+
+void SqliteSink::endBlockDefinition()
+{
+	m_blockIds.pop_back();
+}
+
+void SqliteSink::addBlockReference(long long definitionId, const AcGeMatrix3d &transform)
+{
+	AcGePoint3d origin;
+	AcGeVector3d xAxis, yAxis, zAxis;
+	transform.getCoordSystem(origin, xAxis, yAxis, zAxis);
+	double values[] = { (double)definitionId, xAxis.x, xAxis.y, xAxis.z, yAxis.x, yAxis.y, yAxis.z,
+		zAxis.x, zAxis.y, zAxis.z, origin.x, origin.y, origin.z };
+	insert(BLOCK_REFERENCE, values, _countof(values));
+}
+
+bool SqliteSink::exec(const char *zSql)
+{
+	if (sqlite3_exec(m_db, zSql, NULL, NULL, NULL) != SQLITE_OK)
+		return fail();
+	return true;
+}
+
+bool SqliteSink::prepare(const char *zSql, sqlite3_stmt *&pStmt)
+{
+	if (sqlite3_prepare_v2(m_db, zSql, -1, &pStmt, NULL) != SQLITE_OK)
+		return fail();
+	return true;
+}
+
+long long SqliteSink::queryInt(const char *zSql, long long defaultValue)
+{
+	sqlite3_stmt *pStmt = NULL;
+	if (sqlite3_prepare_v2(m_db, zSql, -1, &pStmt, NULL) != SQLITE_OK)
+		return defaultValue;
+	long long value = defaultValue;
+	if (sqlite3_step(pStmt) == SQLITE_ROW && sqlite3_column_type(pStmt, 0) != SQLITE_NULL)
+		value = sqlite3_column_int64(pStmt, 0);
+	sqlite3_finalize(pStmt);
+	return value;
+}
+
+bool SqliteSink::createTables()
+{
+	for (int i = 0; i < _countof(OLD_TABLES); ++i)
+	{
+		if (!exec((std::string("drop table if exists ") + OLD_TABLES[i]).c_str()))
+			return false;
+	}
+	return exec("drop table if exists entity") && exec("create table entity (handle integer primary key, hash integer)")
+		&& exec("drop table if exists block_definition")
+		&& exec("create table block_definition (id integer primary key, handle integer)")
+		&& writeSchemaVersion();
+}
+
+// after the rows, a full export does not pay for them on every insert
+bool SqliteSink::createIndexes()
+{
+	for (int i = 0; i < NUM_TABLES; ++i)
+	{
+		if (!m_inserts[i].tracked)
+			continue;
+		const char *name = TABLES[i].name;
+		std::string create = std::string("create index if not exists ") + name + "_handle on " + name + " (handle)";
+		if (!exec(create.c_str()))
+			return false;
+	}
+	return true;
+}
+
+bool SqliteSink::prepareTable(Table table, bool create)
+{
+	const TableDef &def = TABLES[table];
+	std::vector<std::string> columns = ExpandColumns(def.columns);
+
+	std::string createSql = std::string("create table ") + def.name
+		+ " (id integer primary key autoincrement";
+	std::string insert = std::string("insert into ") + def.name + " (";
+	std::string params;
+	Insert &ins = m_inserts[table];
+	ins.types.clear();
+	ins.tracked = columns.size() >= 2 && columns[columns.size() - 2] == "handle" && columns.back() == "block_id";
+	for (size_t i = 0; i < columns.size(); ++i)
+	{
+		ColumnType type = IsBlobColumn(columns[i]) ? BLOB : IsIntegerColumn(columns[i]) ? INTEGER : REAL;
+		ins.types.push_back(type);
+		createSql += ", " + columns[i] + (type == BLOB ? " blob" : type == INTEGER ? " integer" : " double");
+		insert += (i == 0 ? "" : ", ") + columns[i];
+		params += (i == 0 ? "?" : ", ?");
+	}
+	createSql += ")";
+	insert += ") values (" + params + ")";
+
+	// shapes and their parts are shared, deleteUnusedShapes() removes them
+	std::string del;
+	if (ins.tracked)
+		del = std::string("delete from ") + def.name + " where handle = ?";
+
+	if (create && (!exec((std::string("drop table if exists ") + def.name).c_str()) || !exec(createSql.c_str())))
+		return false;
+	return prepare(insert.c_str(), ins.pStmt) && (del.empty() || prepare(del.c_str(), ins.pDelete));
+}
+
+bool SqliteSink::writeSchemaVersion()
+{
+	char sql[64];
+	sprintf_s(sql, "insert into schema_version (version) values (%d)", SCHEMA_VERSION);
+	return exec("drop table if exists schema_version") && exec("create table schema_version (version integer)")
+		&& exec(sql);
+}
+
+bool SqliteSink::loadEntities()
+{
+	sqlite3_stmt *pStmt = NULL;
+	if (!prepare("select handle, hash from entity", pStmt))
+		return false;
+	int rc;
+	while ((rc = sqlite3_step(pStmt)) == SQLITE_ROW)
+	{
+		// handle is the rowid, the rows come in ascending order
+		Entity entity = { (Adesk::UInt64)sqlite3_column_int64(pStmt, 1), false };
+		m_entities.insert(m_entities.end(), std::make_pair((Adesk::UInt64)sqlite3_column_int64(pStmt, 0), entity));
+	}
+	sqlite3_finalize(pStmt);
+	if (rc != SQLITE_DONE)
+		return fail();
+
+	if (!prepare("select id, handle from block_definition", pStmt))
+		return false;
+	while ((rc = sqlite3_step(pStmt)) == SQLITE_ROW)
+	{
+		Definition definition = { sqlite3_column_int64(pStmt, 0), false };
+		m_definitions[(Adesk::UInt64)sqlite3_column_int64(pStmt, 1)] = definition;
+		if (definition.id > m_lastBlockId)
+			m_lastBlockId = definition.id;
+	}
+	sqlite3_finalize(pStmt);
+	if (rc != SQLITE_DONE)
+		return fail();
+
+	if (!prepare("select id, hash from combine_shape", pStmt))
+		return false;
+	while ((rc = sqlite3_step(pStmt)) == SQLITE_ROW)
+	{
+		Adesk::UInt64 hash = 0;
+		if (sqlite3_column_bytes(pStmt, 1) == sizeof(hash))
+			memcpy(&hash, sqlite3_column_blob(pStmt, 1), sizeof(hash));
+		m_shapes[hash] = sqlite3_column_int64(pStmt, 0);
+	}
+	sqlite3_finalize(pStmt);
+	if (rc != SQLITE_DONE)
+		return fail();
+	return true;
+}
+
+bool SqliteSink::deleteRows(Adesk::UInt64 handle)
+{
+	for (int i = 0; i < NUM_TABLES; ++i)
+	{
+		sqlite3_stmt *pDelete = m_inserts[i].pDelete;
+		if (pDelete == NULL)
+			continue;
+		sqlite3_bind_int64(pDelete, 1, (sqlite3_int64)handle);
+		int rc = sqlite3_step(pDelete);
+		sqlite3_reset(pDelete);
+		if (rc != SQLITE_DONE)
+			return fail();
+		if (sqlite3_changes(m_db) > 0)
+			m_changed[i] = true;
+	}
+
+	sqlite3_bind_int64(m_pEntityDelete, 1, (sqlite3_int64)handle);
+	int rc = sqlite3_step(m_pEntityDelete);
+	sqlite3_reset(m_pEntityDelete);
+	if (rc != SQLITE_DONE)
+		return fail();
+	return true;
+}
+
+// entities and definitions not seen since begin() were erased from the drawing
+bool SqliteSink::deleteErased()
+{
+	for (EntityMap::const_iterator iter = m_entities.begin(); iter != m_entities.end(); ++iter)
+	{
+		if (iter->second.seen)
+			continue;
+		if (!deleteRows(iter->first))
+			return false;
+		++m_numErased;
+	}
+
+	sqlite3_stmt *pStmt = NULL;
+	if (!prepare("delete from block_definition where id = ?", pStmt))
+		return false;
+	int rc = SQLITE_DONE;
+	for (DefinitionMap::const_iterator iter = m_definitions.begin();
+		rc == SQLITE_DONE && iter != m_definitions.end(); ++iter)
+	{
+		if (iter->second.seen)
+			continue;
+		sqlite3_bind_int64(pStmt, 1, iter->second.id);
+		rc = sqlite3_step(pStmt);
+		sqlite3_reset(pStmt);
+	}
+	sqlite3_finalize(pStmt);
+	if (rc != SQLITE_DONE)
+		return fail();
+	return true;
+}
+
+bool SqliteSink::deleteUnusedShapes()
+{
+	if (!exec("delete from combine_shape where id not in (select shape_id from combine_geometry)"))
+		return false;
+	if (sqlite3_changes(m_db) == 0)
+		return true;
+	m_changed[COMBINE_SHAPE] = true;
+
+	const Table parts[] = { MESH, SHELL, POLYGON };
+	for (int i = 0; i < _countof(parts); ++i)
+	{
+		std::string del = std::string("delete from ") + TABLES[parts[i]].name
+			+ " where shape_id not in (select id from combine_shape)";
+		if (!exec(del.c_str()))
+			return false;
+		if (sqlite3_changes(m_db) > 0)
+			m_changed[parts[i]] = true;
+	}
+	return true;
+}
+
+long long SqliteSink::insertShape()
+{
+	Adesk::UInt64 hash = m_shape.getHash();
+	Blob hashBlob = { &hash, sizeof(hash) };
+	long long shapeId = insert(COMBINE_SHAPE, NULL, 0, &hashBlob, 1);
+	++m_numCombineShapes;
+
+	const std::vector<CombineShape::Part> &parts = m_shape.getParts();
+	for (size_t i = 0; i < parts.size(); ++i)
+	{
+		const CombineShape::Part &part = parts[i];
+		Blob vertexs = packVertexs(m_shape.getVertexs(part), part.numVertexs);
+		if (part.type == CombineShape::MESH)
+		{
+			double values[] = { part.rows, part.columns, (double)shapeId };
+			insert(MESH, values, _countof(values), &vertexs, 1);
+		}
+		else if (part.type == CombineShape::SHELL)
+		{
+			double values[] = { (double)shapeId };
+			Blob blobs[] = { vertexs, { m_shape.getFaces(part), static_cast<int>(part.numFaces * sizeof(Adesk::Int32)) } };
+			insert(SHELL, values, _countof(values), blobs, _countof(blobs));
+		}
+		else
+		{
+			double values[] = { (double)shapeId };
+			insert(POLYGON, values, _countof(values), &vertexs, 1);
+		}
+	}
+	return shapeId;
+}
+
+bool SqliteSink::writeRevisions()
+{
+	// the viewer reads the shapes and their parts with the combine geometry
+	if (m_changed[COMBINE_SHAPE] || m_changed[MESH] || m_changed[SHELL] || m_changed[POLYGON])
+		m_changed[COMBINE_GEOMETRY] = true;
+
+	sqlite3_stmt *pStmt = NULL;
+	if (!prepare("insert or replace into table_revision (name, revision) values (?, ?)", pStmt))
+		return false;
+	int rc = SQLITE_DONE;
+	for (int i = 0; rc == SQLITE_DONE && i < NUM_TABLES; ++i)
+	{
+		if (m_keepRows && !m_changed[i])
+			continue;
+		sqlite3_bind_text(pStmt, 1, TABLES[i].name, -1, SQLITE_STATIC);
+		sqlite3_bind_int64(pStmt, 2, m_revision);
+		rc = sqlite3_step(pStmt);
+		sqlite3_reset(pStmt);
+	}
+	sqlite3_finalize(pStmt);
+	if (rc != SQLITE_DONE)
+		return fail();
+	return true;
+}
+
+long long SqliteSink::insert(Table table, const double *values, unsigned int numValues,
+	const Blob *blobs, unsigned int numBlobs)
+{
+	if (m_failed)
+		return 0;
+
+	Insert &ins = m_inserts[table];
+	assert(numValues + numBlobs + (ins.tracked ? 2 : 0) == ins.types.size());
+	for (unsigned int i = 0; i < numValues; ++i)
+	{
+		assert(ins.types[i] != BLOB);
+		if (ins.types[i] == INTEGER)
+			sqlite3_bind_int64(ins.pStmt, i + 1, (sqlite3_int64)values[i]);
+		else
+			sqlite3_bind_double(ins.pStmt, i + 1, values[i]);
+	}
+	for (unsigned int i = 0; i < numBlobs; ++i)
+	{
+		assert(ins.types[numValues + i] == BLOB);
+		sqlite3_bind_blob(ins.pStmt, numValues + i + 1, blobs[i].data, blobs[i].size, SQLITE_STATIC);
+	}
+	if (ins.tracked)
+	{
+		sqlite3_bind_int64(ins.pStmt, ins.types.size() - 1, (sqlite3_int64)m_handle);
+		sqlite3_bind_int64(ins.pStmt, ins.types.size(), m_blockIds.empty() ? 0 : m_blockIds.back());
+	}
+
+	int rc = sqlite3_step(ins.pStmt);
+	sqlite3_reset(ins.pStmt);
+	if (rc != SQLITE_DONE)
+	{
+		fail();
+		return 0;
+	}
+
+	++m_numRows;
+	m_changed[table] = true;
+	return sqlite3_last_insert_rowid(m_db);
+}
+
+SqliteSink::Blob SqliteSink::packVertexs(const AcGePoint3d *pVertexList, Adesk::UInt32 numVertexs)
+{
+	// x86 is little endian, the floats are written as they are in memory
+	m_packed.resize(numVertexs * 3);
+	for (Adesk::UInt32 i = 0; i < numVertexs; ++i)
+	{
+		m_packed[i * 3] = static_cast<float>(pVertexList[i].x);
+		m_packed[i * 3 + 1] = static_cast<float>(pVertexList[i].y);
+		m_packed[i * 3 + 2] = static_cast<float>(pVertexList[i].z);
+	}
+
+	Blob blob = { m_packed.empty() ? NULL : &m_packed[0], static_cast<int>(m_packed.size() * sizeof(float)) };
+	return blob;
+}
+
+bool SqliteSink::fail()
+{
+	if (!m_failed)
+	{
+		m_failed = true;
+		m_errorMessage = m_db != NULL ? sqlite3_errmsg(m_db) : "out of memory";
+	}
+	return false;
+}
+
+void SqliteSink::finalize()
+{
+	for (int i = 0; i < NUM_TABLES; ++i)
+	{
+		sqlite3_finalize(m_inserts[i].pStmt);
+		sqlite3_finalize(m_inserts[i].pDelete);
+		m_inserts[i].pStmt = NULL;
+		m_inserts[i].pDelete = NULL;
+	}
+	sqlite3_finalize(m_pEntityInsert);
+	sqlite3_finalize(m_pEntityDelete);
+	sqlite3_finalize(m_pDefinitionInsert);
+	m_pEntityInsert = NULL;
+	m_pEntityDelete = NULL;
+	m_pDefinitionInsert = NULL;
+
+	if (m_db != NULL)
+	{
+		sqlite3_close(m_db);
+		m_db = NULL;
+	}
+}
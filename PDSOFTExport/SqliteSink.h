@@ -0,0 +1,244 @@
+#pragma once
+#include <map>
+#include <string>
+#include <vector>
+#include "CombineShape.h"
+#include "ExportSink.h"
+
+struct sqlite3;
+struct sqlite3_stmt;
+
+// Writes the model database directly with SQLite, in the schema SqliteLoad
+// reads. From schema version 2 the vertexs and face lists of shells, meshs
+// and polygons are packed little endian blobs (float x, y, z and int32) on
+// their own row instead of a row per value. Schema version 5 adds the
+// revolve and extrusion tables, their profiles packed the same way with the
+// flags and loop sizes as int32 blobs. From schema version 6 a combine
+// geometry is a combine_shape, its parts in the frame of the shape, placed
+// by the axes and origin on its combine_geometry row; geometries equal up to
+// a rigid transform share one shape. Every table gets one prepared
+// INSERT reused for all its rows and the whole export runs in a single
+// transaction, so a row costs a bind and a step instead of an NHibernate
+// Save. Rows carry the block definition open when they were added, 0 for
+// the model space, and the handle of the entity they come from; the entity
+// table holds the hash of every entity. The first error stops the writing
+// and is kept for getErrorMessage().
+//
+// An incremental sink keeps a database of the current schema: rows of
+// entities with an unchanged hash stay, changed entities are written again
+// and entities not seen by commit() are deleted, and the shapes no geometry
+// uses any more with them. table_revision records the export that last
+// changed each table, so the viewer reads only those again.
+class SqliteSink : public ExportSink
+{
+public:
+	enum { SCHEMA_VERSION = 6 };
+
+	explicit SqliteSink(const std::wstring &dbPath, bool incremental = false);
+	virtual ~SqliteSink();
+
+	virtual bool begin();
+	virtual bool commit();
+	virtual void rollback();
+
+	virtual unsigned long long getNumRows() const;
+	const std::string &getErrorMessage() const;
+	// entities kept as they were and deleted by an incremental export
+	unsigned int getNumKeptEntities() const;
+	unsigned int getNumErasedEntities() const;
+	// combine geometries written and the shapes written for them, the others
+	// share a shape
+	unsigned int getNumCombineGeometries() const;
+	unsigned int getNumCombineShapes() const;
+
+	virtual bool isIncremental() const;
+	virtual bool hasEntity(Adesk::UInt64 handle, Adesk::UInt64 hash);
+	virtual void beginEntity(Adesk::UInt64 handle);
+	virtual void endEntity(Adesk::UInt64 hash);
+
+	virtual void addBox(const AcGePoint3d &org, const AcGeVector3d &xLen, const AcGeVector3d &yLen,
+		const AcGeVector3d &zLen, int color);
+	virtual void addCircularTorus(const AcGePoint3d &center, const AcGePoint3d &startPnt, const AcGeVector3d &normal,
+		double startRadius, double endRadius, double angle, int color);
+	virtual void addCone(const AcGePoint3d &org, const AcGeVector3d &height, const AcGeVector3d &offset,
+		double radius, int color);
+	virtual void addCylinder(const AcGePoint3d &org, const AcGeVector3d &height, double radius, int color);
+	virtual void addEllipsoid(const AcGePoint3d &center, const AcGeVector3d &aLen, double bRadius, double angle,
+		int color);
+	virtual void addPrism(const AcGePoint3d &org, const AcGeVector3d &height, const AcGePoint3d &bottomStartPnt,
+		int edgeNum, int color);
+	virtual void addPyramid(const AcGePoint3d &org, const AcGeVector3d &height, const AcGeVector3d &xAxis,
+		const AcGeVector3d &offset, double bottomXLen, double bottomYLen, double topXLen, double topYLen, int color);
+	virtual void addRectCirc(const AcGePoint3d &rectCenter, const AcGeVector3d &xLen, double yLen,
+		const AcGeVector3d &height, const AcGeVector3d &offset, double radius, int color);
+	virtual void addRectangularTorus(const AcGePoint3d &center, const AcGePoint3d &startPnt, const AcGeVector3d &normal,
+		double startWidth, double startHeight, double endWidth, double endHeight, double angle, int color);
+	virtual void addSaddle(const AcGePoint3d &org, const AcGeVector3d &xLen, double yLen, const AcGeVector3d &zLen,
+		double radius, int color);
+	virtual void addSCylinder(const AcGePoint3d &org, const AcGeVector3d &height, const AcGeVector3d &bottomNormal,
+		double radius, int color);
+	virtual void addSnout(const AcGePoint3d &org, const AcGeVector3d &height, const AcGeVector3d &offset,
+		double bottomRadius, double topRadius, int color);
+	virtual void addSphere(const AcGePoint3d &center, const AcGeVector3d &bottomNormal, double radius, double angle,
+		int color);
+	virtual void addWedge(const AcGePoint3d &org, const AcGeVector3d &edge1, const AcGeVector3d &edge2,
+		const AcGeVector3d &height, int color);
+
+	virtual bool acceptsProfiles() const;
+	virtual void addRevolve(const AcGePoint3d &axisPnt, const AcGeVector3d &axis, double angle,
+		Adesk::UInt32 nbVertex, const AcGePoint3d *pVertexList, const Adesk::Int32 *pFlagList, int color);
+	virtual void addExtrusion(const AcGeVector3d &height, Adesk::UInt32 nbVertex, const AcGePoint3d *pVertexList,
+		const Adesk::Int32 *pFlagList, Adesk::UInt32 nbLoop, const Adesk::Int32 *pLoopList, int color);
+
+	virtual void beginCombineGeometry(int color);
+	virtual void addMesh(Adesk::UInt32 rows, Adesk::UInt32 columns, const AcGePoint3d *pVertexList);
+	virtual void addShell(Adesk::UInt32 nbVertex, const AcGePoint3d *pVertexList,
+		Adesk::UInt32 faceListSize, const Adesk::Int32 *pFaceList);
+	virtual void addPolygon(Adesk::UInt32 nbPoints, const AcGePoint3d *pVertexList);
+	virtual void endCombineGeometry();
+
+	virtual long long beginBlockDefinition(Adesk::UInt64 handle);
+	virtual void endBlockDefinition();
+	virtual void addBlockReference(long long definitionId, const AcGeMatrix3d &transform);
+
+private:
+	enum Table
+	{
+		BOX, CIRCULAR_TORUS, CONE, CYLINDER, ELLIPSOID, PRISM, PYRAMID, RECT_CIRC, RECTANGULAR_TORUS,
+		SADDLE, SCYLINDER, SNOUT, SPHERE, WEDGE, REVOLVE, EXTRUSION,
+		COMBINE_GEOMETRY, COMBINE_SHAPE, MESH, SHELL, POLYGON, BLOCK_REFERENCE,
+		NUM_TABLES
+	};
+
+	struct TableDef
+	{
+		const char *name;
+		// "_xyz" stands for the three columns of a point
+		const char *columns;
+	};
+
+	enum ColumnType
+	{
+		REAL, INTEGER, BLOB
+	};
+
+	struct Insert
+	{
+		sqlite3_stmt *pStmt;
+		// deletes the rows of an entity
+		sqlite3_stmt *pDelete;
+		std::vector<ColumnType> types;
+		// the last columns are handle and block_id, bound from the current
+		// entity and the open definition
+		bool tracked;
+	};
+
+	struct Entity
+	{
+		Adesk::UInt64 hash;
+		bool seen;
+	};
+
+	struct Definition
+	{
+		long long id;
+		bool seen;
+	};
+
+	typedef std::map<Adesk::UInt64, Entity> EntityMap;
+	typedef std::map<Adesk::UInt64, Definition> DefinitionMap;
+	// shape hash to its combine_shape id
+	typedef std::map<Adesk::UInt64, long long> ShapeMap;
+
+	struct Blob
+	{
+		const void *data;
+		int size;
+	};
+
+	static const TableDef TABLES[NUM_TABLES];
+
+	bool exec(const char *zSql);
+	bool prepare(const char *zSql, sqlite3_stmt *&pStmt);
+	// value of the first column of the first row, defaultValue on any error
+	long long queryInt(const char *zSql, long long defaultValue);
+	bool createTables();
+	bool createIndexes();
+	// prepares the statements of table, created again first when create is set
+	bool prepareTable(Table table, bool create);
+	bool writeSchemaVersion();
+	bool loadEntities();
+	bool deleteRows(Adesk::UInt64 handle);
+	bool deleteErased();
+	// the shapes no combine geometry uses and their parts
+	bool deleteUnusedShapes();
+	// writes m_shape with its parts, returns its id
+	long long insertShape();
+	bool writeRevisions();
+	// values go to the leading columns, blobs to the trailing blob columns
+	long long insert(Table table, const double *values, unsigned int numValues,
+		const Blob *blobs = NULL, unsigned int numBlobs = 0);
+	Blob packVertexs(const AcGePoint3d *pVertexList, Adesk::UInt32 numVertexs);
+	bool fail();
+	void finalize();
+
+private:
+	std::wstring m_dbPath;
+	bool m_incremental;
+	sqlite3 *m_db;
+	Insert m_inserts[NUM_TABLES];
+	sqlite3_stmt *m_pEntityInsert;
+	sqlite3_stmt *m_pEntityDelete;
+	sqlite3_stmt *m_pDefinitionInsert;
+	// the rows of the last export are kept
+	bool m_keepRows;
+	bool m_changed[NUM_TABLES];
+	long long m_revision;
+	EntityMap m_entities;
+	DefinitionMap m_definitions;
+	Adesk::UInt64 m_handle;
+	unsigned int m_numKept;
+	unsigned int m_numErased;
+	int m_combineColor;
+	CombineShape m_shape;
+	ShapeMap m_shapes;
+	unsigned int m_numCombineGeometries;
+	unsigned int m_numCombineShapes;
+	std::vector<float> m_packed;
+	// open block definitions, innermost last
+	std::vector<long long> m_blockIds;
+	long long m_lastBlockId;
+	unsigned long long m_numRows;
+	bool m_failed;
+	std::string m_errorMessage;
+};
+
+inline unsigned long long SqliteSink::getNumRows() const
+{
+	return m_numRows;
+}
+
+inline const std::string &SqliteSink::getErrorMessage() const
+{
+	return m_errorMessage;
+}
+
+inline unsigned int SqliteSink::getNumKeptEntities() const
+{
+	return m_numKept;
+}
+
+inline unsigned int SqliteSink::getNumErasedEntities() const
+{
+	return m_numErased;
+}
+
+inline unsigned int SqliteSink::getNumCombineGeometries() const
+{
+	return m_numCombineGeometries;
+}
+
+inline unsigned int SqliteSink::getNumCombineShapes() const
+{
+	return m_numCombineShapes;
+}
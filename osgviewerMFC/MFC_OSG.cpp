@@ -8,6 +8,8 @@
 #include <osg/Multisample>
 #include <osgGA/AnimationPathManipulator>
 #include <DynamicLOD.h>
+#include <LODPolicy.h>
+#include <LODStats.h>
 
 //#include "NetLoad.h"
 #include "SqliteLoad.h"
@@ -40,6 +42,27 @@ private:
 	cOSG* _mOsg;
 };
 
+// 'L' starts and stops writing the LOD statistics of each frame to a CSV file
+class LODStatsCsvHandler : public osgGA::GUIEventHandler
+{
+public:
+	LODStatsCsvHandler(const std::string &fileName) : _fileName(fileName){}
+	virtual bool handle(const osgGA::GUIEventAdapter& ea, osgGA::GUIActionAdapter& aa)
+	{
+		if (ea.getEventType() != osgGA::GUIEventAdapter::KEYDOWN || ea.getKey() != 'L')
+			return false;
+
+		Geometry::LODStats *stats = Geometry::LODStats::instance();
+		if (stats->isWritingCsv())
+			stats->setCsvFile("");
+		else if (stats->setCsvFile(_fileName))
+			TRACE("LOD statistics written to %s\n", _fileName.c_str());
+		return true;
+	}
+private:
+	std::string _fileName;
+};
+
 cOSG::cOSG(HWND hWnd) :
    m_hWnd(hWnd)
    , mHints(new osg::TessellationHints)
@@ -194,7 +217,17 @@ void cOSG::InitCameraConfig(void)
     mViewer = new osgViewer::Viewer();
 
     // Add a Stats Handler to the viewer
-    mViewer->addEventHandler(new osgViewer::StatsHandler);
+	osg::ref_ptr<osgViewer::StatsHandler> statsHandler = new osgViewer::StatsHandler;
+	const osg::Vec4 textColor(1.0f, 1.0f, 0.0f, 1.0f), barColor(1.0f, 1.0f, 0.0f, 0.5f);
+	statsHandler->addUserStatsLine("LOD visited", textColor, barColor, Geometry::LODStats::VISITED, 1.0f, true, false, "", "", 0.0f);
+	statsHandler->addUserStatsLine("LOD small culled", textColor, barColor, Geometry::LODStats::SMALL_FEATURE_CULLED, 1.0f, true, false, "", "", 0.0f);
+	statsHandler->addUserStatsLine("LOD occluded", textColor, barColor, Geometry::LODStats::OCCLUSION_CULLED, 1.0f, true, false, "", "", 0.0f);
+	statsHandler->addUserStatsLine("LOD retessellated", textColor, barColor, Geometry::LODStats::RETESSELLATED, 1.0f, true, false, "", "", 0.0f);
+	statsHandler->addUserStatsLine("LOD vertices", textColor, barColor, Geometry::LODStats::VERTICES, 1.0f, true, false, "", "", 0.0f);
+	statsHandler->addUserStatsLine("LOD triangles", textColor, barColor, Geometry::LODStats::TRIANGLES, 1.0f, true, false, "", "", 0.0f);
+	statsHandler->addUserStatsLine("LOD tess (ms)", textColor, barColor, Geometry::LODStats::TESSELLATION_TIME, 1000.0f, true, false, "", "", 0.0f);
+    mViewer->addEventHandler(statsHandler);
+	mViewer->addEventHandler(new LODStatsCsvHandler(m_ModelName + ".lodstats.csv"));
 	mViewer->addEventHandler(new osgGA::StateSetManipulator(mViewer->getCamera()->getOrCreateStateSet()));
 
     // Get the current window size
@@ -273,6 +306,8 @@ void cOSG::PreFrameUpdate()
 void cOSG::PostFrameUpdate()
 {
     // Due any postframe updates in this routine
+	Geometry::LODStats::instance()->publish(mViewer->getViewerStats(), mViewer->getFrameStamp()->getFrameNumber());
+	Geometry::LODPolicy::instance()->endFrame();
 }
 
 osg::ref_ptr<osg::Group> cOSG::InitOSGFromDb()
@@ -281,8 +316,10 @@ osg::ref_ptr<osg::Group> cOSG::InitOSGFromDb()
 	//NetLoad(group, m_ModelName);
 
 	SqliteLoad sl(group, m_ModelName, trackball);
+	sl.setNumThreads(0);
 	if (!sl.doLoad())
 		AfxMessageBox(sl.getErrorMessage());
+	TRACE("%s\n", sl.getReport().c_str());
 
 	group->setUpdateCallback(new Geometry::DynamicLODUpdateCallback);
 	return group;
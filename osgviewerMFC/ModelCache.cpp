@@ -0,0 +1,667 @@
+#include "stdafx.h"
+#include "ModelCache.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <sys/stat.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+
+const char CACHE_MAGIC[4] = { 'P', 'D', 'M', 'C' };
+const unsigned int SQLITE_HEADER_SIZE = 100;
+
+struct SectionData
+{
+	unsigned int id;
+	unsigned int count;
+	const void *data;
+	unsigned long long size;
+};
+
+template<class T>
+void AddSection(std::vector<SectionData> &sections, unsigned int id, unsigned int count, const T *data, size_t num)
+{
+	SectionData section;
+	section.id = id;
+	section.count = count;
+	section.data = data;
+	section.size = num * sizeof(T);
+	sections.push_back(section);
+}
+
+unsigned long long Align(unsigned long long offset)
+{
+	return (offset + 7) & ~7ull;
+}
+
+bool StatFile(const std::string &fileName, unsigned long long &size, long long &time)
+{
+#ifdef _WIN32
+	struct _stat64 st;
+	if (_stat64(fileName.c_str(), &st) != 0)
+		return false;
+#else
+	struct stat st;
+	if (stat(fileName.c_str(), &st) != 0)
+		return false;
+#endif
+	size = st.st_size;
+	time = st.st_mtime;
+	return true;
+}
+
+// first + count within total, without overflowing
+bool InRange(unsigned int first, unsigned int count, unsigned int total)
+{
+	return count <= total && first <= total - count;
+}
+
+bool IsShape(int shape, const CombineBlock &combine)
+{
+	return shape >= 0 && static_cast<unsigned int>(shape) < combine.numShapes;
+}
+
+// Every range a part or a face refers to, so that a cache whose sections
+// have the right sizes but wrong contents is not read past its pools. Parts
+// of no shape are skipped by the loader and not checked.
+bool ValidateCombine(const CombineBlock &combine)
+{
+	for (unsigned int i = 0; i < combine.numGeometries; ++i)
+	{
+		// negative for a geometry without parts
+		if (combine.shapes[i] >= 0 && !IsShape(combine.shapes[i], combine))
+			return false;
+	}
+
+	for (unsigned int i = 0; i < combine.numShells; ++i)
+	{
+		const CombineBlock::Shell &shell = combine.shells[i];
+		if (!IsShape(shell.shape, combine))
+			continue;
+		if (!InRange(shell.firstVertex, shell.numVertexs, combine.numVertexs)
+			|| !InRange(shell.firstFace, shell.numFaces, combine.numFaces))
+			return false;
+
+		// a vertex count and that many vertexs of the shell per face
+		const int *faces = combine.faces + shell.firstFace;
+		for (unsigned int j = 0; j < shell.numFaces;)
+		{
+			const int numCorners = faces[j];
+			if (numCorners < 0 || static_cast<unsigned int>(numCorners) >= shell.numFaces - j)
+				return false;
+			for (int k = 1; k <= numCorners; ++k)
+			{
+				if (faces[j + k] < 0 || static_cast<unsigned int>(faces[j + k]) >= shell.numVertexs)
+					return false;
+			}
+			j += numCorners + 1;
+		}
+	}
+
+	for (unsigned int i = 0; i < combine.numMeshs; ++i)
+	{
+		const CombineBlock::Mesh &mesh = combine.meshs[i];
+		if (!IsShape(mesh.shape, combine))
+			continue;
+		if (!InRange(mesh.firstVertex, mesh.numVertexs, combine.numVertexs) || mesh.rows < 0 || mesh.columns < 0
+			|| static_cast<unsigned long long>(mesh.rows) * mesh.columns > mesh.numVertexs)
+			return false;
+	}
+
+	for (unsigned int i = 0; i < combine.numPolygons; ++i)
+	{
+		const CombineBlock::Polygon &polygon = combine.polygons[i];
+		if (IsShape(polygon.shape, combine) && !InRange(polygon.firstVertex, polygon.numVertexs, combine.numVertexs))
+			return false;
+	}
+	return true;
+}
+
+bool ValidateProfiles(const ProfileBlock &profiles)
+{
+	for (unsigned int i = 0; i < profiles.numRevolves; ++i)
+	{
+		const ProfileBlock::Revolve &revolve = profiles.revolves[i];
+		if (!InRange(revolve.firstVertex, revolve.numVertexs, profiles.numVertexs))
+			return false;
+	}
+
+	for (unsigned int i = 0; i < profiles.numExtrusions; ++i)
+	{
+		const ProfileBlock::Extrusion &extrusion = profiles.extrusions[i];
+		if (!InRange(extrusion.firstVertex, extrusion.numVertexs, profiles.numVertexs)
+			|| !InRange(extrusion.firstLoop, extrusion.numLoops, profiles.numLoops))
+			return false;
+
+		// the loops split the vertexs of the extrusion
+		unsigned long long numLoopVertexs = 0;
+		for (unsigned int j = 0; j < extrusion.numLoops; ++j)
+		{
+			const int loopSize = profiles.loops[extrusion.firstLoop + j];
+			if (loopSize < 0)
+				return false;
+			numLoopVertexs += loopSize;
+		}
+		if (numLoopVertexs > extrusion.numVertexs)
+			return false;
+	}
+	return true;
+}
+
+} // namespace
+
+ParamBlock::ParamBlock()
+	: numRows(0)
+	, numParams(0)
+	, params(NULL)
+	, colors(NULL)
+	, blockIds(NULL)
+{
+}
+
+void ParamBlock::assign(unsigned int params, const std::vector<double> &rows, std::vector<int> &rowColors,
+	std::vector<int> &rowBlockIds)
+{
+	numRows = rowColors.size();
+	numParams = params;
+	paramStorage.resize(numRows * numParams);
+	for (unsigned int r = 0; r < numRows; ++r)
+	{
+		for (unsigned int p = 0; p < numParams; ++p)
+			paramStorage[p * numRows + r] = rows[r * numParams + p];
+	}
+	colorStorage.swap(rowColors);
+	blockIdStorage.swap(rowBlockIds);
+	bind();
+}
+
+void ParamBlock::bind()
+{
+	params = paramStorage.empty() ? NULL : &paramStorage[0];
+	colors = colorStorage.empty() ? NULL : &colorStorage[0];
+	blockIds = blockIdStorage.empty() ? NULL : &blockIdStorage[0];
+}
+
+void ParamBlock::detach()
+{
+	paramStorage.assign(params, params + numRows * numParams);
+	colorStorage.assign(colors, colors + numRows);
+	blockIdStorage.assign(blockIds, blockIds + numRows);
+	bind();
+}
+
+double ParamBlock::get(unsigned int row, unsigned int param) const
+{
+	return params[param * numRows + row];
+}
+
+osg::Vec3 ParamBlock::getVec3(unsigned int row, unsigned int param) const
+{
+	return osg::Vec3(get(row, param), get(row, param + 1), get(row, param + 2));
+}
+
+int ParamBlock::getColor(unsigned int row) const
+{
+	return colors[row];
+}
+
+int ParamBlock::getBlockId(unsigned int row) const
+{
+	return blockIds[row];
+}
+
+CombineBlock::CombineBlock()
+	: numGeometries(0)
+	, numShapes(0)
+	, numShells(0)
+	, numMeshs(0)
+	, numPolygons(0)
+	, numVertexs(0)
+	, numFaces(0)
+	, colors(NULL)
+	, blockIds(NULL)
+	, shapes(NULL)
+	, matrices(NULL)
+	, shells(NULL)
+	, meshs(NULL)
+	, polygons(NULL)
+	, vertexs(NULL)
+	, faces(NULL)
+{
+}
+
+void CombineBlock::bind()
+{
+	numGeometries = colorStorage.size();
+	numShapes = shapeStorage.empty() ? 0 : *std::max_element(shapeStorage.begin(), shapeStorage.end()) + 1;
+	numShells = shellStorage.size();
+	numMeshs = meshStorage.size();
+	numPolygons = polygonStorage.size();
+	numVertexs = vertexStorage.size() / 3;
+	numFaces = faceStorage.size();
+	colors = colorStorage.empty() ? NULL : &colorStorage[0];
+	blockIds = blockIdStorage.empty() ? NULL : &blockIdStorage[0];
+	shapes = shapeStorage.empty() ? NULL : &shapeStorage[0];
+	matrices = matrixStorage.empty() ? NULL : &matrixStorage[0];
+	shells = shellStorage.empty() ? NULL : &shellStorage[0];
+	meshs = meshStorage.empty() ? NULL : &meshStorage[0];
+	polygons = polygonStorage.empty() ? NULL : &polygonStorage[0];
+	vertexs = vertexStorage.empty() ? NULL : &vertexStorage[0];
+	faces = faceStorage.empty() ? NULL : &faceStorage[0];
+}
+
+void CombineBlock::detach()
+{
+	colorStorage.assign(colors, colors + numGeometries);
+	blockIdStorage.assign(blockIds, blockIds + numGeometries);
+	shapeStorage.assign(shapes, shapes + numGeometries);
+	matrixStorage.assign(matrices, matrices + numGeometries * 16);
+	shellStorage.assign(shells, shells + numShells);
+	meshStorage.assign(meshs, meshs + numMeshs);
+	polygonStorage.assign(polygons, polygons + numPolygons);
+	vertexStorage.assign(vertexs, vertexs + numVertexs * 3);
+	faceStorage.assign(faces, faces + numFaces);
+	bind();
+}
+
+const osg::Vec3 *CombineBlock::getVertexs(unsigned int first) const
+{
+	return reinterpret_cast<const osg::Vec3*>(vertexs) + first;
+}
+
+ReferenceBlock::ReferenceBlock()
+	: numReferences(0)
+	, references(NULL)
+{
+}
+
+void ReferenceBlock::bind()
+{
+	numReferences = referenceStorage.size();
+	references = referenceStorage.empty() ? NULL : &referenceStorage[0];
+}
+
+void ReferenceBlock::detach()
+{
+	referenceStorage.assign(references, references + numReferences);
+	bind();
+}
+
+ProfileBlock::ProfileBlock()
+	: numRevolves(0)
+	, numExtrusions(0)
+	, numVertexs(0)
+	, numLoops(0)
+	, revolves(NULL)
+	, extrusions(NULL)
+	, vertexs(NULL)
+	, flags(NULL)
+	, loops(NULL)
+{
+}
+
+void ProfileBlock::bind()
+{
+	numRevolves = revolveStorage.size();
+	numExtrusions = extrusionStorage.size();
+	numVertexs = vertexStorage.size() / 3;
+	numLoops = loopStorage.size();
+	revolves = revolveStorage.empty() ? NULL : &revolveStorage[0];
+	extrusions = extrusionStorage.empty() ? NULL : &extrusionStorage[0];
+	vertexs = vertexStorage.empty() ? NULL : &vertexStorage[0];
+	flags = flagStorage.empty() ? NULL : &flagStorage[0];
+	loops = loopStorage.empty() ? NULL : &loopStorage[0];
+}
+
+void ProfileBlock::detach()
+{
+	revolveStorage.assign(revolves, revolves + numRevolves);
+	extrusionStorage.assign(extrusions, extrusions + numExtrusions);
+	vertexStorage.assign(vertexs, vertexs + numVertexs * 3);
+	flagStorage.assign(flags, flags + numVertexs);
+	loopStorage.assign(loops, loops + numLoops);
+	bind();
+}
+
+const osg::Vec3 *ProfileBlock::getVertexs(unsigned int first) const
+{
+	return reinterpret_cast<const osg::Vec3*>(vertexs) + first;
+}
+
+ModelCache::ModelCache(const std::string &dbPath)
+	: m_dbPath(dbPath)
+	, m_path(dbPath + ".pdmc")
+	, m_data(NULL)
+	, m_size(0)
+	, m_file(NULL)
+	, m_mapping(NULL)
+	, m_stale(false)
+{
+}
+
+ModelCache::~ModelCache()
+{
+	close();
+}
+
+bool ModelCache::open(bool acceptStale)
+{
+	close();
+
+	Fingerprint fingerprint;
+	bool current = getFingerprint(fingerprint);
+	if (!current && !acceptStale)
+		return false;
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(m_path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+	m_file = file;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart < static_cast<LONGLONG>(sizeof(Header)))
+	{
+		close();
+		return false;
+	}
+	m_size = size.QuadPart;
+
+	m_mapping = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (m_mapping == NULL)
+	{
+		close();
+		return false;
+	}
+	m_data = static_cast<const char*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+#else
+	int fd = ::open(m_path.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(Header)))
+	{
+		::close(fd);
+		return false;
+	}
+	m_size = st.st_size;
+	void *data = mmap(NULL, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if (data != MAP_FAILED)
+	{
+		m_mapping = data;
+		m_data = static_cast<const char*>(data);
+	}
+#endif
+	if (m_data == NULL)
+	{
+		close();
+		return false;
+	}
+
+	const Header *header = reinterpret_cast<const Header*>(m_data);
+	current = current && header->fingerprint.dbSize == fingerprint.dbSize
+		&& header->fingerprint.dbTime == fingerprint.dbTime && header->fingerprint.dbHash == fingerprint.dbHash;
+	if (memcmp(header->magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 || header->version != VERSION
+		|| (!current && !acceptStale) || header->numSections > (m_size - sizeof(Header)) / sizeof(Section))
+	{
+		close();
+		return false;
+	}
+
+	// the lengths come from the file, compared so that no sum can wrap
+	const Section *sections = reinterpret_cast<const Section*>(m_data + sizeof(Header));
+	for (unsigned int i = 0; i < header->numSections; ++i)
+	{
+		if (sections[i].offset > m_size || sections[i].size > m_size - sections[i].offset)
+		{
+			close();
+			return false;
+		}
+	}
+	m_stale = !current;
+	return true;
+}
+
+void ModelCache::close()
+{
+#ifdef _WIN32
+	if (m_data != NULL)
+		UnmapViewOfFile(m_data);
+	if (m_mapping != NULL)
+		CloseHandle(m_mapping);
+	if (m_file != NULL)
+		CloseHandle(m_file);
+#else
+	if (m_mapping != NULL)
+		munmap(m_mapping, m_size);
+#endif
+	m_data = NULL;
+	m_size = 0;
+	m_file = NULL;
+	m_mapping = NULL;
+	m_stale = false;
+}
+
+bool ModelCache::read(std::vector<ParamBlock> &blocks, CombineBlock &combine, ReferenceBlock &references,
+	ProfileBlock &profiles) const
+{
+	if (m_data == NULL)
+		return false;
+
+	unsigned int count;
+	unsigned long long size;
+	for (unsigned int i = 0; i < blocks.size(); ++i)
+	{
+		ParamBlock &block = blocks[i];
+		block.params = static_cast<const double*>(findSection(i * 2, count, size));
+		if (block.params == NULL)
+			return false;
+		block.numParams = count;
+		block.colors = static_cast<const int*>(findSection(i * 2 + 1, block.numRows, size));
+		if (block.colors == NULL || size != block.numRows * sizeof(int)
+			|| findSection(i * 2, count, size) == NULL || size != block.numRows * block.numParams * sizeof(double))
+			return false;
+		block.blockIds = static_cast<const int*>(findSection(BLOCK_ID_SECTION + i, count, size));
+		if (block.blockIds == NULL || count != block.numRows)
+			return false;
+	}
+
+	combine.colors = static_cast<const int*>(findSection(COMBINE_SECTION, combine.numGeometries, size));
+	if (combine.colors == NULL || size != combine.numGeometries * sizeof(int))
+		return false;
+	combine.shells = static_cast<const CombineBlock::Shell*>(findSection(COMBINE_SECTION + 1, combine.numShells, size));
+	if (combine.shells == NULL || size != combine.numShells * sizeof(CombineBlock::Shell))
+		return false;
+	combine.meshs = static_cast<const CombineBlock::Mesh*>(findSection(COMBINE_SECTION + 2, combine.numMeshs, size));
+	if (combine.meshs == NULL || size != combine.numMeshs * sizeof(CombineBlock::Mesh))
+		return false;
+	combine.polygons = static_cast<const CombineBlock::Polygon*>(findSection(COMBINE_SECTION + 3, combine.numPolygons, size));
+	if (combine.polygons == NULL || size != combine.numPolygons * sizeof(CombineBlock::Polygon))
+		return false;
+	combine.vertexs = static_cast<const float*>(findSection(COMBINE_SECTION + 4, combine.numVertexs, size));
+	if (combine.vertexs == NULL || size != combine.numVertexs * 3ull * sizeof(float))
+		return false;
+	combine.faces = static_cast<const int*>(findSection(COMBINE_SECTION + 5, combine.numFaces, size));
+	if (combine.faces == NULL || size != combine.numFaces * sizeof(int))
+		return false;
+	combine.blockIds = static_cast<const int*>(findSection(COMBINE_SECTION + 6, count, size));
+	if (combine.blockIds == NULL || count != combine.numGeometries)
+		return false;
+	// the count of the shape section is the number of shapes
+	combine.shapes = static_cast<const int*>(findSection(COMBINE_SECTION + 7, combine.numShapes, size));
+	if (combine.shapes == NULL || size != combine.numGeometries * sizeof(int))
+		return false;
+	combine.matrices = static_cast<const double*>(findSection(COMBINE_SECTION + 8, count, size));
+	if (combine.matrices == NULL || count != combine.numGeometries || size != combine.numGeometries * 16ull * sizeof(double))
+		return false;
+
+	references.references = static_cast<const ReferenceBlock::Reference*>(
+		findSection(REFERENCE_SECTION, references.numReferences, size));
+	if (references.references == NULL || size != references.numReferences * sizeof(ReferenceBlock::Reference))
+		return false;
+
+	profiles.revolves = static_cast<const ProfileBlock::Revolve*>(
+		findSection(PROFILE_SECTION, profiles.numRevolves, size));
+	if (profiles.revolves == NULL || size != profiles.numRevolves * sizeof(ProfileBlock::Revolve))
+		return false;
+	profiles.extrusions = static_cast<const ProfileBlock::Extrusion*>(
+		findSection(PROFILE_SECTION + 1, profiles.numExtrusions, size));
+	if (profiles.extrusions == NULL || size != profiles.numExtrusions * sizeof(ProfileBlock::Extrusion))
+		return false;
+	profiles.vertexs = static_cast<const float*>(findSection(PROFILE_SECTION + 2, profiles.numVertexs, size));
+	if (profiles.vertexs == NULL || size != profiles.numVertexs * 3ull * sizeof(float))
+		return false;
+	profiles.flags = static_cast<const int*>(findSection(PROFILE_SECTION + 3, count, size));
+	if (profiles.flags == NULL || count != profiles.numVertexs || size != profiles.numVertexs * sizeof(int))
+		return false;
+	profiles.loops = static_cast<const int*>(findSection(PROFILE_SECTION + 4, profiles.numLoops, size));
+	if (profiles.loops == NULL || size != profiles.numLoops * sizeof(int))
+		return false;
+
+	return ValidateCombine(combine) && ValidateProfiles(profiles);
+}
+
+bool ModelCache::readRevisions(std::vector<long long> &revisions) const
+{
+	if (m_data == NULL)
+		return false;
+
+	unsigned int count;
+	unsigned long long size;
+	const long long *data = static_cast<const long long*>(findSection(REVISION_SECTION, count, size));
+	if (data == NULL || size != count * sizeof(long long))
+		return false;
+	revisions.assign(data, data + count);
+	return true;
+}
+
+bool ModelCache::write(const std::vector<ParamBlock> &blocks, const CombineBlock &combine, const ReferenceBlock &references,
+	const ProfileBlock &profiles, const std::vector<long long> &revisions)
+{
+	close();
+
+	Header header;
+	memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+	header.version = VERSION;
+	header.reserved = 0;
+	if (!getFingerprint(header.fingerprint))
+		return false;
+
+	std::vector<SectionData> datas;
+	for (unsigned int i = 0; i < blocks.size(); ++i)
+	{
+		const ParamBlock &block = blocks[i];
+		AddSection(datas, i * 2, block.numParams, block.params, block.numRows * block.numParams);
+		AddSection(datas, i * 2 + 1, block.numRows, block.colors, block.numRows);
+		AddSection(datas, BLOCK_ID_SECTION + i, block.numRows, block.blockIds, block.numRows);
+	}
+	AddSection(datas, COMBINE_SECTION, combine.numGeometries, combine.colors, combine.numGeometries);
+	AddSection(datas, COMBINE_SECTION + 1, combine.numShells, combine.shells, combine.numShells);
+	AddSection(datas, COMBINE_SECTION + 2, combine.numMeshs, combine.meshs, combine.numMeshs);
+	AddSection(datas, COMBINE_SECTION + 3, combine.numPolygons, combine.polygons, combine.numPolygons);
+	AddSection(datas, COMBINE_SECTION + 4, combine.numVertexs, combine.vertexs, combine.numVertexs * 3);
+	AddSection(datas, COMBINE_SECTION + 5, combine.numFaces, combine.faces, combine.numFaces);
+	AddSection(datas, COMBINE_SECTION + 6, combine.numGeometries, combine.blockIds, combine.numGeometries);
+	AddSection(datas, COMBINE_SECTION + 7, combine.numShapes, combine.shapes, combine.numGeometries);
+	AddSection(datas, COMBINE_SECTION + 8, combine.numGeometries, combine.matrices, combine.numGeometries * 16);
+	AddSection(datas, REFERENCE_SECTION, references.numReferences, references.references, references.numReferences);
+	AddSection(datas, PROFILE_SECTION, profiles.numRevolves, profiles.revolves, profiles.numRevolves);
+	AddSection(datas, PROFILE_SECTION + 1, profiles.numExtrusions, profiles.extrusions, profiles.numExtrusions);
+	AddSection(datas, PROFILE_SECTION + 2, profiles.numVertexs, profiles.vertexs, profiles.numVertexs * 3);
+	AddSection(datas, PROFILE_SECTION + 3, profiles.numVertexs, profiles.flags, profiles.numVertexs);
+	AddSection(datas, PROFILE_SECTION + 4, profiles.numLoops, profiles.loops, profiles.numLoops);
+	AddSection(datas, REVISION_SECTION, revisions.size(), revisions.empty() ? NULL : &revisions[0], revisions.size());
+	header.numSections = datas.size();
+
+	std::vector<Section> sections(datas.size());
+	unsigned long long offset = Align(sizeof(Header) + sections.size() * sizeof(Section));
+	for (size_t i = 0; i < datas.size(); ++i)
+	{
+		sections[i].id = datas[i].id;
+		sections[i].count = datas[i].count;
+		sections[i].offset = offset;
+		sections[i].size = datas[i].size;
+		offset = Align(offset + datas[i].size);
+	}
+
+	// written aside and renamed, so a broken write never looks like a cache
+	std::string tmpPath = m_path + ".tmp";
+	FILE *fp = fopen(tmpPath.c_str(), "wb");
+	if (fp == NULL)
+		return false;
+
+	static const char padding[8] = { 0 };
+	bool ok = fwrite(&header, sizeof(header), 1, fp) == 1
+		&& fwrite(&sections[0], sizeof(Section), sections.size(), fp) == sections.size();
+	unsigned long long pos = sizeof(Header) + sections.size() * sizeof(Section);
+	for (size_t i = 0; ok && i < datas.size(); ++i)
+	{
+		ok = fwrite(padding, 1, sections[i].offset - pos, fp) == sections[i].offset - pos;
+		if (ok && datas[i].size > 0)
+			ok = fwrite(datas[i].data, 1, datas[i].size, fp) == datas[i].size;
+		pos = sections[i].offset + sections[i].size;
+	}
+	ok = fclose(fp) == 0 && ok;
+
+	::remove(m_path.c_str());
+	if (!ok || ::rename(tmpPath.c_str(), m_path.c_str()) != 0)
+	{
+		::remove(tmpPath.c_str());
+		return false;
+	}
+	return true;
+}
+
+bool ModelCache::getFingerprint(Fingerprint &fingerprint) const
+{
+	memset(&fingerprint, 0, sizeof(fingerprint));
+	if (!StatFile(m_dbPath, fingerprint.dbSize, fingerprint.dbTime))
+		return false;
+
+	// pending WAL frames are not in the main file yet
+	unsigned long long walSize;
+	long long walTime;
+	if (StatFile(m_dbPath + "-wal", walSize, walTime) && walSize > 0)
+		return false;
+
+	// the header carries the change counter, page count and schema cookie
+	FILE *fp = fopen(m_dbPath.c_str(), "rb");
+	if (fp == NULL)
+		return false;
+	unsigned char dbHeader[SQLITE_HEADER_SIZE];
+	size_t len = fread(dbHeader, 1, sizeof(dbHeader), fp);
+	fclose(fp);
+
+	// FNV-1a
+	unsigned int hash = 2166136261u;
+	for (size_t i = 0; i < len; ++i)
+	{
+		hash ^= dbHeader[i];
+		hash *= 16777619u;
+	}
+	fingerprint.dbHash = hash;
+	return true;
+}
+
+const void *ModelCache::findSection(unsigned int id, unsigned int &count, unsigned long long &size) const
+{
+	const Header *header = reinterpret_cast<const Header*>(m_data);
+	const Section *sections = reinterpret_cast<const Section*>(m_data + sizeof(Header));
+	for (unsigned int i = 0; i < header->numSections; ++i)
+	{
+		if (sections[i].id == id)
+		{
+			count = sections[i].count;
+			size = sections[i].size;
+			return m_data + sections[i].offset;
+		}
+	}
+	return NULL;
+}
@@ -0,0 +1,261 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <osg/Vec3>
+
+// Parameters of one primitive table stored column after column, params[p *
+// numRows + r] is parameter p of row r. The arrays live in the storage
+// vectors when read from the database, or in the mapped cache file. Rows
+// are sorted by the block definition they belong to, 0 is the model space.
+struct ParamBlock
+{
+	ParamBlock();
+
+	// takes row after row of numParams values, one color and one block id
+	// per row
+	void assign(unsigned int params, const std::vector<double> &rows, std::vector<int> &rowColors,
+		std::vector<int> &rowBlockIds);
+	void bind();
+	// copies a block read from the cache into the storage vectors, so it
+	// outlives the mapping
+	void detach();
+
+	double get(unsigned int row, unsigned int param) const;
+	osg::Vec3 getVec3(unsigned int row, unsigned int param) const;
+	int getColor(unsigned int row) const;
+	int getBlockId(unsigned int row) const;
+
+	unsigned int numRows;
+	unsigned int numParams;
+	const double *params;
+	const int *colors;
+	const int *blockIds;
+	std::vector<double> paramStorage;
+	std::vector<int> colorStorage;
+	std::vector<int> blockIdStorage;
+};
+
+// combine_geometry with its shells, meshs and polygons flattened into one
+// vertex pool (x, y, z as float, the precision the geometry is drawn with)
+// and one face pool. Parts refer to their shape by position, a geometry
+// places its shape by a matrix of 16 doubles in osg layout; before schema
+// version 6 every geometry is its own shape at the identity.
+struct CombineBlock
+{
+	struct Shell
+	{
+		int shape;
+		unsigned int firstVertex;
+		unsigned int numVertexs;
+		unsigned int firstFace;
+		unsigned int numFaces;
+	};
+
+	struct Mesh
+	{
+		int shape;
+		int rows;
+		int columns;
+		unsigned int firstVertex;
+		unsigned int numVertexs;
+	};
+
+	struct Polygon
+	{
+		int shape;
+		unsigned int firstVertex;
+		unsigned int numVertexs;
+	};
+
+	CombineBlock();
+
+	void bind();
+	void detach();
+	// the pool seen as osg::Vec3 from vertex first on
+	const osg::Vec3 *getVertexs(unsigned int first) const;
+
+	unsigned int numGeometries;
+	unsigned int numShapes;
+	unsigned int numShells;
+	unsigned int numMeshs;
+	unsigned int numPolygons;
+	unsigned int numVertexs;
+	unsigned int numFaces;
+	const int *colors;
+	const int *blockIds;
+	const int *shapes;
+	const double *matrices;
+	const Shell *shells;
+	const Mesh *meshs;
+	const Polygon *polygons;
+	const float *vertexs;
+	const int *faces;
+
+	std::vector<int> colorStorage;
+	std::vector<int> blockIdStorage;
+	std::vector<int> shapeStorage;
+	std::vector<double> matrixStorage;
+	std::vector<Shell> shellStorage;
+	std::vector<Mesh> meshStorage;
+	std::vector<Polygon> polygonStorage;
+	std::vector<float> vertexStorage;
+	std::vector<int> faceStorage;
+};
+
+// revolve and extrusion rows with their profiles flattened into one vertex
+// pool, a flag per vertex, and one pool of loop sizes, the way CombineBlock
+// keeps its parts. Rows are sorted by their block definition.
+struct ProfileBlock
+{
+	struct Revolve
+	{
+		int color;
+		int block;
+		double axisPnt[3];
+		double axis[3];
+		double angle;
+		unsigned int firstVertex;
+		unsigned int numVertexs;
+	};
+
+	struct Extrusion
+	{
+		int color;
+		int block;
+		double height[3];
+		unsigned int firstVertex;
+		unsigned int numVertexs;
+		unsigned int firstLoop;
+		unsigned int numLoops;
+	};
+
+	ProfileBlock();
+
+	void bind();
+	void detach();
+	// the pool seen as osg::Vec3 from vertex first on
+	const osg::Vec3 *getVertexs(unsigned int first) const;
+
+	unsigned int numRevolves;
+	unsigned int numExtrusions;
+	unsigned int numVertexs;
+	unsigned int numLoops;
+	const Revolve *revolves;
+	const Extrusion *extrusions;
+	const float *vertexs;
+	const int *flags;
+	const int *loops;
+
+	std::vector<Revolve> revolveStorage;
+	std::vector<Extrusion> extrusionStorage;
+	std::vector<float> vertexStorage;
+	std::vector<int> flagStorage;
+	std::vector<int> loopStorage;
+};
+
+// block_reference rows: the subgraph of block definition placed under
+// block (0 is the model space) with matrix, in osg::Matrixd layout.
+struct ReferenceBlock
+{
+	struct Reference
+	{
+		int definition;
+		int block;
+		double matrix[16];
+	};
+
+	ReferenceBlock();
+
+	void bind();
+	void detach();
+
+	unsigned int numReferences;
+	const Reference *references;
+	std::vector<Reference> referenceStorage;
+};
+
+// Binary copy of the blocks next to the database (<db>.pdmc), mapped on
+// later opens so the geometry is built without parsing. The header holds the
+// format version and a fingerprint of the database; a cache that does not
+// match is ignored and written again. The cache also keeps the table
+// revisions of the database it was written from; opened stale after an
+// incremental export, the blocks of tables with the same revision are still
+// current.
+class ModelCache
+{
+public:
+	enum { VERSION = 7 };
+
+	explicit ModelCache(const std::string &dbPath);
+	~ModelCache();
+
+	// acceptStale maps a cache of another state of the database too
+	bool open(bool acceptStale = false);
+	void close();
+	bool isStale() const;
+	bool read(std::vector<ParamBlock> &blocks, CombineBlock &combine, ReferenceBlock &references,
+		ProfileBlock &profiles) const;
+	// one revision per block, then combine, references, revolve and
+	// extrusion; empty when the database had none
+	bool readRevisions(std::vector<long long> &revisions) const;
+	bool write(const std::vector<ParamBlock> &blocks, const CombineBlock &combine, const ReferenceBlock &references,
+		const ProfileBlock &profiles, const std::vector<long long> &revisions);
+
+	const std::string &getPath() const;
+
+private:
+	struct Fingerprint
+	{
+		unsigned long long dbSize;
+		long long dbTime;
+		unsigned int dbHash;
+	};
+
+	struct Header
+	{
+		char magic[4];
+		unsigned int version;
+		Fingerprint fingerprint;
+		unsigned int numSections;
+		unsigned int reserved;
+	};
+
+	struct Section
+	{
+		unsigned int id;
+		unsigned int count;
+		unsigned long long offset;
+		unsigned long long size;
+	};
+
+	enum
+	{
+		COMBINE_SECTION = 1000,
+		REFERENCE_SECTION = 1100,
+		REVISION_SECTION = 1200,
+		PROFILE_SECTION = 1300,
+		BLOCK_ID_SECTION = 2000
+	};
+
+	bool getFingerprint(Fingerprint &fingerprint) const;
+	const void *findSection(unsigned int id, unsigned int &count, unsigned long long &size) const;
+
+private:
+	std::string m_dbPath;
+	std::string m_path;
+	const char *m_data;
+	unsigned long long m_size;
+	void *m_file;
+	void *m_mapping;
+	bool m_stale;
+};
+
+inline bool ModelCache::isStale() const
+{
+	return m_stale;
+}
+
+inline const std::string &ModelCache::getPath() const
+{
+	return m_path;
+}
@@ -18,6 +18,7 @@
 #include <Snout.h>
 #include <Sphere.h>
 #include <Wedge.h>
+#include <PrototypeCache.h>
 
 #ifdef __cplusplus_cli
 
@@ -37,7 +38,7 @@ inline void Point2Vec3(Point^ pnt, osg::Vec3 &vec)
 
 osg::Node* CreateCylinders(NHibernate::ISession^ session)
 {
-	osg::Geode *pCylinders = new osg::Geode();
+	osg::Group *pCylinders = new osg::Group();
 	IList<Cylinder^>^ cylList = session->CreateQuery("from Cylinder")->List<Cylinder^>();
 	osg::Vec3 org, height;
 	for (int i = 0; i < cylList->Count; ++i) {
@@ -50,9 +51,10 @@ osg::Node* CreateCylinders(NHibernate::ISession^ session)
 		geoCyl->setHeight(height);
 		geoCyl->setRadius(cyl->Radius);
 		geoCyl->setColor(CvtColor(cyl->Color));
+		geoCyl->setInstancing(true);
 		geoCyl->draw();
 
-		pCylinders->addDrawable(geoCyl);
+		pCylinders->addChild(Geometry::CreateGeometryNode(geoCyl));
 	}
 
 	//osg::Group *pCylinders = new osg::Group();
@@ -137,9 +139,9 @@ osg::Node* CreateCone(NHibernate::ISession^ session)
 	return pCones;
 }
 
-osg::Geode * CreateBoxs(NHibernate::ISession^ session)
+osg::Node* CreateBoxs(NHibernate::ISession^ session)
 {
-	osg::Geode *pBoxs = new osg::Geode();
+	osg::Group *pBoxs = new osg::Group();
 	IList<Box^>^ boxList = session->CreateQuery("from Box")->List<Box^>();
 	osg::Vec3 org, xlen, ylen, zlen;
 	for (int i = 0; i < boxList->Count; ++i) {
@@ -155,9 +157,10 @@ osg::Geode * CreateBoxs(NHibernate::ISession^ session)
 		geoBox->setYLen(ylen);
 		geoBox->setZLen(zlen);
 		geoBox->setColor(CvtColor(box->Color));
+		geoBox->setInstancing(true);
 		geoBox->draw();
 
-		pBoxs->addDrawable(geoBox);
+		pBoxs->addChild(Geometry::CreateGeometryNode(geoBox));
 	}
 
 	return pBoxs;
@@ -165,7 +168,7 @@ osg::Geode * CreateBoxs(NHibernate::ISession^ session)
 
 osg::Node* CreateCircularTorus(NHibernate::ISession^ session)
 {
-	osg::Geode *pCts = new osg::Geode();
+	osg::Group *pCts = new osg::Group();
 	IList<CircularTorus^>^ ctList = session->CreateQuery("from CircularTorus")->List<CircularTorus^>();
 	osg::Vec3 center, startPnt, normal;
 	for (int i = 0; i < ctList->Count; ++i) {
@@ -182,8 +185,9 @@ osg::Node* CreateCircularTorus(NHibernate::ISession^ session)
 		geoCt->setEndRadius(ct->EndRadius);
 		geoCt->setAngle(ct->Angle);
 		geoCt->setColor(CvtColor(ct->Color));
+		geoCt->setInstancing(true);
 		geoCt->draw();
-		pCts->addDrawable(geoCt);
+		pCts->addChild(Geometry::CreateGeometryNode(geoCt));
 	}
 	return pCts;
 }
@@ -544,6 +548,9 @@ osg::Node* CreateCombineGeometry(NHibernate::ISession^ session)
 
 void NetLoad(osg::ref_ptr<osg::Group> &root, const std::string &filePath)
 {
+	Geometry::PrototypeCache *cache = Geometry::PrototypeCache::instance();
+	cache->resetStatistics();
+
 	DbModel::Util^ util = gcnew DbModel::Util();
 	try {
 		util->init(gcnew String(filePath.c_str()), false);
@@ -581,6 +588,9 @@ void NetLoad(osg::ref_ptr<osg::Group> &root, const std::string &filePath)
 	finally {
 		util->~Util();
 	}
+
+	TRACE("prototypes = %u, instance hits = %u, misses = %u, hit rate = %.1f%%\n",
+		cache->getSize(), cache->getHitCount(), cache->getMissCount(), cache->getHitRate() * 100.0);
 }
 
 #endif // __cplusplus_cli
\ No newline at end of file
@@ -1,7 +1,16 @@
 #include "stdafx.h"
 #include "SqliteLoad.h"
+#include <algorithm>
+#include <climits>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <functional>
 #include <osg/Geode>
-#include <unordered_map>
+#include <osg/MatrixTransform>
+#include <osg/Timer>
+#include <OpenThreads/Atomic>
+#include <OpenThreads/Thread>
 
 #include <Box.h>
 #include <CircularTorus.h>
@@ -9,24 +18,232 @@
 #include <Cone.h>
 #include <Cylinder.h>
 #include <Ellipsoid.h>
+#include <Extrusion.h>
 #include <Prism.h>
 #include <Pyramid.h>
 #include <RectangularTorus.h>
 #include <RectCirc.h>
+#include <Revolve.h>
 #include <Saddle.h>
 #include <SCylinder.h>
 #include <Snout.h>
 #include <Sphere.h>
 #include <Wedge.h>
 #include <DynamicLOD.h>
+#include <BatchGeometry.h>
+#include <PrototypeCache.h>
 
 osg::Vec4 CvtColor(int color);
 
+namespace
+{
+
+class LoadThread : public OpenThreads::Thread
+{
+public:
+	LoadThread(const std::function<void()> &func)
+		: m_func(func)
+	{
+	}
+
+	virtual void run()
+	{
+		m_func();
+	}
+
+private:
+	std::function<void()> m_func;
+};
+
+void RunThreads(unsigned int numThreads, const std::function<void()> &func)
+{
+	std::vector<LoadThread*> threads;
+	for (unsigned int i = 0; i < numThreads; ++i)
+	{
+		threads.push_back(new LoadThread(func));
+		threads.back()->start();
+	}
+	for (size_t i = 0; i < threads.size(); ++i)
+	{
+		threads[i]->join();
+		delete threads[i];
+	}
+}
+
+// printf into a std::string, the loader is also built without MFC
+std::string Format(const char *format, ...)
+{
+	char buffer[512];
+	va_list args;
+	va_start(args, format);
+	vsnprintf(buffer, sizeof(buffer), format, args);
+	va_end(args);
+	buffer[sizeof(buffer) - 1] = '\0';
+	return buffer;
+}
+
+// The statements are ASCII. sqlite3_prepare16() would take wchar_t for
+// UTF-16, which it is not where wchar_t has 4 bytes.
+int Prepare(sqlite3 *pDb, const std::wstring &sql, sqlite3_stmt **ppStmt)
+{
+	std::string narrow(sql.begin(), sql.end());
+	return sqlite3_prepare_v2(pDb, narrow.c_str(), -1, ppStmt, NULL);
+}
+
+// position of id in the ascending ids, -1 when missing
+int FindId(const std::vector<int> &ids, int id)
+{
+	auto iter = std::lower_bound(ids.begin(), ids.end(), id);
+	return iter != ids.end() && *iter == id ? static_cast<int>(iter - ids.begin()) : -1;
+}
+
+// Appends a packed blob column of stride values per element to pool with
+// one memcpy. The blobs are little endian, float x, y, z for vertexs and
+// int32 for face lists, which is the layout of the pools on x86.
+template<class T>
+void AppendBlob(sqlite3_stmt *pStmt, int iCol, unsigned int stride, std::vector<T> &pool,
+	unsigned int &first, unsigned int &count)
+{
+	const void *pBlob = sqlite3_column_blob(pStmt, iCol);
+	count = static_cast<unsigned int>(sqlite3_column_bytes(pStmt, iCol) / (stride * sizeof(T)));
+	first = static_cast<unsigned int>(pool.size() / stride);
+	if (count == 0)
+		return;
+	pool.resize(pool.size() + count * stride);
+	memcpy(&pool[first * stride], pBlob, count * stride * sizeof(T));
+}
+
+// the parts of one combine shape, shared by the geometries placing it
+struct ShapeParts
+{
+	std::vector<std::shared_ptr<Geometry::Shell>> shells;
+	std::vector<std::shared_ptr<Geometry::Mesh>> meshs;
+	std::vector<std::shared_ptr<Geometry::Polygon>> polygons;
+};
+
+// copies of parts with their vertexs moved by matrix, the parts themselves
+// at the identity
+template<class T>
+std::vector<std::shared_ptr<T>> PlaceParts(const std::vector<std::shared_ptr<T>> &parts, const osg::Matrixd &matrix)
+{
+	if (matrix.isIdentity())
+		return parts;
+
+	std::vector<std::shared_ptr<T>> placed;
+	for (size_t i = 0; i < parts.size(); ++i)
+	{
+		std::shared_ptr<T> part(new T(*parts[i]));
+		for (size_t j = 0; j < part->vertexs.size(); ++j)
+			part->vertexs[j] = part->vertexs[j] * matrix;
+		placed.push_back(part);
+	}
+	return placed;
+}
+
+osg::ref_ptr<Geometry::CombineGeometry> PlaceShape(const ShapeParts &parts, const osg::Matrixd &matrix, int color)
+{
+	osg::ref_ptr<Geometry::CombineGeometry> cg(new Geometry::CombineGeometry);
+	cg->setShells(PlaceParts(parts.shells, matrix));
+	cg->setMeshs(PlaceParts(parts.meshs, matrix));
+	cg->setPolygons(PlaceParts(parts.polygons, matrix));
+	cg->setColor(CvtColor(color));
+	return cg;
+}
+
+} // namespace
+
+// in the order of the serial load, saddle is not loaded
+const SqliteLoad::TableDef SqliteLoad::TABLES[] = {
+	{ L"select org_x, org_y, org_z, xlen_x, xlen_y, xlen_z, ylen_x, ylen_y, ylen_z, "
+		L" zlen_x, zlen_y, zlen_z, color from box",
+		12, &SqliteLoad::buildBox },
+	{ L"select center_x, center_y, center_z, "
+		L" start_pnt_x, start_pnt_y, start_pnt_z, "
+		L" normal_x, normal_y, normal_z, "
+		L" start_radius, end_radius, angle, color from circular_torus",
+		12, &SqliteLoad::buildCircularTorus },
+	{ L"select org_x, org_y, org_z, "
+		L" height_x, height_y, height_z, "
+		L" offset_x, offset_y, offset_z, "
+		L" radius, color from cone",
+		10, &SqliteLoad::buildCone },
+	{ L"select org_x, org_y, org_z, "
+		L" height_x, height_y, height_z, "
+		L" radius, color from cylinder",
+		7, &SqliteLoad::buildCylinder },
+	{ L"select center_x, center_y, center_z, "
+		L" a_len_x, a_len_y, a_len_z, "
+		L" b_radius, angle, color from ellipsoid",
+		8, &SqliteLoad::buildEllipsoid },
+	{ L"select org_x, org_y, org_z, "
+		L" height_x, height_y, height_z, "
+		L" bottom_start_pnt_x, bottom_start_pnt_y, bottom_start_pnt_z, "
+		L" edge_num, color from prism",
+		10, &SqliteLoad::buildPrism },
+	{ L"select org_x, org_y, org_z, "
+		L" height_x, height_y, height_z, "
+		L" xaxis_x, xaxis_y, xaxis_z, "
+		L" offset_x, offset_y, offset_z, "
+		L" bottom_xlen, bottom_ylen, top_xlen, top_ylen, color from pyramid",
+		16, &SqliteLoad::buildPyramid },
+	{ L"select rect_center_x, rect_center_y, rect_center_z, "
+		L" xlen_x, xlen_y, xlen_z, "
+		L" height_x, height_y, height_z, "
+		L" offset_x, offset_y, offset_z, "
+		L" ylen, radius, color from rect_circ",
+		14, &SqliteLoad::buildRectCirc },
+	{ L"select center_x, center_y, center_z, "
+		L" start_pnt_x, start_pnt_y, start_pnt_z, "
+		L" normal_x, normal_y, normal_z, "
+		L" start_width, start_height, end_width, end_height, angle, color from rectangular_torus",
+		14, &SqliteLoad::buildRectangularTorus },
+	//{ L"select org_x, org_y, org_z, "
+	//	L" xlen_x, xlen_y, xlen_z, "
+	//	L" zlen_x, zlen_y, zlen_z, "
+	//	L" ylen, radius, color from saddle",
+	//	11, &SqliteLoad::buildSaddle },
+	{ L"select org_x, org_y, org_z, "
+		L" height_x, height_y, height_z, "
+		L" bottom_normal_x, bottom_normal_y, bottom_normal_z, "
+		L" radius, color from scylinder",
+		10, &SqliteLoad::buildSCylinder },
+	{ L"select org_x, org_y, org_z, "
+		L" height_x, height_y, height_z, "
+		L" offset_x, offset_y, offset_z, "
+		L" bottom_radius, top_radius, color from snout",
+		11, &SqliteLoad::buildSnout },
+	{ L"select center_x, center_y, center_z, "
+		L" bottom_normal_x, bottom_normal_y, bottom_normal_z, "
+		L" radius, angle, color from sphere",
+		8, &SqliteLoad::buildSphere },
+	{ L"select org_x, org_y, org_z, "
+		L" edge1_x, edge1_y, edge1_z, "
+		L" edge2_x, edge2_y, edge2_z, "
+		L" height_x, height_y, height_z, "
+		L" color from wedge",
+		12, &SqliteLoad::buildWedge }
+};
+
+const unsigned int SqliteLoad::NUM_TABLES = sizeof(SqliteLoad::TABLES) / sizeof(SqliteLoad::TABLES[0]);
+
+SqliteLoad::ReadResult::ReadResult()
+	: ok(false)
+	, errorCode(SQLITE_OK)
+{
+}
+
 SqliteLoad::SqliteLoad(osg::ref_ptr<osg::Group> &root, const std::string &filePath, ViewCenterManipulator *mani)
 	: m_root(root)
 	, m_mani(mani)
 	, m_filePath(filePath)
 	, m_pDb(NULL)
+	, m_schemaVersion(1)
+	, m_batchMode(false)
+	, m_instancing(true)
+	, m_numThreads(1)
+	, m_useCache(true)
+	, m_division(0)
+	, m_pendings(NULL)
 {
 
 }
@@ -44,1311 +261,1216 @@ bool SqliteLoad::doLoad()
 {
 	if ((m_errorCode = init()) != SQLITE_OK)
 		return false;
-	clock_t start = clock();
-	if (!loadBox())
-		return false;
-	if (!loadCircularTorus())
-		return false;
-	if (!loadCone())
-		return false;
-	if (!loadCylinder())
-		return false;
-	if (!loadEllipsoid())
-		return false;
-	if (!loadPrism())
-		return false;
-	if (!loadPyramid())
-		return false;
-	if (!loadRectCirc())
-		return false;
-	if (!loadRectangularTorus())
-		return false;
-	if (!loadSCylinder())
-		return false;
-	if (!loadSnout())
-		return false;
-	if (!loadSphere())
-		return false;
-	if (!loadWedge())
-		return false;
-	if (!loadCombineGeometry())
-		return false;
+	Geometry::PrototypeCache::instance()->resetStatistics();
+	osg::Timer_t start = osg::Timer::instance()->tick();
+	unsigned int numThreads = m_numThreads;
+	if (numThreads == 0)
+		numThreads = OpenThreads::GetNumberOfProcessors();
+
+	// the blocks point into the mapped cache until the scene is built
+	std::vector<ParamBlock> blocks(NUM_TABLES);
+	CombineBlock combine;
+	ReferenceBlock references;
+	ProfileBlock profiles;
+	ModelCache cache(m_filePath);
+	std::string cacheState = "off";
+	if (m_useCache && cache.open() && cache.read(blocks, combine, references, profiles))
+	{
+		cacheState = "hit";
+	}
+	else
+	{
+		if ((m_schemaVersion = readSchemaVersion()) > SCHEMA_VERSION)
+		{
+			m_errorCode = SQLITE_ERROR;
+			m_errorMessage = "unsupported schema version";
+			return false;
+		}
+		std::vector<long long> revisions;
+		if (!readRevisions(revisions))
+			return false;
 
-	clock_t end = clock();
-	CString msg;
-	msg.Format("Time = %lf", ((double)end - start) / 1000.0);
-	//AfxMessageBox(msg);
+		unsigned int numReloaded = 0;
+		if (m_useCache && readChanged(cache, revisions, blocks, combine, references, profiles, numReloaded))
+		{
+			cacheState = Format("updated (%u of %u tables read)", numReloaded, (unsigned int)revisions.size());
+		}
+		else
+		{
+			blocks.assign(NUM_TABLES, ParamBlock());
+			combine = CombineBlock();
+			references = ReferenceBlock();
+			profiles = ProfileBlock();
+			if (numThreads <= 1 ? !readSerial(blocks, combine, references, profiles)
+				: !readParallel(numThreads, blocks, combine, references, profiles))
+				return false;
+			cacheState = "missed";
+		}
+		if (m_useCache)
+			cacheState += cache.write(blocks, combine, references, profiles, revisions) ? ", written" : ", not written";
+		else
+			cacheState = "off";
+	}
+	osg::Timer_t read = osg::Timer::instance()->tick();
 
-	return true;
-}
+	buildScene(blocks, combine, references, profiles, numThreads);
 
-const char * SqliteLoad::getErrorMessage() const
-{
-	return sqlite3_errmsg(m_pDb);
+	osg::Timer_t end = osg::Timer::instance()->tick();
+	m_report = Format("Time = %lf, threads = %u, read = %lf, cache %s", osg::Timer::instance()->delta_s(start, end),
+		numThreads, osg::Timer::instance()->delta_s(start, read), cacheState.c_str());
+
+	Geometry::PrototypeCache *prototypes = Geometry::PrototypeCache::instance();
+	m_report += Format(", prototypes = %u, instance hits = %u, misses = %u, hit rate = %.1f%%",
+		prototypes->getSize(), prototypes->getHitCount(), prototypes->getMissCount(), prototypes->getHitRate() * 100.0);
+
+	m_report += Format(", combine geometries = %u, shapes = %u, shell faces = %u, vertices = %u",
+		combine.numGeometries, combine.numShapes, combine.numFaces, combine.numVertexs);
+
+	m_report += Format(", revolves = %u, extrusions = %u", profiles.numRevolves, profiles.numExtrusions);
+
+	m_report += Format(", block definitions = %u, references = %u", (unsigned int)m_blockGroups.size(),
+		references.numReferences);
+	m_blockGroups.clear();
+
+	return true;
 }
 
-int SqliteLoad::init()
+bool SqliteLoad::readSerial(std::vector<ParamBlock> &blocks, CombineBlock &combine, ReferenceBlock &references,
+	ProfileBlock &profiles, const std::vector<bool> *pReload)
 {
-	return sqlite3_open(m_filePath.c_str(), &m_pDb);
+	for (unsigned int i = 0; i < NUM_TABLES; ++i)
+	{
+		if ((pReload == NULL || (*pReload)[i]) && !readParams(TABLES[i].sql, TABLES[i].numParams, blocks[i]))
+			return false;
+	}
+	return ((pReload != NULL && !(*pReload)[NUM_TABLES]) || readCombineGeometry(combine))
+		&& ((pReload != NULL && !(*pReload)[NUM_TABLES + 1]) || readReferences(references))
+		&& ((pReload != NULL && !(*pReload)[NUM_TABLES + 2] && !(*pReload)[NUM_TABLES + 3]) || readProfiles(profiles));
 }
 
-bool SqliteLoad::loadBox()
+bool SqliteLoad::readChanged(ModelCache &cache, const std::vector<long long> &revisions,
+	std::vector<ParamBlock> &blocks, CombineBlock &combine, ReferenceBlock &references, ProfileBlock &profiles,
+	unsigned int &numReloaded)
 {
-	const wchar_t *zSql = L"select org_x, org_y, org_z, xlen_x, xlen_y, xlen_z, ylen_x, ylen_y, ylen_z, "
-		L" zlen_x, zlen_y, zlen_z, color from box";
-	sqlite3_stmt *pStmt = NULL;
-	const void *pzTail = NULL;
-	if ((m_errorCode = sqlite3_prepare16(m_pDb, zSql, -1, &pStmt, &pzTail)) != SQLITE_OK)
+	std::vector<long long> cachedRevisions;
+	if (revisions.empty() || !cache.open(true) || !cache.readRevisions(cachedRevisions)
+		|| cachedRevisions.size() != revisions.size() || !cache.read(blocks, combine, references, profiles))
 		return false;
 
-	osg::ref_ptr<Geometry::DynamicLOD> lod(new Geometry::DynamicLOD(m_mani));
+	// the blocks kept are copied out of the mapping, the cache is written
+	// again over it
+	std::vector<bool> reload(revisions.size());
+	numReloaded = 0;
+	for (unsigned int i = 0; i < revisions.size(); ++i)
+	{
+		reload[i] = revisions[i] != cachedRevisions[i];
+		if (reload[i])
+			++numReloaded;
+		if (i < NUM_TABLES)
+		{
+			if (reload[i])
+				blocks[i] = ParamBlock();
+			else
+				blocks[i].detach();
+		}
+		else if (i == NUM_TABLES)
+		{
+			if (reload[i])
+				combine = CombineBlock();
+			else
+				combine.detach();
+		}
+		else if (i == NUM_TABLES + 1)
+		{
+			if (reload[i])
+				references = ReferenceBlock();
+			else
+				references.detach();
+		}
+	}
+	// revolve and extrusion share one block
+	if (reload[NUM_TABLES + 2] || reload[NUM_TABLES + 3])
+		profiles = ProfileBlock();
+	else
+		profiles.detach();
+	cache.close();
+	return readSerial(blocks, combine, references, profiles, &reload);
+}
 
-	osg::Vec3 org, xLen, yLen, zLen;
-	int color;
-	while ((m_errorCode = sqlite3_step(pStmt)) != SQLITE_DONE)
+bool SqliteLoad::readParallel(unsigned int numThreads, std::vector<ParamBlock> &blocks, CombineBlock &combine,
+	ReferenceBlock &references, ProfileBlock &profiles)
+{
+	// one job per primitive table, one for combine_geometry and one for the
+	// profiles
+	std::vector<ReadResult> results(NUM_TABLES + 2);
+	OpenThreads::Atomic nextTable;
+	RunThreads(osg::minimum(numThreads, NUM_TABLES + 2), [&]() {
+		readTables(blocks, combine, references, profiles, results, nextTable);
+	});
+
+	for (size_t i = 0; i < results.size(); ++i)
 	{
-		if (m_errorCode != SQLITE_ROW)
+		if (!results[i].ok)
 		{
-			sqlite3_finalize(pStmt);
+			m_errorCode = results[i].errorCode;
+			m_errorMessage = results[i].errorMessage;
 			return false;
 		}
-
-		int iCol = 0;
-		org[0] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		org[1] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		org[2] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-
-		xLen[0] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		xLen[1] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		xLen[2] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-
-		yLen[0] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		yLen[1] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		yLen[2] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-
-		zLen[0] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		zLen[1] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		zLen[2] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-
-		color = sqlite3_column_int(pStmt, iCol);
-
-		osg::ref_ptr<Geometry::Box> box(new Geometry::Box);
-		box->setOrg(org);
-		box->setXLen(xLen);
-		box->setYLen(yLen);
-		box->setZLen(zLen);
-		box->setColor(CvtColor(color));
-		box->draw();
-		
-		osg::ref_ptr<osg::Geode> boxGeode(new osg::Geode);
-		boxGeode->addDrawable(box);
-		lod->addChild(boxGeode);
 	}
-
-	m_root->addChild(lod);
-	m_errorCode = sqlite3_finalize(pStmt);
-	pStmt = NULL;
-
 	return true;
 }
 
-bool SqliteLoad::loadCircularTorus()
+void SqliteLoad::readTables(std::vector<ParamBlock> &blocks, CombineBlock &combine, ReferenceBlock &references,
+	ProfileBlock &profiles, std::vector<ReadResult> &results, OpenThreads::Atomic &nextTable)
 {
-	const wchar_t *zSql = L"select center_x, center_y, center_z, "
-		L" start_pnt_x, start_pnt_y, start_pnt_z, "
-		L" normal_x, normal_y, normal_z, "
-		L" start_radius, end_radius, angle, color from circular_torus";
-	sqlite3_stmt *pStmt = NULL;
-	const void *pzTail = NULL;
-	if ((m_errorCode = sqlite3_prepare16(m_pDb, zSql, -1, &pStmt, &pzTail)) != SQLITE_OK)
-		return false;
-
-	osg::ref_ptr<Geometry::DynamicLOD> lod(new Geometry::DynamicLOD(m_mani));
+	osg::ref_ptr<osg::Group> root;
+	SqliteLoad worker(root, m_filePath, m_mani);
+	worker.m_schemaVersion = m_schemaVersion;
+	int openCode = sqlite3_open_v2(m_filePath.c_str(), &worker.m_pDb, SQLITE_OPEN_READONLY, NULL);
 
-	osg::Vec3 center, startPnt, normal;
-	double startRadius, endRadius, angle;
-	int color;
-	while ((m_errorCode = sqlite3_step(pStmt)) != SQLITE_DONE)
+	for (;;)
 	{
-		if (m_errorCode != SQLITE_ROW)
-		{
-			sqlite3_finalize(pStmt);
-			return false;
-		};
-
-		int iCol = 0;
-		center[0] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		center[1] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		center[2] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-
-		startPnt[0] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		startPnt[1] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		startPnt[2] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-
-		normal[0] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		normal[1] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		normal[2] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-
-		startRadius = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		endRadius = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		angle = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		color = sqlite3_column_int(pStmt, iCol);
+		unsigned int i = ++nextTable - 1;
+		if (i >= results.size())
+			break;
 
-		osg::ref_ptr<Geometry::CircularTorus> ct(new Geometry::CircularTorus);
-		ct->setCenter(center);
-		ct->setStartPnt(startPnt);
-		ct->setNormal(normal);
-		ct->setStartRadius(startRadius);
-		ct->setEndRadius(endRadius);
-		ct->setAngle(angle);
-		ct->setColor(CvtColor(color));
-		ct->draw();
+		ReadResult &result = results[i];
+		if (openCode != SQLITE_OK)
+		{
+			result.errorCode = openCode;
+			result.errorMessage = sqlite3_errstr(openCode);
+			continue;
+		}
 
-		osg::ref_ptr<osg::Geode> ctGeode(new osg::Geode);
-		ctGeode->addDrawable(ct);
-		lod->addChild(ctGeode);
+		if (i < NUM_TABLES)
+			result.ok = worker.readParams(TABLES[i].sql, TABLES[i].numParams, blocks[i]);
+		else if (i == NUM_TABLES)
+			result.ok = worker.readCombineGeometry(combine) && worker.readReferences(references);
+		else
+			result.ok = worker.readProfiles(profiles);
+		if (!result.ok)
+		{
+			result.errorCode = worker.m_errorCode;
+			result.errorMessage = worker.getErrorMessage();
+		}
 	}
-
-	m_root->addChild(lod);
-	m_errorCode = sqlite3_finalize(pStmt);
-	pStmt = NULL;
-
-	return true;
 }
 
-bool SqliteLoad::loadCone()
+bool SqliteLoad::readParams(const wchar_t *zSql, unsigned int numParams, ParamBlock &block)
 {
-	const wchar_t *zSql = L"select org_x, org_y, org_z, "
-		L" height_x, height_y, height_z, "
-		L" offset_x, offset_y, offset_z, "
-		L" radius, color from cone";
+	// v3 rows carry the block definition they belong to and are read one
+	// definition after the other, older rows are all model space
+	std::wstring sql(zSql);
+	size_t from = sql.rfind(L" from ");
+	if (m_schemaVersion >= 3)
+	{
+		sql.insert(from, L", block_id");
+		sql += L" order by block_id, id";
+	}
+	else
+		sql.insert(from, L", 0");
+
 	sqlite3_stmt *pStmt = NULL;
-	const void *pzTail = NULL;
-	if ((m_errorCode = sqlite3_prepare16(m_pDb, zSql, -1, &pStmt, &pzTail)) != SQLITE_OK)
+	if ((m_errorCode = Prepare(m_pDb, sql, &pStmt)) != SQLITE_OK)
 		return false;
 
-	osg::ref_ptr<Geometry::DynamicLOD> lod(new Geometry::DynamicLOD(m_mani));
-
-	osg::Vec3 org, height, offset;
-	double radius;
-	int color;
+	std::vector<double> rows;
+	std::vector<int> colors;
+	std::vector<int> blockIds;
 	while ((m_errorCode = sqlite3_step(pStmt)) != SQLITE_DONE)
 	{
 		if (m_errorCode != SQLITE_ROW)
 		{
 			sqlite3_finalize(pStmt);
 			return false;
-		};
+		}
 
 		int iCol = 0;
-		org[0] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		org[1] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		org[2] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-
-		height[0] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		height[1] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		height[2] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-
-		offset[0] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		offset[1] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		offset[2] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-
-		radius = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		color = sqlite3_column_int(pStmt, iCol);
-
-		osg::ref_ptr<Geometry::Cone> cone(new Geometry::Cone);
-		cone->setOrg(org);
-		cone->setHeight(height);
-		cone->setOffset(offset);
-		cone->setRadius(radius);
-		cone->setColor(CvtColor(color));
-		cone->draw();
-
-		osg::ref_ptr<osg::Geode> coneGeode(new osg::Geode);
-		coneGeode->addDrawable(cone);
-		lod->addChild(coneGeode);
+		for (; iCol < static_cast<int>(numParams); ++iCol)
+			rows.push_back(sqlite3_column_double(pStmt, iCol));
+		colors.push_back(sqlite3_column_int(pStmt, iCol));
+		blockIds.push_back(sqlite3_column_int(pStmt, iCol + 1));
 	}
-
-	m_root->addChild(lod);
 	m_errorCode = sqlite3_finalize(pStmt);
 	pStmt = NULL;
 
+	block.assign(numParams, rows, colors, blockIds);
 	return true;
 }
 
-bool SqliteLoad::loadCylinder()
+template<class Func>
+bool SqliteLoad::readRows(const wchar_t *zSql, Func func)
 {
-	const wchar_t *zSql = L"select org_x, org_y, org_z, "
-		L" height_x, height_y, height_z, "
-		L" radius, color from cylinder";
 	sqlite3_stmt *pStmt = NULL;
-	const void *pzTail = NULL;
-	if ((m_errorCode = sqlite3_prepare16(m_pDb, zSql, -1, &pStmt, &pzTail)) != SQLITE_OK)
+	if ((m_errorCode = Prepare(m_pDb, zSql, &pStmt)) != SQLITE_OK)
 		return false;
 
-	osg::ref_ptr<Geometry::DynamicLOD> lod(new Geometry::DynamicLOD(m_mani));
-
-	osg::Vec3 org, height;
-	double radius;
-	int color;
 	while ((m_errorCode = sqlite3_step(pStmt)) != SQLITE_DONE)
 	{
 		if (m_errorCode != SQLITE_ROW)
 		{
 			sqlite3_finalize(pStmt);
 			return false;
-		};
-
-		int iCol = 0;
-		org[0] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		org[1] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		org[2] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-
-		height[0] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		height[1] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		height[2] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-
-		radius = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		color = sqlite3_column_int(pStmt, iCol);
-
-		osg::ref_ptr<Geometry::Cylinder> cylinder(new Geometry::Cylinder);
-		cylinder->setOrg(org);
-		cylinder->setHeight(height);
-		cylinder->setRadius(radius);
-		cylinder->setColor(CvtColor(color));
-		cylinder->draw();
-
-		osg::ref_ptr<osg::Geode> cylGeode(new osg::Geode);
-		cylGeode->addDrawable(cylinder);
-		lod->addChild(cylGeode);
+		}
+		func(pStmt);
 	}
-
-	m_root->addChild(lod);
 	m_errorCode = sqlite3_finalize(pStmt);
 	pStmt = NULL;
-
 	return true;
 }
 
-bool SqliteLoad::loadEllipsoid()
+// The exporters write the rows of an owner one after the other, so the id
+// order, which needs no sort, is already the owner order; sorting by an
+// owner column without an index is what takes the time. Should an owner come
+// back after a later one, reset() undoes what func() appended and the rows
+// are read again sorted by owner.
+template<class Func, class Reset>
+bool SqliteLoad::readChildren(const wchar_t *zSql, const wchar_t *zOwnerColumn, const std::vector<int> &ownerIds,
+	Reset reset, Func func)
 {
-	const wchar_t *zSql = L"select center_x, center_y, center_z, "
-		L" a_len_x, a_len_y, a_len_z, "
-		L" b_radius, angle, color from ellipsoid";
-	sqlite3_stmt *pStmt = NULL;
-	const void *pzTail = NULL;
-	if ((m_errorCode = sqlite3_prepare16(m_pDb, zSql, -1, &pStmt, &pzTail)) != SQLITE_OK)
-		return false;
-
-	osg::ref_ptr<Geometry::DynamicLOD> load(new Geometry::DynamicLOD(m_mani));
-
-	osg::Vec3 center, aLen;
-	double bRadius, angle;
-	int color;
-	while ((m_errorCode = sqlite3_step(pStmt)) != SQLITE_DONE)
+	for (int sorted = 0; sorted < 2; ++sorted)
 	{
-		if (m_errorCode != SQLITE_ROW)
-		{
-			sqlite3_finalize(pStmt);
+		std::wstring sql(zSql);
+		sql += sorted ? std::wstring(L" order by ") + zOwnerColumn + L", id" : std::wstring(L" order by id");
+		sqlite3_stmt *pStmt = NULL;
+		if ((m_errorCode = Prepare(m_pDb, sql.c_str(), &pStmt)) != SQLITE_OK)
 			return false;
-		};
-
-		int iCol = 0;
-		center[0] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		center[1] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		center[2] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-
-		aLen[0] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		aLen[1] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		aLen[2] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-
-		bRadius = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		angle = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		color = sqlite3_column_int(pStmt, iCol);
 
-		osg::ref_ptr<Geometry::Ellipsoid> ellipsoid(new Geometry::Ellipsoid);
-		ellipsoid->setCenter(center);
-		ellipsoid->setALen(aLen);
-		ellipsoid->setBRadius(bRadius);
-		ellipsoid->setAngle(angle);
-		ellipsoid->setColor(CvtColor(color));
-		ellipsoid->draw();
+		size_t owner = 0;
+		int lastOwnerId = INT_MIN;
+		bool ordered = true;
+		while ((m_errorCode = sqlite3_step(pStmt)) != SQLITE_DONE)
+		{
+			if (m_errorCode != SQLITE_ROW)
+			{
+				sqlite3_finalize(pStmt);
+				return false;
+			}
+
+			int ownerId = sqlite3_column_int(pStmt, 0);
+			if (ownerId < lastOwnerId)
+			{
+				ordered = false;
+				break;
+			}
+			lastOwnerId = ownerId;
+			while (owner < ownerIds.size() && ownerIds[owner] < ownerId)
+				++owner;
+			if (owner < ownerIds.size() && ownerIds[owner] == ownerId)
+				func(owner, pStmt);
+		}
+		m_errorCode = sqlite3_finalize(pStmt);
+		pStmt = NULL;
 
-		osg::ref_ptr<osg::Geode> ellipsoidGeode(new osg::Geode);
-		ellipsoidGeode->addDrawable(ellipsoid);
-		load->addChild(ellipsoidGeode);
+		if (ordered)
+			return true;
+		reset();
 	}
-
-	m_root->addChild(load);
-	m_errorCode = sqlite3_finalize(pStmt);
-	pStmt = NULL;
-
 	return true;
 }
 
-bool SqliteLoad::loadPrism()
+int SqliteLoad::readSchemaVersion()
 {
-	const wchar_t *zSql = L"select org_x, org_y, org_z, "
-		L" height_x, height_y, height_z, "
-		L" bottom_start_pnt_x, bottom_start_pnt_y, bottom_start_pnt_z, "
-		L" edge_num, color from prism";
+	// schema_version is written from v2 on, older databases have none
 	sqlite3_stmt *pStmt = NULL;
-	const void *pzTail = NULL;
-	if ((m_errorCode = sqlite3_prepare16(m_pDb, zSql, -1, &pStmt, &pzTail)) != SQLITE_OK)
+	if (Prepare(m_pDb, L"select version from schema_version", &pStmt) != SQLITE_OK)
+		return 1;
+
+	int version = 1;
+	if (sqlite3_step(pStmt) == SQLITE_ROW)
+		version = sqlite3_column_int(pStmt, 0);
+	sqlite3_finalize(pStmt);
+	return version;
+}
+
+bool SqliteLoad::readRevisions(std::vector<long long> &revisions)
+{
+	revisions.clear();
+	if (m_schemaVersion < 4)
+		return true;
+
+	std::map<std::string, long long> tableRevisions;
+	if (!readRows(L"select name, revision from table_revision", [&](sqlite3_stmt *pStmt) {
+		tableRevisions[reinterpret_cast<const char*>(sqlite3_column_text(pStmt, 0))] = sqlite3_column_int64(pStmt, 1);
+	}))
 		return false;
 
-	osg::ref_ptr<Geometry::DynamicLOD> lod(new Geometry::DynamicLOD(m_mani));
+	for (unsigned int i = 0; i < NUM_TABLES; ++i)
+	{
+		std::wstring sql(TABLES[i].sql);
+		std::wstring name = sql.substr(sql.rfind(L" from ") + 6);
+		revisions.push_back(tableRevisions[std::string(name.begin(), name.end())]);
+	}
+	revisions.push_back(tableRevisions["combine_geometry"]);
+	revisions.push_back(tableRevisions["block_reference"]);
+	revisions.push_back(tableRevisions["revolve"]);
+	revisions.push_back(tableRevisions["extrusion"]);
+	return true;
+}
 
-	osg::Vec3 org, height, bottomStartPnt;
-	int edgeNum, color;
-	while ((m_errorCode = sqlite3_step(pStmt)) != SQLITE_DONE)
+bool SqliteLoad::readCombineGeometry(CombineBlock &combine)
+{
+	static const double IDENTITY[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+	std::vector<int> shapeIds;
+	if (m_schemaVersion >= 6)
 	{
-		if (m_errorCode != SQLITE_ROW)
-		{
-			sqlite3_finalize(pStmt);
+		if (!readRows(L"select id from combine_shape order by id", [&](sqlite3_stmt *pStmt) {
+			shapeIds.push_back(sqlite3_column_int(pStmt, 0));
+		}))
 			return false;
-		};
-
-		int iCol = 0;
-		org[0] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		org[1] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		org[2] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-
-		height[0] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		height[1] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		height[2] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-
-		bottomStartPnt[0] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		bottomStartPnt[1] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		bottomStartPnt[2] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-
-		edgeNum = sqlite3_column_int(pStmt, iCol);
-		++iCol;
-		color = sqlite3_column_int(pStmt, iCol);
 
-		osg::ref_ptr<Geometry::Prism> prism(new Geometry::Prism);
-		prism->setOrg(org);
-		prism->setHeight(height);
-		prism->setBottomStartPnt(bottomStartPnt);
-		prism->setEdgeNum(edgeNum);
-		prism->setColor(CvtColor(color));
-		prism->draw();
-
-		osg::ref_ptr<osg::Geode> prismGeode(new osg::Geode);
-		prismGeode->addDrawable(prism);
-		lod->addChild(prismGeode);
+		// the frame of the shape becomes the rows of the osg matrix, as for
+		// block_reference
+		if (!readRows(L"select color, block_id, shape_id, x_axis_x, x_axis_y, x_axis_z, "
+			L" y_axis_x, y_axis_y, y_axis_z, z_axis_x, z_axis_y, z_axis_z, "
+			L" origin_x, origin_y, origin_z from combine_geometry order by id", [&](sqlite3_stmt *pStmt) {
+			combine.colorStorage.push_back(sqlite3_column_int(pStmt, 0));
+			combine.blockIdStorage.push_back(sqlite3_column_int(pStmt, 1));
+			combine.shapeStorage.push_back(FindId(shapeIds, sqlite3_column_int(pStmt, 2)));
+			for (int row = 0; row < 4; ++row)
+			{
+				for (int col = 0; col < 3; ++col)
+					combine.matrixStorage.push_back(sqlite3_column_double(pStmt, 3 + row * 3 + col));
+				combine.matrixStorage.push_back(row == 3 ? 1.0 : 0.0);
+			}
+		}))
+			return false;
+	}
+	else
+	{
+		if (!readRows(m_schemaVersion >= 3 ? L"select id, color, block_id from combine_geometry order by id"
+			: L"select id, color, 0 from combine_geometry order by id", [&](sqlite3_stmt *pStmt) {
+			shapeIds.push_back(sqlite3_column_int(pStmt, 0));
+			combine.colorStorage.push_back(sqlite3_column_int(pStmt, 1));
+			combine.blockIdStorage.push_back(sqlite3_column_int(pStmt, 2));
+			combine.shapeStorage.push_back(static_cast<int>(combine.shapeStorage.size()));
+			combine.matrixStorage.insert(combine.matrixStorage.end(), IDENTITY, IDENTITY + 16);
+		}))
+			return false;
 	}
 
-	m_root->addChild(lod);
-	m_errorCode = sqlite3_finalize(pStmt);
-	pStmt = NULL;
+	if (m_schemaVersion >= 2 ? !readPackedParts(shapeIds, combine) : !readRowParts(shapeIds, combine))
+		return false;
 
+	combine.bind();
 	return true;
 }
 
-bool SqliteLoad::loadPyramid()
+bool SqliteLoad::readRowParts(const std::vector<int> &shapeIds, CombineBlock &combine)
 {
-	const wchar_t *zSql = L"select org_x, org_y, org_z, "
-		L" height_x, height_y, height_z, "
-		L" xaxis_x, xaxis_y, xaxis_z, "
-		L" offset_x, offset_y, offset_z, "
-		L" bottom_xlen, bottom_ylen, top_xlen, top_ylen, color from pyramid";
-	sqlite3_stmt *pStmt = NULL;
-	const void *pzTail = NULL;
-	if ((m_errorCode = sqlite3_prepare16(m_pDb, zSql, -1, &pStmt, &pzTail)) != SQLITE_OK)
+	std::vector<int> shellIds, meshIds, polygonIds;
+	std::vector<float> &vertexs = combine.vertexStorage;
+	std::vector<int> &faces = combine.faceStorage;
+
+	if (!readRows(L"select id, combine_geometry_id from shell order by id", [&](sqlite3_stmt *pStmt) {
+		CombineBlock::Shell shell = { FindId(shapeIds, sqlite3_column_int(pStmt, 1)), 0, 0, 0, 0 };
+		shellIds.push_back(sqlite3_column_int(pStmt, 0));
+		combine.shellStorage.push_back(shell);
+	}))
 		return false;
 
-	osg::ref_ptr<osg::Group> group(new osg::Group);
+	if (!readRows(L"select id, rows, columns, combine_geometry_id from mesh order by id", [&](sqlite3_stmt *pStmt) {
+		CombineBlock::Mesh mesh = { FindId(shapeIds, sqlite3_column_int(pStmt, 3)),
+			sqlite3_column_int(pStmt, 1), sqlite3_column_int(pStmt, 2), 0, 0 };
+		meshIds.push_back(sqlite3_column_int(pStmt, 0));
+		combine.meshStorage.push_back(mesh);
+	}))
+		return false;
 
-	osg::Vec3 org, height, xAxis, offset;
-	double bottomXLen, bottomYLen, topXLen, topYLen;
-	int color;
-	while ((m_errorCode = sqlite3_step(pStmt)) != SQLITE_DONE)
-	{
-		if (m_errorCode != SQLITE_ROW)
-		{
-			sqlite3_finalize(pStmt);
-			return false;
-		};
+	if (!readRows(L"select id, combine_geometry_id from polygon order by id", [&](sqlite3_stmt *pStmt) {
+		CombineBlock::Polygon polygon = { FindId(shapeIds, sqlite3_column_int(pStmt, 1)), 0, 0 };
+		polygonIds.push_back(sqlite3_column_int(pStmt, 0));
+		combine.polygonStorage.push_back(polygon);
+	}))
+		return false;
 
-		int iCol = 0;
-		org[0] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		org[1] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		org[2] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-
-		height[0] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		height[1] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		height[2] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-
-		xAxis[0] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		xAxis[1] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		xAxis[2] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-
-		offset[0] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		offset[1] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		offset[2] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-
-		bottomXLen = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		bottomYLen = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		topXLen = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		topYLen = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		color = sqlite3_column_int(pStmt, iCol);
+	// The rows of one owner arrive in one run, so its range is opened on the
+	// first row and grows at the end of the pool.
+	auto appendVertex = [&](sqlite3_stmt *pStmt, unsigned int &firstVertex, unsigned int &numVertexs) {
+		if (numVertexs++ == 0)
+			firstVertex = static_cast<unsigned int>(vertexs.size() / 3);
+		vertexs.push_back(static_cast<float>(sqlite3_column_double(pStmt, 1)));
+		vertexs.push_back(static_cast<float>(sqlite3_column_double(pStmt, 2)));
+		vertexs.push_back(static_cast<float>(sqlite3_column_double(pStmt, 3)));
+	};
+
+	const size_t faceCount = faces.size();
+	if (!readChildren(L"select shell_id, vertex_index from shell_face", L"shell_id", shellIds, [&]() {
+		faces.resize(faceCount);
+		for (auto &shell : combine.shellStorage)
+			shell.numFaces = 0;
+	}, [&](size_t i, sqlite3_stmt *pStmt) {
+		CombineBlock::Shell &shell = combine.shellStorage[i];
+		if (shell.numFaces++ == 0)
+			shell.firstFace = static_cast<unsigned int>(faces.size());
+		faces.push_back(sqlite3_column_int(pStmt, 1));
+	}))
+		return false;
 
-		osg::ref_ptr<Geometry::Pyramid> pyramid(new Geometry::Pyramid);
-		pyramid->setOrg(org);
-		pyramid->setHeight(height);
-		pyramid->setXAxis(xAxis);
-		pyramid->setOffset(offset);
-		pyramid->setBottomXLen(bottomXLen);
-		pyramid->setBottomYLen(bottomYLen);
-		pyramid->setTopXLen(topXLen);
-		pyramid->setTopYLen(topYLen);
-		pyramid->setColor(CvtColor(color));
-		pyramid->draw();
+	size_t vertexCount = vertexs.size();
+	if (!readChildren(L"select shell_id, pos_x, pos_y, pos_z from shell_vertex", L"shell_id", shellIds, [&]() {
+		vertexs.resize(vertexCount);
+		for (auto &shell : combine.shellStorage)
+			shell.numVertexs = 0;
+	}, [&](size_t i, sqlite3_stmt *pStmt) {
+		CombineBlock::Shell &shell = combine.shellStorage[i];
+		appendVertex(pStmt, shell.firstVertex, shell.numVertexs);
+	}))
+		return false;
 
-		osg::ref_ptr<osg::Geode> pyramidGeode(new osg::Geode);
-		pyramidGeode->addDrawable(pyramid);
-		group->addChild(pyramidGeode);
-	}
+	vertexCount = vertexs.size();
+	if (!readChildren(L"select mesh_id, pos_x, pos_y, pos_z from mesh_vertex", L"mesh_id", meshIds, [&]() {
+		vertexs.resize(vertexCount);
+		for (auto &mesh : combine.meshStorage)
+			mesh.numVertexs = 0;
+	}, [&](size_t i, sqlite3_stmt *pStmt) {
+		CombineBlock::Mesh &mesh = combine.meshStorage[i];
+		appendVertex(pStmt, mesh.firstVertex, mesh.numVertexs);
+	}))
+		return false;
 
-	m_root->addChild(group);
-	m_errorCode = sqlite3_finalize(pStmt);
-	pStmt = NULL;
+	vertexCount = vertexs.size();
+	if (!readChildren(L"select polygon_id, pos_x, pos_y, pos_z from polygon_vertex", L"polygon_id", polygonIds, [&]() {
+		vertexs.resize(vertexCount);
+		for (auto &polygon : combine.polygonStorage)
+			polygon.numVertexs = 0;
+	}, [&](size_t i, sqlite3_stmt *pStmt) {
+		CombineBlock::Polygon &polygon = combine.polygonStorage[i];
+		appendVertex(pStmt, polygon.firstVertex, polygon.numVertexs);
+	}))
+		return false;
 
 	return true;
 }
 
-bool SqliteLoad::loadRectCirc()
+bool SqliteLoad::readPackedParts(const std::vector<int> &shapeIds, CombineBlock &combine)
 {
-	const wchar_t *zSql = L"select rect_center_x, rect_center_y, rect_center_z, "
-		L" xlen_x, xlen_y, xlen_z, "
-		L" height_x, height_y, height_z, "
-		L" offset_x, offset_y, offset_z, "
-		L" ylen, radius, color from rect_circ";
-	sqlite3_stmt *pStmt = NULL;
-	const void *pzTail = NULL;
-	if ((m_errorCode = sqlite3_prepare16(m_pDb, zSql, -1, &pStmt, &pzTail)) != SQLITE_OK)
+	std::vector<float> &vertexs = combine.vertexStorage;
+	std::vector<int> &faces = combine.faceStorage;
+	bool shared = m_schemaVersion >= 6;
+
+	if (!readRows(shared ? L"select shape_id, vertexs, faces from shell order by id"
+		: L"select combine_geometry_id, vertexs, faces from shell order by id", [&](sqlite3_stmt *pStmt) {
+		CombineBlock::Shell shell = { FindId(shapeIds, sqlite3_column_int(pStmt, 0)), 0, 0, 0, 0 };
+		AppendBlob(pStmt, 1, 3, vertexs, shell.firstVertex, shell.numVertexs);
+		AppendBlob(pStmt, 2, 1, faces, shell.firstFace, shell.numFaces);
+		combine.shellStorage.push_back(shell);
+	}))
 		return false;
 
-	osg::ref_ptr<Geometry::DynamicLOD> lod(new Geometry::DynamicLOD(m_mani));
-
-	osg::Vec3 rectCenter, height, xLen, offset;
-	double yLen, radius;
-	int color;
-	while ((m_errorCode = sqlite3_step(pStmt)) != SQLITE_DONE)
-	{
-		if (m_errorCode != SQLITE_ROW)
-		{
-			sqlite3_finalize(pStmt);
-			return false;
-		};
+	if (!readRows(shared ? L"select shape_id, rows, columns, vertexs from mesh order by id"
+		: L"select combine_geometry_id, rows, columns, vertexs from mesh order by id", [&](sqlite3_stmt *pStmt) {
+		CombineBlock::Mesh mesh = { FindId(shapeIds, sqlite3_column_int(pStmt, 0)),
+			sqlite3_column_int(pStmt, 1), sqlite3_column_int(pStmt, 2), 0, 0 };
+		AppendBlob(pStmt, 3, 3, vertexs, mesh.firstVertex, mesh.numVertexs);
+		combine.meshStorage.push_back(mesh);
+	}))
+		return false;
 
-		int iCol = 0;
-		rectCenter[0] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		rectCenter[1] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		rectCenter[2] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-
-		xLen[0] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		xLen[1] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		xLen[2] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-
-		height[0] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		height[1] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		height[2] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-
-		offset[0] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		offset[1] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		offset[2] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-
-		yLen = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		radius = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		color = sqlite3_column_int(pStmt, iCol);
+	if (!readRows(shared ? L"select shape_id, vertexs from polygon order by id"
+		: L"select combine_geometry_id, vertexs from polygon order by id", [&](sqlite3_stmt *pStmt) {
+		CombineBlock::Polygon polygon = { FindId(shapeIds, sqlite3_column_int(pStmt, 0)), 0, 0 };
+		AppendBlob(pStmt, 1, 3, vertexs, polygon.firstVertex, polygon.numVertexs);
+		combine.polygonStorage.push_back(polygon);
+	}))
+		return false;
 
-		osg::ref_ptr<Geometry::RectCirc> rectCirc(new Geometry::RectCirc);
-		rectCirc->setRectCenter(rectCenter);
-		rectCirc->setHeight(height);
-		rectCirc->setXLen(xLen);
-		rectCirc->setOffset(offset);
-		rectCirc->setYLen(yLen);
-		rectCirc->setRadius(radius);
-		rectCirc->setColor(CvtColor(color));
-		rectCirc->draw();
+	return true;
+}
 
-		osg::ref_ptr<osg::Geode> ctGeode(new osg::Geode);
-		ctGeode->addDrawable(rectCirc);
-		lod->addChild(ctGeode);
+bool SqliteLoad::readReferences(ReferenceBlock &references)
+{
+	if (m_schemaVersion < 3)
+	{
+		references.bind();
+		return true;
 	}
 
-	m_root->addChild(lod);
-	m_errorCode = sqlite3_finalize(pStmt);
-	pStmt = NULL;
+	// the axes and origin of blockTransform() become the rows of the osg
+	// matrix, osg multiplies row vectors
+	if (!readRows(L"select definition_id, block_id, x_axis_x, x_axis_y, x_axis_z, "
+		L" y_axis_x, y_axis_y, y_axis_z, z_axis_x, z_axis_y, z_axis_z, "
+		L" origin_x, origin_y, origin_z from block_reference order by id", [&](sqlite3_stmt *pStmt) {
+		ReferenceBlock::Reference reference;
+		reference.definition = sqlite3_column_int(pStmt, 0);
+		reference.block = sqlite3_column_int(pStmt, 1);
+		for (int row = 0; row < 4; ++row)
+		{
+			for (int col = 0; col < 3; ++col)
+				reference.matrix[row * 4 + col] = sqlite3_column_double(pStmt, 2 + row * 3 + col);
+			reference.matrix[row * 4 + 3] = row == 3 ? 1.0 : 0.0;
+		}
+		references.referenceStorage.push_back(reference);
+	}))
+		return false;
 
+	references.bind();
 	return true;
 }
 
-bool SqliteLoad::loadRectangularTorus()
+bool SqliteLoad::readProfiles(ProfileBlock &profiles)
 {
-	const wchar_t *zSql = L"select center_x, center_y, center_z, "
-		L" start_pnt_x, start_pnt_y, start_pnt_z, "
-		L" normal_x, normal_y, normal_z, "
-		L" start_width, start_height, end_width, end_height, angle, color from rectangular_torus";
-	sqlite3_stmt *pStmt = NULL;
-	const void *pzTail = NULL;
-	if ((m_errorCode = sqlite3_prepare16(m_pDb, zSql, -1, &pStmt, &pzTail)) != SQLITE_OK)
+	if (m_schemaVersion < 5)
+	{
+		profiles.bind();
+		return true;
+	}
+
+	// a flag per vertex, the flag pool stays as long as the vertex pool
+	std::vector<float> &vertexs = profiles.vertexStorage;
+	std::vector<int> &flags = profiles.flagStorage;
+	unsigned int firstFlag, numFlags;
+	if (!readRows(L"select color, block_id, axis_pnt_x, axis_pnt_y, axis_pnt_z, axis_x, axis_y, axis_z, angle, "
+		L" vertexs, flags from revolve order by block_id, id", [&](sqlite3_stmt *pStmt) {
+		ProfileBlock::Revolve revolve;
+		revolve.color = sqlite3_column_int(pStmt, 0);
+		revolve.block = sqlite3_column_int(pStmt, 1);
+		for (int j = 0; j < 3; ++j)
+		{
+			revolve.axisPnt[j] = sqlite3_column_double(pStmt, 2 + j);
+			revolve.axis[j] = sqlite3_column_double(pStmt, 5 + j);
+		}
+		revolve.angle = sqlite3_column_double(pStmt, 8);
+		AppendBlob(pStmt, 9, 3, vertexs, revolve.firstVertex, revolve.numVertexs);
+		AppendBlob(pStmt, 10, 1, flags, firstFlag, numFlags);
+		flags.resize(vertexs.size() / 3);
+		profiles.revolveStorage.push_back(revolve);
+	}))
 		return false;
 
-	osg::ref_ptr<Geometry::DynamicLOD> lod(new Geometry::DynamicLOD(m_mani));
+	if (!readRows(L"select color, block_id, height_x, height_y, height_z, vertexs, flags, loops "
+		L" from extrusion order by block_id, id", [&](sqlite3_stmt *pStmt) {
+		ProfileBlock::Extrusion extrusion;
+		extrusion.color = sqlite3_column_int(pStmt, 0);
+		extrusion.block = sqlite3_column_int(pStmt, 1);
+		for (int j = 0; j < 3; ++j)
+			extrusion.height[j] = sqlite3_column_double(pStmt, 2 + j);
+		AppendBlob(pStmt, 5, 3, vertexs, extrusion.firstVertex, extrusion.numVertexs);
+		AppendBlob(pStmt, 6, 1, flags, firstFlag, numFlags);
+		flags.resize(vertexs.size() / 3);
+		AppendBlob(pStmt, 7, 1, profiles.loopStorage, extrusion.firstLoop, extrusion.numLoops);
+		profiles.extrusionStorage.push_back(extrusion);
+	}))
+		return false;
 
-	osg::Vec3 center, startPnt, normal;
-	double startWidth, startHeight, endWidth, endHeight, angle;
-	int color;
-	while ((m_errorCode = sqlite3_step(pStmt)) != SQLITE_DONE)
+	profiles.bind();
+	return true;
+}
+
+void SqliteLoad::buildScene(const std::vector<ParamBlock> &blocks, const CombineBlock &combine,
+	const ReferenceBlock &references, const ProfileBlock &profiles, unsigned int numThreads)
+{
+	std::vector<Pending> pendings;
+	if (numThreads > 1)
+		m_pendings = &pendings;
+	m_blockGroups.clear();
+	for (unsigned int i = 0; i < NUM_TABLES; ++i)
 	{
-		if (m_errorCode != SQLITE_ROW)
+		// one run of rows per block definition
+		const ParamBlock &block = blocks[i];
+		for (unsigned int first = 0; first < block.numRows;)
 		{
-			sqlite3_finalize(pStmt);
-			return false;
-		};
-
-		int iCol = 0;
-		center[0] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		center[1] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		center[2] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-
-		startPnt[0] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		startPnt[1] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		startPnt[2] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-
-		normal[0] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		normal[1] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		normal[2] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-
-		startWidth = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		startHeight = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		endWidth = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		endHeight = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		angle = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		color = sqlite3_column_int(pStmt, iCol);
+			int blockId = block.getBlockId(first);
+			unsigned int last = first + 1;
+			while (last < block.numRows && block.getBlockId(last) == blockId)
+				++last;
+			(this->*TABLES[i].builder)(block, first, last, getBlockGroup(blockId));
+			first = last;
+		}
+	}
+	buildCombineGeometry(combine);
+	buildProfiles(profiles);
 
-		osg::ref_ptr<Geometry::RectangularTorus> rt(new Geometry::RectangularTorus);
-		rt->setCenter(center);
-		rt->setStartPnt(startPnt);
-		rt->setNormal(normal);
-		rt->setStartWidth(startWidth);
-		rt->setStartHeight(startHeight);
-		rt->setEndWidth(endWidth);
-		rt->setEndHeight(endHeight);
-		rt->setAngle(angle);
-		rt->setColor(CvtColor(color));
-		rt->draw();
+	// every reference shares the subgraph of its definition
+	for (unsigned int i = 0; i < references.numReferences; ++i)
+	{
+		const ReferenceBlock::Reference &reference = references.references[i];
+		osg::ref_ptr<osg::MatrixTransform> transform(new osg::MatrixTransform(osg::Matrixd(reference.matrix)));
+		transform->addChild(getBlockGroup(reference.definition));
+		getBlockGroup(reference.block)->addChild(transform);
+	}
+	m_pendings = NULL;
+	if (pendings.empty())
+		return;
+
+	// tessellate all tables together, so one big table does not hold a
+	// single thread
+	const unsigned int CHUNK_SIZE = 256;
+	OpenThreads::Atomic nextChunk;
+	RunThreads(numThreads, [&]() {
+		for (;;)
+		{
+			size_t first = static_cast<size_t>(++nextChunk - 1) * CHUNK_SIZE;
+			if (first >= pendings.size())
+				break;
+			size_t last = osg::minimum(first + CHUNK_SIZE, pendings.size());
+			for (size_t i = first; i < last; ++i)
+				pendings[i].geometry->draw();
+		}
+	});
 
-		osg::ref_ptr<osg::Geode> ctGeode(new osg::Geode);
-		ctGeode->addDrawable(rt);
-		lod->addChild(ctGeode);
+	// insert here, in the same order as the serial load
+	for (size_t i = 0; i < pendings.size(); ++i)
+	{
+		if (pendings[i].parent.valid())
+			pendings[i].parent->addChild(Geometry::CreateGeometryNode(pendings[i].geometry));
 	}
+}
 
-	m_root->addChild(lod);
-	m_errorCode = sqlite3_finalize(pStmt);
-	pStmt = NULL;
+osg::Group *SqliteLoad::getBlockGroup(int blockId)
+{
+	if (blockId == 0)
+		return m_root;
 
-	return true;
+	osg::ref_ptr<osg::Group> &group = m_blockGroups[blockId];
+	if (!group.valid())
+		group = new osg::Group;
+	return group;
 }
 
-bool SqliteLoad::loadSaddle()
+void SqliteLoad::addNode(osg::Group *parent, Geometry::BaseGeometry *geometry)
 {
-	const wchar_t *zSql = L"select org_x, org_y, org_z, "
-		L" xlen_x, xlen_y, xlen_z, "
-		L" zlen_x, zlen_y, zlen_z, "
-		L" ylen, radius, color from saddle";
-	sqlite3_stmt *pStmt = NULL;
-	const void *pzTail = NULL;
-	if ((m_errorCode = sqlite3_prepare16(m_pDb, zSql, -1, &pStmt, &pzTail)) != SQLITE_OK)
-		return false;
+	if (m_pendings != NULL)
+	{
+		Pending pending;
+		pending.parent = parent;
+		pending.geometry = geometry;
+		m_pendings->push_back(pending);
+		return;
+	}
 
-	osg::ref_ptr<Geometry::DynamicLOD> lod(new Geometry::DynamicLOD(m_mani));
+	geometry->draw();
+	parent->addChild(Geometry::CreateGeometryNode(geometry));
+}
 
-	osg::Vec3 org, xLen, zLen;
-	double yLen, radius;
-	int color;
-	while ((m_errorCode = sqlite3_step(pStmt)) != SQLITE_DONE)
+void SqliteLoad::drawGeometry(Geometry::BaseGeometry *geometry)
+{
+	if (m_pendings != NULL)
 	{
-		if (m_errorCode != SQLITE_ROW)
-		{
-			sqlite3_finalize(pStmt);
-			return false;
-		};
-
-		int iCol = 0;
-		org[0] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		org[1] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		org[2] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-
-		xLen[0] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		xLen[1] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		xLen[2] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-
-		zLen[0] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		zLen[1] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		zLen[2] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-
-		yLen = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		radius = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		color = sqlite3_column_int(pStmt, iCol);
+		Pending pending;
+		pending.geometry = geometry;
+		m_pendings->push_back(pending);
+		return;
+	}
 
-		osg::ref_ptr<Geometry::Saddle> saddle(new Geometry::Saddle);
-		saddle->setOrg(org);
-		saddle->setXLen(xLen);
-		saddle->setZLen(zLen);
-		saddle->setYLen(yLen);
-		saddle->setRadius(radius);
-		saddle->setColor(CvtColor(color));
-		saddle->draw();
+	geometry->draw();
+}
 
-		osg::ref_ptr<osg::Geode> ctGeode(new osg::Geode);
-		ctGeode->addDrawable(saddle);
-		lod->addChild(ctGeode);
+void SqliteLoad::addGeometry(osg::Group *parent, BatchMap &batchs, int color, Geometry::BaseGeometry *geometry)
+{
+	if (m_division != 0)
+		geometry->setDivision(m_division);
+	if (m_batchMode)
+	{
+		osg::ref_ptr<Geometry::BatchGeometry> &batch = batchs[color];
+		if (batch.valid() && batch->getNumGeometries() >= MAX_BATCH_SIZE)
+		{
+			addBatch(parent, batch);
+			batch = NULL;
+		}
+		if (!batch.valid())
+		{
+			batch = new Geometry::BatchGeometry;
+			batch->setColor(CvtColor(color));
+		}
+		batch->addGeometry(geometry);
+		return;
 	}
 
-	m_root->addChild(lod);
-	m_errorCode = sqlite3_finalize(pStmt);
-	pStmt = NULL;
+	geometry->setInstancing(m_instancing);
+	addNode(parent, geometry);
+}
 
-	return true;
+void SqliteLoad::flushBatchs(osg::Group *parent, BatchMap &batchs)
+{
+	for (auto &entry : batchs)
+		addBatch(parent, entry.second);
+	batchs.clear();
 }
 
-bool SqliteLoad::loadSCylinder()
+void SqliteLoad::addBatch(osg::Group *parent, Geometry::BatchGeometry *batch)
 {
-	const wchar_t *zSql = L"select org_x, org_y, org_z, "
-		L" height_x, height_y, height_z, "
-		L" bottom_normal_x, bottom_normal_y, bottom_normal_z, "
-		L" radius, color from scylinder";
-	sqlite3_stmt *pStmt = NULL;
-	const void *pzTail = NULL;
-	if ((m_errorCode = sqlite3_prepare16(m_pDb, zSql, -1, &pStmt, &pzTail)) != SQLITE_OK)
-		return false;
+	addNode(parent, batch);
+}
 
-	osg::ref_ptr<Geometry::DynamicLOD> lod(new Geometry::DynamicLOD(m_mani));
+const char * SqliteLoad::getErrorMessage() const
+{
+	if (!m_errorMessage.empty())
+		return m_errorMessage.c_str();
+	return sqlite3_errmsg(m_pDb);
+}
 
-	osg::Vec3 org, height, bottomNormal;
-	double radius;
-	int color;
-	while ((m_errorCode = sqlite3_step(pStmt)) != SQLITE_DONE)
-	{
-		if (m_errorCode != SQLITE_ROW)
-		{
-			sqlite3_finalize(pStmt);
-			return false;
-		};
+const std::string &SqliteLoad::getReport() const
+{
+	return m_report;
+}
 
-		int iCol = 0;
-		org[0] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		org[1] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		org[2] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-
-		height[0] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		height[1] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		height[2] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-
-		bottomNormal[0] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		bottomNormal[1] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		bottomNormal[2] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-
-		radius = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		color = sqlite3_column_int(pStmt, iCol);
+int SqliteLoad::init()
+{
+	return sqlite3_open(m_filePath.c_str(), &m_pDb);
+}
 
-		osg::ref_ptr<Geometry::SCylinder> scylinder(new Geometry::SCylinder);
-		scylinder->setOrg(org);
-		scylinder->setHeight(height);
-		scylinder->setBottomNormal(bottomNormal);
-		scylinder->setRadius(radius);
-		scylinder->setColor(CvtColor(color));
-		scylinder->draw();
+void SqliteLoad::buildBox(const ParamBlock &block, unsigned int first, unsigned int last, osg::Group *parent)
+{
+	osg::ref_ptr<Geometry::DynamicLOD> lod(new Geometry::DynamicLOD(m_mani));
+	BatchMap batchs;
 
-		osg::ref_ptr<osg::Geode> ctGeode(new osg::Geode);
-		ctGeode->addDrawable(scylinder);
-		lod->addChild(ctGeode);
+	for (unsigned int i = first; i < last; ++i)
+	{
+		int color = block.getColor(i);
+		osg::ref_ptr<Geometry::Box> box(new Geometry::Box);
+		box->setOrg(block.getVec3(i, 0));
+		box->setXLen(block.getVec3(i, 3));
+		box->setYLen(block.getVec3(i, 6));
+		box->setZLen(block.getVec3(i, 9));
+		box->setColor(CvtColor(color));
+		addGeometry(lod, batchs, color, box);
 	}
 
-	m_root->addChild(lod);
-	m_errorCode = sqlite3_finalize(pStmt);
-	pStmt = NULL;
-
-	return true;
+	flushBatchs(lod, batchs);
+	parent->addChild(lod);
 }
 
-bool SqliteLoad::loadSnout()
+void SqliteLoad::buildCircularTorus(const ParamBlock &block, unsigned int first, unsigned int last, osg::Group *parent)
 {
-	const wchar_t *zSql = L"select org_x, org_y, org_z, "
-		L" height_x, height_y, height_z, "
-		L" offset_x, offset_y, offset_z, "
-		L" bottom_radius, top_radius, color from snout";
-	sqlite3_stmt *pStmt = NULL;
-	const void *pzTail = NULL;
-	if ((m_errorCode = sqlite3_prepare16(m_pDb, zSql, -1, &pStmt, &pzTail)) != SQLITE_OK)
-		return false;
-
-	osg::ref_ptr<Geometry::DynamicLOD> load(new Geometry::DynamicLOD(m_mani));
+	osg::ref_ptr<Geometry::DynamicLOD> lod(new Geometry::DynamicLOD(m_mani));
+	BatchMap batchs;
 
-	osg::Vec3 org, height, offset;
-	double bottomRadius, topRadius;
-	int color;
-	while ((m_errorCode = sqlite3_step(pStmt)) != SQLITE_DONE)
+	for (unsigned int i = first; i < last; ++i)
 	{
-		if (m_errorCode != SQLITE_ROW)
-		{
-			sqlite3_finalize(pStmt);
-			return false;
-		};
+		int color = block.getColor(i);
+		osg::ref_ptr<Geometry::CircularTorus> ct(new Geometry::CircularTorus);
+		ct->setCenter(block.getVec3(i, 0));
+		ct->setStartPnt(block.getVec3(i, 3));
+		ct->setNormal(block.getVec3(i, 6));
+		ct->setStartRadius(block.get(i, 9));
+		ct->setEndRadius(block.get(i, 10));
+		ct->setAngle(block.get(i, 11));
+		ct->setColor(CvtColor(color));
+		addGeometry(lod, batchs, color, ct);
+	}
 
-		int iCol = 0;
-		org[0] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		org[1] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		org[2] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-
-		height[0] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		height[1] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		height[2] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-
-		offset[0] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		offset[1] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		offset[2] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-
-		bottomRadius = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		topRadius = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		color = sqlite3_column_int(pStmt, iCol);
+	flushBatchs(lod, batchs);
+	parent->addChild(lod);
+}
 
-		osg::ref_ptr<Geometry::Snout> snout(new Geometry::Snout);
-		snout->setOrg(org);
-		snout->setHeight(height);
-		snout->setOffset(offset);
-		snout->setBottomRadius(bottomRadius);
-		snout->setTopRadius(topRadius);
-		snout->setColor(CvtColor(color));
-		snout->draw();
+void SqliteLoad::buildCone(const ParamBlock &block, unsigned int first, unsigned int last, osg::Group *parent)
+{
+	osg::ref_ptr<Geometry::DynamicLOD> lod(new Geometry::DynamicLOD(m_mani));
+	BatchMap batchs;
 
-		osg::ref_ptr<osg::Geode> snoutGeode(new osg::Geode);
-		snoutGeode->addDrawable(snout);
-		load->addChild(snoutGeode);
+	for (unsigned int i = first; i < last; ++i)
+	{
+		int color = block.getColor(i);
+		osg::ref_ptr<Geometry::Cone> cone(new Geometry::Cone);
+		cone->setOrg(block.getVec3(i, 0));
+		cone->setHeight(block.getVec3(i, 3));
+		cone->setOffset(block.getVec3(i, 6));
+		cone->setRadius(block.get(i, 9));
+		cone->setColor(CvtColor(color));
+		addGeometry(lod, batchs, color, cone);
 	}
 
-	m_root->addChild(load);
-	m_errorCode = sqlite3_finalize(pStmt);
-	pStmt = NULL;
-
-	return true;
+	flushBatchs(lod, batchs);
+	parent->addChild(lod);
 }
 
-bool SqliteLoad::loadSphere()
+void SqliteLoad::buildCylinder(const ParamBlock &block, unsigned int first, unsigned int last, osg::Group *parent)
 {
-	const wchar_t *zSql = L"select center_x, center_y, center_z, "
-		L" bottom_normal_x, bottom_normal_y, bottom_normal_z, "
-		L" radius, angle, color from sphere";
-	sqlite3_stmt *pStmt = NULL;
-	const void *pzTail = NULL;
-	if ((m_errorCode = sqlite3_prepare16(m_pDb, zSql, -1, &pStmt, &pzTail)) != SQLITE_OK)
-		return false;
-
-	osg::ref_ptr<Geometry::DynamicLOD> load(new Geometry::DynamicLOD(m_mani));
+	osg::ref_ptr<Geometry::DynamicLOD> lod(new Geometry::DynamicLOD(m_mani));
+	BatchMap batchs;
 
-	osg::Vec3 center, height, bottomNormal;
-	double radius, angle;
-	int color;
-	while ((m_errorCode = sqlite3_step(pStmt)) != SQLITE_DONE)
+	for (unsigned int i = first; i < last; ++i)
 	{
-		if (m_errorCode != SQLITE_ROW)
-		{
-			sqlite3_finalize(pStmt);
-			return false;
-		};
+		int color = block.getColor(i);
+		osg::ref_ptr<Geometry::Cylinder> cylinder(new Geometry::Cylinder);
+		cylinder->setOrg(block.getVec3(i, 0));
+		cylinder->setHeight(block.getVec3(i, 3));
+		cylinder->setRadius(block.get(i, 6));
+		cylinder->setColor(CvtColor(color));
+		addGeometry(lod, batchs, color, cylinder);
+	}
 
-		int iCol = 0;
-		center[0] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		center[1] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		center[2] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-
-		bottomNormal[0] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		bottomNormal[1] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		bottomNormal[2] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-
-		radius = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		angle = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		color = sqlite3_column_int(pStmt, iCol);
+	flushBatchs(lod, batchs);
+	parent->addChild(lod);
+}
 
-		osg::ref_ptr<Geometry::Sphere> sphere(new Geometry::Sphere);
-		sphere->setCenter(center);
-		sphere->setBottomNormal(bottomNormal);
-		sphere->setRadius(radius);
-		sphere->setAngle(angle);
-		sphere->setColor(CvtColor(color));
-		sphere->draw();
+void SqliteLoad::buildEllipsoid(const ParamBlock &block, unsigned int first, unsigned int last, osg::Group *parent)
+{
+	osg::ref_ptr<Geometry::DynamicLOD> lod(new Geometry::DynamicLOD(m_mani));
+	BatchMap batchs;
 
-		osg::ref_ptr<osg::Geode> sphereGeode(new osg::Geode);
-		sphereGeode->addDrawable(sphere);
-		load->addChild(sphereGeode);
+	for (unsigned int i = first; i < last; ++i)
+	{
+		int color = block.getColor(i);
+		osg::ref_ptr<Geometry::Ellipsoid> ellipsoid(new Geometry::Ellipsoid);
+		ellipsoid->setCenter(block.getVec3(i, 0));
+		ellipsoid->setALen(block.getVec3(i, 3));
+		ellipsoid->setBRadius(block.get(i, 6));
+		ellipsoid->setAngle(block.get(i, 7));
+		ellipsoid->setColor(CvtColor(color));
+		addGeometry(lod, batchs, color, ellipsoid);
 	}
 
-	m_root->addChild(load);
-	m_errorCode = sqlite3_finalize(pStmt);
-	pStmt = NULL;
-
-	return true;
+	flushBatchs(lod, batchs);
+	parent->addChild(lod);
 }
 
-bool SqliteLoad::loadWedge()
+void SqliteLoad::buildPrism(const ParamBlock &block, unsigned int first, unsigned int last, osg::Group *parent)
 {
-	const wchar_t *zSql = L"select org_x, org_y, org_z, "
-		L" edge1_x, edge1_y, edge1_z, "
-		L" edge2_x, edge2_y, edge2_z, "
-		L" height_x, height_y, height_z, "
-		L" color from wedge";
-	sqlite3_stmt *pStmt = NULL;
-	const void *pzTail = NULL;
-	if ((m_errorCode = sqlite3_prepare16(m_pDb, zSql, -1, &pStmt, &pzTail)) != SQLITE_OK)
-		return false;
-
 	osg::ref_ptr<Geometry::DynamicLOD> lod(new Geometry::DynamicLOD(m_mani));
+	BatchMap batchs;
 
-	osg::Vec3 org, edge1, edge2, height;
-	int color;
-	while ((m_errorCode = sqlite3_step(pStmt)) != SQLITE_DONE)
+	for (unsigned int i = first; i < last; ++i)
 	{
-		if (m_errorCode != SQLITE_ROW)
-		{
-			sqlite3_finalize(pStmt);
-			return false;
-		}
+		int color = block.getColor(i);
+		osg::ref_ptr<Geometry::Prism> prism(new Geometry::Prism);
+		prism->setOrg(block.getVec3(i, 0));
+		prism->setHeight(block.getVec3(i, 3));
+		prism->setBottomStartPnt(block.getVec3(i, 6));
+		prism->setEdgeNum(static_cast<int>(block.get(i, 9)));
+		prism->setColor(CvtColor(color));
+		addGeometry(lod, batchs, color, prism);
+	}
 
-		int iCol = 0;
-		org[0] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		org[1] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		org[2] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-
-		edge1[0] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		edge1[1] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		edge1[2] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-
-		edge2[0] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		edge2[1] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		edge2[2] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-
-		height[0] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		height[1] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		height[2] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-
-		color = sqlite3_column_int(pStmt, iCol);
+	flushBatchs(lod, batchs);
+	parent->addChild(lod);
+}
 
-		osg::ref_ptr<Geometry::Wedge> wedge(new Geometry::Wedge);
-		wedge->setOrg(org);
-		wedge->setEdge1(edge1);
-		wedge->setEdge2(edge2);
-		wedge->setHeight(height);
-		wedge->setColor(CvtColor(color));
-		wedge->draw();
+void SqliteLoad::buildPyramid(const ParamBlock &block, unsigned int first, unsigned int last, osg::Group *parent)
+{
+	osg::ref_ptr<osg::Group> group(new osg::Group);
+	BatchMap batchs;
 
-		osg::ref_ptr<osg::Geode> wedgeGeode(new osg::Geode);
-		wedgeGeode->addDrawable(wedge);
-		lod->addChild(wedgeGeode);
+	for (unsigned int i = first; i < last; ++i)
+	{
+		int color = block.getColor(i);
+		osg::ref_ptr<Geometry::Pyramid> pyramid(new Geometry::Pyramid);
+		pyramid->setOrg(block.getVec3(i, 0));
+		pyramid->setHeight(block.getVec3(i, 3));
+		pyramid->setXAxis(block.getVec3(i, 6));
+		pyramid->setOffset(block.getVec3(i, 9));
+		pyramid->setBottomXLen(block.get(i, 12));
+		pyramid->setBottomYLen(block.get(i, 13));
+		pyramid->setTopXLen(block.get(i, 14));
+		pyramid->setTopYLen(block.get(i, 15));
+		pyramid->setColor(CvtColor(color));
+		addGeometry(group, batchs, color, pyramid);
 	}
 
-	m_root->addChild(lod);
-	m_errorCode = sqlite3_finalize(pStmt);
-	pStmt = NULL;
-
-	return true;
+	flushBatchs(group, batchs);
+	parent->addChild(group);
 }
 
-bool SqliteLoad::loadCombineGeometry()
+void SqliteLoad::buildRectCirc(const ParamBlock &block, unsigned int first, unsigned int last, osg::Group *parent)
 {
-	std::unordered_map<int, osg::ref_ptr<Geometry::CombineGeometry>> cgMap;
-	std::unordered_map<int, std::shared_ptr<Geometry::Shell>> shellMap;
-	std::unordered_map<int, std::shared_ptr<Geometry::Mesh>> meshMap;
-	std::unordered_map<int, std::shared_ptr<Geometry::Polygon>> polygonMap;
+	osg::ref_ptr<Geometry::DynamicLOD> lod(new Geometry::DynamicLOD(m_mani));
+	BatchMap batchs;
 
-	const wchar_t *zCgSql = L"select id, color from combine_geometry";
-	sqlite3_stmt *pStmt = NULL;
-	const void *pzTail = NULL;
-	if ((m_errorCode = sqlite3_prepare16(m_pDb, zCgSql, -1, &pStmt, &pzTail)) != SQLITE_OK)
-		return false;
-	
-	int id, color;
-	while ((m_errorCode = sqlite3_step(pStmt)) != SQLITE_DONE)
+	for (unsigned int i = first; i < last; ++i)
 	{
-		if (m_errorCode != SQLITE_ROW)
-		{
-			sqlite3_finalize(pStmt);
-			return false;
-		}
+		int color = block.getColor(i);
+		osg::ref_ptr<Geometry::RectCirc> rectCirc(new Geometry::RectCirc);
+		rectCirc->setRectCenter(block.getVec3(i, 0));
+		rectCirc->setXLen(block.getVec3(i, 3));
+		rectCirc->setHeight(block.getVec3(i, 6));
+		rectCirc->setOffset(block.getVec3(i, 9));
+		rectCirc->setYLen(block.get(i, 12));
+		rectCirc->setRadius(block.get(i, 13));
+		rectCirc->setColor(CvtColor(color));
+		addGeometry(lod, batchs, color, rectCirc);
+	}
 
-		int iCol = 0;
-		id = sqlite3_column_int(pStmt, iCol);
-		++iCol;
-		color = sqlite3_column_int(pStmt, iCol);
+	flushBatchs(lod, batchs);
+	parent->addChild(lod);
+}
 
-		osg::ref_ptr<Geometry::CombineGeometry> cg(new Geometry::CombineGeometry);
-		cg->setColor(CvtColor(color));
-		cgMap.insert(std::make_pair(id, cg));
+void SqliteLoad::buildRectangularTorus(const ParamBlock &block, unsigned int first, unsigned int last, osg::Group *parent)
+{
+	osg::ref_ptr<Geometry::DynamicLOD> lod(new Geometry::DynamicLOD(m_mani));
+	BatchMap batchs;
+
+	for (unsigned int i = first; i < last; ++i)
+	{
+		int color = block.getColor(i);
+		osg::ref_ptr<Geometry::RectangularTorus> rt(new Geometry::RectangularTorus);
+		rt->setCenter(block.getVec3(i, 0));
+		rt->setStartPnt(block.getVec3(i, 3));
+		rt->setNormal(block.getVec3(i, 6));
+		rt->setStartWidth(block.get(i, 9));
+		rt->setStartHeight(block.get(i, 10));
+		rt->setEndWidth(block.get(i, 11));
+		rt->setEndHeight(block.get(i, 12));
+		rt->setAngle(block.get(i, 13));
+		rt->setColor(CvtColor(color));
+		addGeometry(lod, batchs, color, rt);
 	}
-	m_errorCode = sqlite3_finalize(pStmt);
-	pStmt = NULL;
 
-	const wchar_t *zShellSql = L"select id, combine_geometry_id from shell";
-	if ((m_errorCode = sqlite3_prepare16(m_pDb, zShellSql, -1, &pStmt, &pzTail)) != SQLITE_OK)
-		return false;
+	flushBatchs(lod, batchs);
+	parent->addChild(lod);
+}
 
-	int cgId;
-	while ((m_errorCode = sqlite3_step(pStmt)) != SQLITE_DONE)
+void SqliteLoad::buildSaddle(const ParamBlock &block, unsigned int first, unsigned int last, osg::Group *parent)
+{
+	osg::ref_ptr<Geometry::DynamicLOD> lod(new Geometry::DynamicLOD(m_mani));
+	BatchMap batchs;
+
+	for (unsigned int i = first; i < last; ++i)
 	{
-		if (m_errorCode != SQLITE_ROW)
-		{
-			sqlite3_finalize(pStmt);
-			return false;
-		}
+		int color = block.getColor(i);
+		osg::ref_ptr<Geometry::Saddle> saddle(new Geometry::Saddle);
+		saddle->setOrg(block.getVec3(i, 0));
+		saddle->setXLen(block.getVec3(i, 3));
+		saddle->setZLen(block.getVec3(i, 6));
+		saddle->setYLen(block.get(i, 9));
+		saddle->setRadius(block.get(i, 10));
+		saddle->setColor(CvtColor(color));
+		addGeometry(lod, batchs, color, saddle);
+	}
 
-		int iCol = 0;
-		id = sqlite3_column_int(pStmt, iCol);
-		++iCol;
-		cgId = sqlite3_column_int(pStmt, iCol);
+	flushBatchs(lod, batchs);
+	parent->addChild(lod);
+}
 
-		std::shared_ptr<Geometry::Shell> shell(new Geometry::Shell);
-		shellMap.insert(std::make_pair(id, shell));
-		auto iter = cgMap.find(cgId);
-		if (iter != cgMap.end())
-			iter->second->addShell(shell);
+void SqliteLoad::buildSCylinder(const ParamBlock &block, unsigned int first, unsigned int last, osg::Group *parent)
+{
+	osg::ref_ptr<Geometry::DynamicLOD> lod(new Geometry::DynamicLOD(m_mani));
+	BatchMap batchs;
+
+	for (unsigned int i = first; i < last; ++i)
+	{
+		int color = block.getColor(i);
+		osg::ref_ptr<Geometry::SCylinder> scylinder(new Geometry::SCylinder);
+		scylinder->setOrg(block.getVec3(i, 0));
+		scylinder->setHeight(block.getVec3(i, 3));
+		scylinder->setBottomNormal(block.getVec3(i, 6));
+		scylinder->setRadius(block.get(i, 9));
+		scylinder->setColor(CvtColor(color));
+		addGeometry(lod, batchs, color, scylinder);
 	}
-	m_errorCode = sqlite3_finalize(pStmt);
-	pStmt = NULL;
 
-	const wchar_t *zShellFaceSql = L"select vertex_index, shell_id from shell_face order by id asc";
-	if ((m_errorCode = sqlite3_prepare16(m_pDb, zShellFaceSql, -1, &pStmt, &pzTail)) != SQLITE_OK)
-		return false;
+	flushBatchs(lod, batchs);
+	parent->addChild(lod);
+}
 
-	int vertexIndex, shellId;
-	while ((m_errorCode = sqlite3_step(pStmt)) != SQLITE_DONE)
+void SqliteLoad::buildSnout(const ParamBlock &block, unsigned int first, unsigned int last, osg::Group *parent)
+{
+	osg::ref_ptr<Geometry::DynamicLOD> lod(new Geometry::DynamicLOD(m_mani));
+	BatchMap batchs;
+
+	for (unsigned int i = first; i < last; ++i)
 	{
-		if (m_errorCode != SQLITE_ROW)
-		{
-			sqlite3_finalize(pStmt);
-			return false;
-		}
+		int color = block.getColor(i);
+		osg::ref_ptr<Geometry::Snout> snout(new Geometry::Snout);
+		snout->setOrg(block.getVec3(i, 0));
+		snout->setHeight(block.getVec3(i, 3));
+		snout->setOffset(block.getVec3(i, 6));
+		snout->setBottomRadius(block.get(i, 9));
+		snout->setTopRadius(block.get(i, 10));
+		snout->setColor(CvtColor(color));
+		addGeometry(lod, batchs, color, snout);
+	}
 
-		int iCol = 0;
-		vertexIndex = sqlite3_column_int(pStmt, iCol);
-		++iCol;
-		shellId = sqlite3_column_int(pStmt, iCol);
+	flushBatchs(lod, batchs);
+	parent->addChild(lod);
+}
 
-		auto iter = shellMap.find(shellId);
-		if (iter != shellMap.end())
-			iter->second->faces.push_back(vertexIndex);
+void SqliteLoad::buildSphere(const ParamBlock &block, unsigned int first, unsigned int last, osg::Group *parent)
+{
+	osg::ref_ptr<Geometry::DynamicLOD> lod(new Geometry::DynamicLOD(m_mani));
+	BatchMap batchs;
+
+	for (unsigned int i = first; i < last; ++i)
+	{
+		int color = block.getColor(i);
+		osg::ref_ptr<Geometry::Sphere> sphere(new Geometry::Sphere);
+		sphere->setCenter(block.getVec3(i, 0));
+		sphere->setBottomNormal(block.getVec3(i, 3));
+		sphere->setRadius(block.get(i, 6));
+		sphere->setAngle(block.get(i, 7));
+		sphere->setColor(CvtColor(color));
+		addGeometry(lod, batchs, color, sphere);
 	}
-	m_errorCode = sqlite3_finalize(pStmt);
-	pStmt = NULL;
 
-	const wchar_t *zShellVertexSql = L"select pos_x, pos_y, pos_z, shell_id from shell_vertex order by id asc";
-	if ((m_errorCode = sqlite3_prepare16(m_pDb, zShellVertexSql, -1, &pStmt, &pzTail)) != SQLITE_OK)
-		return false;
+	flushBatchs(lod, batchs);
+	parent->addChild(lod);
+}
 
-	osg::Vec3 pos;
-	while ((m_errorCode = sqlite3_step(pStmt)) != SQLITE_DONE)
-	{
-		if (m_errorCode != SQLITE_ROW)
-		{
-			sqlite3_finalize(pStmt);
-			return false;
-		}
+void SqliteLoad::buildWedge(const ParamBlock &block, unsigned int first, unsigned int last, osg::Group *parent)
+{
+	osg::ref_ptr<Geometry::DynamicLOD> lod(new Geometry::DynamicLOD(m_mani));
+	BatchMap batchs;
 
-		int iCol = 0;
-		pos[0] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		pos[1] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		pos[2] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		shellId = sqlite3_column_int(pStmt, iCol);
-
-		auto iter = shellMap.find(shellId);
-		if (iter != shellMap.end())
-			iter->second->vertexs.push_back(pos);
+	for (unsigned int i = first; i < last; ++i)
+	{
+		int color = block.getColor(i);
+		osg::ref_ptr<Geometry::Wedge> wedge(new Geometry::Wedge);
+		wedge->setOrg(block.getVec3(i, 0));
+		wedge->setEdge1(block.getVec3(i, 3));
+		wedge->setEdge2(block.getVec3(i, 6));
+		wedge->setHeight(block.getVec3(i, 9));
+		wedge->setColor(CvtColor(color));
+		addGeometry(lod, batchs, color, wedge);
 	}
-	m_errorCode = sqlite3_finalize(pStmt);
-	pStmt = NULL;
 
-	const wchar_t *zMeshSql = L"select rows, columns, combine_geometry_id from mesh";
-	if ((m_errorCode = sqlite3_prepare16(m_pDb, zShellFaceSql, -1, &pStmt, &pzTail)) != SQLITE_OK)
-		return false;
+	flushBatchs(lod, batchs);
+	parent->addChild(lod);
+}
 
-	int rows, columns;
-	while ((m_errorCode = sqlite3_step(pStmt)) != SQLITE_DONE)
+void SqliteLoad::buildCombineGeometry(const CombineBlock &combine)
+{
+	std::vector<ShapeParts> shapes(combine.numShapes);
+	for (unsigned int i = 0; i < combine.numShells; ++i)
 	{
-		if (m_errorCode != SQLITE_ROW)
-		{
-			sqlite3_finalize(pStmt);
-			return false;
-		}
-
-		int iCol = 0;
-		rows = sqlite3_column_int(pStmt, iCol);
-		++iCol;
-		columns = sqlite3_column_int(pStmt, iCol);
-		++iCol;
-		cgId = sqlite3_column_int(pStmt, iCol);
+		const CombineBlock::Shell &entry = combine.shells[i];
+		if (entry.shape < 0 || entry.shape >= static_cast<int>(combine.numShapes))
+			continue;
+		std::shared_ptr<Geometry::Shell> shell(new Geometry::Shell);
+		const osg::Vec3 *vertexs = combine.getVertexs(entry.firstVertex);
+		shell->vertexs.assign(vertexs, vertexs + entry.numVertexs);
+		shell->faces.assign(combine.faces + entry.firstFace, combine.faces + entry.firstFace + entry.numFaces);
+		shapes[entry.shape].shells.push_back(shell);
+	}
 
+	for (unsigned int i = 0; i < combine.numMeshs; ++i)
+	{
+		const CombineBlock::Mesh &entry = combine.meshs[i];
+		if (entry.shape < 0 || entry.shape >= static_cast<int>(combine.numShapes))
+			continue;
 		std::shared_ptr<Geometry::Mesh> mesh(new Geometry::Mesh);
-		mesh->rows = rows;
-		mesh->colums = columns;
-		auto iter = cgMap.find(cgId);
-		if (iter != cgMap.end())
-			iter->second->addMesh(mesh);
+		mesh->rows = entry.rows;
+		mesh->colums = entry.columns;
+		const osg::Vec3 *vertexs = combine.getVertexs(entry.firstVertex);
+		mesh->vertexs.assign(vertexs, vertexs + entry.numVertexs);
+		shapes[entry.shape].meshs.push_back(mesh);
 	}
-	m_errorCode = sqlite3_finalize(pStmt);
-	pStmt = NULL;
-
-
-	const wchar_t *zMeshVertexSql = L"select pos_x, pos_y, pos_z, mesh_id from mesh_vertex order by id asc";
-	if ((m_errorCode = sqlite3_prepare16(m_pDb, zMeshVertexSql, -1, &pStmt, &pzTail)) != SQLITE_OK)
-		return false;
 
-	int meshId;
-	while ((m_errorCode = sqlite3_step(pStmt)) != SQLITE_DONE)
+	for (unsigned int i = 0; i < combine.numPolygons; ++i)
 	{
-		if (m_errorCode != SQLITE_ROW)
-		{
-			sqlite3_finalize(pStmt);
-			return false;
-		}
+		const CombineBlock::Polygon &entry = combine.polygons[i];
+		if (entry.shape < 0 || entry.shape >= static_cast<int>(combine.numShapes))
+			continue;
+		std::shared_ptr<Geometry::Polygon> polygon(new Geometry::Polygon);
+		const osg::Vec3 *vertexs = combine.getVertexs(entry.firstVertex);
+		polygon->vertexs.assign(vertexs, vertexs + entry.numVertexs);
+		shapes[entry.shape].polygons.push_back(polygon);
+	}
 
-		int iCol = 0;
-		pos[0] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		pos[1] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		pos[2] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		meshId = sqlite3_column_int(pStmt, iCol);
-
-		auto iter = meshMap.find(meshId);
-		if (iter != meshMap.end())
-			iter->second->vertexs.push_back(pos);
+	std::vector<unsigned int> numUses(combine.numShapes, 0);
+	for (unsigned int i = 0; i < combine.numGeometries; ++i)
+	{
+		if (combine.shapes[i] >= 0)
+			++numUses[combine.shapes[i]];
 	}
-	m_errorCode = sqlite3_finalize(pStmt);
-	pStmt = NULL;
 
-	const wchar_t *zPolygonSql = L"select id, combine_geometry_id from polygon";
-	if ((m_errorCode = sqlite3_prepare16(m_pDb, zPolygonSql, -1, &pStmt, &pzTail)) != SQLITE_OK)
-		return false;
+	// A shape placed more than once is drawn once per color, in its own
+	// frame, and every geometry adds a transform over that node the way a
+	// block reference does. Batches merge their geometries anyway, there
+	// every geometry gets its vertexs placed.
+	typedef std::map<std::pair<int, int>, osg::ref_ptr<osg::Geode>> ShapeNodeMap;
+	ShapeNodeMap shapeNodes;
+	auto placeGeometry = [&](osg::Group *group, BatchMap &batchs, unsigned int i) {
+		int shape = combine.shapes[i];
+		int color = combine.colors[i];
+		osg::Matrixd matrix(combine.matrices + i * 16);
+		if (m_batchMode || numUses[shape] == 1)
+		{
+			addGeometry(group, batchs, color, PlaceShape(shapes[shape], matrix, color));
+			return;
+		}
 
-	while ((m_errorCode = sqlite3_step(pStmt)) != SQLITE_DONE)
+		// the Geode is made now rather than after a parallel draw(), so the
+		// DynamicLOD takes every transform over it for an instance it can
+		// cull and draw as an occluder
+		osg::ref_ptr<osg::Geode> &node = shapeNodes[std::make_pair(shape, color)];
+		if (!node.valid())
+		{
+			osg::ref_ptr<Geometry::CombineGeometry> geometry = PlaceShape(shapes[shape], osg::Matrixd::identity(), color);
+			node = new osg::Geode;
+			node->addDrawable(geometry);
+			drawGeometry(geometry);
+		}
+		osg::ref_ptr<osg::MatrixTransform> transform(new osg::MatrixTransform(matrix));
+		transform->addChild(node);
+		group->addChild(transform);
+	};
+
+	// one DynamicLOD per block definition, the geometries keep their order in
+	// it; the LOD culls them and draws them into the occlusion buffer
+	std::vector<unsigned int> order(combine.numGeometries);
+	for (unsigned int i = 0; i < combine.numGeometries; ++i)
+		order[i] = i;
+	std::stable_sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b) {
+		return combine.blockIds[a] < combine.blockIds[b];
+	});
+
+	for (unsigned int first = 0; first < combine.numGeometries;)
 	{
-		if (m_errorCode != SQLITE_ROW)
+		int blockId = combine.blockIds[order[first]];
+		osg::ref_ptr<Geometry::DynamicLOD> lod(new Geometry::DynamicLOD(m_mani));
+		BatchMap batchs;
+		unsigned int last = first;
+		for (; last < combine.numGeometries && combine.blockIds[order[last]] == blockId; ++last)
 		{
-			sqlite3_finalize(pStmt);
-			return false;
+			if (combine.shapes[order[last]] >= 0)
+				placeGeometry(lod, batchs, order[last]);
 		}
-
-		int iCol = 0;
-		id = sqlite3_column_int(pStmt, iCol);
-		++iCol;
-		cgId = sqlite3_column_int(pStmt, iCol);
-
-		std::shared_ptr<Geometry::Polygon> polygon(new Geometry::Polygon);
-		polygonMap.insert(std::make_pair(id, polygon));
-		auto iter = cgMap.find(cgId);
-		if (iter != cgMap.end())
-			iter->second->addPolygon(polygon);
+		flushBatchs(lod, batchs);
+		getBlockGroup(blockId)->addChild(lod);
+		first = last;
 	}
-	m_errorCode = sqlite3_finalize(pStmt);
-	pStmt = NULL;
-
-	const wchar_t *zPolygonVertexSql = L"select pos_x, pos_y, pos_z, polygon_id from polygon_vertex order by id asc";
-	if ((m_errorCode = sqlite3_prepare16(m_pDb, zPolygonVertexSql, -1, &pStmt, &pzTail)) != SQLITE_OK)
-		return false;
+}
 
-	int polygonId;
-	while ((m_errorCode = sqlite3_step(pStmt)) != SQLITE_DONE)
+void SqliteLoad::buildProfiles(const ProfileBlock &profiles)
+{
+	// one run of rows per block definition
+	for (unsigned int first = 0; first < profiles.numRevolves;)
 	{
-		if (m_errorCode != SQLITE_ROW)
+		int blockId = profiles.revolves[first].block;
+		osg::ref_ptr<Geometry::DynamicLOD> lod(new Geometry::DynamicLOD(m_mani));
+		BatchMap batchs;
+		unsigned int last = first;
+		for (; last < profiles.numRevolves && profiles.revolves[last].block == blockId; ++last)
 		{
-			sqlite3_finalize(pStmt);
-			return false;
+			const ProfileBlock::Revolve &entry = profiles.revolves[last];
+			osg::ref_ptr<Geometry::Revolve> revolve(new Geometry::Revolve);
+			revolve->setAxisPnt(osg::Vec3(entry.axisPnt[0], entry.axisPnt[1], entry.axisPnt[2]));
+			revolve->setAxis(osg::Vec3(entry.axis[0], entry.axis[1], entry.axis[2]));
+			revolve->setAngle(entry.angle);
+			const osg::Vec3 *vertexs = profiles.getVertexs(entry.firstVertex);
+			revolve->setVertexs(std::vector<osg::Vec3>(vertexs, vertexs + entry.numVertexs));
+			const int *flags = profiles.flags + entry.firstVertex;
+			revolve->setFlags(std::vector<int>(flags, flags + entry.numVertexs));
+			revolve->setColor(CvtColor(entry.color));
+			addGeometry(lod, batchs, entry.color, revolve);
 		}
-
-		int iCol = 0;
-		pos[0] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		pos[1] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		pos[2] = sqlite3_column_double(pStmt, iCol);
-		++iCol;
-		polygonId = sqlite3_column_int(pStmt, iCol);
-
-		auto iter = polygonMap.find(polygonId);
-		if (iter != polygonMap.end())
-			iter->second->vertexs.push_back(pos);
+		flushBatchs(lod, batchs);
+		getBlockGroup(blockId)->addChild(lod);
+		first = last;
 	}
-	m_errorCode = sqlite3_finalize(pStmt);
-	pStmt = NULL;
 
-	osg::ref_ptr<osg::Group> group(new osg::Group);
-	for each(auto &entry in cgMap)
+	for (unsigned int first = 0; first < profiles.numExtrusions;)
 	{
-		entry.second->draw();
-		osg::ref_ptr<osg::Geode> cgGeode(new osg::Geode);
-		cgGeode->addDrawable(entry.second);
-		group->addChild(cgGeode);
+		int blockId = profiles.extrusions[first].block;
+		osg::ref_ptr<Geometry::DynamicLOD> lod(new Geometry::DynamicLOD(m_mani));
+		BatchMap batchs;
+		unsigned int last = first;
+		for (; last < profiles.numExtrusions && profiles.extrusions[last].block == blockId; ++last)
+		{
+			const ProfileBlock::Extrusion &entry = profiles.extrusions[last];
+			osg::ref_ptr<Geometry::Extrusion> extrusion(new Geometry::Extrusion);
+			extrusion->setHeight(osg::Vec3(entry.height[0], entry.height[1], entry.height[2]));
+			const osg::Vec3 *vertexs = profiles.getVertexs(entry.firstVertex);
+			extrusion->setVertexs(std::vector<osg::Vec3>(vertexs, vertexs + entry.numVertexs));
+			const int *flags = profiles.flags + entry.firstVertex;
+			extrusion->setFlags(std::vector<int>(flags, flags + entry.numVertexs));
+			const int *loops = profiles.loops + entry.firstLoop;
+			extrusion->setLoopSizes(std::vector<int>(loops, loops + entry.numLoops));
+			extrusion->setColor(CvtColor(entry.color));
+			addGeometry(lod, batchs, entry.color, extrusion);
+		}
+		flushBatchs(lod, batchs);
+		getBlockGroup(blockId)->addChild(lod);
+		first = last;
 	}
-	m_root->addChild(group);
-	return true;
-}
\ No newline at end of file
+}
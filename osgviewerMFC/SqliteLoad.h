@@ -1,9 +1,23 @@
 #pragma once
 #include <string>
+#include <map>
+#include <vector>
 #include <osg/ref_ptr>
 #include <osg/Group>
 #include "sqlite3.h"
 #include <ViewCenterManipulator.h>
+#include "ModelCache.h"
+
+namespace OpenThreads
+{
+class Atomic;
+}
+
+namespace Geometry
+{
+class BaseGeometry;
+class BatchGeometry;
+}
 
 class SqliteLoad
 {
@@ -12,24 +26,144 @@ public:
 	~SqliteLoad();
 	bool doLoad();
 	const char *getErrorMessage() const;
+	// load time and prototype cache statistics of the last doLoad()
+	const std::string &getReport() const;
+
+	// Merge primitives of one type and color into shared buffers instead of
+	// one Geode per primitive.
+	void setBatchMode(bool batchMode);
+	bool isBatchMode() const;
+
+	// Draw repeated cylinders, boxes and elbows from shared unit space
+	// prototypes, on by default. Ignored in batch mode.
+	void setInstancing(bool instancing);
+	bool isInstancing() const;
+
+	// Scan the tables and tessellate on worker threads, each with its own
+	// read-only connection; the scene is assembled on the calling thread in
+	// the serial order. 0 uses one thread per core, 1 (default) loads serially.
+	void setNumThreads(unsigned int numThreads);
+	unsigned int getNumThreads() const;
+
+	// Read the tables from the binary cache next to the database when it is
+	// up to date, and write it after a database read. After an incremental
+	// export only the tables whose revision changed are read from the
+	// database, the others still come from the cache. On by default.
+	void setUseCache(bool useCache);
+	bool isUseCache() const;
+
+	// Division the primitives are first drawn at, before a cull picks one;
+	// 0 (default) keeps g_defaultDivision. The headless tiler loads each
+	// level at its own division.
+	void setDivision(int division);
+	int getDivision() const;
 
 private:
+	typedef std::map<int, osg::ref_ptr<Geometry::BatchGeometry>> BatchMap;
+	typedef std::map<int, osg::ref_ptr<osg::Group>> BlockGroupMap;
+	// builds rows [first, last) of block under parent
+	typedef void (SqliteLoad::*TableBuilder)(const ParamBlock &block, unsigned int first, unsigned int last,
+		osg::Group *parent);
+	enum { MAX_BATCH_SIZE = 4096 };
+	// newest schema_version this loader reads
+	enum { SCHEMA_VERSION = 6 };
+
+	// primitive waiting for draw() and insertion under parent, a NULL parent
+	// when the geometry already sits in its node
+	struct Pending
+	{
+		osg::ref_ptr<osg::Group> parent;
+		osg::ref_ptr<Geometry::BaseGeometry> geometry;
+	};
+
+	// primitive table, read into a ParamBlock of numParams doubles per row
+	// followed by the color
+	struct TableDef
+	{
+		const wchar_t *sql;
+		unsigned int numParams;
+		TableBuilder builder;
+	};
+
+	struct ReadResult
+	{
+		ReadResult();
+
+		bool ok;
+		int errorCode;
+		std::string errorMessage;
+	};
+
+	static const TableDef TABLES[];
+	static const unsigned int NUM_TABLES;
+
+	// reads the blocks set in pReload, all when NULL; the primitive tables
+	// come first, then combine_geometry, block_reference, revolve and
+	// extrusion, the last two into one block
+	bool readSerial(std::vector<ParamBlock> &blocks, CombineBlock &combine, ReferenceBlock &references,
+		ProfileBlock &profiles, const std::vector<bool> *pReload = NULL);
+	// reads the blocks whose revision differs from the one in cache and
+	// takes the others from it, false when the cache cannot be used
+	bool readChanged(ModelCache &cache, const std::vector<long long> &revisions, std::vector<ParamBlock> &blocks,
+		CombineBlock &combine, ReferenceBlock &references, ProfileBlock &profiles, unsigned int &numReloaded);
+	bool readParallel(unsigned int numThreads, std::vector<ParamBlock> &blocks, CombineBlock &combine,
+		ReferenceBlock &references, ProfileBlock &profiles);
+	void readTables(std::vector<ParamBlock> &blocks, CombineBlock &combine, ReferenceBlock &references,
+		ProfileBlock &profiles, std::vector<ReadResult> &results, OpenThreads::Atomic &nextTable);
+	bool readParams(const wchar_t *zSql, unsigned int numParams, ParamBlock &block);
+	int readSchemaVersion();
+	// v4, table_revision in the order of readSerial()
+	bool readRevisions(std::vector<long long> &revisions);
+	bool readCombineGeometry(CombineBlock &combine);
+	// v1, a row per vertex and per face list entry
+	bool readRowParts(const std::vector<int> &shapeIds, CombineBlock &combine);
+	// v2, packed blobs on the shell, mesh and polygon rows; from v6 the parts
+	// belong to a combine_shape
+	bool readPackedParts(const std::vector<int> &shapeIds, CombineBlock &combine);
+	// v3, block_reference rows
+	bool readReferences(ReferenceBlock &references);
+	// v5, revolve and extrusion rows with their packed profiles
+	bool readProfiles(ProfileBlock &profiles);
+	// func(pStmt) for each row of zSql
+	template<class Func>
+	bool readRows(const wchar_t *zSql, Func func);
+	// func(owner, pStmt) for each row of zSql, without an order by, whose
+	// first column, zOwnerColumn, is one of the ascending ownerIds; owner is
+	// its position there. The rows of an owner come in one run, in id order.
+	template<class Func, class Reset>
+	bool readChildren(const wchar_t *zSql, const wchar_t *zOwnerColumn, const std::vector<int> &ownerIds,
+		Reset reset, Func func);
+
+	void buildScene(const std::vector<ParamBlock> &blocks, const CombineBlock &combine,
+		const ReferenceBlock &references, const ProfileBlock &profiles, unsigned int numThreads);
+	// m_root for the model space, else the group shared by the references
+	// of block definition blockId
+	osg::Group *getBlockGroup(int blockId);
+	void addNode(osg::Group *parent, Geometry::BaseGeometry *geometry);
+	// draw() of a geometry the caller put in its node, deferred like addNode()
+	void drawGeometry(Geometry::BaseGeometry *geometry);
+
+	void addGeometry(osg::Group *parent, BatchMap &batchs, int color, Geometry::BaseGeometry *geometry);
+	void flushBatchs(osg::Group *parent, BatchMap &batchs);
+	void addBatch(osg::Group *parent, Geometry::BatchGeometry *batch);
+
 	int init();
-	bool loadBox();
-	bool loadCircularTorus();
-	bool loadCone();
-	bool loadCylinder();
-	bool loadEllipsoid();
-	bool loadPrism();
-	bool loadPyramid();
-	bool loadRectCirc();
-	bool loadRectangularTorus();
-	bool loadSaddle();
-	bool loadSCylinder();
-	bool loadSnout();
-	bool loadSphere();
-	bool loadWedge();
-	bool loadCombineGeometry();
+	void buildBox(const ParamBlock &block, unsigned int first, unsigned int last, osg::Group *parent);
+	void buildCircularTorus(const ParamBlock &block, unsigned int first, unsigned int last, osg::Group *parent);
+	void buildCone(const ParamBlock &block, unsigned int first, unsigned int last, osg::Group *parent);
+	void buildCylinder(const ParamBlock &block, unsigned int first, unsigned int last, osg::Group *parent);
+	void buildEllipsoid(const ParamBlock &block, unsigned int first, unsigned int last, osg::Group *parent);
+	void buildPrism(const ParamBlock &block, unsigned int first, unsigned int last, osg::Group *parent);
+	void buildPyramid(const ParamBlock &block, unsigned int first, unsigned int last, osg::Group *parent);
+	void buildRectCirc(const ParamBlock &block, unsigned int first, unsigned int last, osg::Group *parent);
+	void buildRectangularTorus(const ParamBlock &block, unsigned int first, unsigned int last, osg::Group *parent);
+	void buildSaddle(const ParamBlock &block, unsigned int first, unsigned int last, osg::Group *parent);
+	void buildSCylinder(const ParamBlock &block, unsigned int first, unsigned int last, osg::Group *parent);
+	void buildSnout(const ParamBlock &block, unsigned int first, unsigned int last, osg::Group *parent);
+	void buildSphere(const ParamBlock &block, unsigned int first, unsigned int last, osg::Group *parent);
+	void buildWedge(const ParamBlock &block, unsigned int first, unsigned int last, osg::Group *parent);
+	void buildCombineGeometry(const CombineBlock &combine);
+	void buildProfiles(const ProfileBlock &profiles);
 
 private:
 	std::string m_filePath;
@@ -38,4 +172,65 @@ private:
 
 	sqlite3 *m_pDb;
 	int m_errorCode;
-};
\ No newline at end of file
+	int m_schemaVersion;
+	bool m_batchMode;
+	bool m_instancing;
+	unsigned int m_numThreads;
+	bool m_useCache;
+	int m_division;
+	std::string m_report;
+	std::string m_errorMessage;
+	// set while building for a parallel load, draw() is deferred to the pool
+	std::vector<Pending> *m_pendings;
+	BlockGroupMap m_blockGroups;
+};
+
+inline void SqliteLoad::setBatchMode(bool batchMode)
+{
+	m_batchMode = batchMode;
+}
+
+inline bool SqliteLoad::isBatchMode() const
+{
+	return m_batchMode;
+}
+
+inline void SqliteLoad::setInstancing(bool instancing)
+{
+	m_instancing = instancing;
+}
+
+inline bool SqliteLoad::isInstancing() const
+{
+	return m_instancing;
+}
+
+inline void SqliteLoad::setNumThreads(unsigned int numThreads)
+{
+	m_numThreads = numThreads;
+}
+
+inline unsigned int SqliteLoad::getNumThreads() const
+{
+	return m_numThreads;
+}
+
+inline void SqliteLoad::setUseCache(bool useCache)
+{
+	m_useCache = useCache;
+}
+
+inline bool SqliteLoad::isUseCache() const
+{
+	return m_useCache;
+}
+
+inline void SqliteLoad::setDivision(int division)
+{
+	m_division = division;
+}
+
+inline int SqliteLoad::getDivision() const
+{
+	return m_division;
+}
\ No newline at end of file
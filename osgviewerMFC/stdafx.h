@@ -4,6 +4,19 @@
 
 #pragma once
 
+#ifdef NO_MFC
+
+// SqliteLoad and ModelCache built into the headless DbTiler, without MFC
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#endif
+#define _USE_MATH_DEFINES
+#include <cmath>
+#include <string>
+
+#else
+
 #ifndef _SECURE_ATL
 #define _SECURE_ATL 1
 #endif
@@ -70,4 +83,6 @@ using namespace std::tr2::sys;
 
 
 #include <osgGA/FlightManipulator>
-#include <osg/CullFace>
\ No newline at end of file
+#include <osg/CullFace>
+
+#endif // NO_MFC